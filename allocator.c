@@ -0,0 +1,137 @@
+﻿/*****************************************************************//**
+ * @file   allocator.c
+ * @brief  A memóriafoglalás módját (debugmalloc, libc, nagy lapok)
+ * egységes felületen elérhetővé tevő modul forrásfájlja.
+ *
+ * A program kisebb foglalásai (struktúrák, sorpufferek) debug buildben a
+ * debugmalloc-on, release buildben közvetlenül a libc-n keresztül
+ * történnek. A nagy memóriaterületek (pixelmátrixok) foglalásának módja
+ * futásidőben is választható: a nagy lapos mód a legalább
+ * PLATFORM_HUGE_PAGE_SIZE méretű területeket 2 MB-ra igazítva, átlátszó
+ * nagy lapok kérésével képezi le, ami a nagy képeken kevesebb TLB-tévesztést
+ * eredményez.
+ *
+ * A modul nem szálbiztos: a foglalás módja csak az első foglalás előtt
+ * változtatható meg, a foglalások pedig (a debugmalloc miatt) csak egy
+ * szálból történhetnek.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "allocator.h"
+#include "platform.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* a nagy memóriaterületek foglalásának aktuális módja */
+static AllocatorBackend allocator_backend = ALLOCATOR_DEFAULT_BACKEND;
+
+/**
+ * Beállítja a nagy memóriaterületek foglalásának módját. Release buildben
+ * a debugmalloc nem érhető el, helyette a libc foglal.
+ *
+ * @param backend A foglalás módja.
+ */
+void allocator_set_backend(AllocatorBackend backend)
+{
+#ifdef NDEBUG
+	if (backend == ALLOCATOR_DEBUG)
+		backend = ALLOCATOR_LIBC;
+#endif
+	allocator_backend = backend;
+}
+
+/**
+ * Megadja a nagy memóriaterületek foglalásának aktuális módját.
+ *
+ * @return Visszatér a foglalás módjával.
+ */
+AllocatorBackend allocator_get_backend(void)
+{
+	return allocator_backend;
+}
+
+/**
+ * Megvizsgálja, hogy egy adott méretű terület nagy lapokra kerül-e.
+ *
+ * @param size A terület mérete (bájtban).
+ * @return Logikai igazzal tér vissza, ha a terület nagy lapokra kerül.
+ */
+static bool allocator_uses_pages(size_t size)
+{
+	return allocator_backend == ALLOCATOR_HUGE_PAGES && size >= PLATFORM_HUGE_PAGE_SIZE;
+}
+
+/**
+ * Lefoglal egy nagy memóriaterületet az aktuális foglalási móddal.
+ *
+ * A lefoglalt memóriaterület felszabadítása (allocator_free) a hívó
+ * feladata.
+ *
+ * @param size A terület mérete (bájtban).
+ * @return Sikeres lefutás esetén a lefoglalt területtel, egyébként
+ * NULL-pointerrel tér vissza.
+ */
+void* allocator_allocate(size_t size)
+{
+	if (size == 0)
+		size = 1;
+
+	if (allocator_uses_pages(size))
+		return platform_allocate_pages(size);
+
+	if (allocator_backend == ALLOCATOR_DEBUG)
+	{
+		allocator_reserve(size);
+		return malloc(size);
+	}
+
+	/* a zárójelezett név a debugmalloc makróját megkerülve a libc-t hívja */
+	return (malloc)(size);
+}
+
+/**
+ * Felszabadít egy allocator_allocate által foglalt memóriaterületet.
+ *
+ * @param block A terület (vagy NULL).
+ * @param size A terület foglaláskor megadott mérete (bájtban).
+ */
+void allocator_free(void* block, size_t size)
+{
+	if (block == NULL)
+		return;
+
+	if (size == 0)
+		size = 1;
+
+	if (allocator_uses_pages(size))
+		platform_free_pages(block, size);
+	else if (allocator_backend == ALLOCATOR_DEBUG)
+		free(block);
+	else
+		(free)(block);
+}
+
+/**
+ * Felkészíti a debugmalloc-ot egy adott méretű foglalásra: szükség esetén
+ * megemeli a blokkok méretkorlátját (melyet a kis méretű foglalásokra
+ * alapértelmezetten meghagy). Release buildben nem csinál semmit.
+ *
+ * @param size A foglalás mérete (bájtban).
+ */
+void allocator_reserve(size_t size)
+{
+#ifndef NDEBUG
+	/* a korlát long típusú, ami Windowson 32 bites is lehet */
+	if (size > debugmalloc_max_block_size_default)
+		debugmalloc_max_block_size(size < (size_t)LONG_MAX ? (long)size : LONG_MAX);
+#else
+	(void)size;
+#endif
+}
@@ -0,0 +1,40 @@
+﻿/*****************************************************************//**
+ * @file   allocator.h
+ * @brief  A memóriafoglalás módját (debugmalloc, libc, nagy lapok)
+ * egységes felületen elérhetővé tevő modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef ALLOCATOR_H_INCLUDED
+#define ALLOCATOR_H_INCLUDED
+
+#include <stddef.h>
+
+/**
+ * @brief A nagy memóriaterületek (pixelmátrixok) foglalásának módja.
+ */
+typedef enum allocator_backend_enum
+{
+	ALLOCATOR_DEBUG, /* debugmalloc (csak debug buildben) */
+	ALLOCATOR_LIBC, /* a szabványos könyvtár malloc/free függvényei */
+	ALLOCATOR_HUGE_PAGES /* 2 MB-ra igazított, nagy lapokkal leképezett memória */
+} AllocatorBackend;
+
+/*
+ * Release buildben (NDEBUG) a debugmalloc nem kerül befordításra, a nagy
+ * memóriaterületek pedig alapértelmezetten nagy lapokra kerülnek.
+ */
+#ifdef NDEBUG
+#define ALLOCATOR_DEFAULT_BACKEND	ALLOCATOR_HUGE_PAGES
+#else
+#define ALLOCATOR_DEFAULT_BACKEND	ALLOCATOR_DEBUG
+#endif
+
+void allocator_set_backend(AllocatorBackend backend);
+AllocatorBackend allocator_get_backend(void);
+void* allocator_allocate(size_t size);
+void allocator_free(void* block, size_t size);
+void allocator_reserve(size_t size);
+
+#endif /* ALLOCATOR_H_INCLUDED */
@@ -0,0 +1,632 @@
+﻿/*****************************************************************//**
+ * @file   batch.c
+ * @brief  Egy műveletsort egy vagy több képfájlon végrehajtó (kötegelt
+ * feldolgozást megvalósító) modul forrásfájlja.
+ *
+ * A kötegelt feldolgozás a fájlokat egy munkáskészlet részfeladataiként
+ * dolgozza fel: minden munkás egy-egy teljes fájlt tölt be, alakít át és
+ * ír ki, így az egyik fájl beolvasása és kiírása átfedi a többi fájl
+ * feldolgozását, a processzindítás és az allokátor bemelegedése pedig
+ * csak egyszer fizetődik meg. Az egyszerre feldolgozott képek becsült
+ * memóriaigénye nem lépheti túl a megadott korlátot: a korlát elérésekor
+ * a munkások a korábbi képek végzéséig várakoznak.
+ *
+ * A debugmalloc nem szálbiztos, ezért debug buildben a fájlok egymás után
+ * kerülnek feldolgozásra, a munkáskészlet szálai pedig az egyes képeken
+ * végzett műveleteket gyorsítják.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "batch.h"
+#include "status.h"
+#include "image.h"
+#include "bmp.h"
+#include "stream.h"
+#include "platform.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* a listafájl egy sorának legnagyobb hossza */
+#define BATCH_MAX_LINE			4096
+
+/* a kötegelt feldolgozás részfeladatainak közös állapota */
+struct batch_context_struct
+{
+	BatchJob* jobs; /* a fájlok */
+	const Operation* operations; /* a műveletek */
+	int count; /* a műveletek száma */
+	const Options* options; /* a beállítások */
+	ThreadPool* pool; /* a képeken végzett műveletek munkáskészlete, vagy NULL */
+	PlatformMutex* mutex; /* a memóriahasználatot védő zár */
+	PlatformCondition* memory_released; /* memória felszabadulását jelző feltételváltozó */
+	uint64_t memory_limit; /* az egyszerre feldolgozott képek memóriakorlátja (bájtban) */
+	uint64_t memory_in_use; /* a feldolgozás alatt álló képek becsült memóriaigénye */
+};
+
+/* a könyvtárbejárás állapota */
+struct batch_directory_struct
+{
+	BatchJob* jobs; /* az eddig összegyűjtött fájlok */
+	int count; /* az eddig összegyűjtött fájlok száma */
+	int capacity; /* a tömb kapacitása */
+	const char* input_directory; /* a bemeneti könyvtár */
+	const char* output_directory; /* a kimeneti könyvtár */
+};
+
+/**
+ * Megvizsgálja, hogy egy műveletsort érdemes-e síkos elrendezésű képen
+ * végrehajtani. Ez akkor éri meg, ha a műveletek között van konvolúció
+ * (elhomályosítás/élesítés), a többi művelet ugyanis nem gyorsul annyit,
+ * hogy az átalakítás költsége megtérüljön.
+ *
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @return Logikai igazzal tér vissza, ha a síkos elrendezés előnyösebb.
+ */
+static bool operations_prefer_planar(const Operation* operations, int count)
+{
+	for (int i = 0; i < count; i++)
+		if (operations[i].type == OPERATION_BLUR)
+			return true;
+	return false;
+}
+
+/**
+ * Megvizsgálja, hogy egy műveletsor a sorfolyamban, a teljes kép
+ * memóriába töltése nélkül hajtható-e végre.
+ *
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @param options A beállítások.
+ * @return Logikai igazzal tér vissza, ha a kép soronként feldolgozható.
+ */
+static bool batch_is_streamed(const Operation* operations, int count, const Options* options)
+{
+	/* a palettás kimenethez a teljes kép színeit ismerni kell */
+	return options->output_format == BMP_FORMAT_RGB24 && stream_is_supported(operations, count);
+}
+
+/**
+ * Végrehajt egy műveletsort egy megnyitott bemeneti képfájlon, és az
+ * eredményt kiírja egy megnyitott kimeneti fájlba. Soronként elvégezhető
+ * műveletsor esetén a kép nem kerül a memóriába, a sorfolyam blokkjait a
+ * képműveletek munkáskészlete (lásd image_set_thread_pool) dolgozza fel;
+ * egyébként a kép a fájl leképezésén keresztül töltődik be.
+ *
+ * @param input_file A bemeneti fájl (az elejére pozícionálva).
+ * @param output_file A kimeneti fájl.
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @param options A beállítások.
+ * @param pool A beolvasást, a műveleteket és a kiírást gyorsító
+ * munkáskészlet, vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a beolvasás, a
+ * műveletek vagy a kiírás hibakódjával tér vissza.
+ */
+int batch_process_file(FILE* input_file, FILE* output_file, const Operation* operations, int count, const Options* options, ThreadPool* pool)
+{
+	int status;
+
+	if (batch_is_streamed(operations, count, options))
+		return stream_process(input_file, output_file, operations, count);
+
+	Image* image;
+
+	if ((status = bmp_load_mapped(&image, input_file, pool)) != NO_ERROR)
+		return status;
+
+	/* a konvolúciók síkonként gyorsabbak, az átalakítás egyszer fizetődik ki */
+	if (options->tiled)
+		status = image_set_layout(image, IMAGE_LAYOUT_TILED);
+	else if (operations_prefer_planar(operations, count))
+		status = image_set_layout(image, IMAGE_LAYOUT_PLANAR);
+	if (status != NO_ERROR)
+		goto destroy_image;
+
+	/* az egymást követő pontműveletek egyetlen menetben futnak */
+	if ((status = cmd_execute_operations(image, operations, count)) != NO_ERROR)
+		goto destroy_image;
+
+	if (options->output_format != BMP_FORMAT_RGB24)
+		status = bmp_store_format((const Image**)&image, output_file, options->output_format, options->dither);
+	else if (pool != NULL)
+		status = bmp_store_parallel((const Image**)&image, output_file, pool);
+	else
+		status = bmp_store((const Image**)&image, output_file);
+
+destroy_image:
+	image_destroy(image);
+
+	return status;
+}
+
+/**
+ * Lemásol egy sztringet egy dinamikusan foglalt memóriaterületre.
+ *
+ * @param string A sztring.
+ * @param length A sztring hossza.
+ * @return Sikeres lefutás esetén a másolattal, egyébként NULL-pointerrel
+ * tér vissza.
+ */
+static char* batch_copy_string(const char* string, size_t length)
+{
+	char* copy = (char*)malloc(length + 1);
+	if (copy == NULL)
+		return NULL;
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+/**
+ * Hozzáfűz egy bemeneti és kimeneti fájlpárt egy dinamikusan növelt
+ * tömbhöz; a tömb kapacitása szükség esetén megduplázódik.
+ *
+ * @param p_jobs A tömb helye.
+ * @param p_count A tömb elemszámának helye.
+ * @param p_capacity A tömb kapacitásának helye.
+ * @param input_path A bemeneti fájl elérési útja (dinamikusan foglalt, a
+ * tömb tulajdonába kerül).
+ * @param output_path A kimeneti fájl elérési útja (dinamikusan foglalt, a
+ * tömb tulajdonába kerül).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza; ilyenkor az elérési utak felszabadításra kerülnek.
+ */
+static int batch_append_job(BatchJob** p_jobs, int* p_count, int* p_capacity, char* input_path, char* output_path)
+{
+	if (input_path == NULL || output_path == NULL)
+		goto free_paths;
+
+	if (*p_count == *p_capacity)
+	{
+		int capacity = (*p_capacity > 0) ? 2 * *p_capacity : 16;
+		BatchJob* jobs = (BatchJob*)realloc(*p_jobs, capacity * sizeof(BatchJob));
+		if (jobs == NULL)
+			goto free_paths;
+		*p_jobs = jobs;
+		*p_capacity = capacity;
+	}
+
+	BatchJob* job = &(*p_jobs)[(*p_count)++];
+	job->input_path = input_path;
+	job->output_path = output_path;
+	job->status = NO_ERROR;
+	job->pixel_count = 0;
+
+	return NO_ERROR;
+
+free_paths:
+	if (input_path != NULL)
+		free(input_path);
+	if (output_path != NULL)
+		free(output_path);
+
+	return MEMORY_ERROR;
+}
+
+/**
+ * Beolvassa a feldolgozandó fájlpárokat egy listafájlból. A lista minden
+ * nem üres sora egy bemeneti és egy kimeneti fájl elérési útját
+ * tartalmazza tabulátorral, ennek hiányában az első szóközzel elválasztva.
+ *
+ * A lefoglalt memóriaterület felszabadítása (batch_destroy_jobs) a hívó
+ * feladata.
+ *
+ * @param p_jobs A fájlpárok tömbjének helye.
+ * @param p_count A fájlpárok számának helye.
+ * @param path A listafájl elérési útja.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a listafájl olvasási hibája
+ * esetén IO_ERROR-ral, kimeneti fájl nélküli sor esetén
+ * CMD_TOO_FEW_ARGUMENTS-szel, memóriafoglalási hiba esetén pedig
+ * MEMORY_ERROR-ral tér vissza.
+ */
+int batch_read_list(BatchJob** p_jobs, int* p_count, const char* path)
+{
+	int status = NO_ERROR;
+
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+		return IO_ERROR;
+
+	BatchJob* jobs = NULL;
+	int count = 0, capacity = 0;
+
+	char line[BATCH_MAX_LINE];
+	while (status == NO_ERROR && fgets(line, sizeof(line), file) != NULL)
+	{
+		size_t length = strcspn(line, "\r\n");
+		line[length] = '\0';
+		if (length == 0)
+			continue;
+
+		char* separator = strchr(line, '\t');
+		if (separator == NULL)
+			separator = strchr(line, ' ');
+		if (separator == NULL || separator == line || separator[1] == '\0')
+		{
+			status = CMD_TOO_FEW_ARGUMENTS;
+			break;
+		}
+
+		status = batch_append_job(&jobs, &count, &capacity,
+			batch_copy_string(line, separator - line), batch_copy_string(separator + 1, strlen(separator + 1)));
+	}
+	if (status == NO_ERROR && ferror(file))
+		status = IO_ERROR;
+
+	fclose(file);
+
+	if (status != NO_ERROR)
+	{
+		batch_destroy_jobs(jobs, count);
+		return status;
+	}
+
+	*p_jobs = jobs;
+	*p_count = count;
+
+	return NO_ERROR;
+}
+
+/**
+ * Megvizsgálja, hogy egy fájlnév .bmp kiterjesztésű-e (a kis- és
+ * nagybetűk megkülönböztetése nélkül).
+ *
+ * @param name A fájlnév.
+ * @return Logikai igazzal tér vissza, ha a kiterjesztés .bmp.
+ */
+static bool batch_is_bitmap_name(const char* name)
+{
+	const char* extension = ".bmp";
+	size_t length = strlen(name);
+	if (length <= 4)
+		return false;
+
+	for (size_t i = 0; i < 4; i++)
+		if (tolower((unsigned char)name[length - 4 + i]) != extension[i])
+			return false;
+	return true;
+}
+
+/**
+ * Összefűz egy könyvtárat és egy fájlnevet egy elérési úttá.
+ *
+ * @param directory A könyvtár.
+ * @param name A fájlnév.
+ * @return Sikeres lefutás esetén a dinamikusan foglalt elérési úttal,
+ * egyébként NULL-pointerrel tér vissza.
+ */
+static char* batch_join_path(const char* directory, const char* name)
+{
+	size_t directory_length = strlen(directory), name_length = strlen(name);
+	bool separated = directory_length > 0 && (directory[directory_length - 1] == '/' || directory[directory_length - 1] == '\\');
+
+	char* path = (char*)malloc(directory_length + 1 + name_length + 1);
+	if (path == NULL)
+		return NULL;
+
+	memcpy(path, directory, directory_length);
+	if (!separated)
+		path[directory_length++] = '/';
+	memcpy(path + directory_length, name, name_length + 1);
+
+	return path;
+}
+
+/**
+ * Felveszi egy könyvtár egy bejegyzését a feldolgozandó fájlok közé, ha
+ * az BMP kiterjesztésű (a könyvtárbejárás egy lépése).
+ *
+ * @param argument A könyvtárbejárás állapota.
+ * @param name A bejegyzés neve.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+static int batch_add_directory_entry(void* argument, const char* name)
+{
+	struct batch_directory_struct* directory = (struct batch_directory_struct*)argument;
+
+	if (!batch_is_bitmap_name(name))
+		return NO_ERROR;
+
+	return batch_append_job(&directory->jobs, &directory->count, &directory->capacity,
+		batch_join_path(directory->input_directory, name), batch_join_path(directory->output_directory, name));
+}
+
+/**
+ * Összehasonlít két fájlpárt a bemeneti fájlok elérési útja szerint (a
+ * qsort függvény számára).
+ *
+ * @param a Az egyik fájlpár.
+ * @param b A másik fájlpár.
+ * @return Visszatér a két elérési út strcmp szerinti viszonyával.
+ */
+static int batch_compare_jobs(const void* a, const void* b)
+{
+	return strcmp(((const BatchJob*)a)->input_path, ((const BatchJob*)b)->input_path);
+}
+
+/**
+ * Összegyűjti egy könyvtár BMP kiterjesztésű fájljait, név szerint
+ * rendezve; a kimeneti fájlok ugyanezzel a névvel a kimeneti könyvtárba
+ * kerülnek, mely szükség esetén létrejön.
+ *
+ * A lefoglalt memóriaterület felszabadítása (batch_destroy_jobs) a hívó
+ * feladata.
+ *
+ * @param p_jobs A fájlpárok tömbjének helye.
+ * @param p_count A fájlpárok számának helye.
+ * @param input_directory A bemeneti könyvtár.
+ * @param output_directory A kimeneti könyvtár.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a könyvtárak kezelésének
+ * hibája esetén IO_ERROR-ral, memóriafoglalási hiba esetén pedig
+ * MEMORY_ERROR-ral tér vissza.
+ */
+int batch_read_directory(BatchJob** p_jobs, int* p_count, const char* input_directory, const char* output_directory)
+{
+	int status;
+
+	if ((status = platform_create_directory(output_directory)) != NO_ERROR)
+		return status;
+
+	struct batch_directory_struct directory = { NULL, 0, 0, input_directory, output_directory };
+	if ((status = platform_list_directory(input_directory, batch_add_directory_entry, &directory)) != NO_ERROR)
+	{
+		batch_destroy_jobs(directory.jobs, directory.count);
+		return status;
+	}
+
+	if (directory.count > 1)
+		qsort(directory.jobs, directory.count, sizeof(BatchJob), batch_compare_jobs);
+
+	*p_jobs = directory.jobs;
+	*p_count = directory.count;
+
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadítja a fájlpárok tömbjét az elérési utakkal együtt.
+ *
+ * @param jobs A fájlpárok tömbje (vagy NULL).
+ * @param count A fájlpárok száma.
+ */
+void batch_destroy_jobs(BatchJob* jobs, int count)
+{
+	if (jobs == NULL)
+		return;
+
+	for (int i = 0; i < count; i++)
+	{
+		free(jobs[i].input_path);
+		free(jobs[i].output_path);
+	}
+	free(jobs);
+}
+
+/**
+ * Megbecsüli egy kép feldolgozásának memóriaigényét: a sorfolyamban
+ * feldolgozott képeknél ez a blokkok mérete, egyébként a műveletek alatt
+ * egyszerre legfeljebb a forrás és a cél pixelmátrix él, a skálázások
+ * pedig megváltoztatják a mátrixok méretét.
+ *
+ * @param info A bemeneti kép jellemzői.
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @param options A beállítások.
+ * @return Visszatér a becsült memóriaigénnyel (bájtban).
+ */
+static uint64_t batch_estimate_memory(const BmpInfo* info, const Operation* operations, int count, const Options* options)
+{
+	if (batch_is_streamed(operations, count, options))
+		return stream_estimate_memory(operations, count, info->width, info->height);
+
+	uint32_t width = info->width, height = info->height;
+	uint64_t size = info->memory_size;
+	uint64_t peak = 2 * size;
+
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t new_width = width, new_height = height;
+		if (operations[i].type == OPERATION_SCALE &&
+			image_scaled_size(width, height, &operations[i].param.scale, &new_width, &new_height) != NO_ERROR)
+			break;
+
+		uint64_t new_size = (uint64_t)image_calculate_stride(new_width) * new_height + IMAGE_ALIGNMENT - 1;
+		if (size + new_size > peak)
+			peak = size + new_size;
+
+		width = new_width;
+		height = new_height;
+		size = new_size;
+	}
+
+	return peak;
+}
+
+/**
+ * Lefoglal a memóriakorlátból egy kép feldolgozásához szükséges részt,
+ * szükség esetén a korábbi képek végzéséig várakozva. Egy kép (ha épp
+ * nincs más feldolgozás alatt) a korlátnál nagyobb igénnyel is elindul.
+ *
+ * @param context A kötegelt feldolgozás közös állapota.
+ * @param memory A becsült memóriaigény (bájtban).
+ */
+static void batch_acquire_memory(struct batch_context_struct* context, uint64_t memory)
+{
+	if (context->mutex == NULL)
+		return;
+
+	platform_mutex_lock(context->mutex);
+	while (context->memory_in_use > 0 && context->memory_in_use + memory > context->memory_limit)
+		platform_condition_wait(context->memory_released, context->mutex);
+	context->memory_in_use += memory;
+	platform_mutex_unlock(context->mutex);
+}
+
+/**
+ * Visszaadja a memóriakorlátnak egy kép feldolgozásához lefoglalt részt,
+ * és felébreszti a várakozó munkásokat.
+ *
+ * @param context A kötegelt feldolgozás közös állapota.
+ * @param memory A becsült memóriaigény (bájtban).
+ */
+static void batch_release_memory(struct batch_context_struct* context, uint64_t memory)
+{
+	if (context->mutex == NULL)
+		return;
+
+	platform_mutex_lock(context->mutex);
+	context->memory_in_use -= memory;
+	platform_condition_broadcast(context->memory_released);
+	platform_mutex_unlock(context->mutex);
+}
+
+/**
+ * Feldolgoz egy fájlt (a kötegelt feldolgozás egy részfeladata): a fejlécek
+ * alapján megbecsüli a memóriaigényét, kivárja, hogy az beleférjen a
+ * korlátba, majd betölti, átalakítja és kiírja a képet.
+ *
+ * @param argument A kötegelt feldolgozás közös állapota.
+ * @param task A fájl indexe.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void batch_file_task(void* argument, size_t task, int worker)
+{
+	(void)worker;
+
+	struct batch_context_struct* context = (struct batch_context_struct*)argument;
+	BatchJob* job = &context->jobs[task];
+
+	int status;
+
+	FILE* input_file = fopen(job->input_path, "rb");
+	if (input_file == NULL)
+	{
+		job->status = IO_ERROR;
+		return;
+	}
+
+	BmpInfo info;
+	if ((status = bmp_probe(&info, input_file)) != NO_ERROR)
+		goto close_input;
+	rewind(input_file);
+
+	uint64_t memory = batch_estimate_memory(&info, context->operations, context->count, context->options);
+	batch_acquire_memory(context, memory);
+
+	FILE* output_file = fopen(job->output_path, "wb");
+	if (output_file == NULL)
+		status = IO_ERROR;
+	else
+	{
+		status = batch_process_file(input_file, output_file, context->operations, context->count, context->options, context->pool);
+		if (fclose(output_file) != 0 && status == NO_ERROR)
+			status = IO_ERROR;
+	}
+
+	batch_release_memory(context, memory);
+
+	if (status == NO_ERROR)
+		job->pixel_count = (uint64_t)info.width * info.height;
+
+close_input:
+	fclose(input_file);
+	job->status = status;
+}
+
+/**
+ * Végrehajt egy műveletsort több fájlon. Release buildben a fájlok a
+ * beállított számú szálon, egymással párhuzamosan (szálanként egy-egy
+ * fájl) kerülnek feldolgozásra, az egyszerre feldolgozott képek becsült
+ * memóriaigénye pedig nem lépi túl a beállított korlátot; debug buildben a
+ * fájlok egymás után, a szálak a képeken végzett műveleteken dolgoznak.
+ * Egy fájl hibája nem szakítja meg a többi feldolgozását, a fájlonkénti
+ * hibakódok a fájlpárok status mezőjébe kerülnek.
+ *
+ * @param jobs A fájlpárok tömbje.
+ * @param job_count A fájlpárok száma.
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @param options A beállítások.
+ * @param p_statistics Az összesített eredmény helye.
+ * @return Sikeres lefutás esetén (a fájlok hibáitól függetlenül)
+ * NO_ERROR-ral, egyébként MEMORY_ERROR-ral tér vissza.
+ */
+int batch_run(BatchJob* jobs, int job_count, const Operation* operations, int count, const Options* options, BatchStatistics* p_statistics)
+{
+	int status;
+
+#ifdef NDEBUG
+	int file_threads = (options->thread_count < job_count) ? options->thread_count : job_count;
+#else
+	int file_threads = 1;
+#endif
+	if (file_threads < 1)
+		file_threads = 1;
+
+	struct batch_context_struct context = {
+		.jobs = jobs,
+		.operations = operations,
+		.count = count,
+		.options = options,
+		.pool = NULL,
+		.mutex = NULL,
+		.memory_released = NULL,
+		.memory_limit = (uint64_t)options->memory_limit << 20,
+		.memory_in_use = 0
+	};
+
+	ThreadPool* file_pool;
+	if ((status = threadpool_create(&file_pool, file_threads)) != NO_ERROR)
+		return status;
+
+	/* egy fájl egyszerre: a szálak a képeken végzett műveleteket gyorsítják */
+	if (file_threads == 1 && options->thread_count > 1 && (status = threadpool_create(&context.pool, options->thread_count)) != NO_ERROR)
+		goto destroy_pool;
+
+	if (file_threads > 1 &&
+		((status = platform_mutex_create(&context.mutex)) != NO_ERROR ||
+		(status = platform_condition_create(&context.memory_released)) != NO_ERROR ||
+		(status = image_pool_set_shared(true)) != NO_ERROR))
+		goto destroy_context;
+
+	image_set_thread_pool(context.pool);
+
+	double start = platform_get_time();
+	threadpool_run(file_pool, batch_file_task, &context, (size_t)job_count);
+	p_statistics->elapsed = platform_get_time() - start;
+
+	image_set_thread_pool(NULL);
+
+	p_statistics->file_count = job_count;
+	p_statistics->failed_count = 0;
+	p_statistics->pixel_count = 0;
+	for (int i = 0; i < job_count; i++)
+	{
+		if (jobs[i].status != NO_ERROR)
+			p_statistics->failed_count++;
+		p_statistics->pixel_count += jobs[i].pixel_count;
+	}
+
+destroy_context:
+	image_pool_set_shared(false);
+	if (context.memory_released != NULL)
+		platform_condition_destroy(context.memory_released);
+	if (context.mutex != NULL)
+		platform_mutex_destroy(context.mutex);
+	if (context.pool != NULL)
+		threadpool_destroy(context.pool);
+destroy_pool:
+	threadpool_destroy(file_pool);
+
+	return status;
+}
@@ -0,0 +1,49 @@
+﻿/*****************************************************************//**
+ * @file   batch.h
+ * @brief  Egy műveletsort egy vagy több képfájlon végrehajtó (kötegelt
+ * feldolgozást megvalósító) modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef BATCH_H_INCLUDED
+#define BATCH_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cmd.h"
+#include "threadpool.h"
+
+/* az egyszerre feldolgozott képek alapértelmezett memóriakorlátja (MB-ban) */
+#define BATCH_DEFAULT_MEMORY_LIMIT	1024
+
+/**
+ * @brief A kötegelt feldolgozás egy eleme: egy bemeneti és a hozzá tartozó
+ * kimeneti fájl, valamint a feldolgozás eredménye.
+ */
+typedef struct batch_job_struct
+{
+	char* input_path; /* a bemeneti fájl (dinamikusan foglalt) elérési útja */
+	char* output_path; /* a kimeneti fájl (dinamikusan foglalt) elérési útja */
+	int status; /* a feldolgozás hibakódja */
+	uint64_t pixel_count; /* a bemeneti kép képpontjainak száma (sikeres feldolgozás esetén) */
+} BatchJob;
+
+/**
+ * @brief A kötegelt feldolgozás összesített eredménye.
+ */
+typedef struct batch_statistics_struct
+{
+	int file_count; /* a feldolgozott fájlok száma */
+	int failed_count; /* a hibás fájlok száma */
+	uint64_t pixel_count; /* a sikeresen feldolgozott képek képpontjainak száma */
+	double elapsed; /* a feldolgozás ideje (másodpercben) */
+} BatchStatistics;
+
+int batch_process_file(FILE* input_file, FILE* output_file, const Operation* operations, int count, const Options* options, ThreadPool* pool);
+int batch_read_list(BatchJob** p_jobs, int* p_count, const char* path);
+int batch_read_directory(BatchJob** p_jobs, int* p_count, const char* input_directory, const char* output_directory);
+void batch_destroy_jobs(BatchJob* jobs, int count);
+int batch_run(BatchJob* jobs, int job_count, const Operation* operations, int count, const Options* options, BatchStatistics* p_statistics);
+
+#endif /* BATCH_H_INCLUDED */
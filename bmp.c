@@ -9,11 +9,19 @@
 #include "bmp.h"
 #include "image.h"
 #include "status.h"
+#include "platform.h"
+#include "threadpool.h"
+#include "palette.h"
+#include "readahead.h"
+#include "allocator.h"
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
+#ifndef NDEBUG
 #include "debugmalloc.h"
+#endif
 
 #define BMP_SIGNATURE			19778
 #define BMP_PLANES_VALUE		1
@@ -21,11 +29,27 @@
 #define BMP_FILE_HEADER_SIZE	14
 #define BMP_INFO_HEADER_SIZE	40
 
+/* egy bittérképbeli sor legnagyobb hossza: a sorok hossza és pufferbeli helye 32 bites */
+#define BMP_MAX_ROW_WIDTH		UINT32_MAX
+
+#define BMP_COMPRESSION_NONE	0
+#define BMP_COMPRESSION_RLE8	1
+#define BMP_COMPRESSION_RLE4	2
+#define BMP_COMPRESSION_BITFIELDS		3
+#define BMP_COMPRESSION_ALPHABITFIELDS	6
+
+/* a BITFIELDS tömörítésű képek színmaszkjainak mérete (vörös, zöld, kék) */
+#define BMP_COLOR_MASKS_SIZE	12
+
  /* az BMP fájlok kezelésénél előjövő hibakódok szöveges reprezentációja */
 const char* bmp_error_code_strings[] = {
 	"Hibas fajlalairas.",
 	"Nem tamogatott megjelenitesi beallitas.",
-	"Hibas bitmelyseg."
+	"Hibas bitmelyseg.",
+	"Nem tamogatott tomorites.",
+	"Nem tamogatott informacios fejlec.",
+	"Tul nagy kep.",
+	"Nem tamogatott, felulrol lefele tarolt kep."
 };
 
 /* BMP fájlfejlécet tároló struktúra */
@@ -54,6 +78,11 @@ struct info_header_struct
 	uint32_t y_pixels_per_m;
 	uint32_t colors_used;
 	uint32_t important_colors;
+
+	/* a 16 és 32 bites pixelek színkomponenseinek bitmaszkjai (nem része a 40 bájtos fejlécnek) */
+	uint32_t red_mask;
+	uint32_t green_mask;
+	uint32_t blue_mask;
 };
 
 /* BMP színtáblázat egy bejegyzését tároló stuktúra */
@@ -79,30 +108,78 @@ static int bmp_check_file_validity(struct file_header_struct* fileheader)
 	return NO_ERROR;
 }
 
+/**
+ * Kiszámolja egy bittérképbeli sor hosszát 4 bájtos igazítással. A sor
+ * hossza 32 biten nem feltétlenül ábrázolható (lásd BMP_MAX_ROW_WIDTH).
+ *
+ * @param width A sor hossza (pixelben).
+ * @param bits_per_pixel A pixelenkénti bitek száma, vagyis a bitmélység.
+ * @return Visszatér a kiszámított sorhosszal.
+ */
+static uint64_t bmp_calculate_row_width(uint32_t width, uint16_t bits_per_pixel)
+{
+	/* (count * size + 4-byte-alignment) * 4 bytes */
+	return (((uint64_t)width * bits_per_pixel + 31) / 32) * 4;
+}
+
 /**
  * Megvizsgálja, hogy az információs fejléc szabványos-e.
  *
  * @param infoheader Az információs fejléc.
  * @return Amennyiben sok fejléc "megjelenítés" mezője nem "képernyő"-re
  * van állítva, BMP_TOO_MANY_PLANES-zel, ha a színekkel kapcsolatos mezők
- * helytelenek, BMP_INVALID_COLORS-zal, egyébként pedig NO_ERROR-ral tér
- * vissza.
+ * helytelenek, BMP_INVALID_COLORS-zal, ha a tömörítés nem támogatott (csak
+ * a tömörítetlen, a 8 bites RLE8, a 4 bites RLE4, valamint a 16 és 32 bites
+ * BITFIELDS az), BMP_UNSUPPORTED_COMPRESSION-nel, ha a fejléc rövidebb a
+ * 40 bájtos BITMAPINFOHEADER-nél, BMP_UNSUPPORTED_HEADER-rel, ha egy
+ * bittérképbeli sor hossza meghaladja BMP_MAX_ROW_WIDTH-t, BMP_TOO_LARGE-dzsel,
+ * ha a magasság negatív (felülről lefelé tárolt kép), BMP_TOP_DOWN-nal,
+ * egyébként pedig NO_ERROR-ral tér vissza.
  */
 static int bmp_check_info_validity(struct info_header_struct* infoheader)
 {
+	if (infoheader->header_size < BMP_INFO_HEADER_SIZE)
+		return BMP_UNSUPPORTED_HEADER;
+
+	/* a magasság előjeles; a tömörített képek szabvány szerint sem lehetnek felülről lefelé tároltak */
+	if (infoheader->height > INT32_MAX)
+		return BMP_TOP_DOWN;
+
 	if (infoheader->planes != BMP_PLANES_VALUE)
 		return BMP_TOO_MANY_PLANES;
 
 	if (infoheader->important_colors > infoheader->colors_used)
 		return BMP_INVALID_COLORS;
 
+	switch (infoheader->compression)
+	{
+	case BMP_COMPRESSION_NONE:
+		break;
+	case BMP_COMPRESSION_RLE8:
+		if (infoheader->bits_per_pixel != 8)
+			return BMP_UNSUPPORTED_COMPRESSION;
+		break;
+	case BMP_COMPRESSION_RLE4:
+		if (infoheader->bits_per_pixel != 4)
+			return BMP_UNSUPPORTED_COMPRESSION;
+		break;
+	case BMP_COMPRESSION_BITFIELDS:
+	case BMP_COMPRESSION_ALPHABITFIELDS:
+		if (infoheader->bits_per_pixel != 16 && infoheader->bits_per_pixel != 32)
+			return BMP_UNSUPPORTED_COMPRESSION;
+		break;
+	default:
+		return BMP_UNSUPPORTED_COMPRESSION;
+	}
+
+	if (bmp_calculate_row_width(infoheader->width, infoheader->bits_per_pixel) > BMP_MAX_ROW_WIDTH)
+		return BMP_TOO_LARGE;
+
 	switch (infoheader->bits_per_pixel)
 	{
-	case 1:
-		return (infoheader->colors_used == 1) ? NO_ERROR : BMP_INVALID_COLORS;
-	case 4: case 8:
-		return (infoheader->colors_used == (1u << infoheader->bits_per_pixel)) ? NO_ERROR : BMP_INVALID_COLORS;
-	case 16: case 24:
+	case 1: case 4: case 8:
+		return (infoheader->colors_used >= 1 && infoheader->colors_used <= (1u << infoheader->bits_per_pixel)) ? NO_ERROR : BMP_INVALID_COLORS;
+	case 16: case 24: case 32:
 		return NO_ERROR;
 	default:
 		return BMP_INVALID_COLORS;
@@ -110,116 +187,233 @@ static int bmp_check_info_validity(struct info_header_struct* infoheader)
 }
 
 /**
- * Kiszámolja egy bittérképbeli sor hosszát 4 bájtos igazítással.
+ * Kiolvas egy 16 bites, kis-endián bájtsorrendű előjel nélküli egészet egy
+ * bájtsorozatból.
  *
- * @param width A sor hossza (bájtban).
- * @param bits_per_pixel A pixelenkénti bitek száma, vagyis a bitmélység.
- * @return Visszatér a kiszámított sorhosszal.
+ * @param bytes A bájtsorozat.
+ * @return Visszatér a kiolvasott egésszel.
  */
-static uint32_t bmp_calculate_row_width(uint32_t width, uint16_t bits_per_pixel)
+static uint16_t read_u16_le(const uint8_t* bytes)
 {
-	/* (count * size + 4-byte-alignment) * 4 bytes */
-	return ((width * bits_per_pixel + 31) / 32) * 4;
+	return (uint16_t)(bytes[0] | (bytes[1] << 8));
 }
 
-/* I/O műveletet megvalósító függvényekre mutató függvénypointer típus */
-typedef size_t(*foperation)(void* buffer, size_t element_size, size_t element_count, FILE* stream);
+/**
+ * Kiolvas egy 32 bites, kis-endián bájtsorrendű előjel nélküli egészet egy
+ * bájtsorozatból.
+ *
+ * @param bytes A bájtsorozat.
+ * @return Visszatér a kiolvasott egésszel.
+ */
+static uint32_t read_u32_le(const uint8_t* bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
 
 /**
- * Elvégez egy I/O műveletet egy fájlfejléccel.
+ * Értelmez egy BMP_FILE_HEADER_SIZE méretű, fájlbeli elrendezésű
+ * fájlfejlécet.
  *
  * @param p_fileheader A fájlfejlécre mutató pointer.
- * @param file A fájl.
- * @param operation Az elvégzendő I/O művelet (fread/fwrite).
- * @return Sikeres lefutás esetén NO_ERROR-ral, műveletvégzés közben felmerülő
- * I/O probléma esetén IO_ERROR-ral tér vissza.
+ * @param bytes A fejlécet tartalmazó bájtsorozat.
  */
-static int bmp_rdwr_file_header(struct file_header_struct* p_fileheader, FILE* file, foperation operation)
+static void bmp_parse_file_header(struct file_header_struct* p_fileheader, const uint8_t* bytes)
 {
-	if (operation(&p_fileheader->signature, sizeof(p_fileheader->signature), 1, file) == 1 &&
-		operation(&p_fileheader->file_size, sizeof(p_fileheader->file_size), 1, file) == 1 &&
-		operation(&p_fileheader->reserved, sizeof(p_fileheader->reserved), 1, file) == 1 &&
-		operation(&p_fileheader->data_offset, sizeof(p_fileheader->data_offset), 1, file) == 1)
-		return NO_ERROR;
-	return IO_ERROR;
+	p_fileheader->signature = read_u16_le(bytes + 0);
+	p_fileheader->file_size = read_u32_le(bytes + 2);
+	p_fileheader->reserved = read_u32_le(bytes + 6);
+	p_fileheader->data_offset = read_u32_le(bytes + 10);
 }
 
 /**
- * Beolvas egy fájlfejlécet egy fájlból.
+ * Értelmez egy BMP_INFO_HEADER_SIZE méretű, fájlbeli elrendezésű
+ * információs fejlécet.
  *
- * @param p_fileheader A fájlfejlécre mutató pointer.
- * @param file A fájl.
- * @return Sikeres lefutás esetén NO_ERROR-ral, beolvasás közben felmerülő
- * I/O probléma esetén IO_ERROR-ral tér vissza.
+ * @param p_infoheader Az információs fejlécre mutató pointer.
+ * @param bytes A fejlécet tartalmazó bájtsorozat.
  */
-static int bmp_read_file_header(struct file_header_struct* p_fileheader, FILE* file)
+static void bmp_parse_info_header(struct info_header_struct* p_infoheader, const uint8_t* bytes)
 {
-	return bmp_rdwr_file_header(p_fileheader, file, fread);
+	p_infoheader->header_size = read_u32_le(bytes + 0);
+	p_infoheader->width = read_u32_le(bytes + 4);
+	p_infoheader->height = read_u32_le(bytes + 8);
+	p_infoheader->planes = read_u16_le(bytes + 12);
+	p_infoheader->bits_per_pixel = read_u16_le(bytes + 14);
+	p_infoheader->compression = read_u32_le(bytes + 16);
+	p_infoheader->image_size = read_u32_le(bytes + 20);
+	p_infoheader->x_pixels_per_m = read_u32_le(bytes + 24);
+	p_infoheader->y_pixels_per_m = read_u32_le(bytes + 28);
+	p_infoheader->colors_used = read_u32_le(bytes + 32);
+	p_infoheader->important_colors = read_u32_le(bytes + 36);
 }
 
 /**
- * Kiír egy fájlfejlécet egy fájlba.
+ * Megadja, hogy a bittérkép RLE8 vagy RLE4 tömörítésű-e, vagyis hogy a sorai
+ * változó hosszúak-e.
  *
- * @param p_fileheader A fájlfejlécre mutató pointer.
- * @param file A fájl.
- * @return Sikeres lefutás esetén NO_ERROR-ral, kiírás közben felmerülő
- * I/O probléma esetén IO_ERROR-ral tér vissza.
+ * @param infoheader Az információs fejléc.
+ * @return Visszatér a logikai értékkel.
+ */
+static bool bmp_is_run_length_encoded(const struct info_header_struct* infoheader)
+{
+	return infoheader->compression == BMP_COMPRESSION_RLE8 ||
+		infoheader->compression == BMP_COMPRESSION_RLE4;
+}
+
+/**
+ * Megadja, hogy a bittérkép pixeleinek színkomponenseit a fejlécet követő
+ * színmaszkok határozzák-e meg.
+ *
+ * @param infoheader Az információs fejléc.
+ * @return Visszatér a logikai értékkel.
  */
-static int bmp_write_file_header(struct file_header_struct* p_fileheader, FILE* file)
+static bool bmp_has_color_masks(const struct info_header_struct* infoheader)
 {
-	return bmp_rdwr_file_header(p_fileheader, file, fwrite);
+	return infoheader->compression == BMP_COMPRESSION_BITFIELDS ||
+		infoheader->compression == BMP_COMPRESSION_ALPHABITFIELDS;
 }
 
 /**
- * Elvégez egy I/O műveletet egy információs fejléccel.
+ * Kitölti az információs fejléc színmaszkjait. BITFIELDS tömörítés esetén a
+ * maszkok a 40 bájtos fejlécet követik (a BITMAPV4HEADER és a
+ * BITMAPV5HEADER esetén ugyanezen a helyen, a fejléc részeként), egyébként
+ * a bitmélység alapértelmezett elrendezése érvényes: 16 bit esetén 5-5-5,
+ * 32 bit esetén 8-8-8 bites komponensek.
  *
  * @param p_infoheader Az információs fejlécre mutató pointer.
- * @param file A fájl.
- * @param operation Az elvégzendő I/O művelet (fread/fwrite).
- * @return Sikeres lefutás esetén NO_ERROR-ral, műveletvégzés közben felmerülő
- * I/O probléma esetén IO_ERROR-ral tér vissza.
+ * @param bytes A BMP_COLOR_MASKS_SIZE méretű, fájlbeli elrendezésű
+ * maszkok (vagy NULL, ha a képnek nincsenek színmaszkjai).
  */
-static int bmp_rdwr_info_header(struct info_header_struct* p_infoheader, FILE* file, foperation operation)
-{
-	if (operation(&p_infoheader->header_size, sizeof(p_infoheader->header_size), 1, file) == 1 &&
-		operation(&p_infoheader->width, sizeof(p_infoheader->width), 1, file) == 1 &&
-		operation(&p_infoheader->height, sizeof(p_infoheader->height), 1, file) == 1 &&
-		operation(&p_infoheader->planes, sizeof(p_infoheader->planes), 1, file) == 1 &&
-		operation(&p_infoheader->bits_per_pixel, sizeof(p_infoheader->bits_per_pixel), 1, file) == 1 &&
-		operation(&p_infoheader->compression, sizeof(p_infoheader->compression), 1, file) == 1 &&
-		operation(&p_infoheader->image_size, sizeof(p_infoheader->image_size), 1, file) == 1 &&
-		operation(&p_infoheader->x_pixels_per_m, sizeof(p_infoheader->x_pixels_per_m), 1, file) == 1 &&
-		operation(&p_infoheader->y_pixels_per_m, sizeof(p_infoheader->y_pixels_per_m), 1, file) == 1 &&
-		operation(&p_infoheader->colors_used, sizeof(p_infoheader->colors_used), 1, file) == 1 &&
-		operation(&p_infoheader->important_colors, sizeof(p_infoheader->important_colors), 1, file) == 1)
-		return NO_ERROR;
-	return IO_ERROR;
+static void bmp_parse_color_masks(struct info_header_struct* p_infoheader, const uint8_t* bytes)
+{
+	if (bytes != NULL)
+	{
+		p_infoheader->red_mask = read_u32_le(bytes + 0);
+		p_infoheader->green_mask = read_u32_le(bytes + 4);
+		p_infoheader->blue_mask = read_u32_le(bytes + 8);
+	}
+	else if (p_infoheader->bits_per_pixel == 16)
+	{
+		p_infoheader->red_mask = 0x7C00;
+		p_infoheader->green_mask = 0x03E0;
+		p_infoheader->blue_mask = 0x001F;
+	}
+	else if (p_infoheader->bits_per_pixel == 32)
+	{
+		p_infoheader->red_mask = 0x00FF0000;
+		p_infoheader->green_mask = 0x0000FF00;
+		p_infoheader->blue_mask = 0x000000FF;
+	}
+	else
+	{
+		p_infoheader->red_mask = 0;
+		p_infoheader->green_mask = 0;
+		p_infoheader->blue_mask = 0;
+	}
+}
+
+/**
+ * Kiszámolja a színtáblázat kezdőpozícióját a fájlban: a színtáblázat az
+ * információs fejlécet, 40 bájtos fejléc esetén pedig az azt követő
+ * színmaszkokat követi.
+ *
+ * @param infoheader Az információs fejléc.
+ * @return Visszatér a kiszámított pozícióval.
+ */
+static uint64_t bmp_calculate_color_table_offset(const struct info_header_struct* infoheader)
+{
+	uint64_t offset = (uint64_t)BMP_FILE_HEADER_SIZE + infoheader->header_size;
+	if (infoheader->header_size == BMP_INFO_HEADER_SIZE && bmp_has_color_masks(infoheader))
+		offset += BMP_COLOR_MASKS_SIZE;
+	return offset;
+}
+
+/**
+ * Beír egy 16 bites előjel nélküli egészet kis-endián bájtsorrendben egy
+ * bájtsorozatba.
+ *
+ * @param bytes A bájtsorozat.
+ * @param value Az egész.
+ */
+static void write_u16_le(uint8_t* bytes, uint16_t value)
+{
+	bytes[0] = (uint8_t)value;
+	bytes[1] = (uint8_t)(value >> 8);
+}
+
+/**
+ * Beír egy 32 bites előjel nélküli egészet kis-endián bájtsorrendben egy
+ * bájtsorozatba.
+ *
+ * @param bytes A bájtsorozat.
+ * @param value Az egész.
+ */
+static void write_u32_le(uint8_t* bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)value;
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
 }
 
 /**
- * Beolvas egy információs fejlécet egy fájlból.
+ * Fájlbeli elrendezésű, BMP_FILE_HEADER_SIZE méretű bájtsorozattá alakít
+ * egy fájlfejlécet.
  *
+ * @param bytes A cél bájtsorozat.
+ * @param p_fileheader A fájlfejlécre mutató pointer.
+ */
+static void bmp_serialize_file_header(uint8_t* bytes, const struct file_header_struct* p_fileheader)
+{
+	write_u16_le(bytes + 0, p_fileheader->signature);
+	write_u32_le(bytes + 2, p_fileheader->file_size);
+	write_u32_le(bytes + 6, p_fileheader->reserved);
+	write_u32_le(bytes + 10, p_fileheader->data_offset);
+}
+
+/**
+ * Fájlbeli elrendezésű, BMP_INFO_HEADER_SIZE méretű bájtsorozattá alakít
+ * egy információs fejlécet.
+ *
+ * @param bytes A cél bájtsorozat.
  * @param p_infoheader Az információs fejlécre mutató pointer.
- * @param file A fájl.
- * @return Sikeres lefutás esetén NO_ERROR-ral, beolvasás közben felmerülő
- * I/O probléma esetén IO_ERROR-ral tér vissza.
  */
-static int bmp_read_info_header(struct info_header_struct* p_infoheader, FILE* file)
+static void bmp_serialize_info_header(uint8_t* bytes, const struct info_header_struct* p_infoheader)
 {
-	return bmp_rdwr_info_header(p_infoheader, file, fread);
+	write_u32_le(bytes + 0, p_infoheader->header_size);
+	write_u32_le(bytes + 4, p_infoheader->width);
+	write_u32_le(bytes + 8, p_infoheader->height);
+	write_u16_le(bytes + 12, p_infoheader->planes);
+	write_u16_le(bytes + 14, p_infoheader->bits_per_pixel);
+	write_u32_le(bytes + 16, p_infoheader->compression);
+	write_u32_le(bytes + 20, p_infoheader->image_size);
+	write_u32_le(bytes + 24, p_infoheader->x_pixels_per_m);
+	write_u32_le(bytes + 28, p_infoheader->y_pixels_per_m);
+	write_u32_le(bytes + 32, p_infoheader->colors_used);
+	write_u32_le(bytes + 36, p_infoheader->important_colors);
 }
 
 /**
- * Kiír egy információs fejlécet egy fájlba.
+ * Beolvassa egy fájlból a fájlfejlécet és az információs fejlécet egyetlen
+ * I/O műveletben, majd értelmezi őket.
  *
+ * @param p_fileheader A fájlfejlécre mutató pointer.
  * @param p_infoheader Az információs fejlécre mutató pointer.
  * @param file A fájl.
- * @return Sikeres lefutás esetén NO_ERROR-ral, kiírás közben felmerülő
+ * @return Sikeres lefutás esetén NO_ERROR-ral, beolvasás közben felmerülő
  * I/O probléma esetén IO_ERROR-ral tér vissza.
  */
-static int bmp_write_info_header(struct info_header_struct* p_infoheader, FILE* file)
+static int bmp_read_headers(struct file_header_struct* p_fileheader, struct info_header_struct* p_infoheader, FILE* file)
 {
-	return bmp_rdwr_info_header(p_infoheader, file, fwrite);
+	uint8_t bytes[BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE];
+
+	if (fread(bytes, sizeof(bytes), 1, file) != 1)
+		return IO_ERROR;
+
+	bmp_parse_file_header(p_fileheader, bytes);
+	bmp_parse_info_header(p_infoheader, bytes + BMP_FILE_HEADER_SIZE);
+
+	return NO_ERROR;
 }
 
 /**
@@ -261,177 +455,2377 @@ static uint32_t cut_bitseq_from_u32_array(const uint32_t* array, uint64_t start,
 	return bitseq;
 }
 
+/*
+ * Egy színkomponens kinyerése egy 16 vagy 32 bites pixelből: a maszk
+ * legfelső (legfeljebb 8) bitjét eltolással és maszkolással kivágjuk, majd a
+ * biteket szorzással és eltolással ismételve 8 bitre terjesztjük ki (például
+ * 5 bit esetén abcde -> abcdeabc), így a teljes intenzitás 255 lesz.
+ */
+struct bmp_channel_struct
+{
+	uint32_t shift; /* a kivágandó bitek helye */
+	uint32_t mask; /* a kivágott bitek maszkja (0, ha a komponens hiányzik) */
+	uint32_t factor; /* a bitek ismétlését végző szorzó */
+	uint32_t scale_shift; /* a szorzás után elhagyandó bitek száma */
+};
+
 /**
- * Betölt egy szabványos BMP formátumú képet egy fájlból, melyet paraméterként
- * ad vissza a hívónak.
- *
- * A lefoglalt memóriaterület felszabadítása a hívó feladata.
+ * Felkészít egy színkomponens-kinyerést egy fejlécbeli bitmaszk alapján.
  *
- * @param p_image A képre mutató poitner helye.
- * @param file A fájl.
- * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
- * az allokációk vagy egy I/O művelet által okozott hibakóddal tér vissza.
+ * @param channel A színkomponens-kinyerés.
+ * @param mask A bitmaszk.
  */
-int bmp_load(Image** p_image, FILE* file)
+static void bmp_channel_init(struct bmp_channel_struct* channel, uint32_t mask)
 {
-	int status;
+	uint32_t shift = 0, width = 0;
 
-	struct file_header_struct fileheader;
+	if (mask != 0)
+	{
+		while (((mask >> shift) & 1) == 0)
+			shift++;
+		while (shift + width < 32 && ((mask >> (shift + width)) & 1) != 0)
+			width++;
+	}
 
-	if ((status = bmp_read_file_header(&fileheader, file)) != NO_ERROR)
-		return status;
-	if ((status = bmp_check_file_validity(&fileheader)) != NO_ERROR)
-		return status;
+	/* a 8 bitnél szélesebb komponenseknek csak a felső 8 bitje számít */
+	if (width > 8)
+	{
+		shift += width - 8;
+		width = 8;
+	}
 
-	struct info_header_struct infoheader;
-	if ((status = bmp_read_info_header(&infoheader, file)) != NO_ERROR)
-		return status;
-	if ((status = bmp_check_info_validity(&infoheader)) != NO_ERROR)
-		return status;
+	uint32_t factor = 0, bits = 0;
+	if (width > 0)
+		for (; bits < 8; bits += width)
+			factor |= 1u << bits;
+
+	channel->shift = shift;
+	channel->mask = (width > 0) ? (1u << width) - 1 : 0;
+	channel->factor = factor;
+	channel->scale_shift = (bits > 8) ? bits - 8 : 0;
+}
+
+/**
+ * Kinyer egy színkomponenst egy 16 vagy 32 bites pixelből.
+ *
+ * @param channel A színkomponens-kinyerés.
+ * @param value A pixel.
+ * @return Visszatér a 8 bites színkomponenssel.
+ */
+static uint8_t bmp_channel_extract(const struct bmp_channel_struct* channel, uint32_t value)
+{
+	return (uint8_t)((((value >> channel->shift) & channel->mask) * channel->factor) >> channel->scale_shift);
+}
+
+/**
+ * Dekódol egy bittérképbeli sort a kép pixeleinek egy sorába pixelenkénti
+ * bitkivágással, bármely támogatott bitmélység esetén.
+ *
+ * Az általános, lassú dekódoló csak a specializált dekódolók
+ * teljesítményének összevetésére (bmp_benchmark_decode) szolgál.
+ *
+ * @param dst A cél pixelsor.
+ * @param row A bittérképbeli sor (4 bájtra igazított, teljes hosszában
+ * olvasható).
+ * @param infoheader A bittérkép információs fejléce.
+ * @param color_table A bittérkép színtáblázata (vagy NULL).
+ */
+static void bmp_decode_row_reference(Pixel* dst, const uint32_t* row, const struct info_header_struct* infoheader, const struct color_entry* color_table)
+{
+	struct bmp_channel_struct channels[3];
+	bmp_channel_init(&channels[0], infoheader->blue_mask);
+	bmp_channel_init(&channels[1], infoheader->green_mask);
+	bmp_channel_init(&channels[2], infoheader->red_mask);
 
-	struct color_entry* color_table = NULL;
-	if (infoheader.colors_used > 0)
+	for (uint64_t bitptr = 0; bitptr < (uint64_t)infoheader->width * infoheader->bits_per_pixel; bitptr += infoheader->bits_per_pixel)
 	{
-		color_table = (struct color_entry*)malloc(infoheader.colors_used * sizeof(struct color_entry));
-		if (color_table == NULL)
-			return MEMORY_ERROR;
+		Pixel pixel;
 
-		if (fread(color_table, sizeof(struct color_entry), infoheader.colors_used, file) != infoheader.colors_used)
+		/* egy 32 bites pixel egy teljes tömbelem */
+		uint32_t pixeldata = (infoheader->bits_per_pixel == 32) ? row[bitptr / 32] :
+			cut_bitseq_from_u32_array(row, bitptr, infoheader->bits_per_pixel);
+		if (infoheader->bits_per_pixel == 1 && infoheader->colors_used == 1)
 		{
-			free(color_table);
-			return IO_ERROR;
+			/* egy monokróm képnél egyetlen egy színt tárolunk a színtáblázatban,
+			szóval vagy azt a színt reprezentálja a bit vagy a feketét */
+			const struct color_entry* color = &color_table[0];
+			pixel.blue = pixeldata * color->blue;
+			pixel.green = pixeldata * color->green;
+			pixel.red = pixeldata * color->red;
+		}
+		else if (infoheader->bits_per_pixel <= 8)
+		{
+			/* a színtáblázaton túli indexek feketék */
+			static const struct color_entry black = { 0, 0, 0, 0 };
+			const struct color_entry* color = (pixeldata < infoheader->colors_used) ? &color_table[pixeldata] : &black;
+			pixel.blue = color->blue;
+			pixel.green = color->green;
+			pixel.red = color->red;
+		}
+		else if (infoheader->bits_per_pixel == 24)
+		{
+			pixel.blue = (pixeldata) & 0xFF;
+			pixel.green = (pixeldata >>= 8) & 0xFF;
+			pixel.red = (pixeldata >>= 8);
+		}
+		else
+		{
+			pixel.blue = bmp_channel_extract(&channels[0], pixeldata);
+			pixel.green = bmp_channel_extract(&channels[1], pixeldata);
+			pixel.red = bmp_channel_extract(&channels[2], pixeldata);
 		}
-	}
 
-	if (fseek(file, fileheader.data_offset, SEEK_SET) != 0)
-	{
-		free(color_table);
-		return IO_ERROR;
+		*dst++ = pixel;
 	}
+}
 
-	Image* image = image_create(infoheader.width, infoheader.height);
-	if (image == NULL)
-	{
-		free(color_table);
-		return MEMORY_ERROR;
-	}
+struct bmp_decoder_struct;
 
-	uint32_t row_width = bmp_calculate_row_width(infoheader.width, infoheader.bits_per_pixel);
-	uint32_t* row = (uint32_t*)malloc(row_width * sizeof(uint8_t));
-	if (row == NULL)
-	{
-		free(color_table);
-		image_destroy(image);
-		return MEMORY_ERROR;
-	}
+/* egy bittérképbeli sort a kép pixeleinek egy sorába dekódoló függvényre mutató függvénypointer típus */
+typedef void(*fdecoder)(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width);
 
-	uint32_t idx = 0;
-	while (fread(row, sizeof(uint8_t), row_width, file) == row_width)
-	{
-		for (uint64_t bitptr = 0; bitptr < infoheader.width * infoheader.bits_per_pixel; bitptr += infoheader.bits_per_pixel)
-		{
-			Pixel pixel;
+/*
+ * Egy adott bitmélységű bittérkép sorainak dekódolására felkészített
+ * struktúra. A dekódoló függvény és a színtáblázatból előre kiszámolt
+ * kiterjesztő táblázatok fájlonként egyszer kerülnek kiválasztásra, illetve
+ * kitöltésre.
+ */
+struct bmp_decoder_struct
+{
+	fdecoder decode; /* a bitmélységnek megfelelő dekódoló függvény */
+	Pixel palette[256]; /* a színtáblázat Pixel-ekként */
+	Pixel expand1[256][8]; /* 1 bites bittérkép: bájt -> 8 pixel */
+	Pixel expand4[256][2]; /* 4 bites bittérkép: bájt -> 2 pixel */
+	uint8_t planes4[3][16]; /* 4 bites bittérkép: a színtáblázat komponensenként (SIMD) */
+	struct bmp_channel_struct channels[3]; /* 16 és 32 bites bittérkép: a kék, zöld és vörös komponens kinyerése */
+	uint8_t shuffle32[16]; /* 32 bites, bájthatáros komponensek: 4 pixel -> 12 bájt keverése (SIMD) */
+};
 
-			uint32_t pixeldata = cut_bitseq_from_u32_array(row, bitptr, infoheader.bits_per_pixel);
-			if (infoheader.bits_per_pixel == 1)
-			{
-				/* egy monokróm képnél egyetlen egy színt tárolunk a színtáblázatban,
-				szóval vagy azt a színt reprezentálja a bit vagy a feketét */
-				struct color_entry* color = &color_table[0];
-				pixel.blue = pixeldata * color->blue;
-				pixel.green = pixeldata * color->green;
-				pixel.red = pixeldata * color->red;
-			}
-			else if (infoheader.bits_per_pixel <= 8)
-			{
-				const struct color_entry* color = &color_table[pixeldata];
-				pixel.blue = color->blue;
-				pixel.green = color->green;
-				pixel.red = color->red;
-			}
-			else
-			{
-				pixel.blue = (pixeldata) & 0xFF;
-				pixel.green = (pixeldata >>= 8) & 0xFF;
-				pixel.red = (pixeldata >>= 8);
-			}
+/**
+ * Dekódol egy 1 bites bittérképbeli sort. Egész bájtok esetén egy bájt
+ * 8 pixelét egyetlen táblázatbeli bejegyzés másolásával állítja elő.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
+ */
+static void bmp_decode_row_1(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
+{
+	uint32_t x = 0;
 
-			image->pixel_data[idx++] = pixel;
+	for (; x + 8 <= width; x += 8)
+		memcpy(&dst[x], decoder->expand1[*src++], sizeof(decoder->expand1[0]));
+
+	if (x < width)
+		memcpy(&dst[x], decoder->expand1[*src], (width - x) * sizeof(Pixel));
+}
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define BMP_USE_SSSE3
+#include <tmmintrin.h>
+
+/**
+ * Dekódol egy 4 bites bittérképbeli sor 16 pixelét SSSE3 utasításokkal: a
+ * 16 bejegyzéses színtáblázat komponensenként egy-egy regiszterbe fér, így a
+ * kikeresést egy-egy bájtkeverés (pshufb) végzi, majd a komponenseket további
+ * keverésekkel fésüli össze a Pixel-ek sorrendjébe.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A 16 pixelnyi cél.
+ * @param src A 16 pixelnyi (8 bájtnyi) forrás.
+ */
+static void bmp_decode_16_pixels_4_ssse3(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src)
+{
+	/* a j. kimeneti vektor bájtjai melyik pixel kék/zöld/vörös komponenséből jönnek */
+	static const uint8_t interleave[3][3][16] = {
+		{
+			{ 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80, 0x80, 5 },
+			{ 0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80, 0x80 },
+			{ 0x80, 0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80 }
+		},
+		{
+			{ 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80, 10, 0x80 },
+			{ 5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80, 10 },
+			{ 0x80, 5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80 }
+		},
+		{
+			{ 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15, 0x80, 0x80 },
+			{ 0x80, 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15, 0x80 },
+			{ 10, 0x80, 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15 }
 		}
-	}
+	};
 
-	*p_image = image;
+	const __m128i nibble_mask = _mm_set1_epi8(0x0F);
 
-	free(row);
-	free(color_table);
+	__m128i bytes = _mm_loadl_epi64((const __m128i*)src);
+	__m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+	__m128i low = _mm_and_si128(bytes, nibble_mask);
+	/* a bájtokon belül a felső félbájt az első pixel */
+	__m128i indices = _mm_unpacklo_epi8(high, low);
 
-	return NO_ERROR;
+	__m128i components[3];
+	for (int c = 0; c < 3; c++)
+		components[c] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)decoder->planes4[c]), indices);
+
+	for (int j = 0; j < 3; j++)
+	{
+		__m128i out = _mm_shuffle_epi8(components[0], _mm_loadu_si128((const __m128i*)interleave[j][0]));
+		out = _mm_or_si128(out, _mm_shuffle_epi8(components[1], _mm_loadu_si128((const __m128i*)interleave[j][1])));
+		out = _mm_or_si128(out, _mm_shuffle_epi8(components[2], _mm_loadu_si128((const __m128i*)interleave[j][2])));
+		_mm_storeu_si128((__m128i*)((uint8_t*)dst + 16 * j), out);
+	}
 }
+#endif
 
 /**
- * Kiment egy szabványos BMP formátumú képet egy fájlba, melyet paraméterként
- * vesz át.
+ * Dekódol egy 4 bites bittérképbeli sort. SSSE3 támogatás esetén 16
+ * pixelenként vektorosan, egyébként egy bájt 2 pixelét egyetlen táblázatbeli
+ * bejegyzés másolásával állítja elő.
  *
- * @param p_image A képre mutató poitner helye.
- * @param file A fájl.
- * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk vagy
- * egy I/O művelet által okozott hibakóddal tér vissza.
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
  */
-int bmp_store(const Image** p_image, FILE* file)
+static void bmp_decode_row_4(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
 {
-	int status;
+	uint32_t x = 0;
 
-	const Image* image = *p_image;
+#ifdef BMP_USE_SSSE3
+	for (; x + 16 <= width; x += 16, src += 8)
+		bmp_decode_16_pixels_4_ssse3(decoder, &dst[x], src);
+#endif
 
-	struct info_header_struct infoheader = {
-		.header_size = BMP_INFO_HEADER_SIZE,
-		.width = image->width,
-		.height = image->height,
-		.planes = 1,
-		.bits_per_pixel = 24, /* only 24 bit outputs are supported */
-		.compression = 0, /* only uncompressed outputs are supported */
-		/* .image_size = ..., */
-		.x_pixels_per_m = 0, /* printed size is unsupported */
-		.y_pixels_per_m = 0, /* printed size is unsupported */
-		.colors_used = 0, /* color table is unsupported*/
-		.important_colors = 0 /* color table is unsupported */
-	};
+	for (; x + 2 <= width; x += 2)
+		memcpy(&dst[x], decoder->expand4[*src++], sizeof(decoder->expand4[0]));
 
-	uint32_t row_width = bmp_calculate_row_width(infoheader.width, infoheader.bits_per_pixel);
-	infoheader.image_size = infoheader.height * row_width;
+	if (x < width)
+		dst[x] = decoder->expand4[*src][0];
+}
 
-	struct file_header_struct fileheader = {
-		.signature = BMP_SIGNATURE,
-		.file_size = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + infoheader.image_size,
-		.reserved = 0,
-		.data_offset = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE
-	};
+/**
+ * Dekódol egy 8 bites bittérképbeli sort a színtáblázat közvetlen
+ * indexelésével.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
+ */
+static void bmp_decode_row_8(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
+{
+	const Pixel* palette = decoder->palette;
 
-	if ((status = bmp_write_file_header(&fileheader, file)) != NO_ERROR)
-		return status;
-	if ((status = bmp_write_info_header(&infoheader, file)) != NO_ERROR)
-		return status;
+	uint32_t x = 0;
 
-	uint32_t padding_size = row_width - infoheader.width * 3;
-	uint8_t* padding = NULL;
-	if (padding_size > 0)
+	for (; x + 4 <= width; x += 4, src += 4)
 	{
-		padding = (uint8_t*)calloc(padding_size, sizeof(uint8_t));
-		if (padding == NULL)
-			return MEMORY_ERROR;
+		dst[x + 0] = palette[src[0]];
+		dst[x + 1] = palette[src[1]];
+		dst[x + 2] = palette[src[2]];
+		dst[x + 3] = palette[src[3]];
 	}
 
-	for (Pixel** p_row = image->pixels; p_row < image->pixels + infoheader.height; p_row++)
-	{
-		if (fwrite(*p_row, 3, infoheader.width, file) != infoheader.width ||
-			fwrite(padding, sizeof(uint8_t), padding_size, file) != padding_size)
+	for (; x < width; x++)
+		dst[x] = palette[*src++];
+}
+
+#if defined(BMP_USE_SSSE3) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BMP_USE_SSE2
+#include <emmintrin.h>
+
+/**
+ * Kinyer egy színkomponenst 8 darab 16 bites pixelből SSE2 utasításokkal,
+ * a bmp_channel_extract függvénnyel bitre megegyező eredménnyel.
+ *
+ * @param channel A színkomponens-kinyerés.
+ * @param values A pixelek.
+ * @return Visszatér a 16 bites sávokban tárolt 8 bites színkomponensekkel.
+ */
+static __m128i bmp_channel_extract_epi16(const struct bmp_channel_struct* channel, __m128i values)
+{
+	values = _mm_srl_epi16(values, _mm_cvtsi32_si128((int)channel->shift));
+	values = _mm_and_si128(values, _mm_set1_epi16((short)channel->mask));
+	values = _mm_mullo_epi16(values, _mm_set1_epi16((short)channel->factor));
+	return _mm_srl_epi16(values, _mm_cvtsi32_si128((int)channel->scale_shift));
+}
+
+/**
+ * Kinyer egy színkomponenst 4 darab 32 bites pixelből SSE2 utasításokkal,
+ * a bmp_channel_extract függvénnyel bitre megegyező eredménnyel. A kivágott
+ * bitek a sávok alsó felébe férnek, így a szorzás 16 bites is lehet.
+ *
+ * @param channel A színkomponens-kinyerés.
+ * @param values A pixelek.
+ * @return Visszatér a 32 bites sávokban tárolt 8 bites színkomponensekkel.
+ */
+static __m128i bmp_channel_extract_epi32(const struct bmp_channel_struct* channel, __m128i values)
+{
+	values = _mm_srl_epi32(values, _mm_cvtsi32_si128((int)channel->shift));
+	values = _mm_and_si128(values, _mm_set1_epi32((int)channel->mask));
+	values = _mm_mullo_epi16(values, _mm_set1_epi32((int)channel->factor));
+	return _mm_srl_epi32(values, _mm_cvtsi32_si128((int)channel->scale_shift));
+}
+
+/**
+ * Kiír 8 pixelt a komponensenként 16 bites sávokban tárolt kék, zöld és
+ * vörös értékekből. SSSE3 támogatás esetén a komponenseket bájtkeverésekkel
+ * fésüli össze a Pixel-ek sorrendjébe, egyébként egy átmeneti tömbön át.
+ *
+ * @param dst A 8 pixelnyi cél.
+ * @param blue A kék komponensek.
+ * @param green A zöld komponensek.
+ * @param red A vörös komponensek.
+ */
+static void bmp_store_8_pixels_sse2(Pixel* dst, __m128i blue, __m128i green, __m128i red)
+{
+	/* 0-7. bájt: kék, 8-15. bájt: zöld komponensek; illetve 0-7. bájt: vörös komponensek */
+	__m128i blue_green = _mm_packus_epi16(blue, green);
+	__m128i red_red = _mm_packus_epi16(red, red);
+
+#ifdef BMP_USE_SSSE3
+	static const uint8_t interleave[2][2][16] = {
 		{
-			free(padding);
-			return IO_ERROR;
+			{ 0, 8, 0x80, 1, 9, 0x80, 2, 10, 0x80, 3, 11, 0x80, 4, 12, 0x80, 5 },
+			{ 0x80, 0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80 }
+		},
+		{
+			{ 13, 0x80, 6, 14, 0x80, 7, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+			{ 0x80, 5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 }
 		}
+	};
+
+	__m128i low = _mm_or_si128(_mm_shuffle_epi8(blue_green, _mm_loadu_si128((const __m128i*)interleave[0][0])),
+		_mm_shuffle_epi8(red_red, _mm_loadu_si128((const __m128i*)interleave[0][1])));
+	__m128i high = _mm_or_si128(_mm_shuffle_epi8(blue_green, _mm_loadu_si128((const __m128i*)interleave[1][0])),
+		_mm_shuffle_epi8(red_red, _mm_loadu_si128((const __m128i*)interleave[1][1])));
+	_mm_storeu_si128((__m128i*)dst, low);
+	_mm_storel_epi64((__m128i*)((uint8_t*)dst + 16), high);
+#else
+	uint8_t components[32];
+	_mm_storeu_si128((__m128i*)components, blue_green);
+	_mm_storeu_si128((__m128i*)(components + 16), red_red);
+	for (int i = 0; i < 8; i++)
+	{
+		dst[i].blue = components[i];
+		dst[i].green = components[8 + i];
+		dst[i].red = components[16 + i];
 	}
+#endif
+}
+#endif
+
+/**
+ * Dekódol egy 16 bites bittérképbeli sort a színmaszkok alapján. SSE2
+ * támogatás esetén 8 pixelenként vektorosan.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
+ */
+static void bmp_decode_row_16(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
+{
+	const struct bmp_channel_struct* channels = decoder->channels;
 
-	free(padding);
+	uint32_t x = 0;
 
-	return NO_ERROR;
+#ifdef BMP_USE_SSE2
+	for (; x + 8 <= width; x += 8, src += 16)
+	{
+		__m128i values = _mm_loadu_si128((const __m128i*)src);
+		bmp_store_8_pixels_sse2(&dst[x],
+			bmp_channel_extract_epi16(&channels[0], values),
+			bmp_channel_extract_epi16(&channels[1], values),
+			bmp_channel_extract_epi16(&channels[2], values));
+	}
+#endif
+
+	for (; x < width; x++, src += 2)
+	{
+		uint32_t value = read_u16_le(src);
+		dst[x].blue = bmp_channel_extract(&channels[0], value);
+		dst[x].green = bmp_channel_extract(&channels[1], value);
+		dst[x].red = bmp_channel_extract(&channels[2], value);
+	}
+}
+
+/**
+ * Dekódol egy 32 bites bittérképbeli sort a színmaszkok alapján (az alfa
+ * csatorna elvész). SSE2 támogatás esetén 8 pixelenként vektorosan.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
+ */
+static void bmp_decode_row_32(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
+{
+	const struct bmp_channel_struct* channels = decoder->channels;
+
+	uint32_t x = 0;
+
+#ifdef BMP_USE_SSE2
+	for (; x + 8 <= width; x += 8, src += 32)
+	{
+		__m128i low = _mm_loadu_si128((const __m128i*)src);
+		__m128i high = _mm_loadu_si128((const __m128i*)(src + 16));
+		__m128i components[3];
+		for (int c = 0; c < 3; c++)
+			components[c] = _mm_packs_epi32(bmp_channel_extract_epi32(&channels[c], low), bmp_channel_extract_epi32(&channels[c], high));
+		bmp_store_8_pixels_sse2(&dst[x], components[0], components[1], components[2]);
+	}
+#endif
+
+	for (; x < width; x++, src += 4)
+	{
+		uint32_t value = read_u32_le(src);
+		dst[x].blue = bmp_channel_extract(&channels[0], value);
+		dst[x].green = bmp_channel_extract(&channels[1], value);
+		dst[x].red = bmp_channel_extract(&channels[2], value);
+	}
+}
+
+#ifdef BMP_USE_SSSE3
+/**
+ * Dekódol egy 32 bites, bájthatáros 8 bites komponensekből álló (például
+ * BGRX vagy BGRA elrendezésű) bittérképbeli sort: 4 pixel 12 bájtja
+ * egyetlen bájtkeveréssel (pshufb) áll elő.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
+ */
+static void bmp_decode_row_32_bytes(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
+{
+	const __m128i shuffle = _mm_loadu_si128((const __m128i*)decoder->shuffle32);
+
+	uint32_t x = 0;
+
+	for (; x + 8 <= width; x += 8, src += 32)
+	{
+		/* a keverés utolsó 4 bájtja nulla, így a két 12 bájtos eredmény összefésülhető */
+		__m128i low = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), shuffle);
+		__m128i high = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 16)), shuffle);
+		_mm_storeu_si128((__m128i*)&dst[x], _mm_or_si128(low, _mm_slli_si128(high, 12)));
+		_mm_storel_epi64((__m128i*)((uint8_t*)&dst[x] + 16), _mm_srli_si128(high, 4));
+	}
+
+	for (; x < width; x++, src += 4)
+	{
+		dst[x].blue = src[decoder->shuffle32[0]];
+		dst[x].green = src[decoder->shuffle32[1]];
+		dst[x].red = src[decoder->shuffle32[2]];
+	}
+}
+#endif
+
+/**
+ * Dekódol egy 24 bites bittérképbeli sort, mely bájtról bájtra megegyezik a
+ * Pixel-ek sorozatával, így egyetlen tömbös másolás.
+ *
+ * @param decoder A dekódoló.
+ * @param dst A cél pixelsor.
+ * @param src A bittérképbeli sor.
+ * @param width A sor szélessége (pixelben).
+ */
+static void bmp_decode_row_24(const struct bmp_decoder_struct* decoder, Pixel* dst, const uint8_t* src, uint32_t width)
+{
+	(void)decoder;
+
+	memcpy(dst, src, (size_t)width * sizeof(Pixel));
+}
+
+/* egy RLE parancs (a kitöltéssel együtt) legnagyobb hossza bájtban */
+#define BMP_RLE_MAX_COMMAND		(2 + 255 + 1)
+
+/*
+ * Egy RLE8/RLE4 tömörítésű bittérkép soronkénti kibontásának állapota. A
+ * tömörített adat vagy teljes egészében a memóriában van (leképezett fájl),
+ * vagy egy fájlból kerül blokkonként a pufferbe.
+ */
+struct bmp_rle_state_struct
+{
+	FILE* file; /* a tömörített adatot tartalmazó fájl (vagy NULL) */
+	uint8_t* buffer; /* a fájlból olvasott blokkok puffere (vagy NULL) */
+	size_t capacity; /* a puffer mérete */
+	bool eof; /* elfogyott-e a fájl */
+	const uint8_t* data; /* a tömörített adat (a puffer vagy a leképezés) */
+	size_t length; /* a rendelkezésre álló tömörített bájtok száma */
+	size_t position; /* a következő parancs helye */
+	bool four_bit; /* RLE4 (egyébként RLE8) tömörítés */
+	uint32_t skip_rows; /* a pozícióugrás miatt kihagyandó sorok száma */
+	uint32_t next_x; /* a következő sor első kibontandó pixelének helye */
+	bool ended; /* elértük-e a bittérkép végét jelző parancsot */
+};
+
+/**
+ * Megvizsgálja, hogy egy adott hosszú tömörített bittérkép leírhat-e egy
+ * adott méretű képet. Minden sor legalább egy kétbájtos parancsba kerül,
+ * egy pozícióugrás pedig legfeljebb 255 sort léphet át, így a korlátnál
+ * magasabb képek sorainak túlnyomó része csak a bittérkép vége utáni,
+ * kitöltetlen sorokból állna. Hasonlóan, egy kétbájtos parancs legfeljebb
+ * 255 pixelt tölt ki vagy lép át, így a korlátnál szélesebb képeknek egyetlen
+ * sora sem lehetne teljes. Az ilyen fájlok hibásnak minősülnek.
+ *
+ * @param width A kép szélessége.
+ * @param height A kép magassága.
+ * @param size A tömörített bittérkép legnagyobb lehetséges hossza.
+ * @return Logikai igazzal tér vissza, ha a méretek beleférnek a korlátba.
+ */
+static bool bmp_rle_size_fits(uint32_t width, uint32_t height, uint64_t size)
+{
+	uint64_t limit = (size / 2 + 1) * 255;
+	return width <= limit && height <= limit;
+}
+
+/**
+ * Biztosítja, hogy legalább count tömörített bájt rendelkezésre álljon a
+ * következő parancs helyétől. Fájlból olvasott adat esetén szükség szerint
+ * a puffer elejére mozgatja a maradékot, és egyetlen I/O művelettel
+ * feltölti a puffert.
+ *
+ * @param rle A kibontás állapota.
+ * @param count A szükséges bájtok száma (legfeljebb BMP_RLE_MAX_COMMAND).
+ * @return Amennyiben rendelkezésre áll a szükséges számú bájt, logikai
+ * igazzal, egyébként logikai hamissal tér vissza.
+ */
+static bool bmp_rle_ensure(struct bmp_rle_state_struct* rle, size_t count)
+{
+	if (rle->length - rle->position >= count)
+		return true;
+
+	if (rle->file != NULL && !rle->eof)
+	{
+		size_t left = rle->length - rle->position;
+		memmove(rle->buffer, rle->buffer + rle->position, left);
+
+		size_t wanted = rle->capacity - left;
+		size_t read = fread(rle->buffer + left, sizeof(uint8_t), wanted, rle->file);
+		rle->eof = (read < wanted);
+		rle->length = left + read;
+		rle->position = 0;
+	}
+
+	return rle->length - rle->position >= count;
+}
+
+/**
+ * Kibontja egy tömörített bittérkép következő sorát palettaindexekké
+ * (pixelenként egy bájt). A bittérkép ki nem töltött pixelei (pozícióugrás,
+ * korai sor- vagy bittérképvég) a 0 indexet kapják, a sorból kilógó
+ * pixelek pedig elvesznek.
+ *
+ * @param rle A kibontás állapota.
+ * @param indices A kép szélességével megegyező hosszú cél indexsor.
+ * @param width A kép szélessége.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, csonka tömörített adat
+ * esetén IO_ERROR-ral tér vissza.
+ */
+static int bmp_rle_decode_row(struct bmp_rle_state_struct* rle, uint8_t* indices, uint32_t width)
+{
+	memset(indices, 0, width);
+
+	if (rle->ended)
+		return NO_ERROR;
+	if (rle->skip_rows > 0)
+	{
+		rle->skip_rows--;
+		return NO_ERROR;
+	}
+
+	uint32_t x = rle->next_x;
+	rle->next_x = 0;
+
+	for (;;)
+	{
+		if (!bmp_rle_ensure(rle, 2))
+			return IO_ERROR;
+
+		const uint8_t* command = rle->data + rle->position;
+		uint32_t count = command[0];
+		uint32_t value = command[1];
+		rle->position += 2;
+
+		if (count > 0)
+		{
+			/* kódolt mód: count darab, a value által meghatározott pixel */
+			uint32_t n = (count < width - x) ? count : width - x;
+			if (!rle->four_bit)
+				memset(indices + x, (int)value, n);
+			else
+			{
+				uint8_t pair[2] = { (uint8_t)(value >> 4), (uint8_t)(value & 0x0F) };
+				for (uint32_t i = 0; i < n; i++)
+					indices[x + i] = pair[i & 1];
+			}
+			x += n;
+		}
+		else if (value == 0)
+		{
+			/* sor vége */
+			return NO_ERROR;
+		}
+		else if (value == 1)
+		{
+			/* bittérkép vége */
+			rle->ended = true;
+			return NO_ERROR;
+		}
+		else if (value == 2)
+		{
+			/* pozícióugrás: dx pixellel jobbra, dy sorral feljebb */
+			if (!bmp_rle_ensure(rle, 2))
+				return IO_ERROR;
+
+			uint32_t dx = rle->data[rle->position];
+			uint32_t dy = rle->data[rle->position + 1];
+			rle->position += 2;
+
+			x = (dx < width - x) ? x + dx : width;
+			if (dy > 0)
+			{
+				rle->skip_rows = dy - 1;
+				rle->next_x = x;
+				return NO_ERROR;
+			}
+		}
+		else
+		{
+			/* abszolút mód: value darab index, 16 bitre kitöltve */
+			size_t size = rle->four_bit ? (value + 1) / 2 : value;
+			size += size & 1;
+			if (!bmp_rle_ensure(rle, size))
+				return IO_ERROR;
+
+			const uint8_t* src = rle->data + rle->position;
+			uint32_t n = (value < width - x) ? value : width - x;
+			if (!rle->four_bit)
+				memcpy(indices + x, src, n);
+			else
+			{
+				for (uint32_t i = 0; i < n; i++)
+					indices[x + i] = (i & 1) ? (src[i / 2] & 0x0F) : (src[i / 2] >> 4);
+			}
+			x += n;
+			rle->position += size;
+		}
+	}
+}
+
+/**
+ * Kiolvassa egy BMP formátumú kép jellemzőit kizárólag a fejlécek alapján,
+ * a színtáblázat és a bittérkép beolvasása nélkül. A fájl pozíciója a
+ * hívás után a fejlécek végére mutat.
+ *
+ * @param[out] p_info A jellemzők helye.
+ * @param[in] file A fájl.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások
+ * vagy az I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_probe(BmpInfo* p_info, FILE* file)
+{
+	int status;
+
+	struct file_header_struct fileheader;
+	struct info_header_struct infoheader;
+
+	if ((status = bmp_read_headers(&fileheader, &infoheader, file)) != NO_ERROR)
+		return status;
+	if ((status = bmp_check_file_validity(&fileheader)) != NO_ERROR)
+		return status;
+	if ((status = bmp_check_info_validity(&infoheader)) != NO_ERROR)
+		return status;
+
+	p_info->width = infoheader.width;
+	p_info->height = infoheader.height;
+	p_info->bits_per_pixel = infoheader.bits_per_pixel;
+	p_info->compression = infoheader.compression;
+	/* az igazított, kitöltött sorokból álló pixelmátrix (lásd image_create) */
+	p_info->memory_size = (uint64_t)image_calculate_stride(infoheader.width) * infoheader.height + IMAGE_ALIGNMENT - 1;
+
+	return NO_ERROR;
+}
+
+/**
+ * Felkészít egy dekódolót egy validált információs fejlécű bittérkép
+ * sorainak dekódolására: kiválasztja a bitmélységnek megfelelő dekódoló
+ * függvényt, és kitölti a színtáblázatból számolt táblázatokat.
+ *
+ * @param decoder A dekódoló.
+ * @param infoheader A bittérkép információs fejléce.
+ * @param color_table A bittérkép színtáblázata (vagy NULL).
+ */
+static void bmp_decoder_init(struct bmp_decoder_struct* decoder, const struct info_header_struct* infoheader, const struct color_entry* color_table)
+{
+	uint32_t color_count = infoheader->colors_used < 256 ? infoheader->colors_used : 256;
+
+	memset(decoder->palette, 0, sizeof(decoder->palette));
+	for (uint32_t i = 0; i < color_count; i++)
+	{
+		decoder->palette[i].blue = color_table[i].blue;
+		decoder->palette[i].green = color_table[i].green;
+		decoder->palette[i].red = color_table[i].red;
+	}
+
+	switch (infoheader->bits_per_pixel)
+	{
+	case 1:
+	{
+		/* ha egy monokróm képnél egyetlen egy színt tárolunk a színtáblázatban,
+		akkor vagy azt a színt reprezentálja a bit vagy a feketét */
+		const Pixel black = { 0, 0, 0 };
+		const Pixel colors[2] = {
+			(color_count >= 2) ? decoder->palette[0] : black,
+			(color_count >= 2) ? decoder->palette[1] : decoder->palette[0]
+		};
+		for (int byte = 0; byte < 256; byte++)
+			for (int bit = 0; bit < 8; bit++)
+				decoder->expand1[byte][bit] = colors[(byte >> (7 - bit)) & 1];
+		decoder->decode = bmp_decode_row_1;
+		break;
+	}
+	case 4:
+		for (int byte = 0; byte < 256; byte++)
+		{
+			decoder->expand4[byte][0] = decoder->palette[byte >> 4];
+			decoder->expand4[byte][1] = decoder->palette[byte & 0x0F];
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			decoder->planes4[0][i] = decoder->palette[i].blue;
+			decoder->planes4[1][i] = decoder->palette[i].green;
+			decoder->planes4[2][i] = decoder->palette[i].red;
+		}
+		decoder->decode = bmp_decode_row_4;
+		break;
+	case 8:
+		decoder->decode = bmp_decode_row_8;
+		break;
+	case 16: case 32:
+	{
+		bmp_channel_init(&decoder->channels[0], infoheader->blue_mask);
+		bmp_channel_init(&decoder->channels[1], infoheader->green_mask);
+		bmp_channel_init(&decoder->channels[2], infoheader->red_mask);
+		decoder->decode = (infoheader->bits_per_pixel == 16) ? bmp_decode_row_16 : bmp_decode_row_32;
+
+		/* a bájthatáros 8 bites komponensek egyszerű bájtmásolással is kinyerhetők */
+		bool byte_aligned = true;
+		for (int c = 0; c < 3; c++)
+			byte_aligned = byte_aligned && decoder->channels[c].mask == 0xFF && decoder->channels[c].shift % 8 == 0;
+		memset(decoder->shuffle32, 0x80, sizeof(decoder->shuffle32));
+		if (byte_aligned && infoheader->bits_per_pixel == 32)
+		{
+			for (int i = 0; i < 4; i++)
+				for (int c = 0; c < 3; c++)
+					decoder->shuffle32[3 * i + c] = (uint8_t)(4 * i + decoder->channels[c].shift / 8);
+#ifdef BMP_USE_SSSE3
+			decoder->decode = bmp_decode_row_32_bytes;
+#endif
+		}
+		break;
+	}
+	default:
+		decoder->decode = bmp_decode_row_24;
+		break;
+	}
+
+	/* a tömörített bittérképek sorait bájtonként egy indexszé bontjuk ki */
+	if (bmp_is_run_length_encoded(infoheader))
+		decoder->decode = bmp_decode_row_8;
+}
+
+/* egy blokkba (vagyis egyetlen I/O műveletbe) összefogott sorok legnagyobb összmérete */
+#define BMP_IO_BLOCK_SIZE		(1 << 20)
+/* a több blokkos bittérképek előreolvasásához használt pufferek száma */
+#define BMP_READ_AHEAD_BLOCKS	2
+
+/* BMP képeket soronként beolvasó struktúra */
+struct bmp_reader_struct
+{
+	FILE* file; /* a beolvasandó fájl */
+	struct info_header_struct infoheader; /* a kép információs fejléce */
+	struct color_entry* color_table; /* a kép színtáblázata (vagy NULL) */
+	struct bmp_decoder_struct decoder; /* a kép sorait dekódoló struktúra */
+	uint32_t data_offset; /* a bittérkép kezdőpozíciója a fájlban */
+	uint32_t row_width; /* egy bittérképbeli sor hossza (bájtban) */
+	uint32_t rows_left; /* a még be nem olvasott sorok száma */
+	uint8_t* block; /* több bittérképbeli sort egyszerre tároló puffer (vagy NULL) */
+	ReadAhead* read_ahead; /* a bittérkép blokkjait háttérszálon előre beolvasó struktúra (vagy NULL) */
+	const uint8_t* data; /* az aktuális blokk (a puffer vagy az előreolvasó egy blokkja) */
+	size_t block_rows; /* a pufferben elférő sorok száma */
+	size_t block_length; /* a pufferbe beolvasott bájtok száma */
+	size_t block_position; /* a következő sor helye a pufferben */
+	bool compressed; /* tömörített-e a bittérkép */
+	struct bmp_rle_state_struct rle; /* tömörített bittérkép kibontásának állapota */
+	uint8_t* indices; /* tömörített bittérkép egy kibontott indexsora */
+};
+
+/**
+ * Megnyit egy szabványos BMP formátumú képet soronkénti beolvasásra:
+ * beolvassa és validálja a fejléceket és a színtáblázatot, majd a fájlt a
+ * bittérkép elejére pozícionálja. A sorok a bittérképbeli sorrendjükben
+ * olvashatók be a bmp_reader_read_row függvénnyel, a fájlból azonban
+ * legfeljebb BMP_IO_BLOCK_SIZE méretű blokkokban kerülnek beolvasásra; a
+ * több blokkos, tömörítetlen bittérképek blokkjait egy háttérszál olvassa
+ * be előre, a dekódolással párhuzamosan.
+ *
+ * A lefoglalt memóriaterület felszabadítása (bmp_reader_close) a hívó
+ * feladata.
+ *
+ * @param[out] p_reader A beolvasó struktúrára mutató pointer helye.
+ * @param[in] file A fájl.
+ * @param[out] p_width A kép szélességének helye.
+ * @param[out] p_height A kép magasságának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
+ * az allokációk vagy egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_reader_open(BmpReader** p_reader, FILE* file, uint32_t* p_width, uint32_t* p_height)
+{
+	int status;
+
+	BmpReader* reader = (BmpReader*)malloc(sizeof(BmpReader));
+	if (reader == NULL)
+		return MEMORY_ERROR;
+
+	reader->file = file;
+	reader->color_table = NULL;
+	reader->block = NULL;
+	reader->read_ahead = NULL;
+	reader->data = NULL;
+	reader->indices = NULL;
+
+	struct file_header_struct fileheader;
+	struct info_header_struct* infoheader = &reader->infoheader;
+
+	if ((status = bmp_read_headers(&fileheader, infoheader, file)) != NO_ERROR)
+		goto error;
+	if ((status = bmp_check_file_validity(&fileheader)) != NO_ERROR)
+		goto error;
+	if ((status = bmp_check_info_validity(infoheader)) != NO_ERROR)
+		goto error;
+
+	/* a színmaszkok közvetlenül a 40 bájtos fejlécrész után kezdődnek */
+	if (bmp_has_color_masks(infoheader))
+	{
+		uint8_t masks[BMP_COLOR_MASKS_SIZE];
+		if (fread(masks, sizeof(masks), 1, file) != 1)
+		{
+			status = IO_ERROR;
+			goto error;
+		}
+		bmp_parse_color_masks(infoheader, masks);
+	}
+	else
+		bmp_parse_color_masks(infoheader, NULL);
+
+	if (infoheader->colors_used > 0)
+	{
+		/* a színtáblázat közvetlenül az információs fejléc (és a színmaszkok) után kezdődik,
+		 * és nem nyúlhat bele a bittérképbe (a 8 bitnél mélyebb képeknél a színek száma
+		 * máshol nincs korlátozva) */
+		uint64_t color_table_offset = bmp_calculate_color_table_offset(infoheader);
+		if (color_table_offset + (uint64_t)infoheader->colors_used * sizeof(struct color_entry) > fileheader.data_offset)
+		{
+			status = BMP_INVALID_COLORS;
+			goto error;
+		}
+
+		reader->color_table = (struct color_entry*)malloc(infoheader->colors_used * sizeof(struct color_entry));
+		if (reader->color_table == NULL)
+		{
+			status = MEMORY_ERROR;
+			goto error;
+		}
+
+		if ((infoheader->header_size != BMP_INFO_HEADER_SIZE &&
+			fseek(file, (long)color_table_offset, SEEK_SET) != 0) ||
+			fread(reader->color_table, sizeof(struct color_entry), infoheader->colors_used, file) != infoheader->colors_used)
+		{
+			status = IO_ERROR;
+			goto error;
+		}
+	}
+
+	if (fseek(file, fileheader.data_offset, SEEK_SET) != 0)
+	{
+		status = IO_ERROR;
+		goto error;
+	}
+
+	/* a bittérkép a fájl méretével vethető össze (csővezetéknél nem), még a
+	 * szélességtől függő pufferek lefoglalása előtt */
+	uint64_t file_size;
+	if (platform_get_file_size(file, &file_size) == NO_ERROR)
+	{
+		if (!bmp_is_run_length_encoded(infoheader) &&
+			(uint64_t)fileheader.data_offset + bmp_calculate_row_width(infoheader->width, infoheader->bits_per_pixel) * infoheader->height > file_size)
+		{
+			status = IO_ERROR;
+			goto error;
+		}
+
+		/* a tömörített bittérkép hossza csak a fájl méretéből becsülhető */
+		if (bmp_is_run_length_encoded(infoheader) &&
+			(file_size < fileheader.data_offset || !bmp_rle_size_fits(infoheader->width, infoheader->height, file_size - fileheader.data_offset)))
+		{
+			status = BMP_TOO_LARGE;
+			goto error;
+		}
+	}
+
+	bmp_decoder_init(&reader->decoder, infoheader, reader->color_table);
+
+	reader->data_offset = fileheader.data_offset;
+	reader->row_width = (uint32_t)bmp_calculate_row_width(infoheader->width, infoheader->bits_per_pixel);
+	reader->rows_left = infoheader->height;
+
+	/* a kis képeknek elég a teljes bittérképnyi puffer */
+	reader->block_rows = BMP_IO_BLOCK_SIZE / (reader->row_width > 0 ? reader->row_width : 1);
+	if (reader->block_rows == 0)
+		reader->block_rows = 1;
+	if (reader->block_rows > infoheader->height)
+		reader->block_rows = infoheader->height > 0 ? infoheader->height : 1;
+	reader->block_length = 0;
+	reader->block_position = 0;
+
+	/* a tömörített bittérkép sorai változó hosszúak, ezért a puffert bájtfolyamként kezeljük */
+	reader->compressed = bmp_is_run_length_encoded(infoheader);
+
+	/* a több blokkos, tömörítetlen bittérképek pufferei az első sor olvasásakor kerülnek lefoglalásra */
+	size_t block_size = reader->compressed ? BMP_IO_BLOCK_SIZE : reader->block_rows * reader->row_width;
+	if (reader->compressed || reader->block_rows >= infoheader->height)
+	{
+		allocator_reserve(block_size);
+
+		reader->block = (uint8_t*)malloc(block_size > 0 ? block_size : 1);
+		if (reader->block == NULL)
+		{
+			status = MEMORY_ERROR;
+			goto error;
+		}
+	}
+
+	if (reader->compressed)
+	{
+		reader->indices = (uint8_t*)malloc(infoheader->width > 0 ? infoheader->width : 1);
+		if (reader->indices == NULL)
+		{
+			status = MEMORY_ERROR;
+			goto error;
+		}
+
+		struct bmp_rle_state_struct rle = {
+			.file = file,
+			.buffer = reader->block,
+			.capacity = block_size,
+			.eof = false,
+			.data = reader->block,
+			.length = 0,
+			.position = 0,
+			.four_bit = (infoheader->compression == BMP_COMPRESSION_RLE4),
+			.skip_rows = 0,
+			.next_x = 0,
+			.ended = false
+		};
+		reader->rle = rle;
+	}
+
+	*p_reader = reader;
+	*p_width = infoheader->width;
+	*p_height = infoheader->height;
+
+	return NO_ERROR;
+
+error:
+	bmp_reader_close(reader);
+	return status;
+}
+
+/**
+ * Felkészít egy több blokkos, tömörítetlen bittérképet olvasó struktúrát a
+ * blokkok beolvasására: elindít egy előreolvasót, mely a bittérkép
+ * következő blokkjait a dekódolással párhuzamosan olvassa be. Ha a
+ * háttérszál nem indítható el, a blokkok egyetlen pufferbe, a dekódolással
+ * felváltva kerülnek beolvasásra.
+ *
+ * @param reader A beolvasó struktúra.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+static int bmp_reader_start_blocks(BmpReader* reader)
+{
+	size_t block_size = reader->block_rows * reader->row_width;
+	uint64_t bitmap_size = (uint64_t)reader->rows_left * reader->row_width;
+
+	if (readahead_create(&reader->read_ahead, reader->file, reader->data_offset, bitmap_size, block_size, BMP_READ_AHEAD_BLOCKS) == NO_ERROR)
+		return NO_ERROR;
+	reader->read_ahead = NULL;
+
+	allocator_reserve(block_size);
+
+	reader->block = (uint8_t*)malloc(block_size);
+	return (reader->block != NULL) ? NO_ERROR : MEMORY_ERROR;
+}
+
+/**
+ * Beolvassa és dekódolja a kép következő bittérképbeli sorát. Amennyiben a
+ * blokk kiürült, átveszi az előreolvasótól a következő blokknyi sort (vagy
+ * egyetlen I/O műveletben beolvassa azt), tömörített bittérkép esetén pedig
+ * beolvassa a következő blokknyi tömörített adatot.
+ *
+ * @param reader A beolvasó struktúra.
+ * @param row A kép szélességével megegyező hosszú cél pixelsor.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a fájl idő előtti vége
+ * vagy egyéb I/O probléma esetén IO_ERROR-ral tér vissza.
+ */
+int bmp_reader_read_row(BmpReader* reader, Pixel* row)
+{
+	int status;
+
+	if (reader->compressed)
+	{
+		if (reader->rows_left == 0)
+			return IO_ERROR;
+		if ((status = bmp_rle_decode_row(&reader->rle, reader->indices, reader->infoheader.width)) != NO_ERROR)
+			return status;
+
+		reader->rows_left--;
+		reader->decoder.decode(&reader->decoder, row, reader->indices, reader->infoheader.width);
+
+		return NO_ERROR;
+	}
+
+	if (reader->block_position == reader->block_length)
+	{
+		if (reader->rows_left == 0)
+			return IO_ERROR;
+
+		size_t rows = (reader->rows_left < reader->block_rows) ? reader->rows_left : reader->block_rows;
+		size_t length = rows * reader->row_width;
+
+		if (reader->block == NULL && reader->read_ahead == NULL && (status = bmp_reader_start_blocks(reader)) != NO_ERROR)
+			return status;
+
+		if (reader->read_ahead != NULL)
+		{
+			size_t read;
+			if ((status = readahead_next(reader->read_ahead, &reader->data, &read)) != NO_ERROR)
+				return status;
+			if (read != length)
+				return IO_ERROR;
+		}
+		else
+		{
+			if (fread(reader->block, sizeof(uint8_t), length, reader->file) != length)
+				return IO_ERROR;
+			reader->data = reader->block;
+		}
+
+		reader->rows_left -= (uint32_t)rows;
+		reader->block_length = length;
+		reader->block_position = 0;
+	}
+
+	reader->decoder.decode(&reader->decoder, row, reader->data + reader->block_position, reader->infoheader.width);
+	reader->block_position += reader->row_width;
+
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadít egy beolvasó struktúrát. A fájlt nem zárja le.
+ *
+ * @param reader A beolvasó struktúra.
+ */
+void bmp_reader_close(BmpReader* reader)
+{
+	if (reader->read_ahead != NULL)
+		readahead_destroy(reader->read_ahead);
+	if (reader->indices != NULL)
+		free(reader->indices);
+	if (reader->block != NULL)
+		free(reader->block);
+	if (reader->color_table != NULL)
+		free(reader->color_table);
+	free(reader);
+}
+
+/**
+ * Betölt egy szabványos BMP formátumú képet egy fájlból, melyet paraméterként
+ * ad vissza a hívónak.
+ *
+ * A lefoglalt memóriaterület felszabadítása a hívó feladata.
+ *
+ * @param p_image A képre mutató poitner helye.
+ * @param file A fájl.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
+ * az allokációk vagy egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_load(Image** p_image, FILE* file)
+{
+	int status;
+
+	BmpReader* reader;
+	uint32_t width, height;
+
+	if ((status = bmp_reader_open(&reader, file, &width, &height)) != NO_ERROR)
+		return status;
+
+	Image* image = image_create(width, height);
+	if (image == NULL)
+	{
+		bmp_reader_close(reader);
+		return MEMORY_ERROR;
+	}
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		if ((status = bmp_reader_read_row(reader, image_row(image, y))) != NO_ERROR)
+		{
+			bmp_reader_close(reader);
+			image_destroy(image);
+			return status;
+		}
+	}
+
+	bmp_reader_close(reader);
+
+	*p_image = image;
+
+	return NO_ERROR;
+}
+
+/**
+ * Validálja egy memóriába leképezett BMP fájl fejléceit, és megkeresi a
+ * színtáblázatot és a bittérképet, melyeknek teljes egészében a fájlon
+ * belül kell lenniük.
+ *
+ * @param[in] mapping A leképezett fájl.
+ * @param[in] mapping_size A leképezett fájl mérete (bájtban).
+ * @param[out] p_infoheader Az információs fejléc helye.
+ * @param[out] p_color_table A színtáblázat kezdőcímének helye.
+ * @param[out] p_bitmap A bittérkép kezdőcímének helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, csonka fájl esetén
+ * IO_ERROR-ral, egyébként a validálások hibakódjával tér vissza.
+ */
+static int bmp_validate_mapping(uint8_t* mapping, size_t mapping_size, struct info_header_struct* p_infoheader, const struct color_entry** p_color_table, uint8_t** p_bitmap)
+{
+	int status;
+
+	if (mapping_size < BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE)
+		return IO_ERROR;
+
+	struct file_header_struct fileheader;
+	bmp_parse_file_header(&fileheader, mapping);
+	if ((status = bmp_check_file_validity(&fileheader)) != NO_ERROR)
+		return status;
+
+	bmp_parse_info_header(p_infoheader, mapping + BMP_FILE_HEADER_SIZE);
+	if ((status = bmp_check_info_validity(p_infoheader)) != NO_ERROR)
+		return status;
+
+	if (bmp_has_color_masks(p_infoheader))
+	{
+		if (BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + BMP_COLOR_MASKS_SIZE > mapping_size)
+			return IO_ERROR;
+		bmp_parse_color_masks(p_infoheader, mapping + BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE);
+	}
+	else
+		bmp_parse_color_masks(p_infoheader, NULL);
+
+	uint64_t color_table_offset = bmp_calculate_color_table_offset(p_infoheader);
+	/* a tömörített bittérkép hossza csak a kibontás során derül ki */
+	uint64_t row_width = bmp_calculate_row_width(p_infoheader->width, p_infoheader->bits_per_pixel);
+	uint64_t bitmap_size = !bmp_is_run_length_encoded(p_infoheader) ? row_width * p_infoheader->height : 0;
+	if (color_table_offset + (uint64_t)p_infoheader->colors_used * sizeof(struct color_entry) > mapping_size ||
+		(uint64_t)fileheader.data_offset + bitmap_size > mapping_size)
+		return IO_ERROR;
+	if (bmp_is_run_length_encoded(p_infoheader) && !bmp_rle_size_fits(p_infoheader->width, p_infoheader->height, mapping_size - fileheader.data_offset))
+		return BMP_TOO_LARGE;
+
+	*p_color_table = (const struct color_entry*)(mapping + color_table_offset);
+	*p_bitmap = mapping + fileheader.data_offset;
+
+	return NO_ERROR;
+}
+
+/**
+ * Kibont egy leképezett fájlban található, tömörített bittérképet egy
+ * újonnan létrehozott képbe.
+ *
+ * A lefoglalt memóriaterület felszabadítása (image_destroy) a hívó
+ * feladata.
+ *
+ * @param[out] p_image A kibontott kép helye.
+ * @param[in] infoheader A kép információs fejléce.
+ * @param[in] color_table A kép színtáblázata.
+ * @param[in] bitmap A tömörített bittérkép.
+ * @param[in] size A tömörített bittérkép legnagyobb lehetséges hossza.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk
+ * hibakódjával, csonka tömörített adat esetén pedig IO_ERROR-ral tér
+ * vissza.
+ */
+static int bmp_load_rle_mapped(Image** p_image, const struct info_header_struct* infoheader, const struct color_entry* color_table, const uint8_t* bitmap, size_t size)
+{
+	int status = NO_ERROR;
+
+	struct bmp_decoder_struct decoder;
+	bmp_decoder_init(&decoder, infoheader, color_table);
+
+	struct bmp_rle_state_struct rle = {
+		.file = NULL,
+		.buffer = NULL,
+		.capacity = 0,
+		.eof = true,
+		.data = bitmap,
+		.length = size,
+		.position = 0,
+		.four_bit = (infoheader->compression == BMP_COMPRESSION_RLE4),
+		.skip_rows = 0,
+		.next_x = 0,
+		.ended = false
+	};
+
+	uint8_t* indices = (uint8_t*)malloc(infoheader->width > 0 ? infoheader->width : 1);
+	if (indices == NULL)
+		return MEMORY_ERROR;
+
+	Image* image = image_create(infoheader->width, infoheader->height);
+	if (image == NULL)
+	{
+		free(indices);
+		return MEMORY_ERROR;
+	}
+
+	for (uint32_t y = 0; y < infoheader->height; y++)
+	{
+		if ((status = bmp_rle_decode_row(&rle, indices, infoheader->width)) != NO_ERROR)
+			break;
+		decoder.decode(&decoder, image_row(image, y), indices, infoheader->width);
+	}
+
+	free(indices);
+
+	if (status != NO_ERROR)
+	{
+		image_destroy(image);
+		return status;
+	}
+
+	*p_image = image;
+
+	return NO_ERROR;
+}
+
+/* a párhuzamos beolvasás, illetve kiírás egy részfeladatának legnagyobb mérete */
+#define BMP_BAND_SIZE			(1 << 20)
+
+/* a párhuzamos beolvasás, illetve kiírás egy részfeladatának legkisebb mérete */
+#define BMP_BAND_MIN_SIZE		(1 << 16)
+
+/* ennyi részfeladatra bomlik szálanként a bittérkép a terhelés kiegyenlítéséhez */
+#define BMP_BANDS_PER_THREAD	8
+
+/* a párhuzamos beolvasás és kiírás részfeladatainak közös állapota */
+struct bmp_band_context_struct
+{
+	FILE* file; /* a fájl (leképezett beolvasáskor NULL) */
+	const uint8_t* bitmap; /* a leképezett bittérkép (leképezett beolvasáskor), egyébként NULL */
+	Image* image; /* a beolvasott, illetve kiírandó kép */
+	const struct bmp_decoder_struct* decoder; /* a sorokat dekódoló struktúra (beolvasáskor) */
+	uint64_t data_offset; /* a bittérkép kezdőpozíciója a fájlban */
+	uint32_t row_width; /* egy bittérképbeli sor hossza (bájtban) */
+	uint32_t band_rows; /* egy sáv (részfeladat) sorainak száma */
+	uint8_t** buffers; /* munkásonként egy sávnyi puffer */
+	int* statuses; /* munkásonként az első hiba kódja */
+};
+
+/**
+ * Kiszámolja, hány sor alkot egy sávot: szálanként BMP_BANDS_PER_THREAD
+ * sáv jut, hogy a munkások egymástól lophassanak, a sáv mérete azonban
+ * BMP_BAND_MIN_SIZE és BMP_BAND_SIZE közé esik.
+ *
+ * @param row_width Egy bittérképbeli sor hossza (bájtban).
+ * @param height A kép magassága.
+ * @param thread_count A munkások száma.
+ * @return Visszatér a sorok számával (legalább 1-gyel).
+ */
+static uint32_t bmp_calculate_band_rows(uint32_t row_width, uint32_t height, int thread_count)
+{
+	uint32_t width = (row_width > 0) ? row_width : 1;
+	uint32_t band_rows = height / ((uint32_t)thread_count * BMP_BANDS_PER_THREAD);
+	if (band_rows < BMP_BAND_MIN_SIZE / width)
+		band_rows = BMP_BAND_MIN_SIZE / width;
+	if (band_rows > BMP_BAND_SIZE / width)
+		band_rows = BMP_BAND_SIZE / width;
+	if (band_rows > height)
+		band_rows = height;
+	return (band_rows > 0) ? band_rows : 1;
+}
+
+/**
+ * Lefoglal munkásonként egy-egy sávnyi puffert és állapotjelzőt a
+ * párhuzamos beolvasáshoz, illetve kiíráshoz. A pufferek kitöltése nullákkal
+ * történik, így a sorvégi kitöltés kiírás előtt nem igényel külön lépést.
+ *
+ * @param context A részfeladatok közös állapota, melynek row_width és
+ * band_rows mezői már ki vannak töltve.
+ * @param thread_count A munkások száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+static int bmp_band_context_create(struct bmp_band_context_struct* context, int thread_count)
+{
+	context->statuses = (int*)malloc(thread_count * sizeof(int));
+	context->buffers = (uint8_t**)malloc(thread_count * sizeof(uint8_t*));
+	if (context->statuses == NULL || context->buffers == NULL)
+		return MEMORY_ERROR;
+
+	for (int i = 0; i < thread_count; i++)
+	{
+		context->statuses[i] = NO_ERROR;
+		context->buffers[i] = NULL;
+	}
+
+	size_t buffer_size = (size_t)context->band_rows * context->row_width;
+	allocator_reserve(buffer_size);
+
+	for (int i = 0; i < thread_count; i++)
+	{
+		context->buffers[i] = (uint8_t*)malloc(buffer_size > 0 ? buffer_size : 1);
+		if (context->buffers[i] == NULL)
+			return MEMORY_ERROR;
+		memset(context->buffers[i], 0, buffer_size);
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadítja a párhuzamos beolvasás, illetve kiírás puffereit, és
+ * visszatér az első munkás által jelzett hibával.
+ *
+ * @param context A részfeladatok közös állapota.
+ * @param thread_count A munkások száma.
+ * @return Visszatér az első hibakóddal, hiba hiányában NO_ERROR-ral.
+ */
+static int bmp_band_context_destroy(struct bmp_band_context_struct* context, int thread_count)
+{
+	int status = NO_ERROR;
+
+	if (context->buffers != NULL)
+	{
+		for (int i = 0; i < thread_count; i++)
+			if (context->buffers[i] != NULL)
+				free(context->buffers[i]);
+		free(context->buffers);
+	}
+	if (context->statuses != NULL)
+	{
+		for (int i = 0; i < thread_count && status == NO_ERROR; i++)
+			status = context->statuses[i];
+		free(context->statuses);
+	}
+
+	return status;
+}
+
+/**
+ * Beolvas és dekódol egy sávnyi sort (a párhuzamos beolvasás egy
+ * részfeladata).
+ *
+ * @param argument A részfeladatok közös állapota.
+ * @param task A sáv indexe.
+ * @param worker A munkás indexe.
+ */
+static void bmp_load_band(void* argument, size_t task, int worker)
+{
+	struct bmp_band_context_struct* context = (struct bmp_band_context_struct*)argument;
+
+	if (context->statuses[worker] != NO_ERROR)
+		return;
+
+	uint32_t first = (uint32_t)(task * context->band_rows);
+	uint32_t rows = context->image->height - first;
+	if (rows > context->band_rows)
+		rows = context->band_rows;
+
+	uint8_t* buffer = context->buffers[worker];
+	int status = platform_read_at(context->file, buffer, (size_t)rows * context->row_width,
+		context->data_offset + (uint64_t)first * context->row_width);
+	if (status != NO_ERROR)
+	{
+		context->statuses[worker] = status;
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++)
+		context->decoder->decode(context->decoder, image_row(context->image, first + y), buffer + (size_t)y * context->row_width, context->image->width);
+}
+
+/**
+ * Beolvas egy szabványos BMP formátumú képet egy fájlból több szálon: a
+ * bittérkép sorai rögzített pozíción helyezkednek el, így a munkáskészlet
+ * szálai egymástól függetlenül, pozícionált olvasással tölthetik be és
+ * dekódolhatják a kép egy-egy sávját. A tömörített bittérképek kibontása
+ * egy szálon történik.
+ *
+ * A lefoglalt memóriaterület felszabadítása (image_destroy) a hívó
+ * feladata.
+ *
+ * @param[out] p_image A beolvasott kép helye.
+ * @param[in] file A fájl.
+ * @param[in] pool A munkáskészlet.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
+ * az allokációk vagy egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_load_parallel(Image** p_image, FILE* file, ThreadPool* pool)
+{
+	int status;
+
+	BmpReader* reader;
+	uint32_t width, height;
+
+	if ((status = bmp_reader_open(&reader, file, &width, &height)) != NO_ERROR)
+		return status;
+
+	Image* image = image_create(width, height);
+	if (image == NULL)
+	{
+		bmp_reader_close(reader);
+		return MEMORY_ERROR;
+	}
+
+	/* a tömörített sorok helye csak az előzőek kibontásával derül ki */
+	if (reader->compressed)
+	{
+		for (uint32_t y = 0; y < height && status == NO_ERROR; y++)
+			status = bmp_reader_read_row(reader, image_row(image, y));
+		goto close;
+	}
+
+	int thread_count = threadpool_get_thread_count(pool);
+
+	struct bmp_band_context_struct context = {
+		.file = file,
+		.bitmap = NULL,
+		.image = image,
+		.decoder = &reader->decoder,
+		.data_offset = reader->data_offset,
+		.row_width = reader->row_width,
+		.band_rows = bmp_calculate_band_rows(reader->row_width, height, thread_count),
+		.buffers = NULL,
+		.statuses = NULL
+	};
+
+	if ((status = bmp_band_context_create(&context, thread_count)) == NO_ERROR)
+		threadpool_run(pool, bmp_load_band, &context, (height + context.band_rows - 1) / context.band_rows);
+
+	int band_status = bmp_band_context_destroy(&context, thread_count);
+	if (status == NO_ERROR)
+		status = band_status;
+
+close:
+	bmp_reader_close(reader);
+
+	if (status != NO_ERROR)
+	{
+		image_destroy(image);
+		return status;
+	}
+
+	*p_image = image;
+
+	return NO_ERROR;
+}
+
+/**
+ * Dekódol egy sávnyi sort a leképezett bittérképből (a leképezett
+ * beolvasás egy részfeladata).
+ *
+ * @param argument A részfeladatok közös állapota.
+ * @param task A sáv indexe.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void bmp_decode_mapped_band(void* argument, size_t task, int worker)
+{
+	(void)worker;
+
+	const struct bmp_band_context_struct* context = (const struct bmp_band_context_struct*)argument;
+
+	uint32_t first = (uint32_t)(task * context->band_rows);
+	uint32_t rows = context->image->height - first;
+	if (rows > context->band_rows)
+		rows = context->band_rows;
+
+	for (uint32_t y = first; y < first + rows; y++)
+		context->decoder->decode(context->decoder, image_row(context->image, y), context->bitmap + (size_t)y * context->row_width, context->image->width);
+}
+
+/**
+ * Betölt egy szabványos BMP formátumú képet egy fájlból a fájl
+ * leképezésén keresztül, melyet paraméterként ad vissza a hívónak.
+ *
+ * A fejlécek validálása helyben, a leképezett bájtokon történik. Tömörítetlen,
+ * 24 bites képek esetén a kép sorai közvetlenül a leképezett fájlra mutatnak,
+ * így a betöltés költsége gyakorlatilag a laphibák kiszolgálásáé; a sorokat
+ * módosító műveletek a leképezés privát jellege miatt másolatot kapnak az
+ * érintett lapokról. Egyéb bitmélységeknél a sorok közvetlenül a
+ * leképezésből kerülnek dekódolásra, munkáskészlet esetén sávokra bontva,
+ * párhuzamosan. Amennyiben a fájl nem képezhető le (pl. csővezeték), a
+ * betöltést a bmp_load_parallel, illetve munkáskészlet hiányában a
+ * bmp_load végzi.
+ *
+ * A lefoglalt memóriaterület felszabadítása a hívó feladata.
+ *
+ * @param p_image A képre mutató poitner helye.
+ * @param file A fájl.
+ * @param pool A dekódolást gyorsító munkáskészlet, vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
+ * az allokációk vagy egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_load_mapped(Image** p_image, FILE* file, ThreadPool* pool)
+{
+	int status;
+
+	uint8_t* mapping;
+	size_t mapping_size;
+
+	if (platform_map_file(file, (void**)&mapping, &mapping_size) != NO_ERROR)
+		return (pool != NULL) ? bmp_load_parallel(p_image, file, pool) : bmp_load(p_image, file);
+
+	struct info_header_struct infoheader;
+	const struct color_entry* color_table;
+	uint8_t* bitmap;
+
+	if ((status = bmp_validate_mapping(mapping, mapping_size, &infoheader, &color_table, &bitmap)) != NO_ERROR)
+		goto unmap;
+
+	size_t row_width = (size_t)bmp_calculate_row_width(infoheader.width, infoheader.bits_per_pixel);
+
+	if (bmp_is_run_length_encoded(&infoheader))
+	{
+		status = bmp_load_rle_mapped(p_image, &infoheader, color_table, bitmap, mapping + mapping_size - bitmap);
+		goto unmap;
+	}
+
+	if (infoheader.bits_per_pixel == 24)
+	{
+		/* a bittérkép sorai pontosan Pixel-ek sorozatai, ezért másolás nélkül használhatók */
+		Image* image = image_create_mapped(infoheader.width, infoheader.height, bitmap, row_width, mapping, mapping_size);
+		if (image == NULL)
+		{
+			status = MEMORY_ERROR;
+			goto unmap;
+		}
+
+		*p_image = image;
+		return NO_ERROR;
+	}
+
+	struct bmp_decoder_struct decoder;
+	bmp_decoder_init(&decoder, &infoheader, color_table);
+
+	Image* image = image_create(infoheader.width, infoheader.height);
+	if (image == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto unmap;
+	}
+
+	if (pool != NULL)
+	{
+		struct bmp_band_context_struct context = {
+			.file = NULL,
+			.bitmap = bitmap,
+			.image = image,
+			.decoder = &decoder,
+			.data_offset = 0,
+			.row_width = (uint32_t)row_width,
+			.band_rows = bmp_calculate_band_rows((uint32_t)row_width, infoheader.height, threadpool_get_thread_count(pool)),
+			.buffers = NULL,
+			.statuses = NULL
+		};
+		threadpool_run(pool, bmp_decode_mapped_band, &context, (infoheader.height + context.band_rows - 1) / context.band_rows);
+	}
+	else
+	{
+		for (uint32_t y = 0; y < infoheader.height; y++)
+			decoder.decode(&decoder, image_row(image, y), bitmap + y * row_width, infoheader.width);
+	}
+
+	*p_image = image;
+
+unmap:
+	platform_unmap_file(mapping, mapping_size);
+	return status;
+}
+
+/**
+ * Megméri egy BMP fájl bittérképének dekódolási sebességét a bitmélységre
+ * specializált, valamint az általános, pixelenként bitkivágó dekódolóval.
+ * A fájl leképezésre kerül, és a mérés előtt egyszer dekódolásra is, így az
+ * eredményt az I/O nem befolyásolja.
+ *
+ * @param[in] file A fájl.
+ * @param[in] rounds A dekódolások száma dekódolónként.
+ * @param[out] p_specialized A specializált dekódoló áteresztőképességének
+ * (MB/s) helye.
+ * @param[out] p_reference Az általános dekódoló áteresztőképességének
+ * (MB/s) helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
+ * az allokációk vagy egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_benchmark_decode(FILE* file, int rounds, double* p_specialized, double* p_reference)
+{
+	int status;
+
+	uint8_t* mapping;
+	size_t mapping_size;
+
+	if ((status = platform_map_file(file, (void**)&mapping, &mapping_size)) != NO_ERROR)
+		return status;
+
+	struct info_header_struct infoheader;
+	const struct color_entry* color_table;
+	uint8_t* bitmap;
+
+	if ((status = bmp_validate_mapping(mapping, mapping_size, &infoheader, &color_table, &bitmap)) != NO_ERROR)
+		goto unmap;
+
+	/* a mérés a tömörítetlen sorok dekódolóit hasonlítja össze */
+	if (bmp_is_run_length_encoded(&infoheader))
+	{
+		status = BMP_UNSUPPORTED_COMPRESSION;
+		goto unmap;
+	}
+
+	size_t row_width = (size_t)bmp_calculate_row_width(infoheader.width, infoheader.bits_per_pixel);
+
+	size_t pixels_size = (infoheader.width > 0 ? infoheader.width : 1) * sizeof(Pixel);
+	allocator_reserve(pixels_size);
+
+	Pixel* pixels = (Pixel*)malloc(pixels_size);
+	if (pixels == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto unmap;
+	}
+
+	/* az általános dekódoló 32 bites szavakat olvas, mint a fread-es betöltésnél */
+	uint32_t* row = (uint32_t*)malloc(row_width > 0 ? row_width : 1);
+	if (row == NULL)
+	{
+		free(pixels);
+		status = MEMORY_ERROR;
+		goto unmap;
+	}
+
+	struct bmp_decoder_struct decoder;
+	bmp_decoder_init(&decoder, &infoheader, color_table);
+
+	/* bemelegítés: a leképezett lapok betöltése */
+	for (uint32_t y = 0; y < infoheader.height; y++)
+		decoder.decode(&decoder, pixels, bitmap + y * row_width, infoheader.width);
+
+	double start = platform_get_time();
+	for (int i = 0; i < rounds; i++)
+		for (uint32_t y = 0; y < infoheader.height; y++)
+			decoder.decode(&decoder, pixels, bitmap + y * row_width, infoheader.width);
+	double specialized_time = platform_get_time() - start;
+
+	start = platform_get_time();
+	for (int i = 0; i < rounds; i++)
+	{
+		for (uint32_t y = 0; y < infoheader.height; y++)
+		{
+			memcpy(row, bitmap + y * row_width, row_width);
+			bmp_decode_row_reference(pixels, row, &infoheader, color_table);
+		}
+	}
+	double reference_time = platform_get_time() - start;
+
+	double megabytes = (double)row_width * infoheader.height * rounds / 1e6;
+	*p_specialized = megabytes / (specialized_time > 0 ? specialized_time : 1e-9);
+	*p_reference = megabytes / (reference_time > 0 ? reference_time : 1e-9);
+
+	free(row);
+	free(pixels);
+
+unmap:
+	platform_unmap_file(mapping, mapping_size);
+	return status;
+}
+
+/* BMP képeket soronként kiíró struktúra */
+struct bmp_writer_struct
+{
+	FILE* file; /* a kimeneti fájl */
+	BmpFormat format; /* a kimenet formátuma */
+	struct file_header_struct fileheader; /* a kép fájlfejléce */
+	struct info_header_struct infoheader; /* a kép információs fejléce */
+	uint32_t width; /* a kép szélessége */
+	uint32_t padding_size; /* a sorok végére írandó kitöltés (bájtban) */
+	const Palette* palette; /* palettás kimenet palettája (vagy NULL) */
+	bool dither; /* palettás kimenet rendezett szórással */
+	uint32_t row_index; /* a következő sor indexe */
+	uint8_t* indices; /* palettás kimenet egy indexsora (vagy NULL) */
+	size_t max_row_size; /* egy kódolt sor legnagyobb hossza (bájtban) */
+	uint8_t* block; /* a fejléceket és több sort egyszerre tároló puffer */
+	size_t block_size; /* a puffer mérete */
+	size_t block_length; /* a pufferben várakozó bájtok száma */
+	uint64_t bytes_flushed; /* a fájlba már kiírt bájtok száma */
+};
+
+/**
+ * Kiírja a kiíró struktúra pufferében várakozó bájtokat egyetlen I/O
+ * műveletben.
+ *
+ * @param writer A kiíró struktúra.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral
+ * tér vissza.
+ */
+static int bmp_writer_flush(BmpWriter* writer)
+{
+	if (writer->block_length > 0 &&
+		fwrite(writer->block, sizeof(uint8_t), writer->block_length, writer->file) != writer->block_length)
+		return IO_ERROR;
+
+	writer->bytes_flushed += writer->block_length;
+	writer->block_length = 0;
+
+	return NO_ERROR;
+}
+
+/**
+ * Kitölti egy width × height dimenziójú kép kiírásához szükséges
+ * fejléceket. Tömörített kimenet esetén a bittérkép és a fájl mérete a
+ * kiírás végén derül ki, addig csak a fejlécek és a színtáblázat méretét
+ * tartalmazzák.
+ *
+ * @param[out] p_fileheader A fájlfejlécre mutató pointer.
+ * @param[out] p_infoheader Az információs fejlécre mutató pointer.
+ * @param[in] width A kép szélessége.
+ * @param[in] height A kép magassága.
+ * @param[in] bits_per_pixel A kimenet bitmélysége.
+ * @param[in] compression A kimenet tömörítése.
+ * @param[in] colors_used A színtáblázat bejegyzéseinek száma.
+ */
+static void bmp_prepare_headers(struct file_header_struct* p_fileheader, struct info_header_struct* p_infoheader, uint32_t width, uint32_t height, uint16_t bits_per_pixel, uint32_t compression, uint32_t colors_used)
+{
+	struct info_header_struct infoheader = {
+		.header_size = BMP_INFO_HEADER_SIZE,
+		.width = width,
+		.height = height,
+		.planes = 1,
+		.bits_per_pixel = bits_per_pixel,
+		.compression = compression,
+		/* .image_size = ..., */
+		.x_pixels_per_m = 0, /* printed size is unsupported */
+		.y_pixels_per_m = 0, /* printed size is unsupported */
+		.colors_used = colors_used,
+		.important_colors = 0 /* all colors are important */
+	};
+
+	struct file_header_struct fileheader = {
+		.signature = BMP_SIGNATURE,
+		.reserved = 0,
+		.data_offset = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + colors_used * (uint32_t)sizeof(struct color_entry)
+	};
+
+	/* a 4 GiB-nál nagyobb méretek nem férnek el a fejlécben, ilyenkor 0 kerül beléjük */
+	uint64_t image_size = (compression == BMP_COMPRESSION_NONE) ? bmp_calculate_row_width(width, bits_per_pixel) * height : 0;
+	uint64_t file_size = fileheader.data_offset + image_size;
+	infoheader.image_size = (file_size <= UINT32_MAX) ? (uint32_t)image_size : 0;
+	fileheader.file_size = (file_size <= UINT32_MAX) ? (uint32_t)file_size : 0;
+
+	*p_fileheader = fileheader;
+	*p_infoheader = infoheader;
+}
+
+/**
+ * Bitmélységnek megfelelően bájtokba tömörít egy indexsort, a bájtokon
+ * belül a legnagyobb helyiértékű bitektől kezdve (mint a dekódolóknál).
+ *
+ * @param dst A tömörített sor helye.
+ * @param indices Az indexsor.
+ * @param width Az indexsor hossza.
+ * @param bits_per_pixel A bitmélység (1, 4 vagy 8).
+ * @return Visszatér a tömörített sor hosszával (bájtban, kitöltés nélkül).
+ */
+static size_t bmp_pack_indices(uint8_t* dst, const uint8_t* indices, uint32_t width, uint16_t bits_per_pixel)
+{
+	if (bits_per_pixel == 8)
+	{
+		memcpy(dst, indices, width);
+		return width;
+	}
+
+	uint32_t per_byte = 8 / bits_per_pixel;
+	size_t size = ((size_t)width + per_byte - 1) / per_byte;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		uint32_t byte = 0;
+		for (uint32_t j = 0; j < per_byte; j++)
+		{
+			uint32_t x = (uint32_t)i * per_byte + j;
+			uint32_t index = (x < width) ? indices[x] : 0;
+			byte |= index << (8 - bits_per_pixel * (j + 1));
+		}
+		dst[i] = (uint8_t)byte;
+	}
+
+	return size;
+}
+
+/**
+ * Megadja egy indexsor adott pozícióján kezdődő, azonos indexekből álló
+ * szakasz hosszát.
+ *
+ * @param indices Az indexsor.
+ * @param x A szakasz kezdete.
+ * @param end Az indexsor vége.
+ * @param limit A szakasz legnagyobb vizsgált hossza.
+ * @return Visszatér a szakasz hosszával (legalább 1-gyel).
+ */
+static uint32_t bmp_rle_run_length(const uint8_t* indices, uint32_t x, uint32_t end, uint32_t limit)
+{
+	uint32_t length = 1;
+	while (x + length < end && length < limit && indices[x + length] == indices[x])
+		length++;
+	return length;
+}
+
+/**
+ * Kódol egy indexsort RLE8 tömörítéssel (a sorvége parancs nélkül). A
+ * legalább 3 hosszú, azonos indexekből álló szakaszok kódolt, a köztük
+ * lévők pedig abszolút módba kerülnek; az 1-2 hosszú maradékok kódolt
+ * módban olcsóbbak. A kódolt sor legfeljebb 2 * width bájt.
+ *
+ * @param dst A kódolt sor helye.
+ * @param indices Az indexsor.
+ * @param width Az indexsor hossza.
+ * @return Visszatér a kódolt sor hosszával (bájtban).
+ */
+static size_t bmp_rle8_encode_row(uint8_t* dst, const uint8_t* indices, uint32_t width)
+{
+	uint8_t* out = dst;
+	uint32_t x = 0;
+
+	while (x < width)
+	{
+		uint32_t run = bmp_rle_run_length(indices, x, width, 255);
+		if (run >= 3)
+		{
+			*out++ = (uint8_t)run;
+			*out++ = indices[x];
+			x += run;
+			continue;
+		}
+
+		uint32_t end = x;
+		while (end < width && end - x < 255 && bmp_rle_run_length(indices, end, width, 3) < 3)
+			end++;
+
+		uint32_t count = end - x;
+		if (count < 3)
+		{
+			/* az abszolút mód legalább 3 indexet igényel */
+			while (x < end)
+			{
+				run = bmp_rle_run_length(indices, x, end, 255);
+				*out++ = (uint8_t)run;
+				*out++ = indices[x];
+				x += run;
+			}
+		}
+		else
+		{
+			*out++ = 0;
+			*out++ = (uint8_t)count;
+			memcpy(out, indices + x, count);
+			out += count;
+			if (count & 1)
+				*out++ = 0;
+			x = end;
+		}
+	}
+
+	return (size_t)(out - dst);
+}
+
+/**
+ * Előkészít egy fájlt egy width × height dimenziójú kép soronkénti,
+ * adott formátumú BMP kiírására. A fejlécek, a színtáblázat és a kódolt
+ * sorok egy legfeljebb BMP_IO_BLOCK_SIZE méretű pufferben gyűlnek, mely
+ * csak megteltekor, illetve a bmp_writer_close hívásakor kerül kiírásra,
+ * így egy kis kép egyetlen I/O művelettel kiírható. A sorok a bittérképbeli
+ * sorrendjükben adhatók át a bmp_writer_write_row függvénynek.
+ *
+ * Palettás kimenet esetén a sorok színei a paletta alapján (kvantált
+ * paletta esetén igény szerint rendezett szórással) kerülnek indexekre
+ * leképezésre; a palettának a kiíró lezárásáig érvényesnek kell maradnia. Tömörített kimenet esetén, ha a kép nem fér el egy blokkban, a
+ * fejlécek végleges alakja a lezáráskor a fájl elejére visszapozícionálva
+ * kerül kiírásra, így a fájlnak pozícionálhatónak kell lennie.
+ *
+ * A lefoglalt memóriaterület felszabadítása (bmp_writer_close) a hívó
+ * feladata.
+ *
+ * @param p_writer A kiíró struktúrára mutató pointer helye.
+ * @param file A fájl.
+ * @param width A kép szélessége.
+ * @param height A kép magassága.
+ * @param format A kimenet formátuma.
+ * @param palette Palettás formátum esetén a paletta, egyébként NULL.
+ * @param dither Palettás formátum esetén alkalmazzon-e rendezett szórást.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk
+ * hibakódjával tér vissza.
+ */
+int bmp_writer_open_format(BmpWriter** p_writer, FILE* file, uint32_t width, uint32_t height, BmpFormat format, const Palette* palette, bool dither)
+{
+	BmpWriter* writer = (BmpWriter*)malloc(sizeof(BmpWriter));
+	if (writer == NULL)
+		return MEMORY_ERROR;
+
+	if (bmp_calculate_row_width(width, (format == BMP_FORMAT_RGB24) ? 24 : 8) > BMP_MAX_ROW_WIDTH)
+		return BMP_TOO_LARGE;
+
+	writer->file = file;
+	writer->format = format;
+	writer->width = width;
+	writer->palette = palette;
+	writer->dither = dither;
+	writer->row_index = 0;
+	writer->indices = NULL;
+	writer->block = NULL;
+	writer->block_length = 0;
+	writer->bytes_flushed = 0;
+
+	if (format == BMP_FORMAT_RGB24)
+	{
+		bmp_prepare_headers(&writer->fileheader, &writer->infoheader, width, height, 24, BMP_COMPRESSION_NONE, 0);
+		uint32_t row_width = (uint32_t)bmp_calculate_row_width(width, 24);
+		writer->padding_size = row_width - width * 3;
+		writer->max_row_size = row_width;
+	}
+	else
+	{
+		/* a színtáblázat csak a paletta ténylegesen használt színeit tartalmazza */
+		uint32_t colors_used = (palette->count > 0) ? palette->count : 1;
+		/* egyszínű monokróm képnél is két színt tárolunk, különben a betöltő
+		 * a régi, egyetlen színt tároló monokróm képekre vonatkozó szabályt
+		 * alkalmazná (a 0-s index feketét jelentene) */
+		if (format == BMP_FORMAT_INDEXED1 && colors_used < 2)
+			colors_used = 2;
+
+		if (format == BMP_FORMAT_RLE8)
+		{
+			bmp_prepare_headers(&writer->fileheader, &writer->infoheader, width, height, 8, BMP_COMPRESSION_RLE8, colors_used);
+			writer->padding_size = 0;
+			/* kódolt sor, sorvége és bittérkép vége parancs */
+			writer->max_row_size = 2 * (size_t)width + 4;
+		}
+		else
+		{
+			uint16_t bits_per_pixel = (format == BMP_FORMAT_INDEXED1) ? 1 : (format == BMP_FORMAT_INDEXED4) ? 4 : 8;
+			bmp_prepare_headers(&writer->fileheader, &writer->infoheader, width, height, bits_per_pixel, BMP_COMPRESSION_NONE, colors_used);
+			uint32_t row_width = (uint32_t)bmp_calculate_row_width(width, bits_per_pixel);
+			writer->padding_size = row_width - ((uint32_t)width * bits_per_pixel + 7) / 8;
+			writer->max_row_size = row_width;
+		}
+
+		writer->indices = (uint8_t*)malloc(width > 0 ? width : 1);
+		if (writer->indices == NULL)
+		{
+			bmp_writer_close(writer);
+			return MEMORY_ERROR;
+		}
+	}
+
+	/* a puffernek legalább a fejléceket és egy sort el kell tudnia tárolni */
+	size_t block_size = BMP_IO_BLOCK_SIZE;
+	uint64_t file_size = writer->fileheader.data_offset + (uint64_t)writer->max_row_size * height;
+	if (format == BMP_FORMAT_RGB24 && block_size > file_size)
+		block_size = (size_t)file_size;
+	if (block_size < (size_t)writer->fileheader.data_offset + writer->max_row_size)
+		block_size = (size_t)writer->fileheader.data_offset + writer->max_row_size;
+
+	allocator_reserve(block_size);
+
+	writer->block = (uint8_t*)malloc(block_size);
+	if (writer->block == NULL)
+	{
+		bmp_writer_close(writer);
+		return MEMORY_ERROR;
+	}
+	writer->block_size = block_size;
+
+	bmp_serialize_file_header(writer->block, &writer->fileheader);
+	bmp_serialize_info_header(writer->block + BMP_FILE_HEADER_SIZE, &writer->infoheader);
+	writer->block_length = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE;
+
+	if (palette != NULL)
+	{
+		struct color_entry* color_table = (struct color_entry*)(writer->block + writer->block_length);
+		for (uint32_t i = 0; i < writer->infoheader.colors_used; i++)
+		{
+			/* a paletta színein túli (kitöltő) bejegyzések feketék */
+			Pixel color = { 0, 0, 0 };
+			if (i < palette->count)
+				color = palette->colors[i];
+			color_table[i].blue = color.blue;
+			color_table[i].green = color.green;
+			color_table[i].red = color.red;
+			color_table[i].reserved = 0;
+		}
+		writer->block_length += writer->infoheader.colors_used * sizeof(struct color_entry);
+	}
+
+	*p_writer = writer;
+
+	return NO_ERROR;
+}
+
+/**
+ * Előkészít egy fájlt egy width × height dimenziójú kép soronkénti,
+ * szabványos, 24 bites BMP formátumú kiírására (lásd
+ * bmp_writer_open_format).
+ *
+ * A lefoglalt memóriaterület felszabadítása (bmp_writer_close) a hívó
+ * feladata.
+ *
+ * @param p_writer A kiíró struktúrára mutató pointer helye.
+ * @param file A fájl.
+ * @param width A kép szélessége.
+ * @param height A kép magassága.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk
+ * hibakódjával tér vissza.
+ */
+int bmp_writer_open(BmpWriter** p_writer, FILE* file, uint32_t width, uint32_t height)
+{
+	return bmp_writer_open_format(p_writer, file, width, height, BMP_FORMAT_RGB24, NULL, false);
+}
+
+/**
+ * Átadja kiírásra a kép következő bittérképbeli sorát. A sor kódolva (a
+ * kitöltéssel együtt) a pufferbe kerül, mely megteltekor kiírásra kerül.
+ *
+ * @param writer A kiíró struktúra.
+ * @param row A kép szélességével megegyező hosszú pixelsor.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral
+ * tér vissza.
+ */
+int bmp_writer_write_row(BmpWriter* writer, const Pixel* row)
+{
+	int status;
+
+	if (writer->block_length + writer->max_row_size > writer->block_size &&
+		(status = bmp_writer_flush(writer)) != NO_ERROR)
+		return status;
+
+	uint8_t* end = writer->block + writer->block_length;
+
+	if (writer->format == BMP_FORMAT_RGB24)
+	{
+		size_t pixels_size = (size_t)writer->width * sizeof(Pixel);
+		memcpy(end, row, pixels_size);
+		/* a sorhossz 4 bájtra igazítása miatt legfeljebb 3 bájt kitöltés kell */
+		memset(end + pixels_size, 0, writer->padding_size);
+		writer->block_length += pixels_size + writer->padding_size;
+	}
+	else
+	{
+		palette_map_row(writer->palette, writer->indices, row, writer->width, writer->row_index, writer->dither);
+
+		if (writer->format == BMP_FORMAT_RLE8)
+		{
+			size_t size = bmp_rle8_encode_row(end, writer->indices, writer->width);
+			/* sor vége */
+			end[size] = 0;
+			end[size + 1] = 0;
+			writer->block_length += size + 2;
+		}
+		else
+		{
+			size_t size = bmp_pack_indices(end, writer->indices, writer->width, writer->infoheader.bits_per_pixel);
+			memset(end + size, 0, writer->padding_size);
+			writer->block_length += size + writer->padding_size;
+		}
+	}
+
+	writer->row_index++;
+
+	return NO_ERROR;
+}
+
+/**
+ * Lezárja egy tömörített kimenet bittérképét, és kitölti a fejlécek csak
+ * ekkor ismert méretmezőit: ha a fejlécek még a pufferben vannak, ott,
+ * egyébként a fájl elejére visszapozícionálva.
+ *
+ * @param writer A kiíró struktúra.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral
+ * tér vissza.
+ */
+static int bmp_writer_finish_compressed(BmpWriter* writer)
+{
+	int status;
+
+	if (writer->block_length + 2 > writer->block_size &&
+		(status = bmp_writer_flush(writer)) != NO_ERROR)
+		return status;
+
+	/* bittérkép vége */
+	writer->block[writer->block_length++] = 0;
+	writer->block[writer->block_length++] = 1;
+
+	uint64_t file_size = writer->bytes_flushed + writer->block_length;
+	writer->fileheader.file_size = (file_size <= UINT32_MAX) ? (uint32_t)file_size : 0;
+	writer->infoheader.image_size = (file_size <= UINT32_MAX) ? (uint32_t)(file_size - writer->fileheader.data_offset) : 0;
+
+	uint8_t headers[BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE];
+	bmp_serialize_file_header(headers, &writer->fileheader);
+	bmp_serialize_info_header(headers + BMP_FILE_HEADER_SIZE, &writer->infoheader);
+
+	if (writer->bytes_flushed == 0)
+	{
+		memcpy(writer->block, headers, sizeof(headers));
+		return bmp_writer_flush(writer);
+	}
+
+	if ((status = bmp_writer_flush(writer)) != NO_ERROR)
+		return status;
+
+	if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+		fwrite(headers, sizeof(headers), 1, writer->file) != 1 ||
+		fseek(writer->file, 0, SEEK_END) != 0)
+		return IO_ERROR;
+
+	return NO_ERROR;
+}
+
+/**
+ * Kiírja a pufferben várakozó sorokat, majd felszabadít egy kiíró
+ * struktúrát. A fájlt nem zárja le.
+ *
+ * @param writer A kiíró struktúra.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral
+ * tér vissza.
+ */
+int bmp_writer_close(BmpWriter* writer)
+{
+	int status = NO_ERROR;
+
+	if (writer->block != NULL)
+	{
+		if (writer->infoheader.compression != BMP_COMPRESSION_NONE)
+			status = bmp_writer_finish_compressed(writer);
+		else
+			status = bmp_writer_flush(writer);
+		free(writer->block);
+	}
+
+	if (writer->indices != NULL)
+		free(writer->indices);
+	free(writer);
+
+	return status;
+}
+
+/**
+ * Kiírja egy kép összes sorát egy kiíró struktúrával. Síkos és csempés
+ * elrendezésű kép sorait kiírás előtt egy pufferbe fésüli össze.
+ *
+ * @param writer A kiíró struktúra.
+ * @param image A kép.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokáció vagy
+ * egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+static int bmp_writer_write_image(BmpWriter* writer, const Image* image)
+{
+	int status = NO_ERROR;
+
+	Pixel* buffer = NULL;
+	if (image->layout != IMAGE_LAYOUT_INTERLEAVED)
+	{
+		size_t buffer_size = (image->width > 0 ? image->width : 1) * sizeof(Pixel);
+		allocator_reserve(buffer_size);
+
+		buffer = (Pixel*)malloc(buffer_size);
+		if (buffer == NULL)
+			return MEMORY_ERROR;
+	}
+
+	for (uint32_t y = 0; y < image->height && status == NO_ERROR; y++)
+		status = bmp_writer_write_row(writer, image_get_row(image, y, buffer));
+
+	if (buffer != NULL)
+		free(buffer);
+
+	return status;
+}
+
+/**
+ * Kiment egy szabványos BMP formátumú képet egy fájlba, melyet paraméterként
+ * vesz át.
+ *
+ * @param p_image A képre mutató poitner helye.
+ * @param file A fájl.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk vagy
+ * egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_store(const Image** p_image, FILE* file)
+{
+	int status;
+
+	const Image* image = *p_image;
+
+	BmpWriter* writer;
+
+	if ((status = bmp_writer_open(&writer, file, image->width, image->height)) != NO_ERROR)
+		return status;
+
+	if ((status = bmp_writer_write_image(writer, image)) != NO_ERROR)
+	{
+		bmp_writer_close(writer);
+		return status;
+	}
+
+	return bmp_writer_close(writer);
+}
+
+/**
+ * Kiment egy képet egy fájlba a megadott BMP formátumban. Palettás
+ * formátum esetén a paletta a kép színeiből áll össze: ha azok elférnek
+ * a bitmélység által megengedett számú színben, pontosan, egyébként
+ * kvantálással.
+ *
+ * @param p_image A képre mutató pointer helye.
+ * @param file A fájl.
+ * @param format A kimenet formátuma.
+ * @param dither Kvantált paletta esetén alkalmazzon-e rendezett szórást.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk vagy
+ * egy I/O művelet által okozott hibakóddal tér vissza.
+ */
+int bmp_store_format(const Image** p_image, FILE* file, BmpFormat format, bool dither)
+{
+	int status;
+
+	if (format == BMP_FORMAT_RGB24)
+		return bmp_store(p_image, file);
+
+	const Image* image = *p_image;
+
+	Palette* palette = (Palette*)malloc(sizeof(Palette));
+	if (palette == NULL)
+		return MEMORY_ERROR;
+
+	uint32_t max_colors = (format == BMP_FORMAT_INDEXED1) ? 2 : (format == BMP_FORMAT_INDEXED4) ? 16 : 256;
+	if ((status = palette_build(palette, image, max_colors)) != NO_ERROR)
+	{
+		free(palette);
+		return status;
+	}
+
+	BmpWriter* writer;
+
+	if ((status = bmp_writer_open_format(&writer, file, image->width, image->height, format, palette, dither)) != NO_ERROR)
+	{
+		free(palette);
+		return status;
+	}
+
+	status = bmp_writer_write_image(writer, image);
+
+	int close_status = bmp_writer_close(writer);
+	free(palette);
+
+	return (status != NO_ERROR) ? status : close_status;
+}
+
+/**
+ * Kódol és kiír egy sávnyi sort (a párhuzamos kiírás egy részfeladata).
+ *
+ * @param argument A részfeladatok közös állapota.
+ * @param task A sáv indexe.
+ * @param worker A munkás indexe.
+ */
+static void bmp_store_band(void* argument, size_t task, int worker)
+{
+	struct bmp_band_context_struct* context = (struct bmp_band_context_struct*)argument;
+
+	if (context->statuses[worker] != NO_ERROR)
+		return;
+
+	uint32_t first = (uint32_t)(task * context->band_rows);
+	uint32_t rows = context->image->height - first;
+	if (rows > context->band_rows)
+		rows = context->band_rows;
+
+	uint8_t* buffer = context->buffers[worker];
+	for (uint32_t y = 0; y < rows; y++)
+		image_copy_row(context->image, first + y, (Pixel*)(buffer + (size_t)y * context->row_width));
+
+	context->statuses[worker] = platform_write_at(context->file, buffer, (size_t)rows * context->row_width,
+		context->data_offset + (uint64_t)first * context->row_width);
+}
+
+/**
+ * Kiment egy szabványos BMP formátumú képet egy fájlba több szálon: a
+ * fejlécek kiírása után a munkáskészlet szálai egymástól függetlenül,
+ * pozícionált írással kódolják és írják ki a kép egy-egy sávját.
+ *
+ * A fájlba korábban pufferelten írt adatok elveszhetnek, ezért a
+ * fájlba a hívás előtt nem szabad írni.
+ *
+ * @param p_image A kiírandó kép címe.
+ * @param file A fájl.
+ * @param pool A munkáskészlet.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az allokációk
+ * vagy egy I/O művelet hibakódjával tér vissza.
+ */
+int bmp_store_parallel(const Image** p_image, FILE* file, ThreadPool* pool)
+{
+	int status;
+
+	const Image* image = *p_image;
+
+	struct file_header_struct fileheader;
+	struct info_header_struct infoheader;
+
+	bmp_prepare_headers(&fileheader, &infoheader, image->width, image->height, 24, BMP_COMPRESSION_NONE, 0);
+
+	uint8_t headers[BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE];
+	bmp_serialize_file_header(headers, &fileheader);
+	bmp_serialize_info_header(headers + BMP_FILE_HEADER_SIZE, &infoheader);
+
+	if ((status = platform_write_at(file, headers, sizeof(headers), 0)) != NO_ERROR)
+		return status;
+
+	uint32_t row_width = bmp_calculate_row_width(image->width, infoheader.bits_per_pixel);
+	int thread_count = threadpool_get_thread_count(pool);
+	uint32_t band_rows = bmp_calculate_band_rows(row_width, image->height, thread_count);
+
+	struct bmp_band_context_struct context = {
+		.file = file,
+		.bitmap = NULL,
+		.image = (Image*)image,
+		.decoder = NULL,
+		.data_offset = fileheader.data_offset,
+		.row_width = row_width,
+		.band_rows = band_rows,
+		.buffers = NULL,
+		.statuses = NULL
+	};
+
+	if ((status = bmp_band_context_create(&context, thread_count)) == NO_ERROR)
+		threadpool_run(pool, bmp_store_band, &context, (image->height + band_rows - 1) / band_rows);
+
+	int band_status = bmp_band_context_destroy(&context, thread_count);
+
+	return (status != NO_ERROR) ? status : band_status;
 }
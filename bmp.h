@@ -11,17 +11,71 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "image.h"
+#include "threadpool.h"
+#include "palette.h"
 
 #define BMP_ERROR_OFFSET	    2000
 
 #define BMP_INVALID_SIGNATURE	2000
 #define BMP_TOO_MANY_PLANES		2001
 #define BMP_INVALID_COLORS		2002
+#define BMP_UNSUPPORTED_COMPRESSION	2003
+#define BMP_UNSUPPORTED_HEADER	2004
+#define BMP_TOO_LARGE			2005
+#define BMP_TOP_DOWN			2006
 
 extern const char* bmp_error_code_strings[];
 
+/**
+ * @brief A kiírható BMP formátumok.
+ */
+typedef enum bmp_format_enum
+{
+	BMP_FORMAT_RGB24, /* 24 bites, tömörítetlen */
+	BMP_FORMAT_INDEXED1, /* 1 bites, palettás, tömörítetlen */
+	BMP_FORMAT_INDEXED4, /* 4 bites, palettás, tömörítetlen */
+	BMP_FORMAT_INDEXED8, /* 8 bites, palettás, tömörítetlen */
+	BMP_FORMAT_RLE8 /* 8 bites, palettás, RLE8 tömörítésű */
+} BmpFormat;
+
+/**
+ * @brief Egy BMP formátumú kép fejlécekből kiolvasható jellemzői.
+ */
+typedef struct bmp_info_struct
+{
+	uint32_t width; /* képszélesség */
+	uint32_t height; /* képmagasság */
+	uint16_t bits_per_pixel; /* bitmélység */
+	uint32_t compression; /* tömörítési eljárás azonosítója */
+	uint64_t memory_size; /* a beolvasott kép becsült memóriaigénye (bájtban) */
+} BmpInfo;
+
+/* BMP képeket soronként beolvasó, illetve kiíró struktúrák */
+typedef struct bmp_reader_struct BmpReader;
+typedef struct bmp_writer_struct BmpWriter;
+
+/* a teljes képeket kezelő függvények */
+
+int bmp_probe(BmpInfo* p_info, FILE* file);
 int bmp_load(Image** p_image, FILE* file);
+int bmp_load_mapped(Image** p_image, FILE* file, ThreadPool* pool);
 int bmp_store(const Image** p_image, FILE* file);
+int bmp_store_format(const Image** p_image, FILE* file, BmpFormat format, bool dither);
+int bmp_load_parallel(Image** p_image, FILE* file, ThreadPool* pool);
+int bmp_store_parallel(const Image** p_image, FILE* file, ThreadPool* pool);
+int bmp_benchmark_decode(FILE* file, int rounds, double* p_specialized, double* p_reference);
+
+/* a képeket soronként kezelő függvények */
+
+int bmp_reader_open(BmpReader** p_reader, FILE* file, uint32_t* p_width, uint32_t* p_height);
+int bmp_reader_read_row(BmpReader* reader, Pixel* row);
+void bmp_reader_close(BmpReader* reader);
+
+int bmp_writer_open(BmpWriter** p_writer, FILE* file, uint32_t width, uint32_t height);
+int bmp_writer_open_format(BmpWriter** p_writer, FILE* file, uint32_t width, uint32_t height, BmpFormat format, const Palette* palette, bool dither);
+int bmp_writer_write_row(BmpWriter* writer, const Pixel* row);
+int bmp_writer_close(BmpWriter* writer);
 
 #endif /* BMP_H_INCLUDED */
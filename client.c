@@ -0,0 +1,355 @@
+﻿/*****************************************************************//**
+ * @file   client.c
+ * @brief  A szervernek kéréseket küldő kliens és a szerver késleltetését
+ * mérő terhelésgenerátor modul forrásfájlja.
+ *
+ * A terhelésgenerátor több kapcsolaton, kapcsolatonként egy szálon küldi
+ * egymás után ugyanazt a kérést, és a kérések válaszidejének eloszlását
+ * (medián, 99. percentilis, maximum) méri.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "client.h"
+#include "status.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* a terhelésgenerátor egy kapcsolatának állapota */
+struct client_connection_struct
+{
+	const char* path; /* a szerver socketjének fájlja */
+	PlatformThread* thread; /* a kapcsolat szála */
+	char request[SERVER_MAX_REQUEST]; /* az ismételten elküldött kérés */
+	size_t length; /* a kérés hossza */
+	ServerBuffer buffer; /* a fogadott válaszok */
+	double* latencies; /* a kérések válaszideje (másodpercben) */
+	int count; /* a kapcsolaton elküldendő kérések száma */
+	int completed; /* a megválaszolt kérések száma */
+	int failed_count; /* a hibás kérések száma */
+	int status; /* a kapcsolat hibakódja */
+};
+
+/**
+ * Összeállít egy kérést a szerver protokollja szerint: a mezők
+ * tabulátorral elválasztva, újsor karakterrel lezárva.
+ *
+ * @param buffer A kérés helye.
+ * @param size A puffer mérete.
+ * @param p_length A kérés hosszának helye.
+ * @param input_path A bemeneti fájl elérési útja.
+ * @param output_path A kimeneti fájl elérési útja.
+ * @param switches A kapcsolók.
+ * @param switch_count A kapcsolók száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként (ha egy mező
+ * elválasztó vagy újsor karaktert tartalmaz, vagy a kérés nem fér el a
+ * szerver pufferében) CMD_UNKNOWN_CMD_SWITCH-csel tér vissza.
+ */
+int client_format_request(char* buffer, size_t size, size_t* p_length, const char* input_path, const char* output_path, char* switches[], int switch_count)
+{
+	if (switch_count > SERVER_MAX_SWITCHES)
+		return CMD_UNKNOWN_CMD_SWITCH;
+	if (size > SERVER_MAX_REQUEST)
+		size = SERVER_MAX_REQUEST;
+
+	size_t length = 0;
+	for (int i = -2; i < switch_count; i++)
+	{
+		const char* field = (i == -2) ? input_path : (i == -1) ? output_path : switches[i];
+		size_t field_length = strlen(field);
+		if (strcspn(field, "\t\r\n") != field_length || length + field_length + 1 > size)
+			return CMD_UNKNOWN_CMD_SWITCH;
+
+		memcpy(buffer + length, field, field_length);
+		length += field_length;
+		buffer[length++] = (i + 1 < switch_count) ? SERVER_SEPARATOR : '\n';
+	}
+
+	*p_length = length;
+
+	return NO_ERROR;
+}
+
+/**
+ * Elküld egy kérést egy kapcsolaton, és bevárja a válaszát.
+ *
+ * @param endpoint A kapcsolat socketje.
+ * @param buffer A kapcsolat pufferje.
+ * @param request A kérés (újsor karakterrel lezárva).
+ * @param length A kérés hossza.
+ * @param p_status A kérés (szerver által jelzett) hibakódjának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként (megszakadt
+ * kapcsolat vagy érvénytelen válasz esetén) IO_ERROR-ral tér vissza.
+ */
+int client_request(PlatformSocket* endpoint, ServerBuffer* buffer, const char* request, size_t length, int* p_status)
+{
+	int status;
+
+	if ((status = platform_socket_send(endpoint, request, length)) != NO_ERROR)
+		return status;
+
+	char* response;
+	if ((status = server_read_line(endpoint, buffer, &response)) != NO_ERROR)
+		return status;
+	if (response == NULL)
+		return IO_ERROR;
+
+	char* end;
+	long code = strtol(response, &end, 10);
+	if (end == response || *end != '\0')
+		return IO_ERROR;
+
+	*p_status = (int)code;
+
+	return NO_ERROR;
+}
+
+/**
+ * Kapcsolódik a szerverhez, és elküld egyetlen kérést.
+ *
+ * @param path A szerver socketjének fájlja.
+ * @param input_path A bemeneti fájl elérési útja (a szerver
+ * munkakönyvtárához képest).
+ * @param output_path A kimeneti fájl elérési útja (a szerver
+ * munkakönyvtárához képest).
+ * @param switches A kapcsolók.
+ * @param switch_count A kapcsolók száma.
+ * @param p_status A kérés (szerver által jelzett) hibakódjának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a kérés
+ * összeállításának vagy a kapcsolat hibakódjával tér vissza.
+ */
+int client_send(const char* path, const char* input_path, const char* output_path, char* switches[], int switch_count, int* p_status)
+{
+	int status;
+
+	ServerBuffer buffer;
+	char request[SERVER_MAX_REQUEST];
+	size_t length;
+	if ((status = client_format_request(request, sizeof(request), &length, input_path, output_path, switches, switch_count)) != NO_ERROR)
+		return status;
+
+	PlatformSocket* endpoint;
+	if ((status = platform_socket_connect(&endpoint, path)) != NO_ERROR)
+		return status;
+
+	server_reset_buffer(&buffer);
+	status = client_request(endpoint, &buffer, request, length, p_status);
+
+	platform_socket_close(endpoint);
+
+	return status;
+}
+
+/**
+ * Leállítja a szervert (a már elfogadott kapcsolatok kiszolgálása után).
+ *
+ * @param path A szerver socketjének fájlja.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a kapcsolat
+ * hibakódjával tér vissza.
+ */
+int client_stop(const char* path)
+{
+	int status;
+
+	PlatformSocket* endpoint;
+	if ((status = platform_socket_connect(&endpoint, path)) != NO_ERROR)
+		return status;
+
+	ServerBuffer buffer;
+	server_reset_buffer(&buffer);
+
+	int remote_status;
+	if ((status = client_request(endpoint, &buffer, SERVER_STOP_REQUEST "\n", strlen(SERVER_STOP_REQUEST) + 1, &remote_status)) == NO_ERROR)
+		status = remote_status;
+
+	platform_socket_close(endpoint);
+
+	return status;
+}
+
+/**
+ * A terhelésgenerátor egy kapcsolatának belépési pontja: kapcsolódik a
+ * szerverhez, majd egymás után elküldi a kéréseit, és méri a
+ * válaszidejüket. A szál nem foglal memóriát.
+ *
+ * @param argument A kapcsolat állapota.
+ */
+static void client_connection_main(void* argument)
+{
+	struct client_connection_struct* connection = (struct client_connection_struct*)argument;
+
+	PlatformSocket* endpoint;
+	if ((connection->status = platform_socket_connect(&endpoint, connection->path)) != NO_ERROR)
+		return;
+
+	server_reset_buffer(&connection->buffer);
+
+	for (int i = 0; i < connection->count; i++)
+	{
+		int remote_status;
+
+		double start = platform_get_time();
+		connection->status = client_request(endpoint, &connection->buffer, connection->request, connection->length, &remote_status);
+		if (connection->status != NO_ERROR)
+			break;
+		connection->latencies[i] = platform_get_time() - start;
+
+		connection->completed++;
+		if (remote_status != NO_ERROR)
+			connection->failed_count++;
+	}
+
+	platform_socket_close(endpoint);
+}
+
+/**
+ * Összehasonlít két válaszidőt (a qsort függvény számára).
+ *
+ * @param a Az egyik válaszidő.
+ * @param b A másik válaszidő.
+ * @return Visszatér a két válaszidő viszonyával (-1, 0 vagy 1).
+ */
+static int client_compare_latencies(const void* a, const void* b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Megadja egy rendezett tömb adott hányadhoz tartozó percentilisét (a
+ * legközelebbi rang módszerével).
+ *
+ * @param values A rendezett tömb.
+ * @param count A tömb elemszáma (legalább 1).
+ * @param fraction A hányad a (0, 1] tartományból.
+ * @return Visszatér a percentilissel.
+ */
+static double client_percentile(const double* values, int count, double fraction)
+{
+	int rank = (int)ceil(fraction * count);
+	if (rank < 1)
+		rank = 1;
+	if (rank > count)
+		rank = count;
+	return values[rank - 1];
+}
+
+/**
+ * Megméri a szerver válaszidejét: connection_count kapcsolaton, egymással
+ * párhuzamosan összesen request_count kérést küld, mindegyik kapcsolat a
+ * saját kimeneti fájljába (<output_directory>/<kapcsolat>.bmp), majd
+ * kiszámítja a válaszidők eloszlását.
+ *
+ * @param path A szerver socketjének fájlja.
+ * @param input_path A bemeneti fájl elérési útja (a szerver
+ * munkakönyvtárához képest).
+ * @param output_directory A kimeneti fájlok könyvtára (a szerver
+ * munkakönyvtárához képest), mely szükség esetén létrejön.
+ * @param switches A kapcsolók.
+ * @param switch_count A kapcsolók száma.
+ * @param request_count A kérések száma.
+ * @param connection_count A kapcsolatok száma.
+ * @param p_statistics Az összesített eredmény helye.
+ * @return Sikeres lefutás esetén (a kérések hibáitól függetlenül)
+ * NO_ERROR-ral, egyébként a kérés összeállításának, a memóriafoglalásnak,
+ * vagy az első hibás kapcsolatnak a hibakódjával tér vissza.
+ */
+int client_benchmark(const char* path, const char* input_path, const char* output_directory, char* switches[], int switch_count,
+	int request_count, int connection_count, ClientStatistics* p_statistics)
+{
+	int status;
+
+	if (request_count < 1)
+		request_count = 1;
+	if (connection_count < 1)
+		connection_count = 1;
+	if (connection_count > request_count)
+		connection_count = request_count;
+
+	if ((status = platform_create_directory(output_directory)) != NO_ERROR)
+		return status;
+
+	double* latencies = (double*)malloc(request_count * sizeof(double));
+	if (latencies == NULL)
+		return MEMORY_ERROR;
+
+	struct client_connection_struct* connections = (struct client_connection_struct*)malloc(connection_count * sizeof(struct client_connection_struct));
+	if (connections == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto free_latencies;
+	}
+
+	/* a kérések a szálak indítása előtt készülnek el, a szálak nem foglalnak */
+	int assigned = 0;
+	for (int i = 0; i < connection_count; i++)
+	{
+		struct client_connection_struct* connection = &connections[i];
+
+		char output_path[SERVER_MAX_REQUEST];
+		if (snprintf(output_path, sizeof(output_path), "%s/%d.bmp", output_directory, i) >= (int)sizeof(output_path))
+		{
+			status = CMD_UNKNOWN_CMD_SWITCH;
+			goto free_connections;
+		}
+		if ((status = client_format_request(connection->request, sizeof(connection->request), &connection->length,
+			input_path, output_path, switches, switch_count)) != NO_ERROR)
+			goto free_connections;
+
+		connection->path = path;
+		connection->latencies = latencies + assigned;
+		connection->count = request_count / connection_count + (i < request_count % connection_count);
+		connection->completed = 0;
+		connection->failed_count = 0;
+		connection->status = NO_ERROR;
+		assigned += connection->count;
+	}
+
+	double start = platform_get_time();
+
+	int started = 0;
+	for (; started < connection_count; started++)
+		if ((status = platform_thread_create(&connections[started].thread, client_connection_main, &connections[started])) != NO_ERROR)
+			break;
+	for (int i = 0; i < started; i++)
+		platform_thread_join(connections[i].thread);
+
+	p_statistics->elapsed = platform_get_time() - start;
+
+	/* a megválaszolt kérések válaszideje a tömb elejére kerül */
+	int completed = 0;
+	p_statistics->failed_count = 0;
+	for (int i = 0; i < started; i++)
+	{
+		if (connections[i].status != NO_ERROR && status == NO_ERROR)
+			status = connections[i].status;
+		memmove(latencies + completed, connections[i].latencies, connections[i].completed * sizeof(double));
+		completed += connections[i].completed;
+		p_statistics->failed_count += connections[i].failed_count;
+	}
+	p_statistics->request_count = completed;
+
+	if (completed > 0)
+	{
+		qsort(latencies, completed, sizeof(double), client_compare_latencies);
+		p_statistics->median = client_percentile(latencies, completed, 0.5);
+		p_statistics->percentile_99 = client_percentile(latencies, completed, 0.99);
+		p_statistics->maximum = latencies[completed - 1];
+	}
+	else
+		p_statistics->median = p_statistics->percentile_99 = p_statistics->maximum = 0.0;
+
+free_connections:
+	free(connections);
+free_latencies:
+	free(latencies);
+
+	return status;
+}
@@ -0,0 +1,35 @@
+﻿/*****************************************************************//**
+ * @file   client.h
+ * @brief  A szervernek kéréseket küldő kliens és a szerver késleltetését
+ * mérő terhelésgenerátor modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef CLIENT_H_INCLUDED
+#define CLIENT_H_INCLUDED
+
+#include <stddef.h>
+#include "server.h"
+
+/**
+ * @brief A terhelésgenerátor mérésének összesített eredménye.
+ */
+typedef struct client_statistics_struct
+{
+	int request_count; /* az elküldött kérések száma */
+	int failed_count; /* a hibás kérések száma */
+	double elapsed; /* a mérés ideje (másodpercben) */
+	double median; /* a válaszidők mediánja (másodpercben) */
+	double percentile_99; /* a válaszidők 99. percentilise (másodpercben) */
+	double maximum; /* a leghosszabb válaszidő (másodpercben) */
+} ClientStatistics;
+
+int client_format_request(char* buffer, size_t size, size_t* p_length, const char* input_path, const char* output_path, char* switches[], int switch_count);
+int client_request(PlatformSocket* endpoint, ServerBuffer* buffer, const char* request, size_t length, int* p_status);
+int client_send(const char* path, const char* input_path, const char* output_path, char* switches[], int switch_count, int* p_status);
+int client_stop(const char* path);
+int client_benchmark(const char* path, const char* input_path, const char* output_directory, char* switches[], int switch_count,
+	int request_count, int connection_count, ClientStatistics* p_statistics);
+
+#endif /* CLIENT_H_INCLUDED */
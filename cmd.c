@@ -10,8 +10,13 @@
 #include "status.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
 /* az argumentumok kezelésénél előjövő hibakódok szöveges reprezentációja */
 const char* cmd_error_code_strings[] = {
 	"Tul keves argumentum.",
@@ -49,6 +54,372 @@ bool cmd_find_argument(const char* argv[], const char* arg)
 	return *argv != NULL;
 }
 
+/**
+ * Értelmezi a sztringként megadott kapcsolót, és amennyiben az a
+ * feldolgozás módját befolyásoló beállítás, módosítja a beállításokat.
+ *
+ * @param options A módosítandó beállítások.
+ * @param sw A beállítás parancssori kapcsolóját tartalmazó sztring.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként
+ * CMD_UNKNOWN_CMD_SWITCH-csel tér vissza, amennyiben a kapcsoló nem
+ * beállítás, vagy hibás a paramétere.
+ */
+int cmd_parse_option(Options* options, const char* sw)
+{
+	int value;
+
+	if (sscanf(sw, "-j=%d", &value) == 1)
+	{
+		if (value < 1)
+			return CMD_UNKNOWN_CMD_SWITCH;
+		options->thread_count = value;
+	}
+	else if (sscanf(sw, "-mem=%d", &value) == 1)
+	{
+		if (value < 1)
+			return CMD_UNKNOWN_CMD_SWITCH;
+		options->memory_limit = value;
+	}
+	else if (strcmp(sw, "-o=24") == 0)
+		options->output_format = BMP_FORMAT_RGB24;
+	else if (strcmp(sw, "-o=1") == 0)
+		options->output_format = BMP_FORMAT_INDEXED1;
+	else if (strcmp(sw, "-o=4") == 0)
+		options->output_format = BMP_FORMAT_INDEXED4;
+	else if (strcmp(sw, "-o=8") == 0)
+		options->output_format = BMP_FORMAT_INDEXED8;
+	else if (strcmp(sw, "-o=rle8") == 0)
+		options->output_format = BMP_FORMAT_RLE8;
+	else if (strcmp(sw, "-d") == 0)
+		options->dither = true;
+	else if (strcmp(sw, "-stat") == 0)
+		options->statistics = true;
+	else if (strcmp(sw, "-tiles") == 0)
+		options->tiled = true;
+	else if (strcmp(sw, "-explain") == 0)
+		options->explain = true;
+#ifndef NDEBUG
+	else if (strcmp(sw, "-alloc=debug") == 0)
+		options->allocator = ALLOCATOR_DEBUG;
+#endif
+	else if (strcmp(sw, "-alloc=libc") == 0)
+		options->allocator = ALLOCATOR_LIBC;
+	else if (strcmp(sw, "-alloc=huge") == 0)
+		options->allocator = ALLOCATOR_HUGE_PAGES;
+	else
+		return CMD_UNKNOWN_CMD_SWITCH;
+
+	return NO_ERROR;
+}
+
+/**
+ * Értelmezi egy konvolúció kapcsolóját, melynek alakja
+ * -k=<szélesség>x<magasság>:<súly>,<súly>,...[/<osztó>]: a súlyok soronként,
+ * a mag felső sorától kezdve követik egymást, az opcionális osztóval
+ * minden súly elosztásra kerül.
+ *
+ * @param operation A kitöltendő művelet.
+ * @param sw A kapcsolót tartalmazó sztring.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a mag foglalási hibája
+ * esetén MEMORY_ERROR-ral, egyébként CMD_UNKNOWN_CMD_SWITCH-csel tér
+ * vissza, amennyiben a mag mérete vagy a súlyok hibásak.
+ */
+static int cmd_parse_kernel(Operation* operation, const char* sw)
+{
+	unsigned int width, height;
+	int offset = 0;
+
+	if (sscanf(sw, "-k=%ux%u:%n", &width, &height, &offset) != 2 || offset == 0 ||
+		width % 2 == 0 || height % 2 == 0 || width > IMAGE_KERNEL_MAX_SIZE || height > IMAGE_KERNEL_MAX_SIZE)
+		return CMD_UNKNOWN_CMD_SWITCH;
+
+	ImageKernel* kernel = image_kernel_create(width, height);
+	if (kernel == NULL)
+		return MEMORY_ERROR;
+
+	const char* position = sw + offset;
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++)
+	{
+		char* end;
+		kernel->weights[i] = strtof(position, &end);
+		if (end == position || (i + 1 < count && *end != ','))
+			goto error;
+		position = (i + 1 < count) ? end + 1 : end;
+	}
+
+	if (*position == '/')
+	{
+		char* end;
+		float divisor = strtof(position + 1, &end);
+		if (end == position + 1 || divisor == 0.0f)
+			goto error;
+		for (size_t i = 0; i < count; i++)
+			kernel->weights[i] /= divisor;
+		position = end;
+	}
+
+	if (*position != '\0')
+		goto error;
+
+	operation->type = OPERATION_CONVOLVE;
+	operation->param.kernel = kernel;
+	return NO_ERROR;
+
+error:
+	image_kernel_destroy(kernel);
+	return CMD_UNKNOWN_CMD_SWITCH;
+}
+
+/**
+ * Értelmezi a sztringként megadott kapcsolót, és amennyiben lehetséges,
+ * kitölti az ahhoz társított művelet leírását, a műveletet azonban nem
+ * hajtja végre.
+ *
+ * @param operation A kitöltendő művelet.
+ * @param sw A művelet parancssori kapcsolóját tartalmazó sztring.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként
+ * CMD_UNKNOWN_CMD_SWITCH-csel tér vissza, amennyiben nem ismeret vagy hibás
+ * a megadott kapcsoló.
+ */
+int cmd_parse_operation(Operation* operation, const char* sw)
+{
+	operation->output = NULL;
+
+	if (sscanf(sw, "-sx=%f", &operation->param.scale.horizontal[0]) == 1)
+	{
+		operation->type = OPERATION_SCALE;
+		operation->param.scale.vertical[0] = 1.0;
+		operation->param.scale.count = 1;
+	}
+	else if (sscanf(sw, "-sy=%f", &operation->param.scale.vertical[0]) == 1)
+	{
+		operation->type = OPERATION_SCALE;
+		operation->param.scale.horizontal[0] = 1.0;
+		operation->param.scale.count = 1;
+	}
+	else if (strcmp(sw, "-mx") == 0)
+		operation->type = OPERATION_MIRROR_X;
+	else if (strcmp(sw, "-my") == 0)
+		operation->type = OPERATION_MIRROR_Y;
+	else if (sscanf(sw, "-b=%d", &operation->param.value) == 1)
+		operation->type = OPERATION_BLUR;
+	else if (sscanf(sw, "-e=%d", &operation->param.value) == 1)
+		operation->type = OPERATION_EXPOSURE;
+	else if (sscanf(sw, "-g=%f", &operation->param.sigma) == 1)
+		operation->type = OPERATION_GAUSSIAN_BLUR;
+	else if (strncmp(sw, "-k=", 3) == 0)
+		return cmd_parse_kernel(operation, sw);
+	else if (sscanf(sw, "-c=%d", &operation->param.value) == 1)
+		operation->type = OPERATION_CONTRAST;
+	else if (sscanf(sw, "-gamma=%f", &operation->param.gamma) == 1)
+		operation->type = OPERATION_GAMMA;
+	else if (sscanf(sw, "-l=%d,%d", &operation->param.levels.black, &operation->param.levels.white) == 2)
+		operation->type = OPERATION_LEVELS;
+	else
+		return CMD_UNKNOWN_CMD_SWITCH;
+
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadítja egy sikeresen értelmezett művelet dinamikusan foglalt
+ * paramétereit (a konvolúció magját és a ráolvasztott keresőtáblát).
+ *
+ * @param operation A művelet.
+ */
+void cmd_release_operation(Operation* operation)
+{
+	if (operation->type == OPERATION_CONVOLVE)
+		image_kernel_destroy(operation->param.kernel);
+	if (operation->output != NULL)
+		free(operation->output);
+}
+
+/**
+ * Értelmezi a kapcsolók egy sorozatát: a beállításokat az options
+ * struktúrába, a műveleteket (végrehajtás nélkül) a megadott tömbbe
+ * gyűjti. Hiba esetén a már értelmezett műveletek felszabadításra
+ * kerülnek.
+ *
+ * @param options A beállítások (az alapértelmezett értékekkel).
+ * @param operations A műveletek tömbje (legalább switch_count elemű).
+ * @param p_count A műveletek számának helye.
+ * @param switches A kapcsolók.
+ * @param switch_count A kapcsolók száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az első hibás
+ * kapcsoló hibakódjával tér vissza.
+ */
+int cmd_parse_switches(Options* options, Operation* operations, int* p_count, char* switches[], int switch_count)
+{
+	int count = 0;
+
+	for (int i = 0; i < switch_count; i++)
+	{
+		if (cmd_parse_option(options, switches[i]) == NO_ERROR)
+			continue;
+
+		int status = cmd_parse_operation(&operations[count], switches[i]);
+		if (status != NO_ERROR)
+		{
+			while (count > 0)
+				cmd_release_operation(&operations[--count]);
+			return status;
+		}
+		count++;
+	}
+
+	*p_count = count;
+
+	return NO_ERROR;
+}
+
+/**
+ * Megvizsgálja, hogy egy művelet pontművelet-e, vagyis minden komponenst a
+ * többitől függetlenül, csak a saját értéke alapján képez-e le, így
+ * keresőtáblába foglalható.
+ *
+ * @param operation A művelet.
+ * @return Pontművelet esetén logikai igazzal, egyébként logikai hamissal
+ * tér vissza.
+ */
+bool cmd_is_point_operation(const Operation* operation)
+{
+	switch (operation->type)
+	{
+	case OPERATION_EXPOSURE:
+	case OPERATION_CONTRAST:
+	case OPERATION_GAMMA:
+	case OPERATION_LEVELS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Egyetlen keresőtáblába foglalja egy műveletsor elején álló, egymást
+ * követő pontműveleteket.
+ *
+ * @param[out] p_lut A kitöltendő keresőtábla.
+ * @param[in] operations A műveletek tömbje.
+ * @param[in] count A műveletek száma.
+ * @param[out] p_composed Az összevont pontműveletek számának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a hibás
+ * paraméterezésű pontművelet hibakódjával (IMAGE_BAD_PARAMETER) tér vissza.
+ */
+int cmd_compose_point_operations(ImageLut* p_lut, const Operation* operations, int count, int* p_composed)
+{
+	int status = NO_ERROR;
+
+	image_lut_identity(p_lut);
+
+	int i;
+	for (i = 0; i < count && cmd_is_point_operation(&operations[i]); i++)
+	{
+		const Operation* operation = &operations[i];
+		switch (operation->type)
+		{
+		case OPERATION_EXPOSURE:
+			image_lut_exposure(p_lut, operation->param.value);
+			break;
+		case OPERATION_CONTRAST:
+			status = image_lut_contrast(p_lut, operation->param.value);
+			break;
+		case OPERATION_GAMMA:
+			status = image_lut_gamma(p_lut, operation->param.gamma);
+			break;
+		default:
+			status = image_lut_levels(p_lut, operation->param.levels.black, operation->param.levels.white);
+			break;
+		}
+		if (status != NO_ERROR)
+			return status;
+	}
+
+	*p_composed = i;
+	return NO_ERROR;
+}
+
+/**
+ * Végrehajt egy korábban értelmezett műveletet a megadott képen.
+ *
+ * @param image A feldolgozandó kép.
+ * @param operation A végrehajtandó művelet.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a műveletekhez
+ * tartozó státuszjellel/hibakóddal tér vissza.
+ */
+int cmd_execute_operation(Image* image, const Operation* operation)
+{
+	switch (operation->type)
+	{
+	case OPERATION_SCALE:
+		return image_scale(image, &operation->param.scale);
+	case OPERATION_MIRROR_X:
+		return image_mirror_x(image);
+	case OPERATION_MIRROR_Y:
+		return image_mirror_y(image);
+	case OPERATION_BLUR:
+		return image_blur(image, operation->param.value, operation->output);
+	case OPERATION_EXPOSURE:
+		return image_exposure(image, operation->param.value);
+	case OPERATION_CONTRAST:
+	case OPERATION_GAMMA:
+	case OPERATION_LEVELS:
+	{
+		ImageLut lut;
+		int composed, status;
+		if ((status = cmd_compose_point_operations(&lut, operation, 1, &composed)) != NO_ERROR)
+			return status;
+		return image_apply_lut(image, &lut);
+	}
+	case OPERATION_GAUSSIAN_BLUR:
+		return image_gaussian_blur(image, operation->param.sigma, operation->output);
+	case OPERATION_CONVOLVE:
+		return image_convolve(image, operation->param.kernel, operation->output);
+	default:
+		return CMD_UNKNOWN_CMD_SWITCH;
+	}
+}
+
+/**
+ * Végrehajt egy korábban értelmezett műveletsort a megadott képen. Az
+ * egymást követő pontműveletek egyetlen keresőtáblába olvadnak, így
+ * együttesen is csak egyszer járják be a képet.
+ *
+ * @param image A feldolgozandó kép.
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az első sikertelen
+ * művelet státuszjelével/hibakódjával tér vissza.
+ */
+int cmd_execute_operations(Image* image, const Operation* operations, int count)
+{
+	int status;
+
+	int i = 0;
+	while (i < count)
+	{
+		if (cmd_is_point_operation(&operations[i]))
+		{
+			ImageLut lut;
+			int composed;
+			if ((status = cmd_compose_point_operations(&lut, &operations[i], count - i, &composed)) != NO_ERROR ||
+				(status = image_apply_lut(image, &lut)) != NO_ERROR)
+				return status;
+			i += composed;
+		}
+		else
+		{
+			if ((status = cmd_execute_operation(image, &operations[i])) != NO_ERROR)
+				return status;
+			i++;
+		}
+	}
+
+	return NO_ERROR;
+}
+
 /**
  * Értelmezi a sztringként megadott kapcsolót, és amennyiben lehetséges,
  * végrehajtja az ahhoz társított műveletet a megadott képen.
@@ -61,28 +432,15 @@ bool cmd_find_argument(const char* argv[], const char* arg)
  */
 int cmd_parse_manip_switch(Image* image, const char* sw)
 {
-	int status = NO_ERROR;
+	int status;
 
-	/* lokális unió típus a paraméteres kapcsolók paramétereinek tárolására */
-	union switch_paramter {
-		float scale;
-		int value;
-	} param;
+	Operation operation;
 
-	if (sscanf(sw, "-sx=%f", &param.scale) == 1)
-		status = image_scale(image, param.scale, 1.0);
-	else if (sscanf(sw, "-sy=%f", &param.scale) == 1)
-		status = image_scale(image, 1.0, param.scale);
-	else if (strcmp(sw, "-mx") == 0)
-		status = image_mirror_x(image);
-	else if (strcmp(sw, "-my") == 0)
-		status = image_mirror_y(image);
-	else if (sscanf(sw, "-b=%d", &param.value) == 1)
-		status = image_blur(image, param.value);
-	else if (sscanf(sw, "-e=%d", &param.value) == 1)
-		status = image_exposure(image, param.value);
-	else
-		status = CMD_UNKNOWN_CMD_SWITCH;
+	if ((status = cmd_parse_operation(&operation, sw)) != NO_ERROR)
+		return status;
+
+	status = cmd_execute_operation(image, &operation);
+	cmd_release_operation(&operation);
 
 	return status;
 }
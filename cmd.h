@@ -11,6 +11,8 @@
 
 #include <stdbool.h>
 #include "image.h"
+#include "bmp.h"
+#include "allocator.h"
 
 #define CMD_ERROR_OFFSET		3000
 
@@ -19,8 +21,70 @@
 
 extern const char* cmd_error_code_strings[];
 
+/**
+ * @brief A parancssori kapcsolókkal kiváltható képmanipulációs műveletek.
+ */
+typedef enum operation_type_enum
+{
+	OPERATION_SCALE, /* skálázás */
+	OPERATION_MIRROR_X, /* tükrözés az x tengelyre */
+	OPERATION_MIRROR_Y, /* tükrözés az y tengelyre */
+	OPERATION_BLUR, /* elhomályosítás/élesítés */
+	OPERATION_EXPOSURE, /* expozíció eltolása */
+	OPERATION_GAUSSIAN_BLUR, /* Gauss-elmosás adott szórással */
+	OPERATION_CONVOLVE, /* konvolúció tetszőleges maggal */
+	OPERATION_CONTRAST, /* kontraszt módosítása */
+	OPERATION_GAMMA, /* gammakorrekció */
+	OPERATION_LEVELS /* szintek beállítása */
+} OperationType;
+
+/**
+ * @brief Egy értelmezett, de még végre nem hajtott képmanipulációs művelet
+ * és annak paraméterei.
+ */
+typedef struct operation_struct
+{
+	OperationType type; /* a művelet típusa */
+	union operation_parameter {
+		ImageScale scale; /* a skálázás (összevonás után több) lépése */
+		int value; /* a művelet intenzitása */
+		float sigma; /* a Gauss-elmosás szórása */
+		ImageKernel* kernel; /* a konvolúció (dinamikusan foglalt) magja */
+		float gamma; /* a gammakorrekció gammája */
+		struct levels_parameter {
+			int black; /* a feketére leképeződő komponensérték */
+			int white; /* a fehérre leképeződő komponensérték */
+		} levels;
+	} param;
+	ImageLut* output; /* a kimenetre ráolvasztott pontműveletek (dinamikusan foglalt) keresőtáblája, vagy NULL */
+} Operation;
+
+/**
+ * @brief A képmanipulációs műveletek mellett megadható, a feldolgozás
+ * módját befolyásoló beállítások.
+ */
+typedef struct options_struct
+{
+	int thread_count; /* a beolvasást, a műveleteket és a kiírást végző szálak száma */
+	BmpFormat output_format; /* a kimeneti kép formátuma */
+	bool dither; /* palettás kimenet rendezett szórással */
+	bool statistics; /* erőforrás-használat kiírása a feldolgozás után */
+	AllocatorBackend allocator; /* a pixelmátrixok foglalásának módja */
+	bool tiled; /* a kép csempés elrendezésben a műveletek alatt */
+	bool explain; /* az optimalizált végrehajtási terv kiírása */
+	int memory_limit; /* a kötegelt feldolgozás alatt egyszerre feldolgozott képek memóriakorlátja (MB-ban) */
+} Options;
+
 int cmd_check_argc(int argc, int desired);
 bool cmd_find_argument(const char* argv[], const char* arg);
+int cmd_parse_option(Options* options, const char* sw);
+int cmd_parse_operation(Operation* operation, const char* sw);
+int cmd_parse_switches(Options* options, Operation* operations, int* p_count, char* switches[], int switch_count);
+int cmd_execute_operation(Image* image, const Operation* operation);
+bool cmd_is_point_operation(const Operation* operation);
+int cmd_compose_point_operations(ImageLut* p_lut, const Operation* operations, int count, int* p_composed);
+int cmd_execute_operations(Image* image, const Operation* operations, int count);
+void cmd_release_operation(Operation* operation);
 int cmd_parse_manip_switch(Image* image, const char* sw);
 
 #endif /* CMD_H_INCLUDED */
@@ -0,0 +1,176 @@
+﻿/*****************************************************************//**
+ * @file   fft.c
+ * @brief  Kettő hatványa méretű, egy- és kétdimenziós komplex gyors
+ * Fourier-transzformációt végző modul forrásfájlja.
+ *
+ * A komplex számok valós és képzetes része egymás után, float-ként
+ * tárolódik. A transzformáció iteratív, kettes alapú (Cooley-Tukey): a
+ * bitfordított sorrendbe rendezés után log2(size) menetben végzi el a
+ * pillangóműveleteket a terv előre kiszámolt forgatási tényezőivel. Az
+ * inverz transzformáció nem normál, az eredményt a hívó osztja a
+ * méret(ek)kel.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "fft.h"
+#include "status.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* egy transzformáció terve */
+struct fft_plan_struct
+{
+	size_t size; /* a transzformáció mérete (kettő hatványa) */
+	uint32_t* reversed; /* az indexek bitfordított párja */
+	float* twiddles; /* a size / 2 forgatási tényező (exp(-2 pi i k / size)) */
+};
+
+/**
+ * Elkészíti egy adott méretű transzformáció tervét.
+ *
+ * A lefoglalt memóriaterület felszabadítása (fft_plan_destroy) a hívó
+ * feladata.
+ *
+ * @param p_plan A terv helye.
+ * @param size A transzformáció mérete (kettő hatványa, legalább 2).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int fft_plan_create(FftPlan** p_plan, size_t size)
+{
+	FftPlan* plan = (FftPlan*)malloc(sizeof(FftPlan));
+	if (plan == NULL)
+		return MEMORY_ERROR;
+
+	plan->size = size;
+	plan->reversed = (uint32_t*)malloc(size * sizeof(uint32_t));
+	plan->twiddles = (float*)malloc(size * sizeof(float));
+	if (plan->reversed == NULL || plan->twiddles == NULL)
+	{
+		fft_plan_destroy(plan);
+		return MEMORY_ERROR;
+	}
+
+	int bits = 0;
+	while (((size_t)1 << bits) < size)
+		bits++;
+	for (size_t i = 0; i < size; i++)
+	{
+		uint32_t reversed = 0;
+		for (int b = 0; b < bits; b++)
+			reversed |= (uint32_t)((i >> b) & 1) << (bits - 1 - b);
+		plan->reversed[i] = reversed;
+	}
+
+	const double pi = 3.14159265358979323846;
+	for (size_t k = 0; k < size / 2; k++)
+	{
+		double angle = -2.0 * pi * (double)k / (double)size;
+		plan->twiddles[2 * k] = (float)cos(angle);
+		plan->twiddles[2 * k + 1] = (float)sin(angle);
+	}
+
+	*p_plan = plan;
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadít egy transzformációs tervet.
+ *
+ * @param plan A terv.
+ */
+void fft_plan_destroy(FftPlan* plan)
+{
+	if (plan->reversed != NULL)
+		free(plan->reversed);
+	if (plan->twiddles != NULL)
+		free(plan->twiddles);
+	free(plan);
+}
+
+/**
+ * Helyben transzformál egy size elemű komplex sorozatot.
+ *
+ * @param plan A transzformáció terve.
+ * @param data A sorozat (2 * size float).
+ * @param inverse Logikai igaz esetén az inverz (nem normált) transzformációt
+ * végzi el.
+ */
+void fft_transform(const FftPlan* plan, float* data, bool inverse)
+{
+	size_t size = plan->size;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		size_t j = plan->reversed[i];
+		if (i < j)
+		{
+			float re = data[2 * i], im = data[2 * i + 1];
+			data[2 * i] = data[2 * j];
+			data[2 * i + 1] = data[2 * j + 1];
+			data[2 * j] = re;
+			data[2 * j + 1] = im;
+		}
+	}
+
+	/* az inverz transzformáció a forgatási tényezők konjugáltjait használja */
+	float sign = inverse ? -1.0f : 1.0f;
+
+	for (size_t half = 1; half < size; half *= 2)
+	{
+		size_t stride = size / (2 * half);
+		for (size_t start = 0; start < size; start += 2 * half)
+		{
+			for (size_t k = 0; k < half; k++)
+			{
+				float w_re = plan->twiddles[2 * k * stride];
+				float w_im = sign * plan->twiddles[2 * k * stride + 1];
+
+				float* a = data + 2 * (start + k);
+				float* b = data + 2 * (start + k + half);
+				float t_re = b[0] * w_re - b[1] * w_im;
+				float t_im = b[0] * w_im + b[1] * w_re;
+				b[0] = a[0] - t_re;
+				b[1] = a[1] - t_im;
+				a[0] += t_re;
+				a[1] += t_im;
+			}
+		}
+	}
+}
+
+/**
+ * Helyben transzformál egy size × size méretű, soronként folytonosan
+ * tárolt komplex mátrixot: először a sorait, majd egy segédpufferbe
+ * kigyűjtve az oszlopait transzformálja.
+ *
+ * @param plan A transzformáció terve.
+ * @param data A mátrix (2 * size * size float).
+ * @param column Egy oszlopnyi segédpuffer (2 * size float).
+ * @param inverse Logikai igaz esetén az inverz (nem normált) transzformációt
+ * végzi el.
+ */
+void fft_transform_2d(const FftPlan* plan, float* data, float* column, bool inverse)
+{
+	size_t size = plan->size;
+
+	for (size_t y = 0; y < size; y++)
+		fft_transform(plan, data + 2 * y * size, inverse);
+
+	for (size_t x = 0; x < size; x++)
+	{
+		for (size_t y = 0; y < size; y++)
+			memcpy(column + 2 * y, data + 2 * (y * size + x), 2 * sizeof(float));
+		fft_transform(plan, column, inverse);
+		for (size_t y = 0; y < size; y++)
+			memcpy(data + 2 * (y * size + x), column + 2 * y, 2 * sizeof(float));
+	}
+}
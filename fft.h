@@ -0,0 +1,23 @@
+﻿/*****************************************************************//**
+ * @file   fft.h
+ * @brief  Kettő hatványa méretű, egy- és kétdimenziós komplex gyors
+ * Fourier-transzformációt végző modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef FFT_H_INCLUDED
+#define FFT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* egy adott méretű transzformáció előre kiszámolt táblázatai (opaque típus) */
+typedef struct fft_plan_struct FftPlan;
+
+int fft_plan_create(FftPlan** p_plan, size_t size);
+void fft_plan_destroy(FftPlan* plan);
+void fft_transform(const FftPlan* plan, float* data, bool inverse);
+void fft_transform_2d(const FftPlan* plan, float* data, float* column, bool inverse);
+
+#endif /* FFT_H_INCLUDED */
@@ -7,342 +7,3095 @@
  *********************************************************************/
 #include "image.h"
 #include "status.h"
+#include "platform.h"
+#include "allocator.h"
+#include "fft.h"
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define IMAGE_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#ifndef NDEBUG
 #include "debugmalloc.h"
+#endif
 
 /* az képek kezelésénél előjövő hibakódok szöveges reprezentációja */
 const char* image_error_code_strings[] = {
 	"Hibas parameter."
 };
 
+/* a pixelmátrixok gyorsítótárában tárolható memóriaterületek száma */
+#define IMAGE_POOL_CAPACITY			4
+
+/* ez alatt minden egész szám pontosan ábrázolható float-ként */
+#define IMAGE_FLOAT_EXACT_LIMIT		((uint32_t)1 << 24)
+
+/**
+ * @brief Egy felszabadított, újrahasznosításra váró memóriaterület.
+ */
+typedef struct image_pool_block_struct
+{
+	void* allocation; /* a memóriaterület */
+	size_t size; /* a memóriaterület mérete */
+} ImagePoolBlock;
+
+/*
+ * A műveletek közötti és az egymás után feldolgozott fájlok közötti
+ * pixelmátrixok memóriaterületeit újrahasznosító gyorsítótár, így a már
+ * egyszer lefoglalt (és a laphibák árán beszámozott) memória nem kerül
+ * minden művelet után vissza az operációs rendszerhez. A gyorsítótár
+ * alapesetben nem szálbiztos; ha több szál dolgoz fel egyszerre képeket,
+ * a zárát be kell kapcsolni (lásd image_pool_set_shared).
+ */
+static struct image_pool_struct
+{
+	ImagePoolBlock blocks[IMAGE_POOL_CAPACITY]; /* a tárolt memóriaterületek */
+	int count; /* a tárolt memóriaterületek száma */
+	ImagePoolStatistics statistics; /* a gyorsítótár statisztikái */
+	PlatformMutex* mutex; /* a gyorsítótárat védő zár, vagy NULL */
+} image_pool;
+
+/**
+ * Lezárja a pixelmátrixok gyorsítótárát, ha a zárja be van kapcsolva.
+ */
+static void image_pool_lock(void)
+{
+	if (image_pool.mutex != NULL)
+		platform_mutex_lock(image_pool.mutex);
+}
+
+/**
+ * Feloldja a pixelmátrixok gyorsítótárának zárát, ha az be van kapcsolva.
+ */
+static void image_pool_unlock(void)
+{
+	if (image_pool.mutex != NULL)
+		platform_mutex_unlock(image_pool.mutex);
+}
+
+/**
+ * Kivesz egy legalább size bájtos memóriaterületet a gyorsítótárból (a
+ * legkisebb megfelelőt), vagy ha nincs ilyen, akkor foglal egy újat az
+ * allocator modullal. Új
+ * foglalás előtt a túl kicsi tárolt területeket felszabadítja, hogy azok ne
+ * növeljék feleslegesen a memóriahasználat csúcsát.
+ *
+ * @param size A szükséges méret (bájtban).
+ * @param p_size A kapott memóriaterület tényleges méretének helye.
+ * @return Sikeres lefutás esetén a memóriaterülettel, egyébként
+ * NULL-pointerrel tér vissza.
+ */
+static void* image_pool_acquire(size_t size, size_t* p_size)
+{
+	image_pool_lock();
+
+	image_pool.statistics.requests++;
+
+	int best = -1;
+	for (int i = 0; i < image_pool.count; i++)
+	{
+		if (image_pool.blocks[i].size >= size && (best < 0 || image_pool.blocks[i].size < image_pool.blocks[best].size))
+			best = i;
+	}
+
+	if (best >= 0)
+	{
+		void* allocation = image_pool.blocks[best].allocation;
+		*p_size = image_pool.blocks[best].size;
+		image_pool.statistics.cached_bytes -= *p_size;
+		image_pool.blocks[best] = image_pool.blocks[--image_pool.count];
+		image_pool.statistics.reuses++;
+		image_pool_unlock();
+		return allocation;
+	}
+
+	for (int i = image_pool.count - 1; i >= 0; i--)
+	{
+		image_pool.statistics.cached_bytes -= image_pool.blocks[i].size;
+		allocator_free(image_pool.blocks[i].allocation, image_pool.blocks[i].size);
+	}
+	image_pool.count = 0;
+
+	/* a foglalás alatt a többi szál hozzáférhet a gyorsítótárhoz */
+	image_pool_unlock();
+
+	void* allocation = allocator_allocate(size);
+	if (allocation == NULL)
+		return NULL;
+
+	image_pool_lock();
+	image_pool.statistics.allocated_bytes += size;
+	image_pool_unlock();
+	*p_size = size;
+
+	return allocation;
+}
+
+/**
+ * Visszaad egy memóriaterületet a gyorsítótárnak. Ha a gyorsítótár megtelt,
+ * a legkisebb tárolt (vagy maga a visszaadott) terület felszabadításra kerül.
+ *
+ * @param allocation A memóriaterület (vagy NULL).
+ * @param size A memóriaterület mérete.
+ */
+static void image_pool_release(void* allocation, size_t size)
+{
+	if (allocation == NULL)
+		return;
+
+	image_pool_lock();
+
+	if (image_pool.count == IMAGE_POOL_CAPACITY)
+	{
+		int smallest = 0;
+		for (int i = 1; i < image_pool.count; i++)
+			if (image_pool.blocks[i].size < image_pool.blocks[smallest].size)
+				smallest = i;
+
+		if (image_pool.blocks[smallest].size >= size)
+		{
+			image_pool_unlock();
+			allocator_free(allocation, size);
+			return;
+		}
+
+		image_pool.statistics.cached_bytes -= image_pool.blocks[smallest].size;
+		allocator_free(image_pool.blocks[smallest].allocation, image_pool.blocks[smallest].size);
+		image_pool.blocks[smallest] = image_pool.blocks[--image_pool.count];
+	}
+
+	image_pool.blocks[image_pool.count].allocation = allocation;
+	image_pool.blocks[image_pool.count].size = size;
+	image_pool.count++;
+	image_pool.statistics.cached_bytes += size;
+
+	image_pool_unlock();
+}
+
+/**
+ * Lekérdezi a pixelmátrixok gyorsítótárának statisztikáit.
+ *
+ * @param p_statistics A statisztikák helye.
+ */
+void image_pool_get_statistics(ImagePoolStatistics* p_statistics)
+{
+	image_pool_lock();
+	*p_statistics = image_pool.statistics;
+	image_pool_unlock();
+}
+
+/**
+ * Felszabadítja a pixelmátrixok gyorsítótárában tárolt összes
+ * memóriaterületet. A program végén (vagy memóriaszűkében) kell hívni.
+ */
+void image_pool_clear(void)
+{
+	image_pool_lock();
+	for (int i = 0; i < image_pool.count; i++)
+		allocator_free(image_pool.blocks[i].allocation, image_pool.blocks[i].size);
+	image_pool.count = 0;
+	image_pool.statistics.cached_bytes = 0;
+	image_pool_unlock();
+}
+
+/**
+ * Be- vagy kikapcsolja a pixelmátrixok gyorsítótárának zárát. Bekapcsolt
+ * zár mellett a képek több szálon, egymással párhuzamosan hozhatók létre
+ * és szabadíthatók fel (a debugmalloc-ot nem használó allokátorokkal). Csak
+ * akkor hívható, amikor egyetlen szál használja a modult.
+ *
+ * @param shared Logikai igaz esetén bekapcsolja, egyébként kikapcsolja a
+ * zárat.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int image_pool_set_shared(bool shared)
+{
+	if (shared && image_pool.mutex == NULL)
+		return platform_mutex_create(&image_pool.mutex);
+
+	if (!shared && image_pool.mutex != NULL)
+	{
+		platform_mutex_destroy(image_pool.mutex);
+		image_pool.mutex = NULL;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Felkerekít egy méretet IMAGE_ALIGNMENT többszörösére.
+ *
+ * @param size A méret (bájtban).
+ * @return Visszatér a felkerekített mérettel.
+ */
+static size_t image_align_size(size_t size)
+{
+	return (size + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+}
+
+/**
+ * Összeszoroz két méretet, ha a szorzatuk ábrázolható size_t-ként.
+ *
+ * @param[in] a Az egyik tényező.
+ * @param[in] b A másik tényező.
+ * @param[out] p_product A szorzat helye.
+ * @return Logikai igazzal tér vissza, ha a szorzás nem csordult túl.
+ */
+static bool image_multiply_size(size_t a, size_t b, size_t* p_product)
+{
+	if (b != 0 && a > SIZE_MAX / b)
+		return false;
+	*p_product = a * b;
+	return true;
+}
+
+/**
+ * Kiszámolja egy saját foglalású, Pixel-ekből álló sorokkal tárolt kép két
+ * egymást követő sorának távolságát: a sor hosszát IMAGE_ALIGNMENT
+ * többszörösére kerekíti.
+ *
+ * @param width A kép szélessége.
+ * @return Visszatér a sorok távolságával (bájtban).
+ */
+size_t image_calculate_stride(uint32_t width)
+{
+	return image_align_size((size_t)width * sizeof(Pixel));
+}
+
+/**
+ * Megadja egy kép egy (síkos elrendezésben egy komponenssíkbeli) sorának
+ * hosszát.
+ *
+ * @param image A kép.
+ * @return Visszatér a sor hosszával (bájtban).
+ */
+static size_t image_row_size(const Image* image)
+{
+	return (image->layout == IMAGE_LAYOUT_PLANAR) ? image->width : (size_t)image->width * sizeof(Pixel);
+}
+
+/**
+ * Megadja, hány csempe fed le egy adott hosszúságú oldalt.
+ *
+ * @param length Az oldal hossza (pixelben).
+ * @return Visszatér a csempék számával.
+ */
+static uint32_t image_tiles_across(uint32_t length)
+{
+	return length / IMAGE_TILE_SIZE + (length % IMAGE_TILE_SIZE != 0);
+}
+
+/**
+ * Megadja egy csempés elrendezésű kép adott pixelének címét. A pixeltől
+ * a csempe soráig tartó pixelek folytonosan helyezkednek el.
+ *
+ * @param image A kép.
+ * @param x A pixel oszlopa.
+ * @param y A pixel sora.
+ * @return Visszatér a pixel címével.
+ */
+static Pixel* image_tiled_pixel(const Image* image, uint32_t x, uint32_t y)
+{
+	size_t tile = (size_t)(y / IMAGE_TILE_SIZE) * image_tiles_across(image->width) + x / IMAGE_TILE_SIZE;
+	return (Pixel*)(image->data + tile * image->plane_size + (size_t)(y % IMAGE_TILE_SIZE) * image->stride) + x % IMAGE_TILE_SIZE;
+}
+
+/**
+ * Megadja egy kép síkjainak számát: síkos elrendezésben a komponensek
+ * számát, egyébként egyet.
+ *
+ * @param image A kép.
+ * @return Visszatér a síkok számával.
+ */
+static int image_plane_count(const Image* image)
+{
+	return (image->layout == IMAGE_LAYOUT_PLANAR) ? 3 : 1;
+}
+
+/**
+ * Készít egy dinamikusan foglalt, width × height dimenziójú, adott
+ * elrendezésű pixelmátrixot egyetlen memóriaterületen, IMAGE_ALIGNMENT
+ * bájtra igazított és kitöltött sorokkal, melyet egy képstruktúra
+ * pixelmátrixot leíró mezőiként ad vissza a hívónak, amennyiben sikeres volt
+ * a foglalás.
+ * 
+ * A memóriaterület (allocation) a gyorsítótárból származhat, visszaadása
+ * (image_release_pixel_matrix) a hívó feladata.
+ * 
+ * @param[out] p_matrix A pixelmátrixot leíró képstruktúra helye.
+ * @param[in] width A pixelmátrix szélessége.
+ * @param[in] height A pixelmátrix magassága.
+ * @param[in] layout A pixelmátrix elrendezése.
+ * @return Sikeres lefutás esetén NO_ERROR, egyébként MEMORY_ERROR.
+ */
+static int image_create_pixel_matrix(Image* p_matrix, uint32_t width, uint32_t height, ImageLayout layout)
+{
+	size_t stride, plane_size, size;
+
+	/* a sorhossz és annak felkerekítése sem csordulhat túl (32 bites size_t esetén) */
+	if ((uint64_t)width * sizeof(Pixel) > SIZE_MAX - IMAGE_ALIGNMENT)
+		return MEMORY_ERROR;
+
+	if (layout == IMAGE_LAYOUT_TILED)
+	{
+		/* a csempék sorai (IMAGE_TILE_SIZE Pixel) IMAGE_ALIGNMENT többszörösei */
+		stride = (size_t)IMAGE_TILE_SIZE * sizeof(Pixel);
+		plane_size = stride * IMAGE_TILE_SIZE;
+		if (!image_multiply_size(plane_size, image_tiles_across(width), &size) ||
+			!image_multiply_size(size, image_tiles_across(height), &size))
+			return MEMORY_ERROR;
+	}
+	else
+	{
+		bool planar = (layout == IMAGE_LAYOUT_PLANAR);
+		stride = planar ? image_align_size(width) : image_calculate_stride(width);
+		if (!image_multiply_size(stride, height, &plane_size) ||
+			!image_multiply_size(plane_size, planar ? 3 : 1, &size))
+			return MEMORY_ERROR;
+	}
+
+	/* az igazítás miatt legfeljebb IMAGE_ALIGNMENT - 1 bájttal többre van szükség */
+	if (size > SIZE_MAX - (IMAGE_ALIGNMENT - 1))
+		return MEMORY_ERROR;
+	size += IMAGE_ALIGNMENT - 1;
+
+	void* allocation = image_pool_acquire(size, &size);
+	if (allocation == NULL)
+		return MEMORY_ERROR;
+
+	p_matrix->width = width;
+	p_matrix->height = height;
+	p_matrix->layout = layout;
+	p_matrix->data = (uint8_t*)(((uintptr_t)allocation + IMAGE_ALIGNMENT - 1) & ~(uintptr_t)(IMAGE_ALIGNMENT - 1));
+	p_matrix->stride = stride;
+	p_matrix->plane_size = plane_size;
+	p_matrix->allocation = allocation;
+	p_matrix->allocation_size = size;
+	p_matrix->mapping = NULL;
+	p_matrix->mapping_size = 0;
+
+	return NO_ERROR;
+}
+
+/**
+ * Készít egy dinamikusan foglalt absztrakt képet tároló sturktúrát, mely
+ * elkészítésekor egy width × height dimenziójú kép tárolására alkalmas.
+ *  
+ * A lefoglalt memóriaterület felszabadítása a hívó feladata.
+ * 
+ * @param width A kép szélessége.
+ * @param height A kép magassága.
+ * @return Sikeres lefutás esetén a dinamikusan foglalt stuktúrára mutató
+ * pointer, foglalási hiba esetén pedig NULL-pointer.
+ */
+Image* image_create(uint32_t width, uint32_t height)
+{
+	Image* image = (Image*)malloc(sizeof(Image));
+	if (image == NULL)
+		return NULL;
+
+	if (image_create_pixel_matrix(image, width, height, IMAGE_LAYOUT_INTERLEAVED) != NO_ERROR)
+	{
+		free(image);
+		return NULL;
+	}
+
+	return image;
+}
+
+/**
+ * Készít egy dinamikusan foglalt absztrakt képet tároló struktúrát, melynek
+ * sorai egy fájlleképezés egymástól row_stride bájtnyira elhelyezkedő
+ * soraira mutatnak, így a képpontok nem kerülnek átmásolásra.
+ *
+ * Sikeres lefutás esetén a kép átveszi a leképezés tulajdonjogát, azt a kép
+ * felszabadításakor (vagy a pixelmátrix lecserélésekor) szünteti meg. Mivel a
+ * leképezés privát, a képpontokat helyben módosító műveletek a leképezett
+ * lapokról másolatot kapnak, a fájl tartalma nem változik.
+ *
+ * A lefoglalt memóriaterület felszabadítása a hívó feladata.
+ *
+ * @param width A kép szélessége.
+ * @param height A kép magassága.
+ * @param first_row A kép első sorának címe a leképezésen belül.
+ * @param row_stride Két egymást követő sor kezdőcímének távolsága (bájtban).
+ * @param mapping A leképezés kezdőcíme.
+ * @param mapping_size A leképezés mérete (bájtban).
+ * @return Sikeres lefutás esetén a dinamikusan foglalt stuktúrára mutató
+ * pointer, foglalási hiba esetén pedig NULL-pointer.
+ */
+Image* image_create_mapped(uint32_t width, uint32_t height, uint8_t* first_row, size_t row_stride, void* mapping, size_t mapping_size)
+{
+	Image* image = (Image*)malloc(sizeof(Image));
+	if (image == NULL)
+		return NULL;
+
+	image->width = width;
+	image->height = height;
+	image->layout = IMAGE_LAYOUT_INTERLEAVED;
+	image->data = first_row;
+	image->stride = row_stride;
+	image->plane_size = row_stride * height;
+	image->allocation = NULL;
+	image->allocation_size = 0;
+	image->mapping = mapping;
+	image->mapping_size = mapping_size;
+
+	return image;
+}
+
+/**
+ * Felszabadítja egy kép pixelmátrixát, legyen az dinamikusan foglalt (ekkor
+ * a memóriaterülete a gyorsítótárba kerül) vagy egy fájlleképezés része.
+ *
+ * @param image A kép, melynek pixelmátrixát fel kell szabadítani.
+ */
+static void image_release_pixel_matrix(Image* image)
+{
+	if (image->mapping != NULL)
+	{
+		platform_unmap_file(image->mapping, image->mapping_size);
+		image->mapping = NULL;
+		image->mapping_size = 0;
+	}
+	else
+	{
+		image_pool_release(image->allocation, image->allocation_size);
+	}
+	image->allocation = NULL;
+}
+
+/**
+ * Lecseréli egy kép pixelmátrixát egy másikra: felszabadítja a régit, és a
+ * kép átveszi az új pixelmátrix tulajdonjogát (a méretével és az
+ * elrendezésével együtt).
+ *
+ * @param image A kép.
+ * @param matrix Az új pixelmátrixot leíró képstruktúra.
+ */
+static void image_replace_pixel_matrix(Image* image, const Image* matrix)
+{
+	image_release_pixel_matrix(image);
+	*image = *matrix;
+}
+
+/**
+ * Kimásolja egy Pixel-ekből álló (folytonos vagy csempés) elrendezésű kép
+ * egy sorának egy darabját.
+ *
+ * @param image A kép.
+ * @param x Az első kimásolandó pixel oszlopa.
+ * @param y A sor indexe.
+ * @param count A kimásolandó pixelek száma.
+ * @param dst A cél pixelsor.
+ */
+static void image_copy_span(const Image* image, uint32_t x, uint32_t y, uint32_t count, Pixel* dst)
+{
+	if (image->layout != IMAGE_LAYOUT_TILED)
+	{
+		memcpy(dst, image_row(image, y) + x, (size_t)count * sizeof(Pixel));
+		return;
+	}
+
+	while (count > 0)
+	{
+		uint32_t length = IMAGE_TILE_SIZE - x % IMAGE_TILE_SIZE;
+		if (length > count)
+			length = count;
+		memcpy(dst, image_tiled_pixel(image, x, y), (size_t)length * sizeof(Pixel));
+		dst += length;
+		x += length;
+		count -= length;
+	}
+}
+
+/**
+ * Felülírja egy kép egy sorát Pixel-ek sorozatával, az elrendezéstől
+ * függetlenül (az image_copy_row párja).
+ *
+ * @param image A kép.
+ * @param y A sor indexe.
+ * @param src A kép szélességével megegyező hosszú forrás pixelsor.
+ */
+static void image_store_row(Image* image, uint32_t y, const Pixel* src)
+{
+	if (image->layout == IMAGE_LAYOUT_INTERLEAVED)
+	{
+		memcpy(image_row(image, y), src, (size_t)image->width * sizeof(Pixel));
+		return;
+	}
+
+	if (image->layout == IMAGE_LAYOUT_TILED)
+	{
+		for (uint32_t x = 0; x < image->width; x += IMAGE_TILE_SIZE)
+		{
+			uint32_t length = (image->width - x < IMAGE_TILE_SIZE) ? image->width - x : IMAGE_TILE_SIZE;
+			memcpy(image_tiled_pixel(image, x, y), src + x, (size_t)length * sizeof(Pixel));
+		}
+		return;
+	}
+
+	uint8_t* blue = image_plane_row(image, 0, y);
+	uint8_t* green = image_plane_row(image, 1, y);
+	uint8_t* red = image_plane_row(image, 2, y);
+
+	for (uint32_t x = 0; x < image->width; x++)
+	{
+		blue[x] = src[x].blue;
+		green[x] = src[x].green;
+		red[x] = src[x].red;
+	}
+}
+
+/**
+ * Előállítja egy kép egy sorát Pixel-ek sorozataként, az elrendezéstől
+ * függetlenül: síkos elrendezésben a komponenssíkok sorait fésüli össze,
+ * csempés elrendezésben pedig a csempék sordarabjait fűzi össze.
+ *
+ * @param image A kép.
+ * @param y A sor indexe.
+ * @param dst A kép szélességével megegyező hosszú cél pixelsor.
+ */
+void image_copy_row(const Image* image, uint32_t y, Pixel* dst)
+{
+	if (image->layout != IMAGE_LAYOUT_PLANAR)
+	{
+		image_copy_span(image, 0, y, image->width, dst);
+		return;
+	}
+
+	const uint8_t* blue = image_plane_row(image, 0, y);
+	const uint8_t* green = image_plane_row(image, 1, y);
+	const uint8_t* red = image_plane_row(image, 2, y);
+
+	for (uint32_t x = 0; x < image->width; x++)
+	{
+		dst[x].blue = blue[x];
+		dst[x].green = green[x];
+		dst[x].red = red[x];
+	}
+}
+
+/**
+ * Megadja egy kép egy sorát Pixel-ek sorozataként: Pixel-ekből álló sorok
+ * esetén közvetlenül a kép sorát, síkos és csempés elrendezésben pedig a
+ * pufferbe összefésült sort.
+ *
+ * @param image A kép.
+ * @param y A sor indexe.
+ * @param buffer A kép szélességével megegyező hosszú puffer (folytonos,
+ * Pixel-ekből álló sorok esetén NULL is lehet).
+ * @return Visszatér a sor első pixelének címével.
+ */
+const Pixel* image_get_row(const Image* image, uint32_t y, Pixel* buffer)
+{
+	if (image->layout == IMAGE_LAYOUT_INTERLEAVED)
+		return image_row(image, y);
+
+	image_copy_row(image, y, buffer);
+	return buffer;
+}
+
+/**
+ * Átalakítja egy kép pixelmátrixát a megadott elrendezésűre. Az átalakítás
+ * egy új pixelmátrixba történik, a régit pedig felszabadítja.
+ *
+ * @param image A kép.
+ * @param layout Az új elrendezés.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, memóriafoglalási hiba esetén
+ * MEMORY_ERROR-ral tér vissza.
+ */
+int image_set_layout(Image* image, ImageLayout layout)
+{
+	int status;
+
+	if (image->layout == layout)
+		return NO_ERROR;
+
+	Image matrix;
+	if ((status = image_create_pixel_matrix(&matrix, image->width, image->height, layout)) != NO_ERROR)
+		return status;
+
+	/* két nem folytonos elrendezés között a sorok egy pufferen keresztül kerülnek át */
+	Pixel* buffer = NULL;
+	if (image->layout != IMAGE_LAYOUT_INTERLEAVED && layout != IMAGE_LAYOUT_INTERLEAVED)
+	{
+		size_t buffer_size = (image->width > 0 ? image->width : 1) * sizeof(Pixel);
+		allocator_reserve(buffer_size);
+
+		buffer = (Pixel*)malloc(buffer_size);
+		if (buffer == NULL)
+		{
+			image_release_pixel_matrix(&matrix);
+			return MEMORY_ERROR;
+		}
+	}
+
+	for (uint32_t y = 0; y < image->height; y++)
+	{
+		if (layout == IMAGE_LAYOUT_INTERLEAVED)
+			image_copy_row(image, y, image_row(&matrix, y));
+		else
+			image_store_row(&matrix, y, image_get_row(image, y, buffer));
+	}
+
+	if (buffer != NULL)
+		free(buffer);
+
+	image_replace_pixel_matrix(image, &matrix);
+
+	return NO_ERROR;
+}
+
+/**
+ * Megadja egy kép csempéinek számát (lásd image_get_tile).
+ *
+ * @param image A kép.
+ * @return Visszatér a csempék számával; síkos elrendezésben nullával.
+ */
+size_t image_tile_count(const Image* image)
+{
+	if (image->layout == IMAGE_LAYOUT_PLANAR)
+		return 0;
+	return (size_t)image_tiles_across(image->width) * image_tiles_across(image->height);
+}
+
+/**
+ * Megadja egy Pixel-ekből álló (folytonos vagy csempés) elrendezésű kép
+ * adott indexű csempéjét. A csempék a kép IMAGE_TILE_SIZE × IMAGE_TILE_SIZE
+ * pixeles rácsának celláit fedik le soronként, balról jobbra haladva;
+ * csempés elrendezésben a csempe folytonos memóriaterület, egyébként a
+ * kép sorainak darabjaiból áll. Az indexeken végighaladva a kép minden
+ * pixele pontosan egyszer kerül sorra:
+ *
+ *     ImageTile tile;
+ *     for (size_t i = 0; image_get_tile(image, i, &tile); i++) ...
+ *
+ * @param image A kép.
+ * @param index A csempe indexe.
+ * @param p_tile A csempe helye.
+ * @return Logikai igazzal tér vissza, ha a csempe létezik.
+ */
+bool image_get_tile(const Image* image, size_t index, ImageTile* p_tile)
+{
+	if (index >= image_tile_count(image))
+		return false;
+
+	uint32_t tiles_x = image_tiles_across(image->width);
+
+	p_tile->x = (uint32_t)(index % tiles_x) * IMAGE_TILE_SIZE;
+	p_tile->y = (uint32_t)(index / tiles_x) * IMAGE_TILE_SIZE;
+	p_tile->width = (image->width - p_tile->x < IMAGE_TILE_SIZE) ? image->width - p_tile->x : IMAGE_TILE_SIZE;
+	p_tile->height = (image->height - p_tile->y < IMAGE_TILE_SIZE) ? image->height - p_tile->y : IMAGE_TILE_SIZE;
+	p_tile->stride = image->stride;
+
+	if (image->layout == IMAGE_LAYOUT_TILED)
+		p_tile->pixels = (Pixel*)(image->data + index * image->plane_size);
+	else
+		p_tile->pixels = image_row(image, p_tile->y) + p_tile->x;
+
+	return true;
+}
+
+/**
+ * Megadja egy csempe adott sorának kezdőcímét.
+ *
+ * @param tile A csempe.
+ * @param row A sor indexe a csempén belül.
+ * @return Visszatér a sor első pixelének címével.
+ */
+static Pixel* image_tile_row(const ImageTile* tile, uint32_t row)
+{
+	return (Pixel*)((uint8_t*)tile->pixels + (size_t)row * tile->stride);
+}
+
+/* egy párhuzamosan feldolgozott sáv legkisebb mérete (bájtban) */
+#define IMAGE_BAND_MIN_SIZE			(1 << 14)
+
+/* ennyi sávra bomlik szálanként egy művelet, hogy a munkások egymástól lophassanak */
+#define IMAGE_BANDS_PER_THREAD		16
+
+/*
+ * A képműveleteket sávokra bontva végrehajtó munkáskészlet, vagy NULL, ha
+ * a műveletek egy szálon futnak. A készletet a hívó hozza létre és szünteti
+ * meg (lásd image_set_thread_pool).
+ */
+static ThreadPool* image_thread_pool = NULL;
+
+/* egy sávokra bontott művelet részfeladatainak közös állapota */
+struct image_band_struct
+{
+	fband function; /* a sávot feldolgozó függvény */
+	void* context; /* a művelet közös állapota */
+	size_t count; /* az elemek száma */
+	size_t band_size; /* egy sáv elemeinek száma */
+};
+
+/**
+ * Beállítja a képműveleteket végrehajtó munkáskészletet. A műveletek a
+ * kép (soraiból, oszlopaiból vagy csempéiből álló) vízszintes sávjait a
+ * készlet szálain dolgozzák fel, az eredmény bájtra megegyezik az egy
+ * szálon kapottal. A készlet megszüntetése előtt NULL-lal kell hívni.
+ *
+ * @param pool A munkáskészlet, vagy NULL az egyszálú végrehajtáshoz.
+ */
+void image_set_thread_pool(ThreadPool* pool)
+{
+	image_thread_pool = pool;
+}
+
+/**
+ * Megadja, hány munkás dolgozik a képműveleteken, vagyis hány munkásonkénti
+ * puffert kell egy műveletnek előre lefoglalnia.
+ *
+ * @return Visszatér a munkások számával (legalább 1-gyel).
+ */
+static int image_get_worker_count(void)
+{
+	return (image_thread_pool != NULL) ? threadpool_get_thread_count(image_thread_pool) : 1;
+}
+
+/**
+ * Feldolgoz egy sávot (egy sávokra bontott művelet részfeladata).
+ *
+ * @param argument A részfeladatok közös állapota.
+ * @param task A sáv indexe.
+ * @param worker A munkás indexe.
+ */
+static void image_band_task(void* argument, size_t task, int worker)
+{
+	const struct image_band_struct* band = (const struct image_band_struct*)argument;
+
+	size_t first = task * band->band_size;
+	size_t last = (band->count - first < band->band_size) ? band->count : first + band->band_size;
+	band->function(band->context, first, last, worker);
+}
+
+/**
+ * Végrehajt egy műveletet count elemen, a munkáskészlet szálai között
+ * sávokra osztva. A munkások a szomszédos sávok egy-egy összefüggő
+ * tartományával indulnak, és a saját sávjaik elfogyta után a lassabbak
+ * hátralévő sávjaiból lopnak, így az egyenetlen költségű sávok sem
+ * hagynak tétlen szálat. A sávok legalább IMAGE_BAND_MIN_SIZE bájtnyi
+ * elemből állnak, így a kis képek (és a munkáskészlet hiánya esetén minden
+ * kép) egyetlen sávban, a hívó szálon kerülnek feldolgozásra.
+ *
+ * A sávok a debugmalloc-on keresztül nem foglalhatnak memóriát, a
+ * munkásonkénti puffereket előre kell lefoglalni.
+ *
+ * @param function A sávot feldolgozó függvény.
+ * @param context A művelet közös állapota.
+ * @param count Az elemek száma.
+ * @param item_size Egy elem feldolgozott mérete (bájtban).
+ */
+void image_run_bands(fband function, void* context, size_t count, size_t item_size)
+{
+	if (count == 0)
+		return;
+
+	size_t worker_count = (size_t)image_get_worker_count();
+	size_t band_size = count / (worker_count * IMAGE_BANDS_PER_THREAD);
+	size_t minimum = IMAGE_BAND_MIN_SIZE / (item_size > 0 ? item_size : 1);
+	if (band_size < minimum)
+		band_size = minimum;
+	if (band_size == 0)
+		band_size = 1;
+
+	if (worker_count == 1 || band_size >= count)
+	{
+		function(context, 0, count, 0);
+		return;
+	}
+
+	struct image_band_struct band = { function, context, count, band_size };
+	threadpool_run(image_thread_pool, image_band_task, &band, (count + band_size - 1) / band_size);
+}
+
+/**
+ * Megadja, milyen elemekre bomlik egy kép a soronként vagy csempénként
+ * elvégezhető műveletek sávjaihoz: csempés elrendezésben a csempékre,
+ * egyébként a sorokra (síkos elrendezésben mindhárom sík soraira).
+ *
+ * @param image A kép.
+ * @param p_item_size Egy elem méretének (bájtban) helye.
+ * @return Visszatér az elemek számával.
+ */
+static size_t image_get_band_items(const Image* image, size_t* p_item_size)
+{
+	if (image->layout == IMAGE_LAYOUT_TILED)
+	{
+		*p_item_size = image->plane_size;
+		return image_tile_count(image);
+	}
+
+	*p_item_size = image_row_size(image) * image_plane_count(image);
+	return image->height;
+}
+
+/**
+ * Felszabadít egy dinamikusan foglalt absztrakt képet tároló struktúrát
+ * annak minden dinamikusan foglalt memóriaterületével együtt.
+ * 
+ * @param image A felszabadítandó kép sturktúrára mutató pointer.
+ */
+void image_destroy(Image* image)
+{
+	image_release_pixel_matrix(image);
+	free(image);
+}
+
+/**
+ * Megadja, hogy egy dimenzió skálázása megvalósítható-e egyértelműen, vagyis
+ * hogy a dimenziót a skálázási értékkel elosztva egész szám-e a hányados.
+ * 
+ * IMAGE_FLOAT_EXACT_LIMIT alatt float-tal számol (így a korábbi eredmények
+ * változatlanok), fölötte double-lel, mert ott a float már nem ábrázol
+ * minden egész számot.
+ * 
+ * @param dimension A dimenzió.
+ * @param scale A skálázási érték (skalár).
+ * @return Amennyiben a dimenzió skálázása egyértelmű, logikai igazzal,
+ * egyébként logikai hamissal tér vissza.
+ */
+static bool is_divisible(uint32_t dimension, float scale)
+{
+	double quotient = (dimension < IMAGE_FLOAT_EXACT_LIMIT) ? (float)(dimension / scale) : dimension / (double)scale;
+	if (!(quotient >= 0.0 && quotient <= UINT32_MAX))
+		return false;
+
+	uint32_t whole = (uint32_t)quotient;
+	double original = (dimension < IMAGE_FLOAT_EXACT_LIMIT) ? (float)(whole * scale) : whole * (double)scale;
+	return original >= 0.0 && original <= UINT32_MAX && (uint32_t)original == dimension;
+}
+
+/**
+ * Kiszámolja egy dimenzió skálázás utáni értékét.
+ *
+ * @param[in] dimension A dimenzió.
+ * @param[in] scale A skálázási érték (skalár).
+ * @param[out] p_scaled A skálázott dimenzió helye.
+ * @return Logikai igazzal tér vissza, ha a skálázott dimenzió ábrázolható.
+ */
+static bool image_scale_dimension(uint32_t dimension, float scale, uint32_t* p_scaled)
+{
+	double scaled = (dimension < IMAGE_FLOAT_EXACT_LIMIT) ? (float)(dimension * scale) : dimension * (double)scale;
+	if (!(scaled >= 0.0 && scaled <= UINT32_MAX))
+		return false;
+	*p_scaled = (uint32_t)scaled;
+	return true;
+}
+
+/**
+ * Kiszámolja egy kép skálázás utáni méretét a skálázás lépései szerint:
+ * minden lépés az előző lépés eredményére vonatkozik.
+ *
+ * @param[in] width A kép szélessége.
+ * @param[in] height A kép magassága.
+ * @param[in] scale A skálázás lépései.
+ * @param[out] p_new_width A skálázott szélesség helye.
+ * @param[out] p_new_height A skálázott magasság helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, ha pedig valamelyik lépés
+ * nem egyértelmű vagy 32 biten nem ábrázolható méretet ad,
+ * IMAGE_BAD_PARAMETER-rel tér vissza.
+ */
+int image_scaled_size(uint32_t width, uint32_t height, const ImageScale* scale, uint32_t* p_new_width, uint32_t* p_new_height)
+{
+	for (int i = 0; i < scale->count; i++)
+	{
+		float horizontal = scale->horizontal[i], vertical = scale->vertical[i];
+
+		if (!(is_divisible(width, horizontal) && is_divisible(height, vertical)))
+			return IMAGE_BAD_PARAMETER;
+
+		if (!(image_scale_dimension(width, horizontal, &width) && image_scale_dimension(height, vertical, &height)))
+			return IMAGE_BAD_PARAMETER;
+	}
+
+	*p_new_width = width;
+	*p_new_height = height;
+
+	return NO_ERROR;
+}
+
+/**
+ * Megadja egy skálázott kép adott sorához vagy oszlopához tartozó eredeti
+ * sort vagy oszlopot (legközelebbi szomszéd szerinti mintavételezés). Több
+ * lépés esetén a lépések leképezései visszafelé, az utolsó lépéstől az
+ * elsőig követik egymást, így az eredmény ugyanaz, mintha a lépések
+ * egyenként, külön menetben futnának.
+ * IMAGE_FLOAT_EXACT_LIMIT fölötti koordinátákra double-lel számol, hogy
+ * gigapixeles képeken se lépjen túl az eredeti kép határán.
+ *
+ * @param coordinate A skálázott kép sora vagy oszlopa.
+ * @param scales A lépések skálázási értékei (skalárok). Mindig pozitívak.
+ * @param count A lépések száma.
+ * @return Visszatér az eredeti kép megfelelő sorával vagy oszlopával.
+ */
+uint32_t image_scale_coordinate(uint32_t coordinate, const float* scales, int count)
+{
+	for (int i = count - 1; i >= 0; i--)
+	{
+		if (coordinate < IMAGE_FLOAT_EXACT_LIMIT)
+			coordinate = (uint32_t)(coordinate / scales[i]);
+		else
+			coordinate = (uint32_t)(coordinate / (double)scales[i]);
+	}
+	return coordinate;
+}
+
+/**
+ * Vízszintesen skáláz egy pixelsort legközelebbi szomszéd szerinti
+ * mintavételezéssel.
+ *
+ * @param dst A new_width hosszú cél pixelsor.
+ * @param src A forrás pixelsor.
+ * @param new_width A cél pixelsor hossza.
+ * @param scale A skálázás lépései.
+ */
+void image_scale_row(Pixel* dst, const Pixel* src, uint32_t new_width, const ImageScale* scale)
+{
+	for (uint32_t x_new = 0; x_new < new_width; x_new++)
+	{
+		uint32_t x_old = image_scale_coordinate(x_new, scale->horizontal, scale->count);
+		dst[x_new] = src[x_old];
+	}
+}
+
+/**
+ * Vízszintesen skáláz egy komponenssík egy sorát legközelebbi szomszéd
+ * szerinti mintavételezéssel.
+ *
+ * @param dst A new_width hosszú cél sor.
+ * @param src A forrás sor.
+ * @param new_width A cél sor hossza.
+ * @param scale A skálázás lépései.
+ */
+static void plane_scale_row(uint8_t* dst, const uint8_t* src, uint32_t new_width, const ImageScale* scale)
+{
+	for (uint32_t x_new = 0; x_new < new_width; x_new++)
+	{
+		uint32_t x_old = image_scale_coordinate(x_new, scale->horizontal, scale->count);
+		dst[x_new] = src[x_old];
+	}
+}
+
+/* a skálázás sávjainak közös állapota */
+struct image_scale_band_struct
+{
+	Image* dst; /* az új pixelmátrix */
+	const Image* src; /* a forráskép */
+	const ImageScale* scale; /* a skálázás lépései */
+};
+
+/**
+ * Kitölti az új pixelmátrix egy sávjának sorait a forráskép skálázott
+ * soraiból (az image_scale egy sávja).
+ *
+ * @param argument A skálázás közös állapota.
+ * @param first A sáv első sora.
+ * @param last A sáv utolsó utáni sora.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_scale_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct image_scale_band_struct* band = (const struct image_scale_band_struct*)argument;
+	const ImageScale* scale = band->scale;
+
+	for (size_t y = first; y < last; y++)
+	{
+		uint32_t y_new = (uint32_t)y;
+		uint32_t y_old = image_scale_coordinate(y_new, scale->vertical, scale->count);
+		if (band->src->layout == IMAGE_LAYOUT_PLANAR)
+		{
+			for (int c = 0; c < 3; c++)
+				plane_scale_row(image_plane_row(band->dst, c, y_new), image_plane_row(band->src, c, y_old), band->dst->width, scale);
+		}
+		else
+			image_scale_row(image_row(band->dst, y_new), image_row(band->src, y_old), band->dst->width, scale);
+	}
+}
+
+/**
+ * Fel- vagy leskáláz egy képet megadott függőleges és vízszintes
+ * paraméterek szerint.
+ * 
+ * Az adott tengely szerint skálázás egynél nagyobb értékeknél a kép
+ * nagyítását, egynél kisebb értékekre pedig a kép kicsinyítését idézi elő.
+ * Több lépés esetén a kép egyetlen menetben, egyetlen új pixelmátrixba
+ * kerül, az eredmény azonban megegyezik a lépések egyenkénti elvégzésével.
+ * 
+ * A függvény újrafoglalhat dinamikusan memóriaterületet, ilyenkor a korábbi
+ * területeket felszabadítja, viszont az újonnan foglaltak felszabadítása
+ * továbbra is a hívó feladata marad.
+ * 
+ * @param image A feldolgozandó kép.
+ * @param scale A skálázás lépései.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, hibás paraméter esetén
+ * IMAGE_BAD_PARAMETER-rel, memóriafoglalási hiba esetén pedig MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int image_scale(Image* image, const ImageScale* scale)
+{
+	int status;
+
+	uint32_t new_width, new_height;
+
+	if ((status = image_scaled_size(image->width, image->height, scale, &new_width, &new_height)) != NO_ERROR)
+		return status;
+
+	if (image->layout == IMAGE_LAYOUT_TILED)
+	{
+		/* a skálázás soronként halad, a csempés elrendezés nem gyorsítaná */
+		if ((status = image_set_layout(image, IMAGE_LAYOUT_INTERLEAVED)) != NO_ERROR ||
+			(status = image_scale(image, scale)) != NO_ERROR)
+			return status;
+		return image_set_layout(image, IMAGE_LAYOUT_TILED);
+	}
+
+	Image matrix;
+	if ((status = image_create_pixel_matrix(&matrix, new_width, new_height, image->layout)) != NO_ERROR)
+		return status;
+
+	struct image_scale_band_struct band = { &matrix, image, scale };
+	image_run_bands(image_scale_band, &band, new_height, image_row_size(&matrix) * image_plane_count(&matrix));
+
+	image_replace_pixel_matrix(image, &matrix);
+
+	return NO_ERROR;
+}
+
+/**
+ * Megcseréli két pixel értékét.
+ * 
+ * @param p_pixel1 Az egyik pixelre mutató pointer.
+ * @param p_pixel2 A másik pixelre mutató pointer.
+ */
+static void swap_pixels(Pixel* p_pixel1, Pixel* p_pixel2)
+{
+	Pixel temp = *p_pixel1;
+	*p_pixel1 = *p_pixel2;
+	*p_pixel2 = temp;
+}
+
+/* a tükrözés sávjainak közös állapota */
+struct image_mirror_band_struct
+{
+	Image* dst; /* a tükrözött kép (csempés elrendezésben az új pixelmátrix) */
+	const Image* src; /* a forráskép (helyben tükrözéskor maga a kép) */
+	bool horizontal; /* az y tengelyre (a sorokon belül) kell-e tükrözni */
+};
+
+/**
+ * Kitölti az új pixelmátrix egy sávjának csempéit a forráskép tükrözött
+ * sordarabjaiból (az image_mirror_tiles egy sávja).
+ *
+ * @param argument A tükrözés közös állapota.
+ * @param first A sáv első csempéje.
+ * @param last A sáv utolsó utáni csempéje.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_mirror_tiles_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct image_mirror_band_struct* band = (const struct image_mirror_band_struct*)argument;
+	const Image* image = band->src;
+
+	ImageTile tile;
+	for (size_t i = first; i < last && image_get_tile(band->dst, i, &tile); i++)
+	{
+		for (uint32_t row = 0; row < tile.height; row++)
+		{
+			Pixel* dst = image_tile_row(&tile, row);
+
+			if (!band->horizontal)
+			{
+				image_copy_span(image, tile.x, image->height - 1 - (tile.y + row), tile.width, dst);
+				continue;
+			}
+
+			image_copy_span(image, image->width - tile.x - tile.width, tile.y + row, tile.width, dst);
+			for (uint32_t x = 0; x < tile.width / 2; x++)
+				swap_pixels(&dst[x], &dst[tile.width - 1 - x]);
+		}
+	}
+}
+
+/**
+ * Tükröz egy csempés elrendezésű képet az x vagy az y tengelyre egy új
+ * pixelmátrixba: az új mátrix csempéit egyenként, a forráskép tükrözött
+ * sordarabjaiból tölti ki, így egyszerre csak néhány csempe van használatban.
+ *
+ * @param image A feldolgozandó kép.
+ * @param horizontal Logikai igaz esetén az y tengelyre (a sorokon belül),
+ * egyébként az x tengelyre tükröz.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+static int image_mirror_tiles(Image* image, bool horizontal)
+{
+	int status;
+
+	Image matrix;
+	if ((status = image_create_pixel_matrix(&matrix, image->width, image->height, IMAGE_LAYOUT_TILED)) != NO_ERROR)
+		return status;
+
+	struct image_mirror_band_struct band = { &matrix, image, horizontal };
+	image_run_bands(image_mirror_tiles_band, &band, image_tile_count(&matrix), matrix.plane_size);
+
+	image_replace_pixel_matrix(image, &matrix);
+
+	return NO_ERROR;
+}
+
+/**
+ * Megcseréli egy kép sávjának (felső) sorait a tükörképükkel (az
+ * image_mirror_x egy sávja).
+ *
+ * @param argument A tükrözés közös állapota.
+ * @param first A sáv első sora.
+ * @param last A sáv utolsó utáni sora.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_mirror_x_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct image_mirror_band_struct* band = (const struct image_mirror_band_struct*)argument;
+	Image* image = band->dst;
+
+	size_t row_size = image_row_size(image);
+	uint8_t chunk[1024];
+
+	for (int c = 0; c < image_plane_count(image); c++)
+	{
+		for (size_t y = first; y < last; y++)
+		{
+			uint8_t* top = image_plane_row(image, c, (uint32_t)y);
+			uint8_t* bottom = image_plane_row(image, c, image->height - 1 - (uint32_t)y);
+
+			for (size_t offset = 0; offset < row_size; offset += sizeof(chunk))
+			{
+				size_t size = (row_size - offset < sizeof(chunk)) ? row_size - offset : sizeof(chunk);
+				memcpy(chunk, top + offset, size);
+				memcpy(top + offset, bottom + offset, size);
+				memcpy(bottom + offset, chunk, size);
+			}
+		}
+	}
+}
+
+/**
+ * Tükröz egy képet az x tengelyre: a sorokat (síkonként) páronként,
+ * darabonként megcseréli, csempés elrendezésben pedig csempénként
+ * rendezi át.
+ * 
+ * @param image A feldolgozandó kép.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, csempés elrendezésben
+ * memóriafoglalási hiba esetén MEMORY_ERROR-ral tér vissza.
+ */
+int image_mirror_x(Image* image)
+{
+	if (image->layout == IMAGE_LAYOUT_TILED)
+		return image_mirror_tiles(image, false);
+
+	/* a sávok a felső sorokat tartalmazzák, mindegyik a saját párjaival cserél */
+	struct image_mirror_band_struct band = { image, image, false };
+	image_run_bands(image_mirror_x_band, &band, image->height / 2, 2 * image_row_size(image) * image_plane_count(image));
+
+	return NO_ERROR;
+}
+
+/**
+ * Megfordítja egy kép sávjának sorait (az image_mirror_y egy sávja).
+ *
+ * @param argument A tükrözés közös állapota.
+ * @param first A sáv első sora.
+ * @param last A sáv utolsó utáni sora.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_mirror_y_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct image_mirror_band_struct* band = (const struct image_mirror_band_struct*)argument;
+	Image* image = band->dst;
+
+	if (image->layout == IMAGE_LAYOUT_PLANAR)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			for (size_t y = first; y < last; y++)
+			{
+				uint8_t* row = image_plane_row(image, c, (uint32_t)y);
+				for (uint32_t x = 0; x < image->width / 2; x++)
+				{
+					uint8_t temp = row[x];
+					row[x] = row[image->width - 1 - x];
+					row[image->width - 1 - x] = temp;
+				}
+			}
+		}
+		return;
+	}
+
+	for (size_t y = first; y < last; y++)
+	{
+		Pixel* row = image_row(image, (uint32_t)y);
+		for (uint32_t x = 0; x < image->width / 2; x++)
+			swap_pixels(&row[x], &row[image->width - 1 - x]);
+	}
+}
+
+/**
+ * Tükröz egy képet az y tengelyre (csempés elrendezésben csempénként).
+ *
+ * @param image A feldolgozandó kép.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, csempés elrendezésben
+ * memóriafoglalási hiba esetén MEMORY_ERROR-ral tér vissza.
+ */
+int image_mirror_y(Image* image)
+{
+	if (image->layout == IMAGE_LAYOUT_TILED)
+		return image_mirror_tiles(image, true);
+
+	struct image_mirror_band_struct band = { image, image, true };
+	image_run_bands(image_mirror_y_band, &band, image->height, image_row_size(image) * image_plane_count(image));
+
+	return NO_ERROR;
+}
+
+/**
+ * Limitálja egy 32 bites előjeles egészként megadott színkomponens értékét,
+ * hogy az a 8 bites előjel nélküli számábrázolási tartományon belülre essen.
+ * 
+ * @param component A színkomponens.
+ * @return Visszatér a tartományra limitált komponenssel.
+ */
+static uint8_t limit_pixel_component(int component)
+{
+	return (component < 0) ? 0 : (component > 255) ? 255 : component;
+}
+
+#ifdef IMAGE_USE_AVX2
+/**
+ * Betölt 16 egymást követő bájtot, és egy 256 bites regiszter 16 bites
+ * sávjaira bővítve adja vissza.
+ *
+ * @param src A bájtok kezdőcíme.
+ * @return Visszatér a bővített bájtokkal.
+ */
+static __m256i bytes_load_widened_256(const uint8_t* src)
+{
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src));
+}
+
+/**
+ * Kiszámolja egy sor 16 szomszédos bájtjára a vízszintes 1-2-1 súlyozott
+ * összeget egy 256 bites regiszter 16 bites sávjaiban.
+ *
+ * @param src A 16 bájt közül az első címe.
+ * @param step A vízszintesen szomszédos képpontok azonos komponensei
+ * közötti távolság (bájtban).
+ * @return Visszatér az összegekkel.
+ */
+static __m256i bytes_horizontal_121_256(const uint8_t* src, size_t step)
+{
+	__m256i sides = _mm256_add_epi16(bytes_load_widened_256(src - step), bytes_load_widened_256(src + step));
+	return _mm256_add_epi16(sides, _mm256_slli_epi16(bytes_load_widened_256(src), 1));
+}
+
+/**
+ * Telítéssel visszaalakítja egy 256 bites regiszter 16 darab 16 bites
+ * előjeles sávját bájtokká.
+ *
+ * @param value A sávok.
+ * @return Visszatér a 16 bájttal.
+ */
+static __m128i bytes_pack_256(__m256i value)
+{
+	return _mm_packus_epi16(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+}
+#elif defined(IMAGE_USE_SSE2)
+/**
+ * Betölt 16 egymást követő bájtot, és 16 bites sávokra bővítve adja vissza.
+ *
+ * @param src A bájtok kezdőcíme.
+ * @param p_low Az első 8 bájt helye.
+ * @param p_high Az utolsó 8 bájt helye.
+ */
+static void bytes_load_widened(const uint8_t* src, __m128i* p_low, __m128i* p_high)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i bytes = _mm_loadu_si128((const __m128i*)src);
+	*p_low = _mm_unpacklo_epi8(bytes, zero);
+	*p_high = _mm_unpackhi_epi8(bytes, zero);
+}
+
+/**
+ * Kiszámolja egy sor 16 szomszédos bájtjára a vízszintes 1-2-1 súlyozott
+ * összeget 16 bites sávokban.
+ *
+ * @param src A 16 bájt közül az első címe.
+ * @param step A vízszintesen szomszédos képpontok azonos komponensei
+ * közötti távolság (bájtban).
+ * @param p_low Az első 8 összeg helye.
+ * @param p_high Az utolsó 8 összeg helye.
+ */
+static void bytes_horizontal_121(const uint8_t* src, size_t step, __m128i* p_low, __m128i* p_high)
+{
+	__m128i left_low, left_high, center_low, center_high, right_low, right_high;
+	bytes_load_widened(src - step, &left_low, &left_high);
+	bytes_load_widened(src, &center_low, &center_high);
+	bytes_load_widened(src + step, &right_low, &right_high);
+	*p_low = _mm_add_epi16(_mm_add_epi16(left_low, right_low), _mm_slli_epi16(center_low, 1));
+	*p_high = _mm_add_epi16(_mm_add_epi16(left_high, right_high), _mm_slli_epi16(center_high, 1));
+}
+#endif
+
+/**
+ * Elhomályosít vagy élesít egy bájtokként kezelt sort a szomszédos soraival
+ * együtt, az első és az utolsó képpont kivételével: a célba csak a belső
+ * képpontok kerülnek, a dst tehát a forrás második képpontjának felel meg. A sor step bájtonként ismétlődő komponensekből áll
+ * (komponenssík esetén 1, Pixel-ekből álló sor esetén 3), a konvolúció az
+ * azonos komponensek között történik. Elhomályosításnál a súlyok 1-2-1 /
+ * 2-4-2 / 1-2-1 (osztva 16-tal), élesítésnél a középső 5, a négy szomszéd
+ * -1, a tartományon kívüli értékek 0-ra, illetve 255-re telítődnek. Mindkét
+ * súlyozás egész, így AVX2, illetve SSE2 támogatás esetén 16 bájtonként,
+ * 16 bites fixpontos aritmetikával, egy regiszterben, illetve két
+ * regiszterfélben számol.
+ *
+ * @param dst A cél sor.
+ * @param above A forrás sor feletti sor.
+ * @param row A forrás sor.
+ * @param below A forrás sor alatti sor.
+ * @param size A forrás sorok hossza (bájtban, legalább 3 * step).
+ * @param step A képpontok mérete (bájtban).
+ * @param sharpen Logikai igaz esetén élesít, egyébként elhomályosít.
+ */
+static void bytes_blur_interior(uint8_t* dst, const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t size, size_t step, bool sharpen)
+{
+	size_t x = step;
+
+#if defined(IMAGE_USE_AVX2)
+	/* a 16 bájt jobb oldali szomszédjai is a soron belül vannak */
+	for (; x + 16 + step <= size; x += 16)
+	{
+		__m256i value;
+
+		if (sharpen)
+		{
+			/* 5 * középső - a négy szomszéd (-1020 és 1275 között, 16 biten elfér) */
+			__m256i center = bytes_load_widened_256(row + x);
+			__m256i horizontal = _mm256_add_epi16(bytes_load_widened_256(row + x - step), bytes_load_widened_256(row + x + step));
+			__m256i vertical = _mm256_add_epi16(bytes_load_widened_256(above + x), bytes_load_widened_256(below + x));
+			value = _mm256_add_epi16(_mm256_slli_epi16(center, 2), center);
+			value = _mm256_sub_epi16(value, _mm256_add_epi16(horizontal, vertical));
+		}
+		else
+		{
+			/* (felső + 2 * középső + alsó) / 16 */
+			__m256i up = bytes_horizontal_121_256(above + x, step);
+			__m256i center = bytes_horizontal_121_256(row + x, step);
+			__m256i down = bytes_horizontal_121_256(below + x, step);
+			value = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(up, down), _mm256_slli_epi16(center, 1)), 4);
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + x - step), bytes_pack_256(value));
+	}
+#elif defined(IMAGE_USE_SSE2)
+	/* a 16 bájt jobb oldali szomszédjai is a soron belül vannak */
+	for (; x + 16 + step <= size; x += 16)
+	{
+		__m128i low, high;
+
+		if (sharpen)
+		{
+			__m128i left_low, left_high, right_low, right_high, up_low, up_high, down_low, down_high;
+			bytes_load_widened(row + x, &low, &high);
+			bytes_load_widened(row + x - step, &left_low, &left_high);
+			bytes_load_widened(row + x + step, &right_low, &right_high);
+			bytes_load_widened(above + x, &up_low, &up_high);
+			bytes_load_widened(below + x, &down_low, &down_high);
+
+			/* 5 * középső - a négy szomszéd, a telítést a pakolás végzi */
+			low = _mm_add_epi16(_mm_slli_epi16(low, 2), low);
+			high = _mm_add_epi16(_mm_slli_epi16(high, 2), high);
+			low = _mm_sub_epi16(low, _mm_add_epi16(_mm_add_epi16(left_low, right_low), _mm_add_epi16(up_low, down_low)));
+			high = _mm_sub_epi16(high, _mm_add_epi16(_mm_add_epi16(left_high, right_high), _mm_add_epi16(up_high, down_high)));
+		}
+		else
+		{
+			__m128i up_low, up_high, center_low, center_high, down_low, down_high;
+			bytes_horizontal_121(above + x, step, &up_low, &up_high);
+			bytes_horizontal_121(row + x, step, &center_low, &center_high);
+			bytes_horizontal_121(below + x, step, &down_low, &down_high);
+
+			/* (felső + 2 * középső + alsó) / 16 */
+			low = _mm_add_epi16(_mm_add_epi16(up_low, down_low), _mm_slli_epi16(center_low, 1));
+			high = _mm_add_epi16(_mm_add_epi16(up_high, down_high), _mm_slli_epi16(center_high, 1));
+			low = _mm_srli_epi16(low, 4);
+			high = _mm_srli_epi16(high, 4);
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + x - step), _mm_packus_epi16(low, high));
+	}
+#endif
+
+	for (; x + step < size; x++)
+	{
+		int value;
+		if (sharpen)
+			value = 5 * row[x] - row[x - step] - row[x + step] - above[x] - below[x];
+		else
+			value = (above[x - step] + 2 * above[x] + above[x + step] +
+				2 * (row[x - step] + 2 * row[x] + row[x + step]) +
+				below[x - step] + 2 * below[x] + below[x + step]) >> 4;
+		dst[x - step] = limit_pixel_component(value);
+	}
+}
+
+/**
+ * Elhomályosít vagy élesít egy bájtokként kezelt sort a szomszédos soraival
+ * együtt (lásd bytes_blur_interior).
+ *
+ * A sor első és utolsó képpontja (valamint a háromnál keskenyebb sorok)
+ * változatlanul kerülnek át a célsorba.
+ *
+ * @param dst A cél sor.
+ * @param above A forrás sor feletti sor.
+ * @param row A forrás sor.
+ * @param below A forrás sor alatti sor.
+ * @param size A sorok hossza (bájtban).
+ * @param step A képpontok mérete (bájtban).
+ * @param sharpen Logikai igaz esetén élesít, egyébként elhomályosít.
+ */
+static void bytes_blur_row(uint8_t* dst, const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t size, size_t step, bool sharpen)
+{
+	if (size < 3 * step)
+	{
+		memcpy(dst, row, size);
+		return;
+	}
+
+	bytes_blur_interior(dst + step, above, row, below, size, step, sharpen);
+
+	memcpy(dst, row, step);
+	memcpy(dst + size - step, row + size - step, step);
+}
+
+/**
+ * Elhomályosít vagy élesít egy pixelsort a szomszédos soraival együtt,
+ * vagyis elvégzi az image_blur egy lépését egy soron.
+ *
+ * A sor első és utolsó pixele (valamint a háromnál keskenyebb sorok)
+ * változatlanul kerülnek át a célsorba.
+ *
+ * @param dst A cél pixelsor.
+ * @param above A forrás pixelsor feletti sor.
+ * @param row A forrás pixelsor.
+ * @param below A forrás pixelsor alatti sor.
+ * @param width A pixelsorok szélessége.
+ * @param sharpen Logikai igaz esetén élesít, egyébként elhomályosít.
+ */
+void image_blur_row(Pixel* dst, const Pixel* above, const Pixel* row, const Pixel* below, uint32_t width, bool sharpen)
+{
+	bytes_blur_row((uint8_t*)dst, (const uint8_t*)above, (const uint8_t*)row, (const uint8_t*)below, (size_t)width * sizeof(Pixel), sizeof(Pixel), sharpen);
+}
+
+/**
+ * Elvégzi egy keresőtábla leképezését egy pixelsoron. A cél és a forrás
+ * sor meg is egyezhet.
+ *
+ * @param dst A cél pixelsor.
+ * @param src A forrás pixelsor.
+ * @param width A pixelsorok szélessége.
+ * @param lut A keresőtábla.
+ */
+void image_lut_row(Pixel* dst, const Pixel* src, uint32_t width, const ImageLut* lut)
+{
+	const uint8_t* blue = lut->table[0];
+	const uint8_t* green = lut->table[1];
+	const uint8_t* red = lut->table[2];
+
+	for (uint32_t x = 0; x < width; x++)
+	{
+		Pixel pixel = src[x];
+		dst[x].blue = blue[pixel.blue];
+		dst[x].green = green[pixel.green];
+		dst[x].red = red[pixel.red];
+	}
+}
+
+/**
+ * Elvégzi egy komponenssík sorának leképezését helyben.
+ *
+ * @param row A sor.
+ * @param width A sor szélessége.
+ * @param table A komponens 256 elemű leképezése.
+ */
+static void bytes_apply_lut(uint8_t* row, uint32_t width, const uint8_t* table)
+{
+	for (uint32_t x = 0; x < width; x++)
+		row[x] = table[row[x]];
+}
+
+/**
+ * Elvégzi egy keresőtábla leképezését egy sor (síkos elrendezésben egy
+ * komponenssík sorának) [x, x + count) oszlopain helyben.
+ *
+ * @param image A kép (nem csempés elrendezésű).
+ * @param c A komponenssík indexe (Pixel-ekből álló soroknál 0).
+ * @param y A sor indexe.
+ * @param x Az első oszlop.
+ * @param count Az oszlopok száma.
+ * @param output A keresőtábla, vagy NULL.
+ */
+static void image_lut_plane_span(const Image* image, int c, uint32_t y, uint32_t x, uint32_t count, const ImageLut* output)
+{
+	if (output == NULL)
+		return;
+
+	if (image->layout == IMAGE_LAYOUT_PLANAR)
+		bytes_apply_lut(image_plane_row(image, c, y) + x, count, output->table[c]);
+	else
+		image_lut_row(image_row(image, y) + x, image_row(image, y) + x, count, output);
+}
+
+/**
+ * Elvégzi egy művelet kimenetére ráolvasztott keresőtábla leképezését egy
+ * éppen kiszámolt soron (síkos elrendezésben egy komponenssík során), amíg
+ * az a gyorsítótárban van, így a pontműveletek nem igényelnek külön menetet.
+ *
+ * @param image A kép (nem csempés elrendezésű).
+ * @param c A komponenssík indexe (Pixel-ekből álló soroknál 0).
+ * @param y A sor indexe.
+ * @param output A keresőtábla, vagy NULL.
+ */
+static void image_lut_plane_row(const Image* image, int c, uint32_t y, const ImageLut* output)
+{
+	image_lut_plane_span(image, c, y, 0, image->width, output);
+}
+
+/**
+ * Elhomályosít vagy élesít egy csempés elrendezésű pixelmátrix egy csempéjét.
+ * A forrás csempét és a körülötte lévő egy pixel széles keretet egy, a
+ * gyorsítótárban maradó munkaterületre másolja (a kép szélein a szélső
+ * pixeleket ismételve), ebből számolja ki közvetlenül a cél csempe sorait,
+ * a kép szélső soraiba és oszlopaiba pedig a forrás pixeleit másolja vissza.
+ *
+ * @param dst A cél pixelmátrix.
+ * @param src A forrás pixelmátrix (azonos méretű és elrendezésű).
+ * @param index A csempe indexe.
+ * @param sharpen Logikai igaz esetén élesít, egyébként elhomályosít.
+ * @param output A kimenetre alkalmazandó keresőtábla, vagy NULL.
+ */
+static void tile_apply_blur(Image* dst, const Image* src, size_t index, bool sharpen, const ImageLut* output)
+{
+	Pixel window[IMAGE_TILE_SIZE + 2][IMAGE_TILE_SIZE + 2];
+
+	ImageTile tile;
+	image_get_tile(dst, index, &tile);
+
+	bool left_edge = (tile.x == 0);
+	bool right_edge = (tile.x + tile.width == src->width);
+
+	/* a munkaterület első sora és oszlopa a csempe előtti sor és oszlop */
+	for (uint32_t row = 0; row < tile.height + 2; row++)
+	{
+		uint32_t y = tile.y + row;
+		y = (y == 0) ? 0 : (y - 1 >= src->height) ? src->height - 1 : y - 1;
+
+		Pixel* line = window[row];
+		memcpy(&line[1], image_tiled_pixel(src, tile.x, y), (size_t)tile.width * sizeof(Pixel));
+		line[0] = left_edge ? line[1] : *image_tiled_pixel(src, tile.x - 1, y);
+		line[tile.width + 1] = right_edge ? line[tile.width] : *image_tiled_pixel(src, tile.x + tile.width, y);
+	}
+
+	for (uint32_t row = 0; row < tile.height; row++)
+	{
+		Pixel* pixels = image_tile_row(&tile, row);
+		uint32_t y = tile.y + row;
+
+		if (y == 0 || y == src->height - 1)
+			memcpy(pixels, &window[row + 1][1], (size_t)tile.width * sizeof(Pixel));
+		else
+		{
+			/* a munkaterület sorának belseje éppen a csempe sora */
+			bytes_blur_interior((uint8_t*)pixels, (const uint8_t*)window[row], (const uint8_t*)window[row + 1], (const uint8_t*)window[row + 2],
+				(size_t)(tile.width + 2) * sizeof(Pixel), sizeof(Pixel), sharpen);
+
+			if (left_edge)
+				pixels[0] = window[row + 1][1];
+			if (right_edge)
+				pixels[tile.width - 1] = window[row + 1][tile.width];
+		}
+
+		if (output != NULL)
+			image_lut_row(pixels, pixels, tile.width, output);
+	}
+}
+
+/* egy elhomályosító (élesítő) menet sávjainak közös állapota */
+struct image_blur_band_struct
+{
+	Image* dst; /* a cél pixelmátrix */
+	const Image* src; /* a forrás pixelmátrix */
+	bool sharpen; /* élesíteni kell-e */
+	const ImageLut* output; /* a kimenetre alkalmazandó keresőtábla, vagy NULL */
+};
+
+/**
+ * Elhomályosítja vagy élesíti egy pixelmátrix sávjának sorait vagy
+ * csempéit (a pixel_apply_blur egy sávja). A sáv határain túli (halo) sorok
+ * a változatlan forrásmátrixból olvashatók, így a sávok függetlenek.
+ *
+ * @param argument A menet közös állapota.
+ * @param first A sáv első sora (csempés elrendezésben csempéje).
+ * @param last A sáv utolsó utáni sora (csempéje).
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_blur_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct image_blur_band_struct* band = (const struct image_blur_band_struct*)argument;
+	Image* dst = band->dst;
+	const Image* src = band->src;
+
+	if (src->layout == IMAGE_LAYOUT_TILED)
+	{
+		for (size_t i = first; i < last; i++)
+			tile_apply_blur(dst, src, i, band->sharpen, band->output);
+		return;
+	}
+
+	uint32_t width = src->width;
+	uint32_t height = src->height;
+
+	for (int c = 0; c < image_plane_count(src); c++)
+	{
+		for (uint32_t y = (uint32_t)first; y < (uint32_t)last; y++)
+		{
+			if (y == 0 || y == height - 1)
+				memcpy(image_plane_row(dst, c, y), image_plane_row(src, c, y), image_row_size(src));
+			else if (src->layout == IMAGE_LAYOUT_PLANAR)
+				bytes_blur_row(image_plane_row(dst, c, y), image_plane_row(src, c, y - 1), image_plane_row(src, c, y), image_plane_row(src, c, y + 1), width, 1, band->sharpen);
+			else
+				image_blur_row(image_row(dst, y), image_row(src, y - 1), image_row(src, y), image_row(src, y + 1), width, band->sharpen);
+			image_lut_plane_row(dst, c, y, band->output);
+		}
+	}
+}
+
+/**
+ * Elhomályosít vagy élesít egy pixelmátrixot (síkos elrendezésben
+ * komponenssíkonként, csempés elrendezésben csempénként), vízszintes
+ * sávokra bontva.
+ * 
+ * @param dst A cél pixelmátrix.
+ * @param src A forrás pixelmátrix (azonos méretű és elrendezésű).
+ * @param sharpen Logikai igaz esetén élesít, egyébként elhomályosít.
+ * @param output A kimenetre alkalmazandó keresőtábla, vagy NULL.
+ */
+static void pixel_apply_blur(Image* dst, const Image* src, bool sharpen, const ImageLut* output)
+{
+	struct image_blur_band_struct band = { dst, src, sharpen, output };
+
+	size_t item_size;
+	size_t count = image_get_band_items(src, &item_size);
+	image_run_bands(image_blur_band, &band, count, item_size);
+}
+
+/**
+ * Elhomályosít vagy élesít egy képet megadott intenzitással.
+ * 
+ * @param image A feldolgozandó kép.
+ * @param value Az művelet intenzitása. A művelet pozitív értékek esetén
+ * elhomályosítás, negatív értékek esetén élesítés.
+ * @param output Az utolsó menet kimenetére alkalmazandó keresőtábla
+ * (ráolvasztott pontműveletek), vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, hibás paraméterezés esetén
+ * IMAGE_BAD_PARAMETER-rel, memóriafoglalási hiba esetén pedig
+ * MEMORY_ERROR-ral tér vissza.
+ */
+int image_blur(Image* image, int value, const ImageLut* output)
+{
+	int status;
+
+	if (value == 0)
+		return IMAGE_BAD_PARAMETER;
+
+	Image src = *image;
+	Image dst;
+
+	if ((status = image_create_pixel_matrix(&dst, image->width, image->height, image->layout)) != NO_ERROR)
+		return status;
+
+	bool sharpen = false;
+	if (value < 0)
+	{
+		sharpen = true;
+		value *= -1;
+	}
+
+	for (;;)
+	{
+		pixel_apply_blur(&dst, &src, sharpen, (value == 1) ? output : NULL);
+		value -= 1;
+		if (value == 0)
+			break;
+
+		Image tmp = dst;
+		dst = src;
+		src = tmp;
+	}
+
+	if (dst.data == image->data)
+	{
+		/* az eredmény az eredeti pixelmátrixba került, a segédmátrix felszabadítható */
+		image_pool_release(src.allocation, src.allocation_size);
+	}
+	else
+		image_replace_pixel_matrix(image, &dst);
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief Egy kiterjesztett dobozszűrő: a 2 * radius + 1 belső képpont azonos,
+ * a két szomszédos külső képpont kisebb súllyal számít, így a szűrő szórása
+ * folytonosan állítható. A súlyok 2^23-nal szorzott fixpontos értékek.
+ */
+struct box_filter_struct
+{
+	uint32_t radius; /* a belső képpontok sugara */
+	uint32_t inner; /* egy belső képpont súlya */
+	uint32_t outer; /* egy külső képpont súlya */
+};
+
+/**
+ * Kiszámolja azt a kiterjesztett dobozszűrőt, melyet háromszor egymás után
+ * alkalmazva a szórása sigma (Gwosdek és mtsai. módszere): a belső sugár a
+ * legnagyobb, amellyel a doboz szórása még nem haladja meg a kívántat, a
+ * maradékot a külső képpontok súlya pótolja.
+ *
+ * @param sigma A Gauss-elmosás szórása (pixelben).
+ * @param p_box A dobozszűrő helye.
+ */
+static void image_gaussian_box(float sigma, struct box_filter_struct* p_box)
+{
+	/* egy menet varianciája */
+	double variance = (double)sigma * sigma / 3.0;
+
+	uint32_t radius = 0;
+	while ((2.0 * radius + 3.0) * (2.0 * radius + 3.0) <= 12.0 * variance + 1.0)
+		radius++;
+
+	double alpha = (2.0 * radius + 1.0) * (radius * (radius + 1.0) - 3.0 * variance) / (6.0 * (variance - (radius + 1.0) * (radius + 1.0)));
+	double scale = (double)(1u << 23) / (2.0 * radius + 1.0 + 2.0 * alpha);
+
+	/* a súlyok összege pontosan 2^23 legyen, hogy az egyszínű felületek ne változzanak */
+	int64_t inner = (int64_t)(scale + 0.5);
+	int64_t outer = ((int64_t)(1u << 23) - (2 * (int64_t)radius + 1) * inner) / 2;
+
+	p_box->radius = radius;
+	p_box->inner = (uint32_t)inner;
+	p_box->outer = (outer > 0) ? (uint32_t)outer : 0;
+}
+
+/**
+ * Kiszámolja egy kiterjesztett dobozszűrő kimenetét a belső képpontok és a
+ * két külső képpont összegéből. A súlyok összege 2^23, a belső összeg
+ * legfeljebb 255 * (2 * radius + 1), így a szorzatok összege 32 biten elfér.
+ *
+ * @param box A dobozszűrő.
+ * @param inner A belső képpontok összege.
+ * @param outer A két külső képpont összege.
+ * @return Visszatér a kerekített kimenettel.
+ */
+static uint8_t box_average(const struct box_filter_struct* box, uint32_t inner, uint32_t outer)
+{
+	return (uint8_t)((inner * box->inner + outer * box->outer + (1u << 22)) >> 23);
+}
+
+/**
+ * Kiterjesztett dobozszűrőt alkalmaz egy bájtokként kezelt sorra futó
+ * összeggel, így a költség független a sugártól. A sor step bájtonként
+ * ismétlődő komponensekből áll, a szűrés az azonos komponensek között
+ * történik; a soron kívül eső képpontok helyére a szélső képpontok kerülnek.
+ *
+ * @param dst A cél sor (nem egyezhet meg a forrással).
+ * @param src A forrás sor.
+ * @param count A sor képpontjainak száma (legalább 1).
+ * @param step A képpontok mérete (bájtban).
+ * @param box A dobozszűrő.
+ */
+static void bytes_box_blur(uint8_t* dst, const uint8_t* src, size_t count, size_t step, const struct box_filter_struct* box)
+{
+	size_t radius = box->radius;
+	size_t last = count - 1;
+
+	for (size_t c = 0; c < step; c++)
+	{
+		/* a kezdő ablak: a bal szélen radius + 1 példány, a jobb szélen túl a szélső képpont */
+		uint32_t sum = (uint32_t)(radius + 1) * src[c];
+		size_t inside = (radius < last) ? radius : last;
+		for (size_t i = 1; i <= inside; i++)
+			sum += src[i * step + c];
+		sum += (uint32_t)(radius - inside) * src[last * step + c];
+
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t incoming = (i + radius + 1 < last) ? i + radius + 1 : last;
+			size_t outgoing = (i > radius) ? i - radius : 0;
+			size_t left = (i > radius) ? i - radius - 1 : 0;
+			dst[i * step + c] = box_average(box, sum, (uint32_t)src[left * step + c] + src[incoming * step + c]);
+			sum += src[incoming * step + c];
+			sum -= src[outgoing * step + c];
+		}
+	}
+}
+
+/**
+ * Függőleges kiterjesztett dobozszűrőt alkalmaz egy pixelmátrix egy síkjának
+ * (síkos elrendezésben komponenssíkjának) [first, last) oszlopain. Az
+ * oszlopok futó összegei egy sornyi tömbben vannak, melyet soronként egy-egy
+ * sordarab hozzáadása és kivonása léptet, így a mátrix soronként,
+ * folytonosan kerül bejárásra.
+ *
+ * @param dst A cél pixelmátrix (azonos méretű és elrendezésű).
+ * @param src A forrás pixelmátrix (legalább egy sorral).
+ * @param c A sík indexe.
+ * @param box A dobozszűrő.
+ * @param sums A futó összegek helye (image_row_size elemű, a sor bájtjaival
+ * indexelve).
+ * @param first Az első (pixel)oszlop.
+ * @param last Az utolsó utáni (pixel)oszlop.
+ * @param output A kimenetre alkalmazandó keresőtábla, vagy NULL.
+ */
+static void plane_box_blur_columns(Image* dst, const Image* src, int c, const struct box_filter_struct* box, uint32_t* sums,
+	uint32_t first, uint32_t last, const ImageLut* output)
+{
+	uint32_t radius = box->radius;
+	size_t step = (src->layout == IMAGE_LAYOUT_PLANAR) ? 1 : sizeof(Pixel);
+	size_t begin = first * step;
+	size_t size = last * step;
+	uint32_t bottom = src->height - 1;
+
+	const uint8_t* first_row = image_plane_row(src, c, 0);
+	const uint8_t* last_row = image_plane_row(src, c, bottom);
+	uint32_t inside = (radius < bottom) ? radius : bottom;
+	for (size_t x = begin; x < size; x++)
+		sums[x] = (radius + 1) * first_row[x] + (radius - inside) * last_row[x];
+	for (uint32_t y = 1; y <= inside; y++)
+	{
+		const uint8_t* row = image_plane_row(src, c, y);
+		for (size_t x = begin; x < size; x++)
+			sums[x] += row[x];
+	}
+
+	for (uint32_t y = 0; y < src->height; y++)
+	{
+		const uint8_t* incoming = image_plane_row(src, c, (y + radius + 1 < bottom) ? y + radius + 1 : bottom);
+		const uint8_t* outgoing = image_plane_row(src, c, (y > radius) ? y - radius : 0);
+		const uint8_t* above = image_plane_row(src, c, (y > radius) ? y - radius - 1 : 0);
+
+		uint8_t* out = image_plane_row(dst, c, y);
+		for (size_t x = begin; x < size; x++)
+		{
+			out[x] = box_average(box, sums[x], (uint32_t)above[x] + incoming[x]);
+			sums[x] += (uint32_t)incoming[x] - outgoing[x];
+		}
+		image_lut_plane_span(dst, c, y, first, last - first, output);
+	}
+}
+
+/* a Gauss-elmosás menetei sávjainak közös állapota */
+struct image_gaussian_band_struct
+{
+	Image* image; /* a feldolgozandó kép */
+	Image* matrix; /* a függőleges menetek segédmátrixa */
+	const struct box_filter_struct* box; /* a dobozszűrő */
+	uint8_t* buffers; /* munkásonként két munkasor a vízszintes menetekhez */
+	uint32_t* sums; /* oszloponként a függőleges menetek futó összege */
+	const ImageLut* output; /* a kimenetre alkalmazandó keresőtábla, vagy NULL */
+};
+
+/**
+ * Elvégzi a vízszintes meneteket egy kép sávjának során, helyben, a munkás
+ * gyorsítótárban maradó munkasoraival (az image_gaussian_blur egy sávja).
+ *
+ * @param argument Az elmosás közös állapota.
+ * @param first A sáv első sora.
+ * @param last A sáv utolsó utáni sora.
+ * @param worker A munkás indexe.
+ */
+static void image_gaussian_rows_band(void* argument, size_t first, size_t last, int worker)
+{
+	const struct image_gaussian_band_struct* band = (const struct image_gaussian_band_struct*)argument;
+	Image* image = band->image;
+
+	size_t size = image_row_size(image);
+	size_t step = (image->layout == IMAGE_LAYOUT_PLANAR) ? 1 : sizeof(Pixel);
+	uint8_t* line = band->buffers + (size_t)worker * 2 * size;
+	uint8_t* other = line + size;
+
+	for (int c = 0; c < image_plane_count(image); c++)
+	{
+		for (size_t y = first; y < last; y++)
+		{
+			uint8_t* row = image_plane_row(image, c, (uint32_t)y);
+			bytes_box_blur(line, row, size / step, step, band->box);
+			bytes_box_blur(other, line, size / step, step, band->box);
+			bytes_box_blur(row, other, size / step, step, band->box);
+		}
+	}
+}
+
+/**
+ * Elvégzi a függőleges meneteket egy kép oszlopainak egy sávján, felváltva
+ * a két pixelmátrix között (az image_gaussian_blur egy sávja). Az oszlopok
+ * egymástól függetlenek, így a három menet sávonként egymás után futhat.
+ *
+ * @param argument Az elmosás közös állapota.
+ * @param first A sáv első oszlopa.
+ * @param last A sáv utolsó utáni oszlopa.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_gaussian_columns_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct image_gaussian_band_struct* band = (const struct image_gaussian_band_struct*)argument;
+
+	for (int c = 0; c < image_plane_count(band->image); c++)
+	{
+		plane_box_blur_columns(band->matrix, band->image, c, band->box, band->sums, (uint32_t)first, (uint32_t)last, NULL);
+		plane_box_blur_columns(band->image, band->matrix, c, band->box, band->sums, (uint32_t)first, (uint32_t)last, NULL);
+		plane_box_blur_columns(band->matrix, band->image, c, band->box, band->sums, (uint32_t)first, (uint32_t)last, band->output);
+	}
+}
+
+/**
+ * Gauss-elmosást alkalmaz egy képen megadott szórással. A Gauss-szűrőt
+ * három egymás utáni kiterjesztett dobozszűrő közelíti, melyek
+ * vízszintesen és függőlegesen is futó összegekkel dolgoznak, így a
+ * költség nem függ a szórástól: egy erős elmosás ugyanannyi ideig tart,
+ * mint egy gyenge. A képen kívül eső képpontok helyére a szélső képpontok
+ * kerülnek.
+ *
+ * A függvény újrafoglalhat dinamikusan memóriaterületet, ilyenkor a korábbi
+ * területeket felszabadítja, viszont az újonnan foglaltak felszabadítása
+ * továbbra is a hívó feladata marad.
+ *
+ * @param image A feldolgozandó kép.
+ * @param sigma A Gauss-elmosás szórása (pixelben, legfeljebb
+ * IMAGE_GAUSSIAN_MAX_SIGMA).
+ * @param output A kimenetre alkalmazandó keresőtábla (ráolvasztott
+ * pontműveletek), vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, hibás paraméterezés esetén
+ * IMAGE_BAD_PARAMETER-rel, memóriafoglalási hiba esetén pedig
+ * MEMORY_ERROR-ral tér vissza.
+ */
+int image_gaussian_blur(Image* image, float sigma, const ImageLut* output)
+{
+	int status;
+
+	if (!(sigma > 0.0f && sigma <= IMAGE_GAUSSIAN_MAX_SIGMA))
+		return IMAGE_BAD_PARAMETER;
+
+	if (image->width == 0 || image->height == 0)
+		return NO_ERROR;
+
+	if (image->layout == IMAGE_LAYOUT_TILED)
+	{
+		/* a futó összegek teljes sorokon haladnak, a csempés elrendezés nem gyorsítaná */
+		if ((status = image_set_layout(image, IMAGE_LAYOUT_INTERLEAVED)) != NO_ERROR ||
+			(status = image_gaussian_blur(image, sigma, output)) != NO_ERROR)
+			return status;
+		return image_set_layout(image, IMAGE_LAYOUT_TILED);
+	}
+
+	struct box_filter_struct box;
+	image_gaussian_box(sigma, &box);
+
+	size_t size = image_row_size(image);
+	size_t line_size = image_plane_count(image) * size;
+
+	/* munkásonként két munkasor a vízszintes, egy sornyi futó összeg a függőleges menetekhez */
+	/* az összegek tömbje a sorpufferek után, a saját igazításával kezdődik */
+	size_t buffers_size = ((size_t)image_get_worker_count() * 2 * size + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+	size_t buffer_size = buffers_size + size * sizeof(uint32_t);
+	allocator_reserve(buffer_size);
+
+	uint8_t* buffer = (uint8_t*)malloc(buffer_size);
+	if (buffer == NULL)
+		return MEMORY_ERROR;
+
+	Image matrix;
+	struct image_gaussian_band_struct band = { image, &matrix, &box, buffer, (uint32_t*)(buffer + buffers_size), output };
+
+	/* a vízszintes menetek soronként, helyben */
+	image_run_bands(image_gaussian_rows_band, &band, image->height, line_size);
+
+	/* a függőleges menetek oszlopsávonként, az eredmény a segédmátrixban */
+	if ((status = image_create_pixel_matrix(&matrix, image->width, image->height, image->layout)) != NO_ERROR)
+		goto free_buffer;
+
+	image_run_bands(image_gaussian_columns_band, &band, image->width, (size_t)image->height * sizeof(Pixel));
+
+	image_replace_pixel_matrix(image, &matrix);
+
+free_buffer:
+	free(buffer);
+
+	return status;
+}
+
+/**
+ * Készít egy dinamikusan foglalt, width × height méretű, nullákkal
+ * feltöltött konvolúciós magot.
+ *
+ * A lefoglalt memóriaterület felszabadítása (image_kernel_destroy) a hívó
+ * feladata.
+ *
+ * @param width A mag szélessége.
+ * @param height A mag magassága.
+ * @return Sikeres lefutás esetén a dinamikusan foglalt magra mutató
+ * pointer, foglalási hiba esetén pedig NULL-pointer.
+ */
+ImageKernel* image_kernel_create(uint32_t width, uint32_t height)
+{
+	ImageKernel* kernel = (ImageKernel*)malloc(sizeof(ImageKernel));
+	if (kernel == NULL)
+		return NULL;
+
+	kernel->width = width;
+	kernel->height = height;
+	kernel->weights = (float*)calloc((size_t)width * height, sizeof(float));
+	if (kernel->weights == NULL)
+	{
+		free(kernel);
+		return NULL;
+	}
+
+	return kernel;
+}
+
+/**
+ * Felszabadít egy dinamikusan foglalt konvolúciós magot.
+ *
+ * @param kernel A mag.
+ */
+void image_kernel_destroy(ImageKernel* kernel)
+{
+	free(kernel->weights);
+	free(kernel);
+}
+
+/**
+ * @brief A konvolúció lehetséges végrehajtási módjai.
+ */
+typedef enum convolution_path_enum
+{
+	CONVOLUTION_DIRECT, /* súlyonként egy-egy sorművelet */
+	CONVOLUTION_SEPARABLE, /* egy vízszintes és egy függőleges egydimenziós menet */
+	CONVOLUTION_FFT /* blokkonként, a frekvenciatartományban */
+} ConvolutionPath;
+
+/* a közvetlen és a szeparált konvolúció ennyi súlyozott összeadást végez egy utasítással */
+#ifdef IMAGE_USE_SSE2
+#define IMAGE_CONVOLUTION_LANES		4
+#else
+#define IMAGE_CONVOLUTION_LANES		1
+#endif
+
+/* a frekvenciatartománybeli konvolúció legnagyobb blokkmérete */
+#define IMAGE_FFT_MAX_BLOCK			1024
+
+/**
+ * Egy float sorhoz hozzáadja egy másik sor súlyozott értékeit. SSE2
+ * támogatás esetén 4 elemenként, a skalárissal azonos sorrendben számol,
+ * így az eredmény bitre azonos.
+ *
+ * @param acc Az összegeket tartalmazó sor.
+ * @param src A hozzáadandó sor.
+ * @param weight A súly.
+ * @param count A sorok hossza.
+ */
+static void floats_multiply_add(float* acc, const float* src, float weight, size_t count)
+{
+	size_t x = 0;
+
+#ifdef IMAGE_USE_SSE2
+	__m128 factor = _mm_set1_ps(weight);
+	for (; x + 4 <= count; x += 4)
+		_mm_storeu_ps(acc + x, _mm_add_ps(_mm_loadu_ps(acc + x), _mm_mul_ps(_mm_loadu_ps(src + x), factor)));
+#endif
+
+	for (; x < count; x++)
+		acc[x] += src[x] * weight;
+}
+
+/**
+ * Kerekíti és a 8 bites tartományra limitálja a konvolúció egy eredményét.
+ *
+ * @param value Az eredmény.
+ * @return Visszatér a színkomponenssel.
+ */
+static uint8_t float_to_component(float value)
+{
+	return (value <= 0.0f) ? 0 : (value >= 255.0f) ? 255 : (uint8_t)(value + 0.5f);
+}
+
+/**
+ * Float-okká alakít egy bájtokként kezelt sort, és mindkét oldalán a szélső
+ * képpont ismétlésével kiegészíti.
+ *
+ * @param dst A (left + width + right) * step hosszú cél sor.
+ * @param src A forrás sor.
+ * @param width A forrás sor képpontjainak száma.
+ * @param step A képpontok mérete (bájtban).
+ * @param left A bal oldalon hozzáadott képpontok száma.
+ * @param right A jobb oldalon hozzáadott képpontok száma.
+ */
+static void kernel_load_row(float* dst, const uint8_t* src, uint32_t width, size_t step, uint32_t left, uint32_t right)
+{
+	for (uint32_t x = 0; x < left; x++)
+		for (size_t s = 0; s < step; s++)
+			dst[x * step + s] = src[s];
+
+	for (size_t i = 0; i < (size_t)width * step; i++)
+		dst[left * step + i] = src[i];
+
+	const uint8_t* last = src + (size_t)(width - 1) * step;
+	for (uint32_t x = 0; x < right; x++)
+		for (size_t s = 0; s < step; s++)
+			dst[((size_t)left + width + x) * step + s] = last[s];
+}
+
+/**
+ * Megvizsgálja, hogy egy mag felírható-e egy oszlop- és egy sorvektor
+ * szorzataként (egyrangú-e), és ha igen, megadja a két vektort: a
+ * legnagyobb abszolút értékű súly oszlopa és (azzal osztott) sora a
+ * tényezők, a többi súlynak ezek szorzatával kell megegyeznie.
+ *
+ * @param kernel A mag.
+ * @param column Az oszlopvektor helye (kernel->height elem).
+ * @param row A sorvektor helye (kernel->width elem).
+ * @return Logikai igazzal tér vissza, ha a mag szeparálható.
+ */
+static bool kernel_factorize(const ImageKernel* kernel, float* column, float* row)
+{
+	uint32_t width = kernel->width, height = kernel->height;
+	const float* weights = kernel->weights;
+
+	size_t pivot = 0;
+	for (size_t i = 1; i < (size_t)width * height; i++)
+		if (fabsf(weights[i]) > fabsf(weights[pivot]))
+			pivot = i;
+
+	float largest = fabsf(weights[pivot]);
+	if (largest == 0.0f)
+	{
+		memset(column, 0, height * sizeof(float));
+		memset(row, 0, width * sizeof(float));
+		return true;
+	}
+
+	uint32_t p = (uint32_t)(pivot / width), q = (uint32_t)(pivot % width);
+	for (uint32_t j = 0; j < height; j++)
+		column[j] = weights[(size_t)j * width + q];
+	for (uint32_t i = 0; i < width; i++)
+		row[i] = weights[(size_t)p * width + i] / weights[pivot];
+
+	for (uint32_t j = 0; j < height; j++)
+		for (uint32_t i = 0; i < width; i++)
+			if (fabsf(weights[(size_t)j * width + i] - column[j] * row[i]) > 1e-5f * largest)
+				return false;
+
+	return true;
+}
+
+/**
+ * Megadja, hogy a konvolúció a frekvenciatartományban adott blokkmérettel
+ * képpontonként és komponensenként nagyjából hány lebegőpontos műveletbe
+ * kerül: blokkonként két kétdimenziós transzformáció (5 N log2 N művelet) és
+ * a spektrumok szorzása, egy transzformáció két komponenst dolgoz fel.
+ *
+ * @param width A kép szélessége.
+ * @param height A kép magassága.
+ * @param kernel A mag.
+ * @param block A blokkméret.
+ * @return Visszatér a becsült költséggel.
+ */
+static double convolution_fft_cost(uint32_t width, uint32_t height, const ImageKernel* kernel, size_t block)
+{
+	double points = (double)block * block;
+	double bits = 0.0;
+	for (size_t size = 1; size < block; size *= 2)
+		bits += 2.0;
+
+	size_t valid_width = block - kernel->width + 1, valid_height = block - kernel->height + 1;
+	double blocks = (double)((width + valid_width - 1) / valid_width) * ((height + valid_height - 1) / valid_height);
+	double per_block = 2.0 * 5.0 * points * bits + 6.0 * points;
+
+	/* három komponens két transzformációs menetben */
+	return 2.0 * blocks * per_block / (3.0 * width * height);
+}
+
+/**
+ * Kiválasztja a konvolúció legolcsóbb végrehajtási módját a műveletszámok
+ * becslése alapján: a közvetlen konvolúció a nem nulla súlyok, a szeparált a
+ * mag oldalainak összegével arányos (mindkettő SIMD-del), a
+ * frekvenciatartománybeli a mag méretétől alig függ.
+ *
+ * @param[in] image A kép.
+ * @param[in] kernel A mag.
+ * @param[in] separable Szeparálható-e a mag.
+ * @param[out] p_block A frekvenciatartománybeli konvolúció blokkméretének
+ * helye.
+ * @return Visszatér a választott móddal.
+ */
+static ConvolutionPath convolution_choose_path(const Image* image, const ImageKernel* kernel, bool separable, size_t* p_block)
+{
+	size_t taps = 0;
+	for (size_t i = 0; i < (size_t)kernel->width * kernel->height; i++)
+		taps += (kernel->weights[i] != 0.0f);
+
+	ConvolutionPath path = CONVOLUTION_DIRECT;
+	double cost = 2.0 * taps / IMAGE_CONVOLUTION_LANES;
+
+	if (separable && 2.0 * (kernel->width + kernel->height) / IMAGE_CONVOLUTION_LANES < cost)
+	{
+		path = CONVOLUTION_SEPARABLE;
+		cost = 2.0 * (kernel->width + kernel->height) / IMAGE_CONVOLUTION_LANES;
+	}
+
+	uint32_t side = (kernel->width > kernel->height) ? kernel->width : kernel->height;
+	uint32_t extent = (image->width > image->height) ? image->width : image->height;
+	for (size_t block = 2; block <= IMAGE_FFT_MAX_BLOCK; block *= 2)
+	{
+		if (block < (size_t)side + 1)
+			continue;
+
+		double fft_cost = convolution_fft_cost(image->width, image->height, kernel, block);
+		if (fft_cost < cost)
+		{
+			path = CONVOLUTION_FFT;
+			cost = fft_cost;
+			*p_block = block;
+		}
+
+		/* a képnél (és a magnál) jóval nagyobb blokkok már csak a kitöltést növelik */
+		if (block >= (size_t)extent + side)
+			break;
+	}
+
+	return path;
+}
+
+/**
+ * Megadja egy kép adott komponensének egy sorát: síkos elrendezésben a
+ * komponenssík sorát, egyébként a Pixel-ekből álló sor komponensének első
+ * bájtját (a képpontok ekkor sizeof(Pixel) bájtonként követik egymást).
+ *
+ * @param image A kép.
+ * @param channel A komponens indexe.
+ * @param y A sor indexe.
+ * @return Visszatér a sor első komponensének címével.
+ */
+static uint8_t* image_channel_row(const Image* image, int channel, uint32_t y)
+{
+	if (image->layout == IMAGE_LAYOUT_PLANAR)
+		return image_plane_row(image, channel, y);
+	return image_plane_row(image, 0, y) + channel;
+}
+
+/* a közvetlen és a szeparált konvolúció sávjainak közös állapota */
+struct image_convolve_band_struct
+{
+	Image* dst; /* a cél pixelmátrix */
+	const Image* src; /* a forrás pixelmátrix */
+	const ImageKernel* kernel; /* a mag */
+	const float* column; /* szeparált esetben a mag oszlopvektora, egyébként NULL */
+	const float* row; /* szeparált esetben a mag sorvektora, egyébként NULL */
+	const ImageLut* output; /* a kimenetre alkalmazandó keresőtábla, vagy NULL */
+	float* buffers; /* munkásonként a gyűrű, a kiegészített sor és az összegző sor */
+	size_t ring_row_size; /* a gyűrű egy sorának hossza (float-ban) */
+	size_t padded_size; /* a kiegészített sor hossza (float-ban) */
+	size_t buffer_size; /* egy munkás pufferének hossza (float-ban) */
+};
+
+/**
+ * Kiszámolja a konvolúció célsorait egy sávban (az image_convolve_rows egy
+ * sávja). A munkás gyűrűje a sáv elején a sáv feletti (halo) sorokkal
+ * töltődik fel, így a sávok függetlenek, és a célsorok ugyanazokból a
+ * gyűrűsorokból, ugyanabban a sorrendben összegződnek, mint egy sávban.
+ *
+ * @param argument A konvolúció közös állapota.
+ * @param first A sáv első sora.
+ * @param last A sáv utolsó utáni sora.
+ * @param worker A munkás indexe.
+ */
+static void image_convolve_band(void* argument, size_t first, size_t last, int worker)
+{
+	const struct image_convolve_band_struct* band = (const struct image_convolve_band_struct*)argument;
+	Image* dst = band->dst;
+	const Image* src = band->src;
+	const ImageKernel* kernel = band->kernel;
+	const float* column = band->column;
+	const float* row = band->row;
+
+	bool separable = (column != NULL);
+	uint32_t kernel_width = kernel->width, kernel_height = kernel->height;
+	uint32_t center_x = kernel_width / 2, center_y = kernel_height / 2;
+	size_t size = image_row_size(src);
+	size_t step = (src->layout == IMAGE_LAYOUT_PLANAR) ? 1 : sizeof(Pixel);
+	size_t ring_row_size = band->ring_row_size;
+
+	float* ring = band->buffers + (size_t)worker * band->buffer_size;
+	float* padded = ring + (size_t)kernel_height * ring_row_size;
+	float* acc = padded + band->padded_size;
+
+	uint32_t bottom = src->height - 1;
+
+	for (int c = 0; c < image_plane_count(src); c++)
+	{
+		/* a sáv első sorához szükséges legfelső forrássor előttig minden betöltöttnek számít */
+		int64_t loaded = (int64_t)first - center_y - 1;
+		if (loaded < -1)
+			loaded = -1;
+
+		for (uint32_t y = (uint32_t)first; y < (uint32_t)last; y++)
+		{
+			/* a gyűrűbe kerülnek a sor kiszámításához még hiányzó forrássorok */
+			int64_t needed = (int64_t)y + kernel_height - 1 - center_y;
+			if (needed > bottom)
+				needed = bottom;
+			for (; loaded < needed; loaded++)
+			{
+				uint32_t r = (uint32_t)(loaded + 1);
+				float* slot = ring + (size_t)(r % kernel_height) * ring_row_size;
+				kernel_load_row(separable ? padded : slot, image_plane_row(src, c, r), src->width, step, center_x, kernel_width - 1 - center_x);
+				if (separable)
+				{
+					memset(slot, 0, size * sizeof(float));
+					for (uint32_t i = 0; i < kernel_width; i++)
+						if (row[i] != 0.0f)
+							floats_multiply_add(slot, padded + (size_t)i * step, row[i], size);
+				}
+			}
+
+			memset(acc, 0, size * sizeof(float));
+			for (uint32_t j = 0; j < kernel_height; j++)
+			{
+				int64_t r = (int64_t)y + j - center_y;
+				r = (r < 0) ? 0 : (r > bottom) ? bottom : r;
+				const float* slot = ring + (size_t)(r % kernel_height) * ring_row_size;
+
+				if (separable)
+				{
+					if (column[j] != 0.0f)
+						floats_multiply_add(acc, slot, column[j], size);
+					continue;
+				}
+
+				for (uint32_t i = 0; i < kernel_width; i++)
+				{
+					float weight = kernel->weights[(size_t)j * kernel_width + i];
+					if (weight != 0.0f)
+						floats_multiply_add(acc, slot + (size_t)i * step, weight, size);
+				}
+			}
+
+			uint8_t* out = image_plane_row(dst, c, y);
+			for (size_t x = 0; x < size; x++)
+				out[x] = float_to_component(acc[x]);
+			image_lut_plane_row(dst, c, y, band->output);
+		}
+	}
+}
+
+/**
+ * Elvégzi a konvolúciót közvetlenül vagy szeparáltan, vízszintes sávokra
+ * bontva. A forrás sorai a széleken kiegészítve, float-okká alakítva
+ * (szeparált esetben már a vízszintes menet után) munkásonként egy
+ * magasságnyi sorból álló gyűrűbe kerülnek, a célsorok pedig a gyűrű
+ * sorainak súlyozott összegei.
+ *
+ * @param dst A cél pixelmátrix (azonos méretű és elrendezésű, nem csempés).
+ * @param src A forrás pixelmátrix.
+ * @param kernel A mag.
+ * @param column Szeparált esetben a mag oszlopvektora, egyébként NULL.
+ * @param row Szeparált esetben a mag sorvektora, egyébként NULL.
+ * @param output A kimenetre alkalmazandó keresőtábla, vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+static int image_convolve_rows(Image* dst, const Image* src, const ImageKernel* kernel, const float* column, const float* row, const ImageLut* output)
+{
+	size_t size = image_row_size(src);
+	size_t step = (src->layout == IMAGE_LAYOUT_PLANAR) ? 1 : sizeof(Pixel);
+	size_t padded_size = ((size_t)src->width + kernel->width - 1) * step;
+
+	/* közvetlen esetben a gyűrű kiegészített sorokból áll, szeparáltan a vízszintes menet eredményeiből */
+	size_t ring_row_size = (column != NULL) ? size : padded_size;
+	size_t worker_size = (size_t)kernel->height * ring_row_size + padded_size + size;
+	size_t buffer_size = (size_t)image_get_worker_count() * worker_size * sizeof(float);
+	allocator_reserve(buffer_size);
+
+	float* buffer = (float*)malloc(buffer_size);
+	if (buffer == NULL)
+		return MEMORY_ERROR;
+
+	struct image_convolve_band_struct band = { dst, src, kernel, column, row, output, buffer, ring_row_size, padded_size, worker_size };
+	image_run_bands(image_convolve_band, &band, src->height, size * image_plane_count(src));
+
+	free(buffer);
+
+	return NO_ERROR;
+}
+
+/* a frekvenciatartománybeli konvolúció sávjainak közös állapota */
+struct image_fft_band_struct
+{
+	Image* dst; /* a cél pixelmátrix */
+	const Image* src; /* a forrás pixelmátrix */
+	const ImageKernel* kernel; /* a mag */
+	const FftPlan* plan; /* a blokkméretű transzformáció terve */
+	size_t block; /* a blokkméret */
+	const ImageLut* output; /* a kimenetre alkalmazandó keresőtábla */
+	const float* spectrum; /* a mag spektruma */
+	float* buffers; /* munkásonként egy blokk és egy oszlop munkaterülete */
+	size_t buffer_size; /* egy munkás munkaterületének hossza (float-ban) */
+};
+
+/**
+ * Elvégzi a frekvenciatartománybeli konvolúciót a blokkok egy sávjában (az
+ * image_convolve_fft egy sávja). A blokkok a mag méretével átfedik a
+ * szomszédaikat, így a sávok a forrásmátrixból függetlenül tölthetők be.
+ *
+ * @param argument A konvolúció közös állapota.
+ * @param first_block A sáv első blokksora.
+ * @param last_block A sáv utolsó utáni blokksora.
+ * @param worker A munkás indexe.
+ */
+static void image_fft_band(void* argument, size_t first_block, size_t last_block, int worker)
+{
+	const struct image_fft_band_struct* band = (const struct image_fft_band_struct*)argument;
+	Image* dst = band->dst;
+	const Image* src = band->src;
+	const FftPlan* plan = band->plan;
+	const float* spectrum = band->spectrum;
+	const ImageLut* output = band->output;
+	size_t block = band->block;
+
+	uint32_t center_x = band->kernel->width / 2, center_y = band->kernel->height / 2;
+	size_t step = (src->layout == IMAGE_LAYOUT_PLANAR) ? 1 : sizeof(Pixel);
+	size_t valid_width = block - band->kernel->width + 1, valid_height = block - band->kernel->height + 1;
+
+	float* data = band->buffers + (size_t)worker * band->buffer_size;
+	float* column = data + 2 * block * block;
+
+	for (int first = 0; first < 3; first += 2)
+	{
+		bool paired = (first + 1 < 3);
+		const uint8_t* real_table = output->table[first];
+		const uint8_t* imaginary_table = paired ? output->table[first + 1] : NULL;
+
+		for (size_t task = first_block; task < last_block; task++)
+		{
+			uint32_t block_y = (uint32_t)(task * valid_height);
+			for (uint32_t block_x = 0; block_x < src->width; block_x += (uint32_t)valid_width)
+			{
+				for (size_t v = 0; v < block; v++)
+				{
+					int64_t y = (int64_t)block_y - center_y + (int64_t)v;
+					y = (y < 0) ? 0 : (y >= src->height) ? src->height - 1 : y;
+					const uint8_t* real = image_channel_row(src, first, (uint32_t)y);
+					const uint8_t* imaginary = paired ? image_channel_row(src, first + 1, (uint32_t)y) : NULL;
+
+					float* out = data + 2 * v * block;
+					for (size_t u = 0; u < block; u++)
+					{
+						int64_t x = (int64_t)block_x - center_x + (int64_t)u;
+						x = (x < 0) ? 0 : (x >= src->width) ? src->width - 1 : x;
+						out[2 * u] = real[x * step];
+						out[2 * u + 1] = paired ? imaginary[x * step] : 0.0f;
+					}
+				}
+
+				fft_transform_2d(plan, data, column, false);
+				for (size_t i = 0; i < block * block; i++)
+				{
+					float re = data[2 * i] * spectrum[2 * i] - data[2 * i + 1] * spectrum[2 * i + 1];
+					float im = data[2 * i] * spectrum[2 * i + 1] + data[2 * i + 1] * spectrum[2 * i];
+					data[2 * i] = re;
+					data[2 * i + 1] = im;
+				}
+				fft_transform_2d(plan, data, column, true);
+
+				for (size_t v = 0; v < valid_height && block_y + v < src->height; v++)
+				{
+					uint8_t* real = image_channel_row(dst, first, block_y + (uint32_t)v);
+					uint8_t* imaginary = paired ? image_channel_row(dst, first + 1, block_y + (uint32_t)v) : NULL;
+
+					const float* in = data + 2 * ((v + center_y) * block + center_x);
+					for (size_t u = 0; u < valid_width && block_x + u < src->width; u++)
+					{
+						real[(block_x + u) * step] = real_table[float_to_component(in[2 * u])];
+						if (paired)
+							imaginary[(block_x + u) * step] = imaginary_table[float_to_component(in[2 * u + 1])];
+					}
+				}
+			}
+		}
+	}
+}
+
 /**
- * Készít egy dinamikusan foglalt, width × height dimenziójú
- * pixelmátrixot - az annak indexelését segítő pointertömbbel együtt,
- * melyeket paraméterként ad vissza a hívónak, amennyiben sikeresek
- * voltak a foglalások.
- * 
- * A lefoglalt memóriaterület felszabadítása a hívó feladata.
- * 
- * @param[in] width A pixelmátrix szélessége.
- * @param[in] height A pixelmátrix magassága.
- * @param[out] p_pixel_data A pixelmátrixra mutató pointer helye.
- * @param[out] p_pixels A pixelmátrix pointertömbjére mutató pointer helye.
- * @return Sikeres lefutás esetén NO_ERROR, egyébként MEMORY_ERROR.
+ * Elvégzi a konvolúciót a frekvenciatartományban, átfedéses blokkokkal
+ * (overlap-save): a kép block × block méretű, a mag méretével átfedő
+ * blokkjait (a széleken a szélső képpontok ismétlésével) transzformálja,
+ * megszorozza a mag spektrumával, visszatranszformálja, és a körkörös
+ * konvolúció által nem érintett belső részt írja a célba. Egy komplex
+ * transzformáció két komponenst dolgoz fel (valós és képzetes részként),
+ * mivel a mag valós.
+ *
+ * @param dst A cél pixelmátrix (azonos méretű és elrendezésű, nem csempés).
+ * @param src A forrás pixelmátrix.
+ * @param kernel A mag.
+ * @param block A blokkméret (kettő hatványa, nagyobb a mag oldalainál).
+ * @param output A kimenetre alkalmazandó keresőtábla (a blokkok írásakor),
+ * vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
  */
-static int image_create_pixel_matrix(uint32_t width, uint32_t height, Pixel** p_pixel_data, Pixel*** p_pixels)
+static int image_convolve_fft(Image* dst, const Image* src, const ImageKernel* kernel, size_t block, const ImageLut* output)
 {
-	debugmalloc_max_block_size(width * height * sizeof(Pixel) + height * sizeof(Pixel*));
+	int status;
 
-	Pixel* pixel_data = (Pixel*)malloc(width * height * sizeof(Pixel));
-	if (pixel_data == NULL)
-		return MEMORY_ERROR;
+	uint32_t center_x = kernel->width / 2, center_y = kernel->height / 2;
+	size_t valid_height = block - kernel->height + 1;
 
-	Pixel** pixels = (Pixel**)malloc(height * sizeof(Pixel*));
-	if (pixels == NULL)
+	FftPlan* plan;
+	if ((status = fft_plan_create(&plan, block)) != NO_ERROR)
+		return status;
+
+	/* a spektrum után munkásonként egy blokk és egy oszlop munkaterülete */
+	size_t matrix_size = 2 * block * block * sizeof(float);
+	size_t worker_size = 2 * block * block + 2 * block;
+	size_t buffer_size = matrix_size + (size_t)image_get_worker_count() * worker_size * sizeof(float);
+	allocator_reserve(buffer_size);
+
+	float* spectrum = (float*)malloc(buffer_size);
+	if (spectrum == NULL)
 	{
-		free(pixel_data);
-		return MEMORY_ERROR;
+		status = MEMORY_ERROR;
+		goto destroy_plan;
 	}
+	float* column = spectrum + 2 * block * block + 2 * block * block; /* a hívó szál munkaterületéből */
 
-	for (uint32_t i = 0; i < height; i++)
-		pixels[i] = &pixel_data[i * width + 0];
+	/* a mag tükrözve kerül a blokkba, így a körkörös konvolúció a korrelációt adja; a normálás is a spektrumba kerül */
+	memset(spectrum, 0, matrix_size);
+	float scale = 1.0f / ((float)block * block);
+	for (uint32_t j = 0; j < kernel->height; j++)
+	{
+		for (uint32_t i = 0; i < kernel->width; i++)
+		{
+			size_t u = (block + center_x - i) % block, v = (block + center_y - j) % block;
+			spectrum[2 * (v * block + u)] = kernel->weights[(size_t)j * kernel->width + i] * scale;
+		}
+	}
+	fft_transform_2d(plan, spectrum, column, false);
 
-	*p_pixel_data = pixel_data;
-	*p_pixels = pixels;
+	/* a blokkok a keresőtáblán át íródnak, ráolvasztott pontművelet híján az identitáson */
+	ImageLut identity;
+	if (output == NULL)
+	{
+		image_lut_identity(&identity);
+		output = &identity;
+	}
 
-	return NO_ERROR;
+	struct image_fft_band_struct band = { dst, src, kernel, plan, block, output, spectrum, spectrum + 2 * block * block, worker_size };
+	image_run_bands(image_fft_band, &band, (src->height + valid_height - 1) / valid_height,
+		valid_height * image_row_size(src) * image_plane_count(src));
+
+	free(spectrum);
+destroy_plan:
+	fft_plan_destroy(plan);
+
+	return status;
 }
 
 /**
- * Készít egy dinamikusan foglalt absztrakt képet tároló sturktúrát, mely
- * elkészítésekor egy width × height dimenziójú kép tárolására alkalmas.
- *  
- * A lefoglalt memóriaterület felszabadítása a hívó feladata.
- * 
- * @param width A kép szélessége.
- * @param height A kép magassága.
- * @return Sikeres lefutás esetén a dinamikusan foglalt stuktúrára mutató
- * pointer, foglalási hiba esetén pedig NULL-pointer.
+ * Konvolúciót (pontosabban korrelációt) végez egy képen egy tetszőleges,
+ * páratlan oldalú maggal: egy képpont új értéke a mag középpontjához
+ * igazított környezetének súlyozott összege, kerekítve és a 8 bites
+ * tartományra limitálva. A képen kívül eső képpontok helyére a szélső
+ * képpontok kerülnek.
+ *
+ * A végrehajtás módját költségbecslés választja ki (lásd
+ * convolution_choose_path): a szeparálható (egyrangú) magok két
+ * egydimenziós menetben, a kis magok közvetlenül, SIMD-del, a nagyok
+ * (nagyjából 15 × 15 fölött) a frekvenciatartományban kerülnek
+ * alkalmazásra. A módok eredménye a lebegőpontos kerekítés miatt
+ * egy-egy képpontban eggyel eltérhet.
+ *
+ * A függvény újrafoglalhat dinamikusan memóriaterületet, ilyenkor a korábbi
+ * területeket felszabadítja, viszont az újonnan foglaltak felszabadítása
+ * továbbra is a hívó feladata marad.
+ *
+ * @param image A feldolgozandó kép.
+ * @param kernel A mag.
+ * @param output A kimenetre alkalmazandó keresőtábla (ráolvasztott
+ * pontműveletek), vagy NULL.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, páros oldalú vagy
+ * IMAGE_KERNEL_MAX_SIZE-nál nagyobb mag esetén IMAGE_BAD_PARAMETER-rel,
+ * memóriafoglalási hiba esetén pedig MEMORY_ERROR-ral tér vissza.
  */
-Image* image_create(uint32_t width, uint32_t height)
+int image_convolve(Image* image, const ImageKernel* kernel, const ImageLut* output)
 {
-	Image* image = (Image*)malloc(sizeof(Image));
-	if (image == NULL)
-		return NULL;
+	int status;
+
+	if (kernel->width % 2 == 0 || kernel->height % 2 == 0 ||
+		kernel->width > IMAGE_KERNEL_MAX_SIZE || kernel->height > IMAGE_KERNEL_MAX_SIZE)
+		return IMAGE_BAD_PARAMETER;
 
-	if (image_create_pixel_matrix(width, height, &image->pixel_data, &image->pixels) != NO_ERROR)
+	if (image->width == 0 || image->height == 0)
+		return NO_ERROR;
+
+	if (image->layout == IMAGE_LAYOUT_TILED)
 	{
-		free(image);
-		return NULL;
+		/* a gyűrű teljes sorokból áll, a csempés elrendezés nem gyorsítaná */
+		if ((status = image_set_layout(image, IMAGE_LAYOUT_INTERLEAVED)) != NO_ERROR ||
+			(status = image_convolve(image, kernel, output)) != NO_ERROR)
+			return status;
+		return image_set_layout(image, IMAGE_LAYOUT_TILED);
 	}
 
-	image->width = width;
-	image->height = height;
+	float column[IMAGE_KERNEL_MAX_SIZE], row[IMAGE_KERNEL_MAX_SIZE];
+	bool separable = kernel_factorize(kernel, column, row);
 
-	return image;
+	size_t block = 0;
+	ConvolutionPath path = convolution_choose_path(image, kernel, separable, &block);
+
+	Image matrix;
+	if ((status = image_create_pixel_matrix(&matrix, image->width, image->height, image->layout)) != NO_ERROR)
+		return status;
+
+	if (path == CONVOLUTION_FFT)
+		status = image_convolve_fft(&matrix, image, kernel, block, output);
+	else if (path == CONVOLUTION_SEPARABLE)
+		status = image_convolve_rows(&matrix, image, kernel, column, row, output);
+	else
+		status = image_convolve_rows(&matrix, image, kernel, NULL, NULL, output);
+
+	if (status != NO_ERROR)
+	{
+		image_pool_release(matrix.allocation, matrix.allocation_size);
+		return status;
+	}
+
+	image_replace_pixel_matrix(image, &matrix);
+
+	return NO_ERROR;
 }
 
 /**
- * Felszabadít egy dinamikusan foglalt absztrakt képet tároló struktúrát
- * annak minden dinamikusan foglalt memóriaterületével együtt.
- * 
- * @param image A felszabadítandó kép sturktúrára mutató pointer.
+ * Megnöveli, illetve lecsökkenti egy pixelsor fényerejét megadott
+ * intenzitással. A cél és a forrás sor meg is egyezhet. A művelet
+ * komponensenként azonos, így a sor bájtsorozatként, SSE2 támogatás esetén
+ * 16 bájtonként, telítő összeadással (kivonással) dolgozható fel.
+ *
+ * @param dst A cél pixelsor.
+ * @param src A forrás pixelsor.
+ * @param width A pixelsorok szélessége.
+ * @param value Az művelet intenzitása.
  */
-void image_destroy(Image* image)
+void image_exposure_row(Pixel* dst, const Pixel* src, uint32_t width, int value)
 {
-	free(image->pixels);
-	free(image->pixel_data);
-	free(image);
+	uint8_t* dst_bytes = (uint8_t*)dst;
+	const uint8_t* src_bytes = (const uint8_t*)src;
+	size_t size = (size_t)width * sizeof(Pixel);
+	size_t i = 0;
+
+#ifdef IMAGE_USE_SSE2
+	int magnitude = (value < 0) ? -value : value;
+	__m128i delta = _mm_set1_epi8((char)(magnitude > 255 ? 255 : magnitude));
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(src_bytes + i));
+		bytes = (value < 0) ? _mm_subs_epu8(bytes, delta) : _mm_adds_epu8(bytes, delta);
+		_mm_storeu_si128((__m128i*)(dst_bytes + i), bytes);
+	}
+#endif
+
+	for (; i < size; i++)
+		dst_bytes[i] = limit_pixel_component(src_bytes[i] + value);
 }
 
+#ifdef IMAGE_USE_SSE2
 /**
- * Megadja, hogy egy dimenzió skálázása megvalósítható-e egyértelműen, vagyis
- * hogy a dimenziót a skálázási értékkel elosztva egész szám-e a hányados.
- * 
- * @param dimension A dimenzió.
- * @param scale A skálázási érték (skalár).
- * @return Amennyiben a dimenzió skálázása egyértelmű, logikai igazzal,
- * egyébként logikai hamissal tér vissza.
+ * Megnöveli, illetve lecsökkenti egy saját foglalású kép (komponenssíkja) egy sorának
+ * fényerejét helyben: a sor igazított, és a kitöltés miatt a hossza
+ * felkerekíthető, így csak igazított, teljes vektorokkal dolgozik.
+ *
+ * @param row A sor (IMAGE_ALIGNMENT bájtra igazítva).
+ * @param size A sor hossza (bájtban).
+ * @param value Az művelet intenzitása.
  */
-static bool is_divisible(uint32_t dimension, float scale)
+static void image_exposure_aligned_row(uint8_t* row, size_t size, int value)
 {
-	uint32_t quotient = dimension / scale;
-	uint32_t original = quotient * scale;
-	return original == dimension;
+	int magnitude = (value < 0) ? -value : value;
+	__m128i delta = _mm_set1_epi8((char)(magnitude > 255 ? 255 : magnitude));
+
+	for (size_t i = 0; i < size; i += 16)
+	{
+		__m128i bytes = _mm_load_si128((const __m128i*)(row + i));
+		bytes = (value < 0) ? _mm_subs_epu8(bytes, delta) : _mm_adds_epu8(bytes, delta);
+		_mm_store_si128((__m128i*)(row + i), bytes);
+	}
 }
+#endif
+
+/* az eltolás sávjainak közös állapota */
+struct image_shift_struct
+{
+	Image* image; /* a feldolgozandó kép */
+	int value; /* az eltolás mértéke */
+};
 
 /**
- * Fel- vagy leskáláz egy képet megadott függőleges és vízszintes
- * paraméterek szerint.
- * 
- * Az adott tengely szerint skálázás egynél nagyobb értékeknél a kép
- * nagyítását, egynél kisebb értékekre pedig a kép kicsinyítését idézi elő.
- * 
- * A függvény újrafoglalhat dinamikusan memóriaterületet, ilyenkor a korábbi
- * területeket felszabadítja, viszont az újonnan foglaltak felszabadítása
- * továbbra is a hívó feladata marad.
- * 
- * @param image A feldolgozandó kép.
- * @param horizontal A vízszintes skálázás értéke. Mindig pozitív.
- * @param vertical A függőleges skálázás értéke. Mindig pozitív.
- * @return Sikeres lefutás esetén NO_ERROR-ral, hibás paraméter esetén
- * IMAGE_BAD_PARAMETER-rel, memóriafoglalási hiba esetén pedig MEMORY_ERROR-ral
- * tér vissza.
+ * Eltolja egy kép sávjának (sorainak vagy csempéinek) komponenseit (az
+ * image_shift_components egy sávja).
+ *
+ * @param argument Az eltolás közös állapota.
+ * @param first A sáv első eleme.
+ * @param last A sáv utolsó utáni eleme.
+ * @param worker A munkás indexe (nem használt).
  */
-int image_scale(Image* image, float horizontal, float vertical)
+static void image_shift_band(void* argument, size_t first, size_t last, int worker)
 {
-	int status;
+	(void)worker;
 
-	if (!(is_divisible(image->width, horizontal) && is_divisible(image->height, vertical)))
-		return IMAGE_BAD_PARAMETER;
-
-	uint32_t new_width = image->width * horizontal;
-	uint32_t new_height = image->height * vertical;
+	const struct image_shift_struct* shift = (const struct image_shift_struct*)argument;
+	Image* image = shift->image;
+	int value = shift->value;
 
-	Pixel* pixel_data;
-	Pixel** pixels;
-
-	if ((status = image_create_pixel_matrix(new_width, new_height, &pixel_data, &pixels)) != NO_ERROR)
-		return status;
+	if (image->layout == IMAGE_LAYOUT_TILED)
+	{
+		/* a csempék egyetlen folytonos, igazított területet alkotnak */
+#ifdef IMAGE_USE_SSE2
+		image_exposure_aligned_row(image->data + first * image->plane_size, (last - first) * image->plane_size, value);
+#else
+		for (size_t i = first; i < last; i++)
+		{
+			Pixel* tile = (Pixel*)(image->data + i * image->plane_size);
+			image_exposure_row(tile, tile, IMAGE_TILE_SIZE * IMAGE_TILE_SIZE, value);
+		}
+#endif
+		return;
+	}
 
-	for (uint32_t i = 0; i < new_height; i++)
-		pixels[i] = &pixel_data[i * new_width + 0];
+#ifdef IMAGE_USE_SSE2
+	if (image->allocation != NULL)
+	{
+		for (int c = 0; c < image_plane_count(image); c++)
+			for (size_t y = first; y < last; y++)
+				image_exposure_aligned_row(image_plane_row(image, c, (uint32_t)y), image_row_size(image), value);
+		return;
+	}
+#endif
 
-	for (uint32_t y_new = 0; y_new < new_height; y_new++)
+	if (image->layout == IMAGE_LAYOUT_PLANAR)
 	{
-		uint32_t y_old = y_new / vertical;
-		for (uint32_t x_new = 0; x_new < new_width; x_new++)
+		for (int c = 0; c < 3; c++)
 		{
-			uint32_t x_old = x_new / horizontal;
-			pixels[y_new][x_new] = image->pixels[y_old][x_old];
+			for (size_t y = first; y < last; y++)
+			{
+				uint8_t* row = image_plane_row(image, c, (uint32_t)y);
+				for (uint32_t x = 0; x < image->width; x++)
+					row[x] = limit_pixel_component(row[x] + value);
+			}
 		}
+		return;
 	}
 
-	free(image->pixels);
-	free(image->pixel_data);
+	for (size_t y = first; y < last; y++)
+		image_exposure_row(image_row(image, (uint32_t)y), image_row(image, (uint32_t)y), image->width, value);
+}
 
-	image->pixel_data = pixel_data;
-	image->pixels = pixels;
-	image->width = new_width;
-	image->height = new_height;
+/**
+ * Megnöveli, illetve lecsökkenti egy kép minden komponensét ugyanazzal az
+ * értékkel, a tartomány határain telítve. Ez a pontműveletek leggyakoribb
+ * esete (a puszta expozíció), mely keresőtábla nélkül, SSE2 támogatás
+ * esetén telítő összeadással (kivonással) végezhető el.
+ *
+ * @param image A feldolgozandó kép.
+ * @param value Az eltolás mértéke.
+ */
+static void image_shift_components(Image* image, int value)
+{
+	struct image_shift_struct shift = { image, value };
 
-	return NO_ERROR;
+	size_t item_size;
+	size_t count = image_get_band_items(image, &item_size);
+	image_run_bands(image_shift_band, &shift, count, item_size);
 }
 
 /**
- * Megcseréli két pixel értékét.
- * 
- * @param p_pixel1 Az egyik pixelre mutató pointer.
- * @param p_pixel2 A másik pixelre mutató pointer.
+ * Alaphelyzetbe állít egy keresőtáblát: minden komponensérték önmagára
+ * képeződik le.
+ *
+ * @param lut A keresőtábla.
  */
-static void swap_pixels(Pixel* p_pixel1, Pixel* p_pixel2)
+void image_lut_identity(ImageLut* lut)
 {
-	Pixel temp = *p_pixel1;
-	*p_pixel1 = *p_pixel2;
-	*p_pixel2 = temp;
+	for (int c = 0; c < 3; c++)
+		for (int i = 0; i < 256; i++)
+			lut->table[c][i] = (uint8_t)i;
 }
 
 /**
- * Tükröz egy képet az x tengelyre.
- * 
- * @param image A feldolgozandó kép.
- * @return Minden esetben NO_ERROR státusszal tér vissza.
+ * Kiegészíti egy keresőtábla leképezését egy mindhárom komponensre azonos
+ * leképezéssel, mely a tábla eddigi leképezése után hajtódik végre.
+ *
+ * @param lut A keresőtábla.
+ * @param map A hozzáfűzendő leképezés (256 elemű).
  */
-int image_mirror_x(Image* image)
+static void image_lut_compose(ImageLut* lut, const uint8_t* map)
 {
-	for (uint32_t x = 0; x < image->width; x++)
-		for (uint32_t y = 0; y < image->height / 2; y++)
-			swap_pixels(&image->pixels[y][x], &image->pixels[image->height - 1 - y][x]);
-	return NO_ERROR;
+	for (int c = 0; c < 3; c++)
+		for (int i = 0; i < 256; i++)
+			lut->table[c][i] = map[lut->table[c][i]];
 }
 
 /**
- * Tükröz egy képet az y tengelyre.
+ * Kiegészíti egy keresőtábla leképezését egy másik keresőtábláéval, mely a
+ * tábla eddigi leképezése után hajtódik végre.
  *
- * @param image A feldolgozandó kép.
- * @return Minden esetben NO_ERROR státusszal tér vissza.
+ * @param lut A keresőtábla.
+ * @param next A hozzáfűzendő keresőtábla.
  */
-int image_mirror_y(Image* image)
+void image_lut_append(ImageLut* lut, const ImageLut* next)
 {
-	for (uint32_t y = 0; y < image->height; y++)
-		for (uint32_t x = 0; x < image->width / 2; x++)
-			swap_pixels(&image->pixels[y][x], &image->pixels[y][image->width - 1 - x]);
-	return NO_ERROR;
+	for (int c = 0; c < 3; c++)
+		for (int i = 0; i < 256; i++)
+			lut->table[c][i] = next->table[c][lut->table[c][i]];
 }
 
 /**
- * Alkalmaz egy mátrix-szal megadott konvolúciót egy pixelmátrixra.
- * 
- * @param dst A cél pixelmátrix.
- * @param src A forrás pixelmátrix.
- * @param width A pixelmátrixok szélessége.
- * @param height A pixelmátrixok magassága.
- * @param coeff A konvolúciós mátrix együtthatója.
- * @param kernel A konvolúciós mátrix.
+ * Kerekít és a komponensek tartományára limitál egy lebegőpontos értéket.
+ *
+ * @param value Az érték.
+ * @return Visszatér a legközelebbi, tartományba eső komponensértékkel.
  */
-static void pixel_apply_kernel(Pixel** dst, Pixel** src, uint32_t width, uint32_t height, float coeff, const int kernel[3][3])
+static uint8_t round_pixel_component(double value)
 {
-	for (uint32_t y = 0; y < height - 2; y++)
-	{
-		for (uint32_t x = 0; x < width - 2; x++)
-		{
-			int blue = 0, green = 0, red = 0;
+	return (value <= 0.0) ? 0 : (value >= 255.0) ? 255 : (uint8_t)(value + 0.5);
+}
 
-			for (uint32_t i = 0; i < 3; i++)
-			{
-				for (uint32_t j = 0; j < 3; j++)
-				{
-					blue += kernel[i][j] * src[y + i][x + j].blue;
-					green += kernel[i][j] * src[y + i][x + j].green;
-					red += kernel[i][j] * src[y + i][x + j].red;
-				}
-			}
+/**
+ * Hozzáfűzi egy keresőtáblához az expozíció eltolását (lásd image_exposure).
+ *
+ * @param lut A keresőtábla.
+ * @param value Az művelet intenzitása.
+ */
+void image_lut_exposure(ImageLut* lut, int value)
+{
+	/* a 255-nél nagyobb eltolás már minden komponenst telít */
+	if (value > 255)
+		value = 255;
+	else if (value < -255)
+		value = -255;
 
-			Pixel pixel = { .blue = blue * coeff, .green = green * coeff, .red = red * coeff };
+	uint8_t map[256];
+	for (int i = 0; i < 256; i++)
+		map[i] = limit_pixel_component(i + value);
+	image_lut_compose(lut, map);
+}
 
-			dst[y + 1][x + 1] = pixel;
-		}
-	}
+/**
+ * Hozzáfűzi egy keresőtáblához a kontraszt módosítását: a komponensek a
+ * középérték (128) körül a value értékből számolt tényezővel nyúlnak meg
+ * (pozitív érték), illetve húzódnak össze (negatív érték).
+ *
+ * @param lut A keresőtábla.
+ * @param value A művelet intenzitása (-255 és 255 között).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a tartományon kívüli
+ * intenzitás esetén IMAGE_BAD_PARAMETER-rel tér vissza.
+ */
+int image_lut_contrast(ImageLut* lut, int value)
+{
+	if (value < -255 || value > 255)
+		return IMAGE_BAD_PARAMETER;
 
-	for (uint32_t y = 0; y < height; y++)
-	{
-		dst[y][0] = src[y][0];
-		dst[y][width - 1] = src[y][width - 1];
-	}
+	double factor = 259.0 * (value + 255) / (255.0 * (259 - value));
 
-	for (uint32_t x = 0; x < width; x++)
-	{
-		dst[0][x] = src[0][x];
-		dst[height - 1][x] = src[height - 1][x];
-	}
+	uint8_t map[256];
+	for (int i = 0; i < 256; i++)
+		map[i] = round_pixel_component(factor * (i - 128) + 128.0);
+	image_lut_compose(lut, map);
+
+	return NO_ERROR;
 }
 
 /**
- * Elhomályosít vagy élesít egy képet megadott intenzitással.
- * 
- * @param image A feldolgozandó kép.
- * @param value Az művelet intenzitása. A művelet pozitív értékek esetén
- * elhomályosítás, negatív értékek esetén élesítés.
- * @return Sikeres lefutás esetén NO_ERROR-ral, hibás paraméterezés esetén
- * IMAGE_BAD_PARAMETER-rel, memóriafoglalási hiba esetén pedig
- * MEMORY_ERROR-ral tér vissza.
+ * Hozzáfűzi egy keresőtáblához a gammakorrekciót: a [0, 1] tartományra
+ * normált komponensek az 1 / gamma kitevőre emelődnek, így az 1-nél
+ * nagyobb gamma a középtónusokat világosítja, a kisebb sötétíti.
+ *
+ * @param lut A keresőtábla.
+ * @param gamma A gamma értéke (pozitív, véges).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, hibás gamma esetén
+ * IMAGE_BAD_PARAMETER-rel tér vissza.
  */
-int image_blur(Image* image, int value)
+int image_lut_gamma(ImageLut* lut, float gamma)
 {
-	int status;
+	if (!(gamma > 0.0f && gamma < INFINITY))
+		return IMAGE_BAD_PARAMETER;
 
-	static const int blur[3][3] = {
-		1, 2, 1,
-		2, 4, 2,
-		1, 2, 1
-	};
-	static const int sharpen[3][3] = {
-		0, -1, 0,
-		-1, 5, -1,
-		0, -1, 0
-	};
+	uint8_t map[256];
+	for (int i = 0; i < 256; i++)
+		map[i] = round_pixel_component(255.0 * pow(i / 255.0, 1.0 / gamma));
+	image_lut_compose(lut, map);
 
-	if (value == 0)
+	return NO_ERROR;
+}
+
+/**
+ * Hozzáfűzi egy keresőtáblához a szintek beállítását: a [black, white]
+ * tartomány lineárisan a teljes [0, 255] tartományra nyúlik, az azon kívül
+ * eső komponensek telítődnek.
+ *
+ * @param lut A keresőtábla.
+ * @param black A feketére leképeződő komponensérték.
+ * @param white A fehérre leképeződő komponensérték.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, ha pedig nem teljesül a
+ * 0 <= black < white <= 255 feltétel, IMAGE_BAD_PARAMETER-rel tér vissza.
+ */
+int image_lut_levels(ImageLut* lut, int black, int white)
+{
+	if (black < 0 || white > 255 || black >= white)
 		return IMAGE_BAD_PARAMETER;
 
-	Pixel* src_data = image->pixel_data;
-	Pixel** src = image->pixels;
+	uint8_t map[256];
+	for (int i = 0; i < 256; i++)
+		map[i] = round_pixel_component((i - black) * 255.0 / (white - black));
+	image_lut_compose(lut, map);
 
-	Pixel* dst_data;
-	Pixel** dst;
+	return NO_ERROR;
+}
 
-	if ((status = image_create_pixel_matrix(image->width, image->height, &dst_data, &dst)) != NO_ERROR)
-		return status;
+/**
+ * Megvizsgálja, hogy egy keresőtábla leképezése minden komponensen ugyanaz
+ * a telítő eltolás-e (ilyen a csak expozíciókból álló műveletsoré).
+ *
+ * @param[in] lut A keresőtábla.
+ * @param[out] p_value Az eltolás mértékének helye.
+ * @return Logikai igazzal tér vissza, ha a leképezés telítő eltolás.
+ */
+static bool image_lut_get_offset(const ImageLut* lut, int* p_value)
+{
+	int value = (lut->table[0][0] > 0) ? lut->table[0][0] : lut->table[0][255] - 255;
 
-	for (uint32_t i = 0; i < image->height; i++)
-		dst[i] = &dst_data[i * image->width + 0];
+	for (int c = 0; c < 3; c++)
+		for (int i = 0; i < 256; i++)
+			if (lut->table[c][i] != limit_pixel_component(i + value))
+				return false;
 
-	float coeff = 1.0 / 16.0;
-	int(*kernel)[3] = blur;
-	if (value < 0)
-	{
-		coeff = 1.0;
-		kernel = sharpen;
-		value *= -1;
-	}
+	*p_value = value;
+	return true;
+}
 
-	for (;;)
-	{
-		pixel_apply_kernel(dst, src, image->width, image->height, coeff, kernel);
-		value -= 1;
-		if (value == 0)
-			break;
+/* a keresőtábla alkalmazása sávjainak közös állapota */
+struct image_lut_band_struct
+{
+	Image* image; /* a feldolgozandó kép */
+	const ImageLut* lut; /* a keresőtábla */
+};
 
-		Pixel* tmp_data = dst_data;
-		dst_data = src_data;
-		src_data = tmp_data;
+/**
+ * Alkalmaz egy keresőtáblát egy kép sávjának (sorainak vagy csempéinek)
+ * komponensein (az image_apply_lut egy sávja).
+ *
+ * @param argument A keresőtábla alkalmazásának közös állapota.
+ * @param first A sáv első eleme.
+ * @param last A sáv utolsó utáni eleme.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void image_lut_band(void* argument, size_t first, size_t last, int worker)
+{
+	(void)worker;
 
-		Pixel** tmp = dst;
-		dst = src;
-		src = tmp;
-	}
+	const struct image_lut_band_struct* band = (const struct image_lut_band_struct*)argument;
+	Image* image = band->image;
+	const ImageLut* lut = band->lut;
 
-	image->pixel_data = dst_data;
-	image->pixels = dst;
+	if (image->layout == IMAGE_LAYOUT_TILED)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			Pixel* tile = (Pixel*)(image->data + i * image->plane_size);
+			image_lut_row(tile, tile, IMAGE_TILE_SIZE * IMAGE_TILE_SIZE, lut);
+		}
+		return;
+	}
 
-	free(src);
-	free(src_data);
+	if (image->layout == IMAGE_LAYOUT_PLANAR)
+	{
+		for (int c = 0; c < 3; c++)
+			for (size_t y = first; y < last; y++)
+				bytes_apply_lut(image_plane_row(image, c, (uint32_t)y), image->width, lut->table[c]);
+		return;
+	}
 
-	return NO_ERROR;
+	for (size_t y = first; y < last; y++)
+		image_lut_row(image_row(image, (uint32_t)y), image_row(image, (uint32_t)y), image->width, lut);
 }
 
 /**
- * Limitálja egy 32 bites előjeles egészként megadott színkomponens értékét,
- * hogy az a 8 bites előjel nélküli számábrázolási tartományon belülre essen.
- * 
- * @param component A színkomponens.
- * @return Visszatér a tartományra limitált komponenssel.
+ * Elvégzi egy keresőtábla (tetszőleges számú összevont pontművelet)
+ * leképezését egy képen, egyetlen menetben. A puszta eltolások a telítő
+ * összeadás vektoros útján futnak.
+ *
+ * @param image A feldolgozandó kép.
+ * @param lut A keresőtábla.
+ * @return Minden esetben NO_ERROR státusszal tér vissza.
  */
-static uint8_t limit_pixel_component(int component)
+int image_apply_lut(Image* image, const ImageLut* lut)
 {
-	return (component < 0) ? 0 : (component > 255) ? 255 : component;
+	int value;
+	if (image_lut_get_offset(lut, &value))
+	{
+		if (value != 0)
+			image_shift_components(image, value);
+		return NO_ERROR;
+	}
+
+	struct image_lut_band_struct band = { image, lut };
+
+	size_t item_size;
+	size_t count = image_get_band_items(image, &item_size);
+	image_run_bands(image_lut_band, &band, count, item_size);
+
+	return NO_ERROR;
 }
 
 /**
@@ -354,19 +3107,9 @@ static uint8_t limit_pixel_component(int component)
  */
 int image_exposure(Image* image, int value)
 {
-	for (uint32_t y = 0; y < image->height; y++)
-	{
-		for (uint32_t x = 0; x < image->width; x++)
-		{
-			Pixel pixel = image->pixels[y][x];
-
-			pixel.blue = limit_pixel_component(pixel.blue + value);
-			pixel.green = limit_pixel_component(pixel.green + value);
-			pixel.red = limit_pixel_component(pixel.red + value);
+	ImageLut lut;
+	image_lut_identity(&lut);
+	image_lut_exposure(&lut, value);
 
-			image->pixels[y][x] = pixel;
-		}
-	}
-
-	return NO_ERROR;
+	return image_apply_lut(image, &lut);
 }
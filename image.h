@@ -9,7 +9,9 @@
 #define IMAGE_H_INCLUDED
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threadpool.h"
 
 #define IMAGE_ERROR_OFFSET			1000
 
@@ -28,34 +30,225 @@ typedef struct pixel_struct
 	uint8_t red; /* vörös */
 } Pixel;
 
+/* a saját foglalású képek sorainak igazítása (bájtban) */
+#define IMAGE_ALIGNMENT				64
+
+/**
+ * @brief A képpontok tárolásának elrendezése.
+ */
+typedef enum image_layout_enum
+{
+	IMAGE_LAYOUT_INTERLEAVED, /* Pixel-ekből álló sorok */
+	IMAGE_LAYOUT_PLANAR, /* komponensenként (kék, zöld, vörös) egy-egy bájtsík */
+	IMAGE_LAYOUT_TILED /* IMAGE_TILE_SIZE × IMAGE_TILE_SIZE pixeles, folytonos csempék */
+} ImageLayout;
+
+/* a csempés elrendezés csempéinek szélessége és magassága (pixelben) */
+#define IMAGE_TILE_SIZE				64
+
+/* a Gauss-elmosás legnagyobb szórása (pixelben) */
+#define IMAGE_GAUSSIAN_MAX_SIGMA	1000.0f
+
+/* a konvolúciós magok legnagyobb szélessége és magassága */
+#define IMAGE_KERNEL_MAX_SIZE		255
+
+/* az egyetlen menetben elvégezhető, egymást követő skálázások legnagyobb száma */
+#define IMAGE_SCALE_MAX_STEPS		8
+
 /**
  * @brief Egy absztrakt képstruktúra, mely egy – a 32 bites előjel nélküli
  * egész számábrázolási korlátjaitól eltekintve – tetszőlegesen nagy
  * dimenziójú, legfeljebb 8 bites RGB komponensekkel rendelkező kép és jellemző
  * paramétereinek (szélesség, magasság) egységbezárására alkalmas.
  * 
- * A képpontokat a címaritmetikát helyettesítő pixels sorcím-leképzett
- * pointertömbön keresztül is el lehet érni.
+ * A képpontok egyetlen memóriaterületen, egymástól stride bájtnyira kezdődő
+ * sorokban helyezkednek el; egy sor az image_row függvénnyel érhető el. A
+ * saját foglalású képek sorai IMAGE_ALIGNMENT bájtra igazítottak, a sorok
+ * végén pedig legalább a következő igazított címig tartó kitöltés van, így
+ * a sorok vektoros műveletekkel a kitöltésbe átnyúlva is feldolgozhatók.
+ *
+ * Síkos elrendezésben mindhárom komponens egy-egy, plane_size bájtnyira
+ * kezdődő, igazított sorokból álló bájtsíkban helyezkedik el (sorrendben a
+ * kék, a zöld és a vörös); egy sík sora az image_plane_row függvénnyel
+ * érhető el, a Pixel-ekből álló sort pedig az image_copy_row állítja elő.
+ * A bájtsíkokon a műveletek komponensenként, vektorosan végezhetők el.
+ *
+ * Csempés elrendezésben a kép IMAGE_TILE_SIZE × IMAGE_TILE_SIZE pixeles
+ * csempékre oszlik, melyek soronként (a csempesorok sorrendjében), egymástól
+ * plane_size bájtnyira helyezkednek el; egy csempén belül a Pixel-ekből álló
+ * sorok stride bájtnyira követik egymást. A kép jobb és alsó szélén lévő
+ * csempék is teljes méretűek. Egy csempe bármely elrendezésben elérhető az
+ * image_get_tile függvénnyel, így a műveletek csempénként, a gyorsítótárban
+ * maradó munkaterülettel is elvégezhetők (ami a nagyon széles képeken
+ * számít).
+ *
+ * Egy fájlleképezésből létrehozott kép sorai közvetlenül a leképezett
+ * fájlra mutatnak, ilyenkor az allocation NULL, a képpontokat tároló
+ * memóriaterület pedig a mapping leképezés; ezek a sorok nem igazítottak.
  */
 typedef struct image_struct
 {
 	uint32_t width; /* képszélesség */
 	uint32_t height; /* képmagasság */
-	Pixel* pixel_data; /* pixelmátrix */
-	Pixel** pixels; /* pointertömb a pixelmátrix soraira */
+	ImageLayout layout; /* a képpontok elrendezése */
+	uint8_t* data; /* az első sor (síkos elrendezésben a kék sík első sorának) kezdőcíme */
+	size_t stride; /* két egymást követő sor kezdőcímének távolsága (bájtban) */
+	size_t plane_size; /* két egymást követő sík (csempés elrendezésben csempe) kezdőcímének távolsága (bájtban) */
+	void* allocation; /* a sorokat tartalmazó foglalt memóriaterület (vagy NULL) */
+	size_t allocation_size; /* a foglalt memóriaterület mérete */
+	void* mapping; /* a sorokat tartalmazó fájlleképezés (vagy NULL) */
+	size_t mapping_size; /* a fájlleképezés mérete */
 } Image;
 
+/**
+ * Megadja egy Pixel-ekből álló sorokkal tárolt kép adott sorának
+ * kezdőcímét.
+ *
+ * @param image A kép.
+ * @param y A sor indexe.
+ * @return Visszatér a sor első pixelének címével.
+ */
+static inline Pixel* image_row(const Image* image, uint32_t y)
+{
+	return (Pixel*)(image->data + (size_t)y * image->stride);
+}
+
+/**
+ * Megadja egy síkos elrendezésű kép adott komponenssíkja adott sorának
+ * kezdőcímét.
+ *
+ * @param image A kép.
+ * @param channel A komponens indexe (0: kék, 1: zöld, 2: vörös).
+ * @param y A sor indexe.
+ * @return Visszatér a sor első bájtjának címével.
+ */
+static inline uint8_t* image_plane_row(const Image* image, int channel, uint32_t y)
+{
+	return image->data + (size_t)channel * image->plane_size + (size_t)y * image->stride;
+}
+
+/**
+ * @brief A pixelmátrixok foglalásait újrahasznosító gyorsítótár
+ * statisztikái.
+ */
+typedef struct image_pool_statistics_struct
+{
+	uint64_t requests; /* a kért pixelmátrixok száma */
+	uint64_t reuses; /* a gyorsítótárból kiszolgált kérések száma */
+	uint64_t allocated_bytes; /* az újonnan foglalt memória összesen (bájtban) */
+	size_t cached_bytes; /* a gyorsítótárban jelenleg tárolt memória (bájtban) */
+} ImagePoolStatistics;
+
+/**
+ * @brief Egy kép egy legfeljebb IMAGE_TILE_SIZE × IMAGE_TILE_SIZE pixeles
+ * téglalap alakú része (csempéje), melynek sorai Pixel-ekből állnak.
+ */
+typedef struct image_tile_struct
+{
+	uint32_t x; /* a csempe bal felső pixelének oszlopa */
+	uint32_t y; /* a csempe bal felső pixelének sora */
+	uint32_t width; /* a csempe képbe eső részének szélessége */
+	uint32_t height; /* a csempe képbe eső részének magassága */
+	Pixel* pixels; /* a csempe bal felső pixele */
+	size_t stride; /* a csempe két egymást követő sorának távolsága (bájtban) */
+} ImageTile;
+
+/**
+ * @brief Egymást követő, legközelebbi szomszéd szerinti skálázások (lépések)
+ * sora, melyek egyetlen menetben végezhetők el: a célkép egy pontjához
+ * tartozó forráspont a lépések leképezéseinek egymásutánjával adódik.
+ */
+typedef struct image_scale_struct
+{
+	int count; /* a lépések száma */
+	float horizontal[IMAGE_SCALE_MAX_STEPS]; /* a lépések vízszintes skálázási értékei */
+	float vertical[IMAGE_SCALE_MAX_STEPS]; /* a lépések függőleges skálázási értékei */
+} ImageScale;
+
+/**
+ * @brief Egy konvolúciós mag: páratlan szélességű és magasságú súlymátrix,
+ * melynek középső eleme tartozik az éppen számolt képponthoz.
+ */
+typedef struct image_kernel_struct
+{
+	uint32_t width; /* a mag szélessége (páratlan) */
+	uint32_t height; /* a mag magassága (páratlan) */
+	float* weights; /* a súlyok soronként, a felső sortól kezdve */
+} ImageKernel;
+
+/**
+ * @brief Komponensenként egy-egy 256 elemű keresőtábla, mely tetszőleges
+ * számú egymást követő pontművelet (expozíció, kontraszt, gamma, szintek)
+ * összevont leképezését írja le, így a műveletsor egyetlen menetben
+ * végezhető el a képen.
+ */
+typedef struct image_lut_struct
+{
+	uint8_t table[3][256]; /* komponensenként (kék, zöld, vörös) az értékek képe */
+} ImageLut;
+
+/*
+ * Egy sávot feldolgozó függvényre mutató függvénypointer típus: a context a
+ * művelet közös állapota, a [first, last) tartomány a sáv elemei (sorok,
+ * oszlopok vagy csempék), a worker pedig a végrehajtó munkás indexe.
+ */
+typedef void(*fband)(void* context, size_t first, size_t last, int worker);
+
 /* a képstuktúra kezelését megvalósító függvények */
 
 Image* image_create(uint32_t width, uint32_t height);
+size_t image_calculate_stride(uint32_t width);
+int image_set_layout(Image* image, ImageLayout layout);
+void image_copy_row(const Image* image, uint32_t y, Pixel* dst);
+const Pixel* image_get_row(const Image* image, uint32_t y, Pixel* buffer);
+size_t image_tile_count(const Image* image);
+bool image_get_tile(const Image* image, size_t index, ImageTile* p_tile);
+Image* image_create_mapped(uint32_t width, uint32_t height, uint8_t* first_row, size_t row_stride, void* mapping, size_t mapping_size);
 void image_destroy(Image* image);
 
+/* a konvolúciós magokat kezelő függvények */
+
+ImageKernel* image_kernel_create(uint32_t width, uint32_t height);
+void image_kernel_destroy(ImageKernel* kernel);
+
+/* a pontműveletek keresőtábláit kezelő függvények */
+
+void image_lut_identity(ImageLut* lut);
+void image_lut_append(ImageLut* lut, const ImageLut* next);
+void image_lut_exposure(ImageLut* lut, int value);
+int image_lut_contrast(ImageLut* lut, int value);
+int image_lut_gamma(ImageLut* lut, float gamma);
+int image_lut_levels(ImageLut* lut, int black, int white);
+
+/* a pixelmátrixok gyorsítótárát kezelő függvények */
+
+void image_pool_get_statistics(ImagePoolStatistics* p_statistics);
+void image_pool_clear(void);
+int image_pool_set_shared(bool shared);
+
+/* a képműveletek párhuzamos végrehajtását vezérlő függvények */
+
+void image_set_thread_pool(ThreadPool* pool);
+void image_run_bands(fband function, void* context, size_t count, size_t item_size);
+
 /* az elemi képmanipulációkat megvalósító függvények */
 
-int image_scale(Image* image, float horizontal, float vertical);
+int image_scale(Image* image, const ImageScale* scale);
 int image_mirror_x(Image* image);
 int image_mirror_y(Image* image);
-int image_blur(Image* image, int value);
+int image_blur(Image* image, int value, const ImageLut* output);
+int image_gaussian_blur(Image* image, float sigma, const ImageLut* output);
+int image_convolve(Image* image, const ImageKernel* kernel, const ImageLut* output);
 int image_exposure(Image* image, int value);
+int image_apply_lut(Image* image, const ImageLut* lut);
+
+/* az elemi képmanipulációk soronként elvégezhető lépései */
+
+int image_scaled_size(uint32_t width, uint32_t height, const ImageScale* scale, uint32_t* p_new_width, uint32_t* p_new_height);
+uint32_t image_scale_coordinate(uint32_t coordinate, const float* scales, int count);
+void image_scale_row(Pixel* dst, const Pixel* src, uint32_t new_width, const ImageScale* scale);
+void image_blur_row(Pixel* dst, const Pixel* above, const Pixel* row, const Pixel* below, uint32_t width, bool sharpen);
+void image_exposure_row(Pixel* dst, const Pixel* src, uint32_t width, int value);
+void image_lut_row(Pixel* dst, const Pixel* src, uint32_t width, const ImageLut* lut);
 
 #endif /* IMAGE_H_INCLUDED */
@@ -6,20 +6,337 @@
  * @date   November 2022
  *********************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "status.h"
 #include "image.h"
 #include "bmp.h"
 #include "cmd.h"
+#include "batch.h"
+#include "server.h"
+#include "client.h"
+#include "plan.h"
+#include "threadpool.h"
+#include "platform.h"
+#include "allocator.h"
 
+#ifndef NDEBUG
 #include "debugmalloc.h"
+#endif
+
+/**
+ * Megméri és kiírja egy BMP fájl dekódolási sebességét a bitmélységre
+ * specializált és az általános dekódolóval.
+ *
+ * @param path A fájl elérési útja.
+ * @param rounds A dekódolások száma dekódolónként.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a mérés
+ * hibakódjával tér vissza.
+ */
+static int run_benchmark(const char* path, int rounds)
+{
+	int status;
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return IO_ERROR;
+
+	double specialized, reference;
+	if ((status = bmp_benchmark_decode(file, (rounds > 0) ? rounds : 1, &specialized, &reference)) == NO_ERROR)
+	{
+		printf("Dekodolas (specializalt): %.1f MB/s\n", specialized);
+		printf("Dekodolas (altalanos): %.1f MB/s\n", reference);
+	}
+
+	fclose(file);
+
+	return status;
+}
+
+/**
+ * Kiírja több BMP fájl fejlécekből kiolvasható jellemzőit (szélesség,
+ * magasság, bitmélység, tömörítés, becsült memóriaigény), majd a
+ * feldolgozás sebességét. A fájloknak csak a fejlécei kerülnek
+ * beolvasásra, a hibás fájlok pedig nem szakítják meg a feldolgozást.
+ *
+ * @param paths A fájlok elérési útjai.
+ * @param count A fájlok száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként az első hibás
+ * fájl hibakódjával tér vissza.
+ */
+static int run_probe(char* paths[], int count)
+{
+	int first_status = NO_ERROR;
+
+	double start = platform_get_time();
+
+	for (int i = 0; i < count; i++)
+	{
+		int status;
+
+		BmpInfo info;
+
+		FILE* file = fopen(paths[i], "rb");
+		if (file == NULL)
+			status = IO_ERROR;
+		else
+		{
+			/* a fejléceken túli bájtokat fölösleges a pufferbe olvasni */
+			setvbuf(file, NULL, _IONBF, 0);
+			status = bmp_probe(&info, file);
+			fclose(file);
+		}
+
+		if (status == NO_ERROR)
+			printf("%s: %" PRIu32 "x%" PRIu32 ", %" PRIu16 " bit, tomorites: %" PRIu32 ", memoria: %" PRIu64 " bajt\n",
+				paths[i], info.width, info.height, info.bits_per_pixel, info.compression, info.memory_size);
+		else
+		{
+			printf("%s: ", paths[i]);
+			fflush(stdout);
+			status_print(status);
+			if (first_status == NO_ERROR)
+				first_status = status;
+		}
+	}
+
+	double elapsed = platform_get_time() - start;
+	printf("Osszesen: %d fajl, %.0f fajl/s\n", count, (elapsed > 0.0) ? count / elapsed : 0.0);
+
+	return first_status;
+}
+
+/**
+ * Kiírja a folyamat erőforrás-használatát (a rezidens memória csúcsértékét
+ * és a laphibák számát), valamint a pixelmátrixok gyorsítótárának
+ * statisztikáit.
+ */
+static void print_statistics(void)
+{
+	PlatformResourceUsage usage;
+	if (platform_get_resource_usage(&usage) == NO_ERROR)
+	{
+		printf("Rezidens memoria csucsa: %.1f MB\n", usage.peak_resident_size / (1024.0 * 1024.0));
+		printf("Laphibak: %" PRIu64 " kisebb, %" PRIu64 " nagyobb\n", usage.minor_faults, usage.major_faults);
+	}
+
+	ImagePoolStatistics statistics;
+	image_pool_get_statistics(&statistics);
+	printf("Pixelmatrixok: %" PRIu64 " keres, ebbol %" PRIu64 " ujrahasznositott, %.1f MB uj foglalas\n",
+		statistics.requests, statistics.reuses, statistics.allocated_bytes / (1024.0 * 1024.0));
+}
+
+/**
+ * Felszabadítja a műveletek tömbjét.
+ *
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ */
+static void free_operations(Operation* operations, int count)
+{
+	for (int i = 0; i < count; i++)
+		cmd_release_operation(&operations[i]);
+	free(operations);
+}
+
+/**
+ * Feldolgozza a kapcsolókat: a beállításokat az options struktúrába, a
+ * műveleteket egy dinamikusan foglalt tömbbe gyűjti, majd egyszerűsíti a
+ * végrehajtási tervet. A műveletek tömbjének felszabadítása
+ * (free_operations) sikeres lefutás esetén a hívó feladata.
+ *
+ * @param options A beállítások helye (az alapértelmezett értékekkel).
+ * @param p_operations A műveletek tömbjének helye.
+ * @param p_count A műveletek számának helye.
+ * @param arguments A kapcsolók.
+ * @param argument_count A kapcsolók száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a kapcsolók
+ * feldolgozásának hibakódjával tér vissza.
+ */
+static int parse_switches(Options* options, Operation** p_operations, int* p_count, char* arguments[], int argument_count)
+{
+	int status;
+
+	int count;
+	Operation* operations = (Operation*)malloc((argument_count + 1) * sizeof(Operation));
+	if (operations == NULL)
+		return MEMORY_ERROR;
+
+	if ((status = cmd_parse_switches(options, operations, &count, arguments, argument_count)) != NO_ERROR)
+	{
+		free(operations);
+		return status;
+	}
+
+	/* a kapcsolók csak a terv egyszerűsítése után, a szükséges menetekben futnak */
+	int switch_count = count;
+	if ((status = plan_optimize(operations, &count)) != NO_ERROR)
+	{
+		free_operations(operations, count);
+		return status;
+	}
+	if (options->explain)
+		plan_print(operations, count, switch_count);
+
+	allocator_set_backend(options->allocator);
+
+	*p_operations = operations;
+	*p_count = count;
+
+	return NO_ERROR;
+}
+
+/**
+ * Végrehajtja ugyanazt a műveletsort több fájlon, majd kiírja a hibás
+ * fájlokat és a feldolgozás sebességét (fájl/s és megapixel/s). A fájlok
+ * egy listafájlból (soronként egy bemeneti és egy kimeneti fájl), vagy egy
+ * könyvtár BMP fájljaiból származnak; utóbbi esetben az eredmény azonos
+ * néven a kimeneti könyvtárba kerül.
+ *
+ * @param arguments A -batch kapcsolót követő argumentumok.
+ * @param argument_count A -batch kapcsolót követő argumentumok száma.
+ * @param options A beállítások helye (az alapértelmezett értékekkel).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a feldolgozás
+ * vagy az első hibás fájl hibakódjával tér vissza.
+ */
+static int run_batch(char* arguments[], int argument_count, Options* options)
+{
+	int status, first_status = NO_ERROR;
+
+	BatchJob* jobs;
+	int job_count;
+
+	bool directory = platform_is_directory(arguments[0]);
+	if (directory && (status = cmd_check_argc(argument_count, 2)) != NO_ERROR)
+		goto print_status;
+
+	int first_switch = directory ? 2 : 1;
+
+	Operation* operations;
+	int operation_count;
+	if ((status = parse_switches(options, &operations, &operation_count, arguments + first_switch, argument_count - first_switch)) != NO_ERROR)
+		goto print_status;
+
+	if (directory)
+		status = batch_read_directory(&jobs, &job_count, arguments[0], arguments[1]);
+	else
+		status = batch_read_list(&jobs, &job_count, arguments[0]);
+	if (status != NO_ERROR)
+		goto release_operations;
+
+	BatchStatistics statistics;
+	if ((status = batch_run(jobs, job_count, operations, operation_count, options, &statistics)) != NO_ERROR)
+		goto destroy_jobs;
+
+	for (int i = 0; i < job_count; i++)
+	{
+		if (jobs[i].status == NO_ERROR)
+			continue;
+		printf("%s: ", jobs[i].input_path);
+		fflush(stdout);
+		status_print(jobs[i].status);
+		if (first_status == NO_ERROR)
+			first_status = jobs[i].status;
+	}
+
+	double elapsed = statistics.elapsed;
+	printf("Osszesen: %d fajl (%d hibas), %.2f s, %.1f fajl/s, %.1f MP/s\n", statistics.file_count, statistics.failed_count, elapsed,
+		(elapsed > 0.0) ? statistics.file_count / elapsed : 0.0, (elapsed > 0.0) ? statistics.pixel_count / elapsed / 1e6 : 0.0);
+
+	if (options->statistics)
+		print_statistics();
+	image_pool_clear();
+
+destroy_jobs:
+	batch_destroy_jobs(jobs, job_count);
+release_operations:
+	free_operations(operations, operation_count);
+print_status:
+	/* a hibás fájlok hibakódja már a fájlnév mellett megjelent */
+	if (status != NO_ERROR)
+	{
+		status_print(status);
+		return status;
+	}
+
+	return first_status;
+}
+
+/**
+ * Elindítja a szervert a megadott socketfájlon, és a leállító kérésig
+ * kiszolgálja a kéréseket, majd kiírja a kiszolgált kérések számát.
+ *
+ * @param path A socket fájljának elérési útja.
+ * @param arguments A beállítások kapcsolói (műveletek nélkül).
+ * @param argument_count A kapcsolók száma.
+ * @param options A beállítások helye (az alapértelmezett értékekkel).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a kapcsolók vagy
+ * a szerver hibakódjával tér vissza.
+ */
+static int run_server(const char* path, char* arguments[], int argument_count, Options* options)
+{
+	int status;
+
+	for (int i = 0; i < argument_count; i++)
+		if ((status = cmd_parse_option(options, arguments[i])) != NO_ERROR)
+			return status;
+
+	allocator_set_backend(options->allocator);
+
+	ServerStatistics statistics;
+	if ((status = server_run(path, options, &statistics)) != NO_ERROR)
+		return status;
+
+	printf("Kiszolgalt keresek: %" PRIu64 " (%" PRIu64 " hibas)\n", statistics.request_count, statistics.failed_count);
+
+	if (options->statistics)
+		print_statistics();
+	image_pool_clear();
+
+	return NO_ERROR;
+}
+
+/**
+ * Megméri a szerver válaszidejét több kapcsolaton párhuzamosan küldött
+ * kérésekkel, majd kiírja az áteresztőképességet és a válaszidők
+ * eloszlását.
+ *
+ * @param arguments A -loadgen kapcsolót követő argumentumok (socket,
+ * bemeneti kép, kimeneti könyvtár, kérések és kapcsolatok száma, majd a
+ * kapcsolók).
+ * @param argument_count Az argumentumok száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a mérés
+ * hibakódjával tér vissza.
+ */
+static int run_loadgen(char* arguments[], int argument_count)
+{
+	int status;
+
+	if ((status = cmd_check_argc(argument_count, 5)) != NO_ERROR)
+		return status;
+
+	ClientStatistics statistics;
+	if ((status = client_benchmark(arguments[0], arguments[1], arguments[2], arguments + 5, argument_count - 5,
+		atoi(arguments[3]), atoi(arguments[4]), &statistics)) != NO_ERROR)
+		return status;
+
+	double elapsed = statistics.elapsed;
+	printf("Keresek: %d (%d hibas), %.2f s, %.1f keres/s\n", statistics.request_count, statistics.failed_count, elapsed,
+		(elapsed > 0.0) ? statistics.request_count / elapsed : 0.0);
+	printf("Valaszido: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+		statistics.median * 1000.0, statistics.percentile_99 * 1000.0, statistics.maximum * 1000.0);
+
+	return NO_ERROR;
+}
 
  /**
   * A program belépési pontja.
   * Itt történik
   *   - az argumentumok validálása (részben),
   *   - az erőforrások kezelése (allokátorok, deallokátorok vezérlése),
-  *   - az argumentumokban meghatározott műveletek meghívása.
+  *   - az argumentumokban meghatározott műveletek meghívása; soronként
+  *     elvégezhető műveletsor esetén a kép memóriába töltése nélkül.
   * @param argc Argumentumok száma beleértve a futtatható bináris nevét.
   * @param argv A NULL-terminált arugmentumvektor.
   * @return A program visszatérési kódja, mely sikeres lefutás esetén
@@ -33,6 +350,13 @@ int main(int argc, char* argv[])
 	if (cmd_find_argument(argv + 1, "-h"))
 	{
 		const char* help_string = "Hasznalat: photoman <kep_be> <kep_ki> [opciok]\n"
+			"          photoman -batch <lista> [opciok]\n"
+			"          photoman -batch <konyvtar_be> <konyvtar_ki> [opciok]\n"
+			"          photoman -server <socket> [opciok]\n"
+			"          photoman -client <socket> <kep_be> <kep_ki> [opciok] | -stop\n"
+			"          photoman -loadgen <socket> <kep_be> <konyvtar_ki> <keresek> <kapcsolatok> [opciok]\n"
+			"          photoman -bench <kep_be> [ismetlesek]\n"
+			"          photoman -probe <kep_be>...\n"
 			"Alapveto manipulaciot kepes vegezni egy BMP formatumu kepen.\n\n"
 			"Bemeneti vagy kimeneti fajl hijan csak a sugot kepes kiirni.\n\n"
 			"Opciok:\n"
@@ -40,7 +364,45 @@ int main(int argc, char* argv[])
 			"  -s<xy>=parameter: horizontalis skalazas\n"
 			"  -m<xy>: tukrozes az x/y tengelyre\n"
 			"  -b=parameter: Gauss-elmosas merteke\n"
-			"  -e=parameter: expozicio eltolasanak merteke (negativ - sotetit, pozitiv - vilagosit)";
+			"  -e=parameter: expozicio eltolasanak merteke (negativ - sotetit, pozitiv - vilagosit)\n"
+			"  -c=parameter: kontraszt modositasa -255 es 255 kozott (negativ - csokkenti, pozitiv - noveli)\n"
+			"  -gamma=parameter: gammakorrekcio (1-nel nagyobb - vilagosit, kisebb - sotetit)\n"
+			"  -l=<fekete>,<feher>: szintek, a [fekete, feher] tartomany kinyujtasa a teljes tartomanyra\n"
+			"               (az egymast koveto -e, -c, -gamma es -l muveletek egyetlen menetben futnak)\n"
+			"  -g=parameter: Gauss-elmosas szorasa pixelben (legfeljebb 1000), a futasido nem fugg tole\n"
+			"  -k=<sz>x<m>:s1,s2,...[/oszto]: konvolucio paratlan, legfeljebb 255x255 meretu maggal; a sulyok soronkent,\n"
+			"               a felso sortol kezdve; a szeparalhato es a nagy magok gyorsabb uton futnak\n"
+			"  -j=parameter: a beolvasast, a muveleteket es a kiirast vegzo szalak szama (alapertelmezetten\n"
+			"               a processzormagok szama); a soronkent elvegezheto muveletsorok a szalak szamatol\n"
+			"               fuggetlenul a kep memoriaba toltese nelkul, blokkonkent futnak\n"
+			"  -o=formatum: a kimeneti kep formatuma: 24 (24 bites, alapertelmezett), 1, 4, 8 (1/4/8 bites, palettas)\n"
+			"               vagy rle8 (8 bites, palettas, RLE8 tomoritesu); a tul sok szinu kepek palettaja kvantalt\n"
+			"  -d: rendezett szoras a kvantalt palettaju kimenetnel\n"
+			"  -alloc=mod: a pixelmatrixok foglalasa: debug (debugmalloc, csak debug buildben), libc\n"
+			"              vagy huge (2 MB-os igazitas, nagy lapok); alapertelmezetten debug buildben debug, egyebkent huge\n"
+			"  -tiles: a kep csempes (64x64 pixeles) tarolasa a muveletek alatt, nagyon szeles kepekhez\n"
+			"  -explain: az egyszerusitett vegrehajtasi terv kiirasa (a kioltott tukrozesek, osszevont skalazasok\n"
+			"            es a konvoluciokra olvasztott pontmuveletek mar nem kulon lepesek)\n"
+			"  -mem=parameter: kotegelt feldolgozasnal az egyszerre feldolgozott kepek becsult memoriaigenyenek\n"
+			"                 korlatja MB-ban (alapertelmezetten 1024)\n"
+			"  -stat: a memoriahasznalat csucsanak, a laphibaknak es a pixelmatrixok ujrahasznositasanak kiirasa\n\n"
+			"Kotegelt feldolgozas:\n"
+			"  -batch: ugyanannak a muveletsornak a vegrehajtasa tobb fajlon; a lista soronkent egy bemeneti es egy\n"
+			"          kimeneti fajlt tartalmaz (tabulatorral vagy szokozzel elvalasztva), konyvtar eseten pedig a\n"
+			"          .bmp fajlok azonos neven a kimeneti konyvtarba kerulnek; release buildben a fajlok a -j szalon\n"
+			"          parhuzamosan futnak; a vegen a hibas fajlok es a sebesseg (fajl/s, MP/s) jelenik meg\n\n"
+			"Szerver:\n"
+			"  -server: a keresek fogadasa egy helyi (Unix domain) socketen, a folyamatosan futo, bemelegitett\n"
+			"           munkasszalakon (release buildben -j szal, keresenkent egy); a 60 mp-ig tetlen kapcsolatok lezarulnak;\n"
+			"           az opciok a keresek alapertelmezesei (a folyamatra vonatkozo -alloc es -explain a keresekben\n"
+			"           nem megengedett)\n"
+			"  -client: egy keres kuldese a szervernek (a relativ utak a szerver munkakonyvtarahoz kepest ertendok),\n"
+			"           vagy a szerver leallitasa (-stop)\n"
+			"  -loadgen: a szerver valaszidejenek merese (p50, p99) a megadott szamu kapcsolaton parhuzamosan kuldott\n"
+			"            keresekkel; a kapcsolatok a kimeneti konyvtar <kapcsolat>.bmp fajljaiba irnak\n\n"
+			"Meresek:\n"
+			"  -bench: a bemeneti kep dekodolasi sebessegenek merese (MB/s)\n"
+			"  -probe: a bemeneti kepek meretenek, bitmelysegenek, tomoritesenek es becsult memoriaigenyenek kiirasa a kepek beolvasasa nelkul";
 		puts(help_string);
 		goto print_status;
 	}
@@ -48,11 +410,61 @@ int main(int argc, char* argv[])
 	if ((status = cmd_check_argc(argc, 3)) != NO_ERROR)
 		goto print_status;
 
+	if (strcmp(argv[1], "-probe") == 0)
+	{
+		/* a hibás fájlok hibakódja már a fájlnév mellett megjelent */
+		return run_probe(argv + 2, argc - 2);
+	}
+
+	if (strcmp(argv[1], "-bench") == 0)
+	{
+		status = run_benchmark(argv[2], (argc > 3) ? atoi(argv[3]) : 10);
+		goto print_status;
+	}
+
+	Options options = { .thread_count = platform_get_cpu_count(), .output_format = BMP_FORMAT_RGB24, .dither = false, .statistics = false,
+		.allocator = ALLOCATOR_DEFAULT_BACKEND, .tiled = false, .explain = false, .memory_limit = BATCH_DEFAULT_MEMORY_LIMIT };
+
+	if (strcmp(argv[1], "-batch") == 0)
+	{
+		/* a hibakódok a fájlnevek mellett, illetve a feldolgozás végén már megjelentek */
+		return run_batch(argv + 2, argc - 2, &options);
+	}
+
+	if (strcmp(argv[1], "-server") == 0)
+	{
+		status = run_server(argv[2], argv + 3, argc - 3, &options);
+		goto print_status;
+	}
+
+	if (strcmp(argv[1], "-client") == 0)
+	{
+		/* a szerver által jelzett hibakód a kliens hibakódja */
+		int remote_status;
+		if (argc == 4 && strcmp(argv[3], SERVER_STOP_REQUEST) == 0)
+			status = client_stop(argv[2]);
+		else if ((status = cmd_check_argc(argc, 5)) == NO_ERROR &&
+			(status = client_send(argv[2], argv[3], argv[4], argv + 5, argc - 5, &remote_status)) == NO_ERROR)
+			status = remote_status;
+		goto print_status;
+	}
+
+	if (strcmp(argv[1], "-loadgen") == 0)
+	{
+		status = run_loadgen(argv + 2, argc - 2);
+		goto print_status;
+	}
+
+	Operation* operations;
+	int operation_count;
+	if ((status = parse_switches(&options, &operations, &operation_count, argv + 3, argc - 3)) != NO_ERROR)
+		goto print_status;
+
 	FILE* input_file = fopen(argv[1], "rb");
 	if (input_file == NULL)
 	{
 		status = IO_ERROR;
-		goto print_status;
+		goto release_operations;
 	}
 
 	FILE* output_file = fopen(argv[2], "wb");
@@ -62,28 +474,28 @@ int main(int argc, char* argv[])
 		goto close_input;
 	}
 
-	Image* image;
-
-	if ((status = bmp_load(&image, input_file)) != NO_ERROR)
+	ThreadPool* pool = NULL;
+	if (options.thread_count > 1 && (status = threadpool_create(&pool, options.thread_count)) != NO_ERROR)
 		goto close_output;
 
-	for (int i = 3; i < argc; i++)
-	{
-		status = cmd_parse_manip_switch(image, argv[i]);
-		if (status != NO_ERROR)
-			goto destroy_image;
-	}
+	/* a műveletek a kép vízszintes sávjain párhuzamosan futnak */
+	image_set_thread_pool(pool);
 
-	if ((status = bmp_store(&image, output_file)) != NO_ERROR)
-		goto destroy_image;
+	status = batch_process_file(input_file, output_file, operations, operation_count, &options, pool);
 
-destroy_image:
-	image_destroy(image);
+	image_set_thread_pool(NULL);
+	if (pool != NULL)
+		threadpool_destroy(pool);
 close_output:
 	fflush(output_file);
 	fclose(output_file);
 close_input:
 	fclose(input_file);
+	if (options.statistics)
+		print_statistics();
+	image_pool_clear();
+release_operations:
+	free_operations(operations, operation_count);
 print_status:
 	if (status != NO_ERROR)
 		status_print(status);
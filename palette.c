@@ -0,0 +1,458 @@
+﻿/*****************************************************************//**
+ * @file   palette.c
+ * @brief  A palettás (indexelt színű) kimenethez szükséges színpaletta
+ * előállítását és a pixelek palettaindexekre való leképezését megvalósító
+ * modul forrásfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "palette.h"
+#include "status.h"
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* 8x8-as Bayer-mátrix a rendezett szóráshoz (küszöbértékek 0-tól 63-ig) */
+static const uint8_t bayer8[8][8] = {
+	{  0, 32,  8, 40,  2, 34, 10, 42 },
+	{ 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44,  4, 36, 14, 46,  6, 38 },
+	{ 60, 28, 52, 20, 62, 30, 54, 22 },
+	{  3, 35, 11, 43,  1, 33,  9, 41 },
+	{ 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47,  7, 39, 13, 45,  5, 37 },
+	{ 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+/* a medián vágás egy doboza a 15 bites színtérben */
+struct palette_box_struct
+{
+	uint8_t low[3]; /* a doboz alsó határai komponensenként (vörös, zöld, kék) */
+	uint8_t high[3]; /* a doboz felső határai komponensenként (zárt) */
+	uint64_t population; /* a dobozba eső pixelek száma */
+};
+
+/**
+ * Előállítja egy szín hasítótáblabeli kulcsát. A kulcs sosem nulla, így a
+ * nulla az üres rekeszt jelölheti.
+ *
+ * @param color A szín.
+ * @return Visszatér a kulccsal.
+ */
+static uint32_t palette_key(Pixel color)
+{
+	return (((uint32_t)color.red << 16) | ((uint32_t)color.green << 8) | color.blue) + 1;
+}
+
+/**
+ * Megkeresi egy kulcs rekeszét a hasítótáblában (nyílt címzés, lineáris
+ * próbálkozás). A tábla legfeljebb negyedéig telik meg, így mindig van
+ * üres rekesz.
+ *
+ * @param palette A paletta.
+ * @param key A kulcs.
+ * @return Visszatér a kulcsot tartalmazó, ennek hiányában pedig az első
+ * üres rekesz indexével.
+ */
+static uint32_t palette_find_slot(const Palette* palette, uint32_t key)
+{
+	uint32_t slot = (key * 2654435761u) >> 22; /* Fibonacci-hasítás 10 bitre */
+	while (palette->keys[slot] != 0 && palette->keys[slot] != key)
+		slot = (slot + 1) & (PALETTE_HASH_SIZE - 1);
+	return slot;
+}
+
+/**
+ * Összegyűjti egy kép összes különböző színét egy palettába, amennyiben
+ * azok száma nem haladja meg a max_colors-t. A színek a képbeli első
+ * előfordulásuk sorrendjében kapják az indexüket.
+ *
+ * @param palette A kitöltendő, kiürített paletta.
+ * @param image A kép.
+ * @param max_colors A paletta legnagyobb mérete.
+ * @param buffer Síkos elrendezésű kép esetén egy sornyi puffer (egyébként
+ * NULL).
+ * @return Amennyiben a kép színei elférnek a palettában, logikai igazzal,
+ * egyébként logikai hamissal tér vissza.
+ */
+static bool palette_build_exact(Palette* palette, const Image* image, uint32_t max_colors, Pixel* buffer)
+{
+	for (uint32_t y = 0; y < image->height; y++)
+	{
+		const Pixel* row = image_get_row(image, y, buffer);
+		uint32_t last_key = 0;
+
+		for (uint32_t x = 0; x < image->width; x++)
+		{
+			uint32_t key = palette_key(row[x]);
+			/* az egyszínű területeken a legtöbb pixel az előzővel egyezik */
+			if (key == last_key)
+				continue;
+			last_key = key;
+
+			uint32_t slot = palette_find_slot(palette, key);
+			if (palette->keys[slot] == key)
+				continue;
+
+			if (palette->count == max_colors)
+				return false;
+
+			palette->keys[slot] = key;
+			palette->indices[slot] = (uint8_t)palette->count;
+			palette->colors[palette->count++] = row[x];
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Megadja egy szín 15 bites cellájának indexét.
+ *
+ * @param red A vörös komponens.
+ * @param green A zöld komponens.
+ * @param blue A kék komponens.
+ * @return Visszatér a cella indexével.
+ */
+static uint32_t palette_cell(uint32_t red, uint32_t green, uint32_t blue)
+{
+	return ((red >> 3) << 10) | ((green >> 3) << 5) | (blue >> 3);
+}
+
+/**
+ * Kiszámolja egy doboz egy komponens menti hisztogramját.
+ *
+ * @param histogram A 15 bites színtér hisztogramja.
+ * @param box A doboz.
+ * @param axis A komponens (0: vörös, 1: zöld, 2: kék).
+ * @param counts A komponens 32 lehetséges értékéhez tartozó darabszámok helye.
+ */
+static void palette_box_project(const uint64_t* histogram, const struct palette_box_struct* box, int axis, uint64_t counts[32])
+{
+	memset(counts, 0, 32 * sizeof(uint64_t));
+
+	for (uint32_t r = box->low[0]; r <= box->high[0]; r++)
+		for (uint32_t g = box->low[1]; g <= box->high[1]; g++)
+			for (uint32_t b = box->low[2]; b <= box->high[2]; b++)
+			{
+				uint32_t value = (axis == 0) ? r : (axis == 1) ? g : b;
+				counts[value] += histogram[(r << 10) | (g << 5) | b];
+			}
+}
+
+/**
+ * Összehúzza egy doboz határait a benne ténylegesen előforduló színekre, és
+ * kiszámolja a populációját.
+ *
+ * @param histogram A 15 bites színtér hisztogramja.
+ * @param box A doboz.
+ */
+static void palette_box_shrink(const uint64_t* histogram, struct palette_box_struct* box)
+{
+	uint64_t counts[32];
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		palette_box_project(histogram, box, axis, counts);
+
+		uint32_t low = box->low[axis], high = box->high[axis];
+		while (low < high && counts[low] == 0)
+			low++;
+		while (high > low && counts[high] == 0)
+			high--;
+		box->low[axis] = (uint8_t)low;
+		box->high[axis] = (uint8_t)high;
+
+		if (axis == 0)
+		{
+			box->population = 0;
+			for (uint32_t v = low; v <= high; v++)
+				box->population += counts[v];
+		}
+	}
+}
+
+/**
+ * Előállít egy legfeljebb max_colors színből álló palettát medián vágással:
+ * a kép színeinek 15 bites hisztogramját befoglaló dobozból kiindulva
+ * ismételten azt a dobozt vágja ketté a leghosszabb oldala mentén, a
+ * populáció mediánjánál, melyre a populáció és a leghosszabb oldal szorzata
+ * a legnagyobb, majd a dobozok színeit a beléjük eső pixelek átlagszíne
+ * adja.
+ *
+ * @param palette A kitöltendő, kiürített paletta.
+ * @param histogram A kép 15 bites hisztogramja.
+ * @param sums A cellákba eső pixelek komponensenkénti összegei (cellánként 3).
+ * @param max_colors A paletta legnagyobb mérete.
+ */
+static void palette_median_cut(Palette* palette, const uint64_t* histogram, const uint64_t* sums, uint32_t max_colors)
+{
+	struct palette_box_struct boxes[PALETTE_MAX_COLORS];
+	uint32_t box_count = 1;
+
+	boxes[0] = (struct palette_box_struct){ { 0, 0, 0 }, { 31, 31, 31 }, 0 };
+	palette_box_shrink(histogram, &boxes[0]);
+
+	while (box_count < max_colors)
+	{
+		/* a populáció és a leghosszabb oldal szorzata szerinti legnagyobb doboz */
+		int chosen = -1;
+		uint64_t chosen_score = 0;
+		for (uint32_t i = 0; i < box_count; i++)
+		{
+			const struct palette_box_struct* box = &boxes[i];
+			uint32_t side = 0;
+			for (int axis = 0; axis < 3; axis++)
+				if ((uint32_t)(box->high[axis] - box->low[axis]) > side)
+					side = box->high[axis] - box->low[axis];
+			uint64_t score = box->population * side;
+			if (score > chosen_score)
+			{
+				chosen = (int)i;
+				chosen_score = score;
+			}
+		}
+		if (chosen < 0)
+			break;
+
+		struct palette_box_struct* box = &boxes[chosen];
+
+		int axis = 0;
+		for (int i = 1; i < 3; i++)
+			if (box->high[i] - box->low[i] > box->high[axis] - box->low[axis])
+				axis = i;
+
+		uint64_t counts[32];
+		palette_box_project(histogram, box, axis, counts);
+
+		/* a medián utáni első értéknél vágunk, de mindkét fél nemüres marad */
+		uint32_t cut = box->low[axis];
+		uint64_t below = counts[cut];
+		while (cut + 1 < box->high[axis] && below * 2 < box->population)
+			below += counts[++cut];
+
+		struct palette_box_struct upper = *box;
+		upper.low[axis] = (uint8_t)(cut + 1);
+		box->high[axis] = (uint8_t)cut;
+
+		palette_box_shrink(histogram, box);
+		palette_box_shrink(histogram, &upper);
+		boxes[box_count++] = upper;
+	}
+
+	for (uint32_t i = 0; i < box_count; i++)
+	{
+		const struct palette_box_struct* box = &boxes[i];
+		uint64_t total[3] = { 0, 0, 0 };
+
+		for (uint32_t r = box->low[0]; r <= box->high[0]; r++)
+			for (uint32_t g = box->low[1]; g <= box->high[1]; g++)
+				for (uint32_t b = box->low[2]; b <= box->high[2]; b++)
+				{
+					uint32_t cell = (r << 10) | (g << 5) | b;
+					total[0] += sums[cell * 3 + 0];
+					total[1] += sums[cell * 3 + 1];
+					total[2] += sums[cell * 3 + 2];
+				}
+
+		uint64_t population = (box->population > 0) ? box->population : 1;
+		palette->colors[i].red = (uint8_t)((total[0] + population / 2) / population);
+		palette->colors[i].green = (uint8_t)((total[1] + population / 2) / population);
+		palette->colors[i].blue = (uint8_t)((total[2] + population / 2) / population);
+	}
+	palette->count = box_count;
+}
+
+/**
+ * Kiszámolja a színtér minden 15 bites cellájához (a cella középpontjához)
+ * legközelebbi palettaszín indexét.
+ *
+ * @param palette A paletta.
+ */
+static void palette_build_nearest(Palette* palette)
+{
+	for (uint32_t cell = 0; cell < PALETTE_CELL_COUNT; cell++)
+	{
+		int red = (int)((cell >> 10) << 3) + 4;
+		int green = (int)(((cell >> 5) & 31) << 3) + 4;
+		int blue = (int)((cell & 31) << 3) + 4;
+
+		uint32_t best = 0;
+		int best_distance = 3 * 256 * 256;
+		for (uint32_t i = 0; i < palette->count; i++)
+		{
+			int dr = red - palette->colors[i].red;
+			int dg = green - palette->colors[i].green;
+			int db = blue - palette->colors[i].blue;
+			int distance = dr * dr + dg * dg + db * db;
+			if (distance < best_distance)
+			{
+				best_distance = distance;
+				best = i;
+			}
+		}
+		palette->nearest[cell] = (uint8_t)best;
+	}
+}
+
+/**
+ * Előállít egy legfeljebb max_colors színből álló palettát egy képhez. Ha a
+ * kép összes színe elfér benne, a paletta pontos, egyébként a kép
+ * hisztogramjából medián vágással készül. Kvantált paletta esetén
+ * kiszámolja a rendezett szórás amplitúdóját is, mely a palettaszínek
+ * komponensenkénti átlagos távolságával arányos.
+ *
+ * @param palette A kitöltendő paletta.
+ * @param image A kép.
+ * @param max_colors A paletta legnagyobb mérete (legfeljebb
+ * PALETTE_MAX_COLORS).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int palette_build(Palette* palette, const Image* image, uint32_t max_colors)
+{
+	int status = NO_ERROR;
+
+	uint64_t* histogram = NULL;
+	uint64_t* sums = NULL;
+
+	/* a síkos és a csempés elrendezésű kép sorait egy pufferbe fésüljük össze */
+	Pixel* buffer = NULL;
+	if (image->layout != IMAGE_LAYOUT_INTERLEAVED)
+	{
+		size_t buffer_size = (image->width > 0 ? image->width : 1) * sizeof(Pixel);
+		allocator_reserve(buffer_size);
+
+		buffer = (Pixel*)malloc(buffer_size);
+		if (buffer == NULL)
+			return MEMORY_ERROR;
+	}
+
+	memset(palette, 0, sizeof(Palette));
+
+	if (palette_build_exact(palette, image, max_colors, buffer))
+	{
+		palette->exact = true;
+		goto free_buffer;
+	}
+
+	memset(palette, 0, sizeof(Palette));
+
+	/* egy cella számlálója gigapixeles képeken a 32 bitet is meghaladhatja */
+	histogram = (uint64_t*)malloc(PALETTE_CELL_COUNT * sizeof(uint64_t));
+	if (histogram == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto free_buffer;
+	}
+
+	size_t sums_size = PALETTE_CELL_COUNT * 3 * sizeof(uint64_t);
+	allocator_reserve(sums_size);
+
+	sums = (uint64_t*)malloc(sums_size);
+	if (sums == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto free_histogram;
+	}
+
+	memset(histogram, 0, PALETTE_CELL_COUNT * sizeof(uint64_t));
+	memset(sums, 0, sums_size);
+
+	for (uint32_t y = 0; y < image->height; y++)
+	{
+		const Pixel* row = image_get_row(image, y, buffer);
+		for (uint32_t x = 0; x < image->width; x++)
+		{
+			uint32_t cell = palette_cell(row[x].red, row[x].green, row[x].blue);
+			histogram[cell]++;
+			sums[cell * 3 + 0] += row[x].red;
+			sums[cell * 3 + 1] += row[x].green;
+			sums[cell * 3 + 2] += row[x].blue;
+		}
+	}
+
+	palette_median_cut(palette, histogram, sums, max_colors);
+	palette_build_nearest(palette);
+
+	/* n szín esetén komponensenként nagyjából n^(1/3) szint jut */
+	int levels = 1;
+	while ((uint32_t)((levels + 1) * (levels + 1) * (levels + 1)) <= palette->count)
+		levels++;
+	palette->dither_spread = 256 / (levels + 1);
+
+	free(sums);
+free_histogram:
+	free(histogram);
+free_buffer:
+	if (buffer != NULL)
+		free(buffer);
+
+	return status;
+}
+
+/**
+ * Leképezi egy pixelsor színeit a palettabeli indexükre. Pontos paletta
+ * esetén a színek a saját indexüket, a palettában nem szereplő színek a 0
+ * indexet kapják. Kvantált paletta esetén a legközelebbi palettaszín
+ * indexét kapják, melyet rendezett szórás esetén a pixel pozíciójától
+ * függő (Bayer-mátrixbeli) eltolás után keresünk meg.
+ *
+ * @param palette A paletta.
+ * @param indices A kép szélességével megegyező hosszú cél indexsor.
+ * @param row A pixelsor.
+ * @param width A sor szélessége.
+ * @param y A sor indexe (a szórás mintázatához).
+ * @param dither Alkalmazzon-e rendezett szórást (csak kvantált palettánál).
+ */
+void palette_map_row(const Palette* palette, uint8_t* indices, const Pixel* row, uint32_t width, uint32_t y, bool dither)
+{
+	if (!palette->exact)
+	{
+		if (!dither)
+		{
+			for (uint32_t x = 0; x < width; x++)
+				indices[x] = palette->nearest[palette_cell(row[x].red, row[x].green, row[x].blue)];
+			return;
+		}
+
+		/* a küszöbértékek [-spread/2, spread/2) közé eső eltolássá alakítva */
+		int offsets[8];
+		for (int i = 0; i < 8; i++)
+			offsets[i] = (2 * bayer8[y & 7][i] - 63) * palette->dither_spread / 128;
+
+		for (uint32_t x = 0; x < width; x++)
+		{
+			int offset = offsets[x & 7];
+			int red = row[x].red + offset;
+			int green = row[x].green + offset;
+			int blue = row[x].blue + offset;
+			red = (red < 0) ? 0 : (red > 255) ? 255 : red;
+			green = (green < 0) ? 0 : (green > 255) ? 255 : green;
+			blue = (blue < 0) ? 0 : (blue > 255) ? 255 : blue;
+			indices[x] = palette->nearest[palette_cell((uint32_t)red, (uint32_t)green, (uint32_t)blue)];
+		}
+		return;
+	}
+
+	uint32_t last_key = 0;
+	uint8_t last_index = 0;
+
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t key = palette_key(row[x]);
+		if (key != last_key)
+		{
+			uint32_t slot = palette_find_slot(palette, key);
+			last_index = (palette->keys[slot] == key) ? palette->indices[slot] : 0;
+			last_key = key;
+		}
+		indices[x] = last_index;
+	}
+}
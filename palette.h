@@ -0,0 +1,44 @@
+﻿/*****************************************************************//**
+ * @file   palette.h
+ * @brief  A palettás (indexelt színű) kimenethez szükséges színpaletta
+ * előállítását és a pixelek palettaindexekre való leképezését megvalósító
+ * modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef PALETTE_H_INCLUDED
+#define PALETTE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "image.h"
+
+#define PALETTE_MAX_COLORS		256
+#define PALETTE_HASH_SIZE		1024
+#define PALETTE_CELL_COUNT		32768
+
+/**
+ * @brief Legfeljebb PALETTE_MAX_COLORS színből álló paletta, a színeket
+ * indexükre leképező táblázatokkal együtt.
+ *
+ * Ha a kép összes színe elfér a palettában (pontos paletta), a leképezés
+ * egy hasítótáblával, egyébként (kvantált paletta) a színtér 15 bites
+ * (komponensenként 5 bites) celláihoz előre kiszámolt legközelebbi
+ * palettaszínekkel történik.
+ */
+typedef struct palette_struct
+{
+	Pixel colors[PALETTE_MAX_COLORS]; /* a paletta színei */
+	uint32_t count; /* a színek száma */
+	bool exact; /* pontos-e a paletta */
+	uint32_t keys[PALETTE_HASH_SIZE]; /* hasítótábla: a szín 24 bites kódja + 1 (0: üres) */
+	uint8_t indices[PALETTE_HASH_SIZE]; /* hasítótábla: a szín indexe */
+	uint8_t nearest[PALETTE_CELL_COUNT]; /* cellánként a legközelebbi szín indexe */
+	int dither_spread; /* a rendezett szórás amplitúdója (komponensenként) */
+} Palette;
+
+int palette_build(Palette* palette, const Image* image, uint32_t max_colors);
+void palette_map_row(const Palette* palette, uint8_t* indices, const Pixel* row, uint32_t width, uint32_t y, bool dither);
+
+#endif /* PALETTE_H_INCLUDED */
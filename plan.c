@@ -0,0 +1,448 @@
+﻿/*****************************************************************//**
+ * @file   plan.c
+ * @brief  A parancssori kapcsolókból értelmezett műveletsort végrehajtás
+ * előtt egyszerűsítő (végrehajtási tervvé alakító) modul forrásfájlja.
+ *
+ * A kapcsolók a kép betöltése előtt egy műveletsorba kerülnek, melyet a
+ * terv algebrai átírásokkal egyszerűsít, így csak a szükséges menetek
+ * futnak le. Az átírások nem változtatják meg az eredményt (bájtra
+ * ugyanaz, mint a műveletek egyenkénti végrehajtásáé), és a hibás
+ * paraméterezésű műveleteket sem tüntetik el:
+ *   - a pontműveletek a tükrözések és a nagyítások elé kerülnek (a
+ *     képpontok helyét nem, csak az értékét változtatják, így felcserélhetők,
+ *     a nagyítás előtt pedig kevesebb képponton futnak),
+ *   - az azonos tengelyű tükrözéspárok (köztük csak pontműveletekkel és
+ *     a másik tengelyű tükrözésekkel) kiesnek,
+ *   - az egymást követő skálázások egyetlen, több lépéses skálázássá,
+ *     egyetlen menetté és egyetlen foglalássá olvadnak, az identitások
+ *     kiesnek,
+ *   - a konvolúciók (elhomályosítás, Gauss-elmosás, tetszőleges mag)
+ *     utáni pontműveletek a konvolúció kimenetére olvadnak.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "plan.h"
+#include "status.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/**
+ * Megvizsgálja, hogy egy művelet tükrözés-e.
+ *
+ * @param operation A művelet.
+ * @return Tükrözés esetén logikai igazzal, egyébként logikai hamissal tér
+ * vissza.
+ */
+static bool plan_is_mirror(const Operation* operation)
+{
+	return operation->type == OPERATION_MIRROR_X || operation->type == OPERATION_MIRROR_Y;
+}
+
+/**
+ * Megvizsgálja, hogy egy művelet konvolúció-e, vagyis olyan művelet, melynek
+ * kimenetére keresőtábla olvasztható.
+ *
+ * @param operation A művelet.
+ * @return Konvolúció esetén logikai igazzal, egyébként logikai hamissal tér
+ * vissza.
+ */
+static bool plan_is_kernel(const Operation* operation)
+{
+	return operation->type == OPERATION_BLUR || operation->type == OPERATION_GAUSSIAN_BLUR || operation->type == OPERATION_CONVOLVE;
+}
+
+/**
+ * Megvizsgálja, hogy egy művelet nagyítás-e, vagyis olyan skálázás, melynek
+ * egyik lépése sem kicsinyít.
+ *
+ * @param operation A művelet.
+ * @return Nagyítás esetén logikai igazzal, egyébként logikai hamissal tér
+ * vissza.
+ */
+static bool plan_is_enlargement(const Operation* operation)
+{
+	if (operation->type != OPERATION_SCALE)
+		return false;
+
+	const ImageScale* scale = &operation->param.scale;
+	for (int i = 0; i < scale->count; i++)
+		if (!(scale->horizontal[i] >= 1.0f && scale->vertical[i] >= 1.0f))
+			return false;
+	return true;
+}
+
+/**
+ * Eltávolít egy műveletet a műveletsorból, és felszabadítja a paramétereit.
+ *
+ * @param operations A műveletek tömbje.
+ * @param p_count A műveletek számának helye.
+ * @param index Az eltávolítandó művelet indexe.
+ */
+static void plan_remove(Operation* operations, int* p_count, int index)
+{
+	cmd_release_operation(&operations[index]);
+	memmove(&operations[index], &operations[index + 1], (size_t)(*p_count - index - 1) * sizeof(Operation));
+	(*p_count)--;
+}
+
+/**
+ * Hozzáfűz egy lépést egy skálázáshoz. Az identitás lépés kimarad, és ha az
+ * utolsó lépés és az új lépés tengelyenként legalább egyikének értéke 1
+ * (például vízszintes, majd függőleges skálázás), a kettő egyetlen lépéssé
+ * olvad, ami ugyanazt a méretet és leképezést adja.
+ *
+ * @param scale A skálázás.
+ * @param horizontal A lépés vízszintes skálázási értéke.
+ * @param vertical A lépés függőleges skálázási értéke.
+ * @return Logikai hamissal tér vissza, ha a lépés már nem fér el.
+ */
+static bool plan_append_scale_step(ImageScale* scale, float horizontal, float vertical)
+{
+	if (horizontal == 1.0f && vertical == 1.0f)
+		return true;
+
+	if (scale->count > 0)
+	{
+		int last = scale->count - 1;
+		if ((scale->horizontal[last] == 1.0f || horizontal == 1.0f) && (scale->vertical[last] == 1.0f || vertical == 1.0f))
+		{
+			scale->horizontal[last] = (horizontal == 1.0f) ? scale->horizontal[last] : horizontal;
+			scale->vertical[last] = (vertical == 1.0f) ? scale->vertical[last] : vertical;
+			return true;
+		}
+	}
+
+	if (scale->count == IMAGE_SCALE_MAX_STEPS)
+		return false;
+
+	scale->horizontal[scale->count] = horizontal;
+	scale->vertical[scale->count] = vertical;
+	scale->count++;
+	return true;
+}
+
+/**
+ * Összefűz két skálázást (előbb a first, majd a second lépései).
+ *
+ * @param[out] p_merged Az összefűzött skálázás helye.
+ * @param[in] first Az első skálázás.
+ * @param[in] second A második skálázás.
+ * @return Logikai hamissal tér vissza, ha a lépések nem férnek el egy
+ * skálázásban.
+ */
+static bool plan_merge_scale(ImageScale* p_merged, const ImageScale* first, const ImageScale* second)
+{
+	p_merged->count = 0;
+	for (int i = 0; i < first->count; i++)
+		if (!plan_append_scale_step(p_merged, first->horizontal[i], first->vertical[i]))
+			return false;
+	for (int i = 0; i < second->count; i++)
+		if (!plan_append_scale_step(p_merged, second->horizontal[i], second->vertical[i]))
+			return false;
+	return true;
+}
+
+/**
+ * Tömöríti a skálázások lépéseit, az identitássá egyszerűsödő skálázásokat
+ * pedig eltávolítja.
+ *
+ * @param operations A műveletek tömbje.
+ * @param p_count A műveletek számának helye.
+ * @return Logikai igazzal tér vissza, ha a műveletsor megváltozott.
+ */
+static bool plan_simplify_scales(Operation* operations, int* p_count)
+{
+	bool changed = false;
+
+	for (int i = 0; i < *p_count; i++)
+	{
+		if (operations[i].type != OPERATION_SCALE)
+			continue;
+
+		ImageScale* scale = &operations[i].param.scale;
+		ImageScale empty = { .count = 0 };
+		ImageScale simplified;
+		if (plan_merge_scale(&simplified, scale, &empty) && simplified.count < scale->count)
+		{
+			*scale = simplified;
+			changed = true;
+		}
+
+		if (scale->count == 0)
+		{
+			plan_remove(operations, p_count, i--);
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+/**
+ * A pontműveleteket egy-egy lépéssel a közvetlenül előttük álló tükrözések
+ * és nagyítások elé mozgatja.
+ *
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @return Logikai igazzal tér vissza, ha a műveletsor megváltozott.
+ */
+static bool plan_hoist_point_operations(Operation* operations, int count)
+{
+	bool changed = false;
+
+	for (int i = 1; i < count; i++)
+	{
+		if (cmd_is_point_operation(&operations[i]) &&
+			(plan_is_mirror(&operations[i - 1]) || plan_is_enlargement(&operations[i - 1])))
+		{
+			Operation temp = operations[i];
+			operations[i] = operations[i - 1];
+			operations[i - 1] = temp;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+/**
+ * Eltávolít egy azonos tengelyű tükrözéspárt, melyek között csak
+ * pontműveletek és a másik tengelyű tükrözések állnak.
+ *
+ * @param operations A műveletek tömbje.
+ * @param p_count A műveletek számának helye.
+ * @return Logikai igazzal tér vissza, ha a műveletsor megváltozott.
+ */
+static bool plan_cancel_mirrors(Operation* operations, int* p_count)
+{
+	for (int i = 0; i < *p_count; i++)
+	{
+		if (!plan_is_mirror(&operations[i]))
+			continue;
+
+		for (int j = i + 1; j < *p_count; j++)
+		{
+			if (operations[j].type == operations[i].type)
+			{
+				plan_remove(operations, p_count, j);
+				plan_remove(operations, p_count, i);
+				return true;
+			}
+			if (!plan_is_mirror(&operations[j]) && !cmd_is_point_operation(&operations[j]))
+				break;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Összevon két skálázást, melyek között csak pontműveletek állnak; a
+ * pontműveletek az összevont skálázás után futnak.
+ *
+ * @param operations A műveletek tömbje.
+ * @param p_count A műveletek számának helye.
+ * @return Logikai igazzal tér vissza, ha a műveletsor megváltozott.
+ */
+static bool plan_merge_scales(Operation* operations, int* p_count)
+{
+	for (int i = 0; i < *p_count; i++)
+	{
+		if (operations[i].type != OPERATION_SCALE)
+			continue;
+
+		int j = i + 1;
+		while (j < *p_count && cmd_is_point_operation(&operations[j]))
+			j++;
+		if (j == *p_count || operations[j].type != OPERATION_SCALE)
+			continue;
+
+		ImageScale merged;
+		if (!plan_merge_scale(&merged, &operations[i].param.scale, &operations[j].param.scale))
+			continue;
+
+		operations[i].param.scale = merged;
+		plan_remove(operations, p_count, j);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * A konvolúciókat közvetlenül követő pontműveleteket a konvolúció
+ * kimenetének keresőtáblájába olvasztja. A hibás paraméterezésű
+ * pontműveletek a helyükön maradnak, hogy a hiba a végrehajtáskor derüljön
+ * ki.
+ *
+ * @param[in,out] operations A műveletek tömbje.
+ * @param[in,out] p_count A műveletek számának helye.
+ * @param[out] p_changed Logikai igazra állítódik, ha a műveletsor
+ * megváltozott.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+static int plan_fold_point_operations(Operation* operations, int* p_count, bool* p_changed)
+{
+	for (int i = 1; i < *p_count; i++)
+	{
+		if (!cmd_is_point_operation(&operations[i]) || !plan_is_kernel(&operations[i - 1]))
+			continue;
+
+		ImageLut lut;
+		int composed;
+		if (cmd_compose_point_operations(&lut, &operations[i], *p_count - i, &composed) != NO_ERROR)
+			continue;
+
+		Operation* kernel = &operations[i - 1];
+		if (kernel->output == NULL)
+		{
+			if ((kernel->output = (ImageLut*)malloc(sizeof(ImageLut))) == NULL)
+				return MEMORY_ERROR;
+			*kernel->output = lut;
+		}
+		else
+			image_lut_append(kernel->output, &lut);
+
+		while (composed-- > 0)
+			plan_remove(operations, p_count, i);
+		*p_changed = true;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Egyszerűsíti a műveletsort (lásd a modul leírását): az átírásokat addig
+ * ismétli, amíg azok változtatnak rajta. Az eltávolított műveletek
+ * paraméterei felszabadulnak.
+ *
+ * @param[in,out] operations A műveletek tömbje.
+ * @param[in,out] p_count A műveletek számának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int plan_optimize(Operation* operations, int* p_count)
+{
+	int status;
+
+	bool changed;
+	do
+	{
+		changed = plan_simplify_scales(operations, p_count);
+		changed |= plan_hoist_point_operations(operations, *p_count);
+		changed |= plan_cancel_mirrors(operations, p_count);
+		changed |= plan_merge_scales(operations, p_count);
+		if ((status = plan_fold_point_operations(operations, p_count, &changed)) != NO_ERROR)
+			return status;
+	} while (changed);
+
+	return NO_ERROR;
+}
+
+/**
+ * Megszámolja a terv lépéseit: minden művelet egy lépés, az egymást követő
+ * pontműveletek azonban együtt is csak egy.
+ *
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @return Visszatér a lépések számával.
+ */
+int plan_count_passes(const Operation* operations, int count)
+{
+	int passes = 0;
+	for (int i = 0; i < count; i++)
+		if (!cmd_is_point_operation(&operations[i]) || i == 0 || !cmd_is_point_operation(&operations[i - 1]))
+			passes++;
+	return passes;
+}
+
+/**
+ * Kiírja egy művelet rövid leírását (sortörés nélkül).
+ *
+ * @param operation A művelet.
+ */
+static void plan_print_operation(const Operation* operation)
+{
+	switch (operation->type)
+	{
+	case OPERATION_SCALE:
+	{
+		const ImageScale* scale = &operation->param.scale;
+		printf("skalazas");
+		for (int i = 0; i < scale->count; i++)
+			printf("%s%gx%g", (i == 0) ? " " : ", ", scale->horizontal[i], scale->vertical[i]);
+		break;
+	}
+	case OPERATION_MIRROR_X:
+		printf("tukrozes az x tengelyre");
+		break;
+	case OPERATION_MIRROR_Y:
+		printf("tukrozes az y tengelyre");
+		break;
+	case OPERATION_BLUR:
+		printf("%s %d", (operation->param.value < 0) ? "elesites" : "elhomalyositas", abs(operation->param.value));
+		break;
+	case OPERATION_EXPOSURE:
+		printf("expozicio %d", operation->param.value);
+		break;
+	case OPERATION_GAUSSIAN_BLUR:
+		printf("Gauss-elmosas %g", operation->param.sigma);
+		break;
+	case OPERATION_CONVOLVE:
+		printf("konvolucio %" PRIu32 "x%" PRIu32, operation->param.kernel->width, operation->param.kernel->height);
+		break;
+	case OPERATION_CONTRAST:
+		printf("kontraszt %d", operation->param.value);
+		break;
+	case OPERATION_GAMMA:
+		printf("gamma %g", operation->param.gamma);
+		break;
+	case OPERATION_LEVELS:
+		printf("szintek %d-%d", operation->param.levels.black, operation->param.levels.white);
+		break;
+	}
+
+	if (operation->output != NULL)
+		printf(" + pontmuveletek a kimeneten");
+}
+
+/**
+ * Kiírja a végrehajtási tervet: lépésenként a műveleteket, az egy menetben
+ * futó pontműveleteket egy sorban.
+ *
+ * @param operations A (már egyszerűsített) műveletek tömbje.
+ * @param count A műveletek száma.
+ * @param switch_count A parancssorban megadott műveletek száma.
+ */
+void plan_print(const Operation* operations, int count, int switch_count)
+{
+	printf("Vegrehajtasi terv: %d muvelet helyett %d lepes\n", switch_count, plan_count_passes(operations, count));
+
+	int pass = 0;
+	for (int i = 0; i < count; i++)
+	{
+		bool continued = i > 0 && cmd_is_point_operation(&operations[i]) && cmd_is_point_operation(&operations[i - 1]);
+		if (continued)
+			printf(", ");
+		else
+		{
+			if (i > 0)
+				printf("\n");
+			printf("  %d. ", ++pass);
+			if (cmd_is_point_operation(&operations[i]))
+				printf("keresotabla: ");
+		}
+		plan_print_operation(&operations[i]);
+	}
+	if (count > 0)
+		printf("\n");
+}
@@ -0,0 +1,18 @@
+﻿/*****************************************************************//**
+ * @file   plan.h
+ * @brief  A parancssori kapcsolókból értelmezett műveletsort végrehajtás
+ * előtt egyszerűsítő (végrehajtási tervvé alakító) modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef PLAN_H_INCLUDED
+#define PLAN_H_INCLUDED
+
+#include "cmd.h"
+
+int plan_optimize(Operation* operations, int* p_count);
+int plan_count_passes(const Operation* operations, int count);
+void plan_print(const Operation* operations, int count, int switch_count);
+
+#endif /* PLAN_H_INCLUDED */
@@ -0,0 +1,1115 @@
+﻿/*****************************************************************//**
+ * @file   platform.c
+ * @brief  Az operációs rendszertől függő szolgáltatásokat (fájlleképezés,
+ * pozícionált I/O, könyvtárak, helyi socketek, memórialapok, szálkezelés, időmérés, erőforrás-használat) egységes felületen elérhetővé tevő modul forrásfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "platform.h"
+#include "status.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	/* windows */
+	#define WIN32_LEAN_AND_MEAN
+	#include <winsock2.h>
+	#include <afunix.h>
+	#include <windows.h>
+	#include <io.h>
+	#include <psapi.h>
+	#pragma comment(lib, "psapi.lib")
+	#pragma comment(lib, "ws2_32.lib")
+#else
+	/* posix */
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#include <time.h>
+	#include <pthread.h>
+	#include <sys/resource.h>
+	#include <dirent.h>
+	#include <errno.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <poll.h>
+#endif
+
+/*
+ * A modul a szálakból is hívható függvényei miatt nem használja a
+ * debugmalloc-ot (mely nem szálbiztos), az itt lefoglalt struktúrákat
+ * a libc allokátora kezeli.
+ */
+
+/* egy végrehajtási szál */
+struct platform_thread_struct
+{
+#ifdef _WIN32
+	HANDLE handle; /* a szál leírója */
+#else
+	pthread_t handle; /* a szál azonosítója */
+#endif
+	fthread function; /* a szál által végrehajtott függvény */
+	void* argument; /* a függvény argumentuma */
+};
+
+/* egy helyi socket */
+struct platform_socket_struct
+{
+#ifdef _WIN32
+	SOCKET handle; /* a socket leírója */
+#else
+	int handle; /* a socket leírója */
+#endif
+	char path[sizeof(((struct sockaddr_un*)NULL)->sun_path)]; /* a figyelő socket fájlja, egyébként üres */
+};
+
+/* egy kölcsönös kizárást biztosító zár */
+struct platform_mutex_struct
+{
+#ifdef _WIN32
+	SRWLOCK lock;
+#else
+	pthread_mutex_t lock;
+#endif
+};
+
+/* egy feltételváltozó */
+struct platform_condition_struct
+{
+#ifdef _WIN32
+	CONDITION_VARIABLE variable;
+#else
+	pthread_cond_t variable;
+#endif
+};
+
+/**
+ * Leképezi egy megnyitott fájl teljes tartalmát a folyamat címterébe.
+ *
+ * A leképezés privát és írható, vagyis a leképezett lapokat módosító
+ * műveletek az első íráskor lapszinten lemásolódnak (copy-on-write), így a
+ * fájl tartalma sosem változik meg. A leképezés a fájl lezárása után is
+ * érvényes marad, megszüntetése a hívó feladata.
+ *
+ * @param[in] file A leképezendő fájl.
+ * @param[out] p_address A leképezés kezdőcímének helye.
+ * @param[out] p_size A leképezés méretének (bájtban) helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként (pl. üres vagy
+ * nem leképezhető fájl, mint egy csővezeték esetén) IO_ERROR-ral tér vissza.
+ */
+int platform_map_file(FILE* file, void** p_address, size_t* p_size)
+{
+#ifdef _WIN32
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	if (handle == INVALID_HANDLE_VALUE)
+		return IO_ERROR;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(handle, &file_size) || file_size.QuadPart <= 0 ||
+		(uint64_t)file_size.QuadPart > SIZE_MAX)
+		return IO_ERROR;
+
+	HANDLE mapping = CreateFileMappingW(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping == NULL)
+		return IO_ERROR;
+
+	void* address = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	/* a nézet a leképezési objektum lezárása után is életben marad */
+	CloseHandle(mapping);
+	if (address == NULL)
+		return IO_ERROR;
+
+	*p_address = address;
+	*p_size = (size_t)file_size.QuadPart;
+#else
+	int fd = fileno(file);
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size <= 0 ||
+		(uint64_t)file_stat.st_size > SIZE_MAX)
+		return IO_ERROR;
+
+	size_t size = (size_t)file_stat.st_size;
+	void* address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (address == MAP_FAILED)
+		return IO_ERROR;
+
+	/* a sorokat jellemzően egyszer, elejétől a végéig olvassuk */
+	madvise(address, size, MADV_SEQUENTIAL);
+
+	*p_address = address;
+	*p_size = size;
+#endif
+
+	return NO_ERROR;
+}
+
+/**
+ * Megszünteti egy platform_map_file által létrehozott fájlleképezést.
+ *
+ * @param address A leképezés kezdőcíme.
+ * @param size A leképezés mérete (bájtban).
+ */
+void platform_unmap_file(void* address, size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(address);
+#else
+	munmap(address, size);
+#endif
+}
+
+/**
+ * Kerekít egy méretet PLATFORM_HUGE_PAGE_SIZE többszörösére.
+ *
+ * @param size A méret (bájtban).
+ * @return Visszatér a felkerekített mérettel.
+ */
+static size_t platform_round_to_pages(size_t size)
+{
+	return (size + PLATFORM_HUGE_PAGE_SIZE - 1) & ~(PLATFORM_HUGE_PAGE_SIZE - 1);
+}
+
+/**
+ * Lefoglal egy PLATFORM_HUGE_PAGE_SIZE-ra igazított, névtelen leképezésként
+ * létrehozott memóriaterületet, és kéri, hogy az operációs rendszer nagy
+ * (átlátszó) lapokkal képezze le. Ha ez nem lehetséges, a terület normál
+ * lapokon marad. A terület tartalma nulla.
+ *
+ * A lefoglalt memóriaterület felszabadítása (platform_free_pages) a hívó
+ * feladata.
+ *
+ * @param size A terület mérete (bájtban).
+ * @return Sikeres lefutás esetén a terület kezdőcímével, egyébként
+ * NULL-pointerrel tér vissza.
+ */
+void* platform_allocate_pages(size_t size)
+{
+	size_t rounded = platform_round_to_pages(size);
+	if (rounded < size)
+		return NULL;
+
+#ifdef _WIN32
+	/* a nagy lapokhoz jogosultság kellene, a foglalás 64 kB-ra igazított */
+	return VirtualAlloc(NULL, rounded, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	/* az igazításhoz egy lappal nagyobb tartomány kerül leképezésre, melynek felesleges szélei visszaadhatók */
+	size_t mapped = rounded + PLATFORM_HUGE_PAGE_SIZE;
+	if (mapped < rounded)
+		return NULL;
+
+	uint8_t* address = (uint8_t*)mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (address == (uint8_t*)MAP_FAILED)
+		return NULL;
+
+	uint8_t* aligned = (uint8_t*)(((uintptr_t)address + PLATFORM_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(PLATFORM_HUGE_PAGE_SIZE - 1));
+	if (aligned > address)
+		munmap(address, (size_t)(aligned - address));
+	if (address + mapped > aligned + rounded)
+		munmap(aligned + rounded, (size_t)(address + mapped - (aligned + rounded)));
+
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, rounded, MADV_HUGEPAGE);
+#endif
+
+	return aligned;
+#endif
+}
+
+/**
+ * Felszabadít egy platform_allocate_pages által foglalt memóriaterületet.
+ *
+ * @param address A terület kezdőcíme.
+ * @param size A terület foglaláskor megadott mérete (bájtban).
+ */
+void platform_free_pages(void* address, size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	VirtualFree(address, 0, MEM_RELEASE);
+#else
+	munmap(address, platform_round_to_pages(size));
+#endif
+}
+
+/**
+ * Megadja egy monoton óra aktuális értékét, mely időtartamok mérésére
+ * alkalmas.
+ *
+ * @return Visszatér egy tetszőleges kezdőpont óta eltelt idővel
+ * (másodpercben).
+ */
+double platform_get_time(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Lekérdezi a folyamat eddigi erőforrás-használatát: a rezidens memória
+ * csúcsértékét és a laphibák számát. A Windows a laphibákat nem bontja
+ * kisebb és nagyobb laphibákra, ott mind kisebbnek számít.
+ *
+ * @param p_usage Az erőforrás-használat helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral tér
+ * vissza.
+ */
+int platform_get_resource_usage(PlatformResourceUsage* p_usage)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return IO_ERROR;
+
+	p_usage->peak_resident_size = (uint64_t)counters.PeakWorkingSetSize;
+	p_usage->minor_faults = (uint64_t)counters.PageFaultCount;
+	p_usage->major_faults = 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return IO_ERROR;
+
+#ifdef __APPLE__
+	p_usage->peak_resident_size = (uint64_t)usage.ru_maxrss;
+#else
+	/* Linuxon kilobájtban */
+	p_usage->peak_resident_size = (uint64_t)usage.ru_maxrss * 1024;
+#endif
+	p_usage->minor_faults = (uint64_t)usage.ru_minflt;
+	p_usage->major_faults = (uint64_t)usage.ru_majflt;
+#endif
+
+	return NO_ERROR;
+}
+
+/**
+ * Megadja egy megnyitott, szabályos fájl méretét.
+ *
+ * @param file A fájl.
+ * @param p_size A méret (bájtban) helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként (pl. csővezeték
+ * esetén) IO_ERROR-ral tér vissza.
+ */
+int platform_get_file_size(FILE* file, uint64_t* p_size)
+{
+#ifdef _WIN32
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	LARGE_INTEGER file_size;
+	if (handle == INVALID_HANDLE_VALUE || GetFileType(handle) != FILE_TYPE_DISK || !GetFileSizeEx(handle, &file_size))
+		return IO_ERROR;
+
+	*p_size = (uint64_t)file_size.QuadPart;
+#else
+	struct stat file_stat;
+	if (fstat(fileno(file), &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+		return IO_ERROR;
+
+	*p_size = (uint64_t)file_stat.st_size;
+#endif
+
+	return NO_ERROR;
+}
+
+/**
+ * Beolvas egy fájl adott pozíciójáról adott számú bájtot a fájlpozíció
+ * használata és módosítása nélkül, így egyazon fájlból több szál is
+ * olvashat egyszerre.
+ *
+ * @param file A fájl.
+ * @param buffer A cél memóriaterület.
+ * @param size A beolvasandó bájtok száma.
+ * @param offset A beolvasás kezdőpozíciója a fájl elejétől (bájtban).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a fájl idő előtti vége
+ * vagy egyéb I/O probléma esetén IO_ERROR-ral tér vissza.
+ */
+int platform_read_at(FILE* file, void* buffer, size_t size, uint64_t offset)
+{
+	uint8_t* bytes = (uint8_t*)buffer;
+
+	while (size > 0)
+	{
+#ifdef _WIN32
+		HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+		OVERLAPPED overlapped = { 0 };
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD chunk = (size > 0x40000000) ? 0x40000000 : (DWORD)size;
+		DWORD done;
+		if (!ReadFile(handle, bytes, chunk, &done, &overlapped) || done == 0)
+			return IO_ERROR;
+#else
+		ssize_t done = pread(fileno(file), bytes, size, (off_t)offset);
+		if (done <= 0)
+			return IO_ERROR;
+#endif
+		bytes += done;
+		size -= (size_t)done;
+		offset += (uint64_t)done;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Kiír egy fájl adott pozíciójára adott számú bájtot a fájlpozíció
+ * használata és módosítása nélkül, így egyazon fájlba több szál is
+ * írhat egyszerre (egymást nem átfedő tartományokba).
+ *
+ * @param file A fájl.
+ * @param buffer A forrás memóriaterület.
+ * @param size A kiírandó bájtok száma.
+ * @param offset A kiírás kezdőpozíciója a fájl elejétől (bájtban).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral
+ * tér vissza.
+ */
+int platform_write_at(FILE* file, const void* buffer, size_t size, uint64_t offset)
+{
+	const uint8_t* bytes = (const uint8_t*)buffer;
+
+	while (size > 0)
+	{
+#ifdef _WIN32
+		HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+		OVERLAPPED overlapped = { 0 };
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD chunk = (size > 0x40000000) ? 0x40000000 : (DWORD)size;
+		DWORD done;
+		if (!WriteFile(handle, bytes, chunk, &done, &overlapped) || done == 0)
+			return IO_ERROR;
+#else
+		ssize_t done = pwrite(fileno(file), bytes, size, (off_t)offset);
+		if (done <= 0)
+			return IO_ERROR;
+#endif
+		bytes += done;
+		size -= (size_t)done;
+		offset += (uint64_t)done;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Megvizsgálja, hogy egy elérési út létező könyvtárra mutat-e.
+ *
+ * @param path Az elérési út.
+ * @return Logikai igazzal tér vissza, ha az elérési út könyvtár.
+ */
+bool platform_is_directory(const char* path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	struct stat info;
+	return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+/**
+ * Létrehoz egy könyvtárat, ha az még nem létezik.
+ *
+ * @param path A könyvtár elérési útja.
+ * @return Sikeres lefutás (vagy már létező könyvtár) esetén NO_ERROR-ral,
+ * egyébként IO_ERROR-ral tér vissza.
+ */
+int platform_create_directory(const char* path)
+{
+#ifdef _WIN32
+	if (!CreateDirectoryA(path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+		return IO_ERROR;
+#else
+	if (mkdir(path, 0777) != 0 && errno != EEXIST)
+		return IO_ERROR;
+#endif
+	return platform_is_directory(path) ? NO_ERROR : IO_ERROR;
+}
+
+/**
+ * Bejárja egy könyvtár bejegyzéseit (az alkönyvtárak, valamint a . és ..
+ * bejegyzések kivételével), és mindegyik nevével meghívja a megadott
+ * függvényt. A bejárás sorrendje nem meghatározott; a bejárás az első
+ * hibát jelző hívásnál megáll.
+ *
+ * @param path A könyvtár elérési útja.
+ * @param function A bejegyzésenként meghívott függvény.
+ * @param context A függvénynek átadott állapot.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a könyvtár megnyitásának
+ * hibája esetén IO_ERROR-ral, egyébként a függvény által jelzett hibával
+ * tér vissza.
+ */
+int platform_list_directory(const char* path, fentry function, void* context)
+{
+	int status = NO_ERROR;
+
+#ifdef _WIN32
+	char pattern[MAX_PATH];
+	if (snprintf(pattern, sizeof(pattern), "%s\\*", path) >= (int)sizeof(pattern))
+		return IO_ERROR;
+
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA(pattern, &entry);
+	if (find == INVALID_HANDLE_VALUE)
+		return (GetLastError() == ERROR_FILE_NOT_FOUND) ? NO_ERROR : IO_ERROR;
+
+	do
+	{
+		if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+			status = function(context, entry.cFileName);
+	} while (status == NO_ERROR && FindNextFileA(find, &entry));
+
+	FindClose(find);
+#else
+	DIR* directory = opendir(path);
+	if (directory == NULL)
+		return IO_ERROR;
+
+	struct dirent* entry;
+	while (status == NO_ERROR && (entry = readdir(directory)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 || entry->d_type == DT_DIR)
+			continue;
+		status = function(context, entry->d_name);
+	}
+
+	closedir(directory);
+#endif
+
+	return status;
+}
+
+#ifdef _WIN32
+	#define PLATFORM_INVALID_SOCKET		INVALID_SOCKET
+	#define platform_close_handle		closesocket
+#else
+	#define PLATFORM_INVALID_SOCKET		-1
+	#define platform_close_handle		close
+#endif
+
+/**
+ * Létrehoz egy helyi socketet, és kitölti a megadott fájlhoz tartozó
+ * címet. Windowson a Winsock is inicializálásra kerül (a hívások száma
+ * szerint, a platform_socket_close párjaként).
+ *
+ * @param p_socket A socket helye.
+ * @param address A cím helye.
+ * @param path A socket fájljának elérési útja.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, túl hosszú elérési út vagy
+ * a socket létrehozásának hibája esetén IO_ERROR-ral, egyébként
+ * MEMORY_ERROR-ral tér vissza.
+ */
+static int platform_socket_create(PlatformSocket** p_socket, struct sockaddr_un* address, const char* path)
+{
+	size_t length = strlen(path);
+	if (length >= sizeof(address->sun_path))
+		return IO_ERROR;
+
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	memcpy(address->sun_path, path, length + 1);
+
+	PlatformSocket* endpoint = (PlatformSocket*)malloc(sizeof(PlatformSocket));
+	if (endpoint == NULL)
+		return MEMORY_ERROR;
+	endpoint->path[0] = '\0';
+
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		free(endpoint);
+		return IO_ERROR;
+	}
+#endif
+
+	endpoint->handle = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (endpoint->handle == PLATFORM_INVALID_SOCKET)
+	{
+		platform_socket_close(endpoint);
+		return IO_ERROR;
+	}
+
+	*p_socket = endpoint;
+
+	return NO_ERROR;
+}
+
+/**
+ * Eltávolítja egy socket fájljának korábbi (például egy leállított szerver
+ * után hátramaradt) példányát. Csak olyan socket fájl törlődik, melyen
+ * már senki sem fogad kapcsolódást; más fájlok és élő szerverek socketjei
+ * érintetlenül maradnak.
+ *
+ * @param path A socket fájljának elérési útja.
+ * @return Nem létező vagy törölt fájl esetén NO_ERROR-ral, egyébként
+ * IO_ERROR-ral tér vissza.
+ */
+static int platform_socket_remove_stale(const char* path)
+{
+#ifdef _WIN32
+	/* a Windows a socket fájlokat újraelemzési pontként (reparse point) tárolja */
+	DWORD attributes = GetFileAttributesA(path);
+	if (attributes == INVALID_FILE_ATTRIBUTES)
+		return (GetLastError() == ERROR_FILE_NOT_FOUND) ? NO_ERROR : IO_ERROR;
+	if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0 || (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		return IO_ERROR;
+#else
+	struct stat info;
+	if (lstat(path, &info) != 0)
+		return (errno == ENOENT) ? NO_ERROR : IO_ERROR;
+	if (!S_ISSOCK(info.st_mode))
+		return IO_ERROR;
+#endif
+
+	/* egy próbakapcsolódás dönti el, hogy fut-e még szerver a fájlon */
+	PlatformSocket* probe;
+	if (platform_socket_connect(&probe, path) == NO_ERROR)
+	{
+		platform_socket_close(probe);
+		return IO_ERROR;
+	}
+
+#ifdef _WIN32
+	return DeleteFileA(path) ? NO_ERROR : IO_ERROR;
+#else
+	return (unlink(path) == 0 || errno == ENOENT) ? NO_ERROR : IO_ERROR;
+#endif
+}
+
+/**
+ * Létrehoz egy helyi socketet, mely a megadott fájlon fogadja a
+ * kapcsolódásokat. A fájl egy korábbi, már nem használt socket példánya
+ * törlésre kerül, bármely más létező fájl (vagy egy élő szerver socketje)
+ * esetén a művelet sikertelen; a socket lezárásakor a fájl is törlődik.
+ *
+ * A socket lezárása (platform_socket_close) a hívó feladata.
+ *
+ * @param p_socket A socket helye.
+ * @param path A socket fájljának elérési útja.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, memóriafoglalási hiba
+ * esetén MEMORY_ERROR-ral, egyébként IO_ERROR-ral tér vissza.
+ */
+int platform_socket_listen(PlatformSocket** p_socket, const char* path)
+{
+	int status;
+
+	PlatformSocket* listener;
+	struct sockaddr_un address;
+	if ((status = platform_socket_create(&listener, &address, path)) != NO_ERROR)
+		return status;
+
+	if ((status = platform_socket_remove_stale(path)) != NO_ERROR)
+	{
+		platform_socket_close(listener);
+		return status;
+	}
+
+	if (bind(listener->handle, (struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		platform_socket_close(listener);
+		return IO_ERROR;
+	}
+	memcpy(listener->path, address.sun_path, sizeof(listener->path));
+
+	if (listen(listener->handle, SOMAXCONN) != 0)
+	{
+		platform_socket_close(listener);
+		return IO_ERROR;
+	}
+
+	*p_socket = listener;
+
+	return NO_ERROR;
+}
+
+/**
+ * Bevárja és elfogadja a következő kapcsolódást egy figyelő socketen.
+ *
+ * A kapcsolat lezárása (platform_socket_close) a hívó feladata.
+ *
+ * @param listener A figyelő socket.
+ * @param p_socket A kapcsolat socketjének helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, memóriafoglalási hiba
+ * esetén MEMORY_ERROR-ral, egyébként IO_ERROR-ral tér vissza.
+ */
+int platform_socket_accept(PlatformSocket* listener, PlatformSocket** p_socket)
+{
+	PlatformSocket* endpoint = (PlatformSocket*)malloc(sizeof(PlatformSocket));
+	if (endpoint == NULL)
+		return MEMORY_ERROR;
+	endpoint->path[0] = '\0';
+
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		free(endpoint);
+		return IO_ERROR;
+	}
+#endif
+
+#ifdef _WIN32
+	endpoint->handle = accept(listener->handle, NULL, NULL);
+#else
+	do
+		endpoint->handle = accept(listener->handle, NULL, NULL);
+	while (endpoint->handle == PLATFORM_INVALID_SOCKET && errno == EINTR);
+#endif
+	if (endpoint->handle == PLATFORM_INVALID_SOCKET)
+	{
+		platform_socket_close(endpoint);
+		return IO_ERROR;
+	}
+
+	*p_socket = endpoint;
+
+	return NO_ERROR;
+}
+
+/**
+ * Kapcsolódik egy helyi socketen figyelő folyamathoz.
+ *
+ * A kapcsolat lezárása (platform_socket_close) a hívó feladata.
+ *
+ * @param p_socket A kapcsolat socketjének helye.
+ * @param path A figyelő socket fájljának elérési útja.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, memóriafoglalási hiba
+ * esetén MEMORY_ERROR-ral, egyébként IO_ERROR-ral tér vissza.
+ */
+int platform_socket_connect(PlatformSocket** p_socket, const char* path)
+{
+	int status;
+
+	PlatformSocket* endpoint;
+	struct sockaddr_un address;
+	if ((status = platform_socket_create(&endpoint, &address, path)) != NO_ERROR)
+		return status;
+
+	if (connect(endpoint->handle, (struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		platform_socket_close(endpoint);
+		return IO_ERROR;
+	}
+
+	*p_socket = endpoint;
+
+	return NO_ERROR;
+}
+
+/**
+ * Elküldi egy puffer teljes tartalmát egy kapcsolaton. A túloldalon már
+ * lezárt kapcsolat hibát jelez, nem szakítja meg a folyamatot.
+ *
+ * @param endpoint A kapcsolat socketje.
+ * @param buffer A puffer.
+ * @param size A küldendő bájtok száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral tér
+ * vissza.
+ */
+int platform_socket_send(PlatformSocket* endpoint, const void* buffer, size_t size)
+{
+	const char* data = (const char*)buffer;
+
+	while (size > 0)
+	{
+#ifdef _WIN32
+		int sent = send(endpoint->handle, data, (size > INT_MAX) ? INT_MAX : (int)size, 0);
+		if (sent == SOCKET_ERROR)
+			return IO_ERROR;
+#else
+	#ifdef MSG_NOSIGNAL
+		ssize_t sent = send(endpoint->handle, data, size, MSG_NOSIGNAL);
+	#else
+		ssize_t sent = send(endpoint->handle, data, size, 0);
+	#endif
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent < 0)
+			return IO_ERROR;
+#endif
+		data += sent;
+		size -= (size_t)sent;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Fogad legfeljebb size bájtot egy kapcsolaton; legalább egy bájt
+ * érkezéséig, vagy a kapcsolat lezárásáig várakozik.
+ *
+ * @param endpoint A kapcsolat socketje.
+ * @param buffer A puffer.
+ * @param size A puffer mérete.
+ * @param p_received A fogadott bájtok számának helye (a kapcsolat
+ * lezárása esetén nulla).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként IO_ERROR-ral tér
+ * vissza.
+ */
+int platform_socket_receive(PlatformSocket* endpoint, void* buffer, size_t size, size_t* p_received)
+{
+#ifdef _WIN32
+	int received = recv(endpoint->handle, (char*)buffer, (size > INT_MAX) ? INT_MAX : (int)size, 0);
+	if (received == SOCKET_ERROR)
+		return IO_ERROR;
+#else
+	ssize_t received;
+	do
+		received = recv(endpoint->handle, buffer, size, 0);
+	while (received < 0 && errno == EINTR);
+	if (received < 0)
+		return IO_ERROR;
+#endif
+
+	*p_received = (size_t)received;
+
+	return NO_ERROR;
+}
+
+/**
+ * Bevárja, hogy a megadott socketek közül legalább egy olvasható legyen
+ * (fogadott bájtok, várakozó kapcsolódás, vagy a kapcsolat lezárása
+ * esetén), vagy hogy a várakozás ideje lejárjon.
+ *
+ * @param sockets A socketek tömbje.
+ * @param ready Az olvasható socketeket jelző tömb (a socketekével azonos
+ * hosszú); lejárt várakozás esetén minden eleme hamis.
+ * @param count A socketek száma.
+ * @param timeout A várakozás leghosszabb ideje ezredmásodpercben, negatív
+ * érték esetén korlátlan.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, memóriafoglalási hiba
+ * esetén MEMORY_ERROR-ral, egyébként IO_ERROR-ral tér vissza.
+ */
+int platform_socket_wait(PlatformSocket* sockets[], bool ready[], int count, int timeout)
+{
+#ifdef _WIN32
+	WSAPOLLFD* descriptors = (WSAPOLLFD*)malloc(count * sizeof(WSAPOLLFD));
+#else
+	struct pollfd* descriptors = (struct pollfd*)malloc(count * sizeof(struct pollfd));
+#endif
+	if (descriptors == NULL)
+		return MEMORY_ERROR;
+
+	for (int i = 0; i < count; i++)
+	{
+		descriptors[i].fd = sockets[i]->handle;
+#ifdef _WIN32
+		descriptors[i].events = POLLRDNORM;
+#else
+		descriptors[i].events = POLLIN;
+#endif
+		descriptors[i].revents = 0;
+	}
+
+#ifdef _WIN32
+	int result = WSAPoll(descriptors, (ULONG)count, timeout);
+	if (result == SOCKET_ERROR)
+	{
+		free(descriptors);
+		return IO_ERROR;
+	}
+#else
+	int result;
+	do
+		result = poll(descriptors, (nfds_t)count, timeout);
+	while (result < 0 && errno == EINTR);
+	if (result < 0)
+	{
+		free(descriptors);
+		return IO_ERROR;
+	}
+#endif
+
+	/* a hiba- és lezárásjelzés is olvashatóságnak számít: a fogadás jelzi majd */
+	for (int i = 0; i < count; i++)
+		ready[i] = descriptors[i].revents != 0;
+
+	free(descriptors);
+
+	return NO_ERROR;
+}
+
+/**
+ * Lezár egy socketet, és felszabadítja a leíróját; figyelő socket esetén a
+ * socket fájlja is törlődik.
+ *
+ * @param endpoint A socket.
+ */
+void platform_socket_close(PlatformSocket* endpoint)
+{
+	if (endpoint->handle != PLATFORM_INVALID_SOCKET)
+		platform_close_handle(endpoint->handle);
+
+#ifdef _WIN32
+	if (endpoint->path[0] != '\0')
+		DeleteFileA(endpoint->path);
+	WSACleanup();
+#else
+	if (endpoint->path[0] != '\0')
+		unlink(endpoint->path);
+#endif
+
+	free(endpoint);
+}
+
+/**
+ * Megadja a folyamat számára elérhető logikai processzorok számát.
+ *
+ * @return Visszatér a processzorok számával (legalább 1-gyel).
+ */
+int platform_get_cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (int)count : 1;
+#endif
+}
+
+#ifdef _WIN32
+/**
+ * A Windows szálkezelőjének megfelelő szignatúrájú belépési pont, mely
+ * meghívja a szál függvényét.
+ *
+ * @param argument A szál leírója.
+ * @return Mindig nullával tér vissza.
+ */
+static DWORD WINAPI platform_thread_entry(LPVOID argument)
+{
+	PlatformThread* thread = (PlatformThread*)argument;
+	thread->function(thread->argument);
+	return 0;
+}
+#else
+/**
+ * A POSIX szálkezelőjének megfelelő szignatúrájú belépési pont, mely
+ * meghívja a szál függvényét.
+ *
+ * @param argument A szál leírója.
+ * @return Mindig NULL-lal tér vissza.
+ */
+static void* platform_thread_entry(void* argument)
+{
+	PlatformThread* thread = (PlatformThread*)argument;
+	thread->function(thread->argument);
+	return NULL;
+}
+#endif
+
+/**
+ * Elindít egy új szálat, mely végrehajtja a megadott függvényt.
+ *
+ * A szál bevárása és a leíró felszabadítása (platform_thread_join) a
+ * hívó feladata.
+ *
+ * @param[out] p_thread A szál leírójának helye.
+ * @param[in] function A szál által végrehajtandó függvény.
+ * @param[in] argument A függvény argumentuma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int platform_thread_create(PlatformThread** p_thread, fthread function, void* argument)
+{
+	PlatformThread* thread = (PlatformThread*)malloc(sizeof(PlatformThread));
+	if (thread == NULL)
+		return MEMORY_ERROR;
+
+	thread->function = function;
+	thread->argument = argument;
+
+#ifdef _WIN32
+	thread->handle = CreateThread(NULL, 0, platform_thread_entry, thread, 0, NULL);
+	if (thread->handle == NULL)
+#else
+	if (pthread_create(&thread->handle, NULL, platform_thread_entry, thread) != 0)
+#endif
+	{
+		free(thread);
+		return MEMORY_ERROR;
+	}
+
+	*p_thread = thread;
+
+	return NO_ERROR;
+}
+
+/**
+ * Bevárja egy szál lefutását, majd felszabadítja a leíróját.
+ *
+ * @param thread A szál leírója.
+ */
+void platform_thread_join(PlatformThread* thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->handle, NULL);
+#endif
+	free(thread);
+}
+
+/**
+ * Létrehoz egy kölcsönös kizárást biztosító zárat.
+ *
+ * @param p_mutex A zár helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int platform_mutex_create(PlatformMutex** p_mutex)
+{
+	PlatformMutex* mutex = (PlatformMutex*)malloc(sizeof(PlatformMutex));
+	if (mutex == NULL)
+		return MEMORY_ERROR;
+
+#ifdef _WIN32
+	InitializeSRWLock(&mutex->lock);
+#else
+	if (pthread_mutex_init(&mutex->lock, NULL) != 0)
+	{
+		free(mutex);
+		return MEMORY_ERROR;
+	}
+#endif
+
+	*p_mutex = mutex;
+
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadít egy (szabad) zárat.
+ *
+ * @param mutex A zár.
+ */
+void platform_mutex_destroy(PlatformMutex* mutex)
+{
+#ifndef _WIN32
+	pthread_mutex_destroy(&mutex->lock);
+#endif
+	free(mutex);
+}
+
+/**
+ * Megszerez egy zárat, szükség esetén megvárva, amíg felszabadul.
+ *
+ * @param mutex A zár.
+ */
+void platform_mutex_lock(PlatformMutex* mutex)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive(&mutex->lock);
+#else
+	pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+/**
+ * Elenged egy megszerzett zárat.
+ *
+ * @param mutex A zár.
+ */
+void platform_mutex_unlock(PlatformMutex* mutex)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(&mutex->lock);
+#else
+	pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+/**
+ * Létrehoz egy feltételváltozót.
+ *
+ * @param p_condition A feltételváltozó helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int platform_condition_create(PlatformCondition** p_condition)
+{
+	PlatformCondition* condition = (PlatformCondition*)malloc(sizeof(PlatformCondition));
+	if (condition == NULL)
+		return MEMORY_ERROR;
+
+#ifdef _WIN32
+	InitializeConditionVariable(&condition->variable);
+#else
+	if (pthread_cond_init(&condition->variable, NULL) != 0)
+	{
+		free(condition);
+		return MEMORY_ERROR;
+	}
+#endif
+
+	*p_condition = condition;
+
+	return NO_ERROR;
+}
+
+/**
+ * Felszabadít egy feltételváltozót, melyre már egy szál sem vár.
+ *
+ * @param condition A feltételváltozó.
+ */
+void platform_condition_destroy(PlatformCondition* condition)
+{
+#ifndef _WIN32
+	pthread_cond_destroy(&condition->variable);
+#endif
+	free(condition);
+}
+
+/**
+ * Atomikusan elengedi a megszerzett zárat, és várakozik a feltételváltozó
+ * jelzéséig, majd visszatérés előtt újra megszerzi a zárat. A várakozás
+ * jelzés nélkül is véget érhet, így a feltételt a hívónak ciklusban kell
+ * vizsgálnia.
+ *
+ * @param condition A feltételváltozó.
+ * @param mutex A hívó által birtokolt zár.
+ */
+void platform_condition_wait(PlatformCondition* condition, PlatformMutex* mutex)
+{
+#ifdef _WIN32
+	SleepConditionVariableSRW(&condition->variable, &mutex->lock, INFINITE, 0);
+#else
+	pthread_cond_wait(&condition->variable, &mutex->lock);
+#endif
+}
+
+/**
+ * Felébreszti a feltételváltozóra várakozó összes szálat.
+ *
+ * @param condition A feltételváltozó.
+ */
+void platform_condition_broadcast(PlatformCondition* condition)
+{
+#ifdef _WIN32
+	WakeAllConditionVariable(&condition->variable);
+#else
+	pthread_cond_broadcast(&condition->variable);
+#endif
+}
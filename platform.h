@@ -0,0 +1,103 @@
+﻿/*****************************************************************//**
+ * @file   platform.h
+ * @brief  Az operációs rendszertől függő szolgáltatásokat (fájlleképezés,
+ * pozícionált I/O, memórialapok, szálkezelés, időmérés, erőforrás-használat) egységes felületen elérhetővé tevő modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef PLATFORM_H_INCLUDED
+#define PLATFORM_H_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* a nagy (átlátszó) memórialapok mérete, egyben a lapfoglalások igazítása */
+#define PLATFORM_HUGE_PAGE_SIZE		((size_t)2 << 20)
+
+/* egy végrehajtási szál (opaque típus) */
+typedef struct platform_thread_struct PlatformThread;
+/* egy kölcsönös kizárást biztosító zár (opaque típus) */
+typedef struct platform_mutex_struct PlatformMutex;
+/* egy feltételváltozó (opaque típus) */
+typedef struct platform_condition_struct PlatformCondition;
+/* egy helyi (Unix domain) socket (opaque típus) */
+typedef struct platform_socket_struct PlatformSocket;
+
+/**
+ * @brief A folyamat erőforrás-használata.
+ */
+typedef struct platform_resource_usage_struct
+{
+	uint64_t peak_resident_size; /* a rezidens memória csúcsértéke (bájtban) */
+	uint64_t minor_faults; /* a háttértár nélkül kiszolgált laphibák száma */
+	uint64_t major_faults; /* a háttértárról kiszolgált laphibák száma */
+} PlatformResourceUsage;
+
+/* egy szál által végrehajtott függvényre mutató függvénypointer típus */
+typedef void(*fthread)(void* argument);
+
+/*
+ * Egy könyvtár bejegyzéseit feldolgozó függvényre mutató függvénypointer
+ * típus: a context a bejárás állapota, a name a bejegyzés neve. A
+ * visszatérési érték NO_ERROR-tól eltérő értéke megállítja a bejárást.
+ */
+typedef int(*fentry)(void* context, const char* name);
+
+/* fájlleképezést megvalósító függvények */
+
+int platform_map_file(FILE* file, void** p_address, size_t* p_size);
+void platform_unmap_file(void* address, size_t size);
+
+/* nagy lapokkal leképezett memóriaterületek foglalása */
+
+void* platform_allocate_pages(size_t size);
+void platform_free_pages(void* address, size_t size);
+
+/* pozícionált (a fájlpozíciót nem használó) I/O műveletek */
+
+int platform_get_file_size(FILE* file, uint64_t* p_size);
+int platform_read_at(FILE* file, void* buffer, size_t size, uint64_t offset);
+int platform_write_at(FILE* file, const void* buffer, size_t size, uint64_t offset);
+
+/* könyvtárakat kezelő függvények */
+
+bool platform_is_directory(const char* path);
+int platform_create_directory(const char* path);
+int platform_list_directory(const char* path, fentry function, void* context);
+
+/* helyi socketeket kezelő függvények */
+
+int platform_socket_listen(PlatformSocket** p_socket, const char* path);
+int platform_socket_accept(PlatformSocket* listener, PlatformSocket** p_socket);
+int platform_socket_connect(PlatformSocket** p_socket, const char* path);
+int platform_socket_send(PlatformSocket* endpoint, const void* buffer, size_t size);
+int platform_socket_receive(PlatformSocket* endpoint, void* buffer, size_t size, size_t* p_received);
+int platform_socket_wait(PlatformSocket* sockets[], bool ready[], int count, int timeout);
+void platform_socket_close(PlatformSocket* endpoint);
+
+/* szálkezelést megvalósító függvények */
+
+int platform_get_cpu_count(void);
+int platform_thread_create(PlatformThread** p_thread, fthread function, void* argument);
+void platform_thread_join(PlatformThread* thread);
+int platform_mutex_create(PlatformMutex** p_mutex);
+void platform_mutex_destroy(PlatformMutex* mutex);
+void platform_mutex_lock(PlatformMutex* mutex);
+void platform_mutex_unlock(PlatformMutex* mutex);
+int platform_condition_create(PlatformCondition** p_condition);
+void platform_condition_destroy(PlatformCondition* condition);
+void platform_condition_wait(PlatformCondition* condition, PlatformMutex* mutex);
+void platform_condition_broadcast(PlatformCondition* condition);
+
+/* időmérést megvalósító függvények */
+
+double platform_get_time(void);
+
+/* erőforrás-használatot lekérdező függvények */
+
+int platform_get_resource_usage(PlatformResourceUsage* p_usage);
+
+#endif /* PLATFORM_H_INCLUDED */
@@ -0,0 +1,241 @@
+﻿/*****************************************************************//**
+ * @file   readahead.c
+ * @brief  Egy fájl összefüggő tartományát egy háttérszálon, előre
+ * blokkonként beolvasó modul forrásfájlja.
+ *
+ * Az előreolvasó block_count darab pufferből álló gyűrűt tart fenn: amíg a
+ * hívó egy már beolvasott blokkot dolgoz fel, a háttérszál a következő
+ * szabad puffereket tölti fel, így a beolvasás és a feldolgozás ideje
+ * átfedi egymást. A háttérszál pozícionált olvasást (platform_read_at)
+ * használ, így a fájlpozíciót nem módosítja.
+ *
+ * A pufferek a hívó szálon kerülnek lefoglalásra, mivel a debugmalloc nem
+ * szálbiztos.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "readahead.h"
+#include "platform.h"
+#include "status.h"
+#include "allocator.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* előreolvasó */
+struct read_ahead_struct
+{
+	FILE* file; /* a beolvasandó fájl */
+	uint64_t offset; /* a következő beolvasandó blokk helye a fájlban */
+	uint64_t end; /* a beolvasandó tartomány vége a fájlban */
+	size_t block_size; /* egy blokk legnagyobb mérete */
+	int block_count; /* a pufferek száma */
+	uint8_t** blocks; /* a pufferek */
+	size_t* lengths; /* a pufferekbe beolvasott bájtok száma */
+	int fill_index; /* a következő feltöltendő puffer indexe */
+	int read_index; /* a következő átadandó puffer indexe */
+	int filled; /* a feltöltött, még át nem adott pufferek száma */
+	bool holding; /* a hívónál van-e a legutóbb átadott puffer */
+	bool stopping; /* le kell-e állnia a háttérszálnak */
+	int status; /* a háttérszál első hibájának kódja (vagy NO_ERROR) */
+	PlatformThread* thread; /* a háttérszál */
+	PlatformMutex* mutex; /* az állapotot védő zár */
+	PlatformCondition* changed; /* a pufferek állapotának változását jelző feltételváltozó */
+};
+
+/**
+ * A háttérszál főciklusa: amíg van szabad puffer, beolvassa a következő
+ * blokkot, egészen a tartomány végéig, az első hibáig vagy a leállításig.
+ *
+ * @param argument Az előreolvasó.
+ */
+static void readahead_main(void* argument)
+{
+	ReadAhead* read_ahead = (ReadAhead*)argument;
+
+	platform_mutex_lock(read_ahead->mutex);
+	for (;;)
+	{
+		/* a hívónál lévő puffer sem tölthető fel */
+		while (!read_ahead->stopping && read_ahead->offset < read_ahead->end &&
+			read_ahead->filled + (read_ahead->holding ? 1 : 0) == read_ahead->block_count)
+			platform_condition_wait(read_ahead->changed, read_ahead->mutex);
+		if (read_ahead->stopping || read_ahead->offset >= read_ahead->end)
+			break;
+
+		int index = read_ahead->fill_index;
+		uint64_t offset = read_ahead->offset;
+		uint64_t left = read_ahead->end - offset;
+		size_t length = (left < read_ahead->block_size) ? (size_t)left : read_ahead->block_size;
+		platform_mutex_unlock(read_ahead->mutex);
+
+		int status = platform_read_at(read_ahead->file, read_ahead->blocks[index], length, offset);
+
+		platform_mutex_lock(read_ahead->mutex);
+		if (status != NO_ERROR)
+		{
+			read_ahead->status = status;
+			platform_condition_broadcast(read_ahead->changed);
+			break;
+		}
+		read_ahead->lengths[index] = length;
+		read_ahead->fill_index = (index + 1) % read_ahead->block_count;
+		read_ahead->offset += length;
+		read_ahead->filled++;
+		platform_condition_broadcast(read_ahead->changed);
+	}
+	platform_mutex_unlock(read_ahead->mutex);
+}
+
+/**
+ * Létrehoz egy előreolvasót egy fájl [offset, offset + length) tartományára,
+ * és elindítja a háttérszálát, mely azonnal megkezdi a beolvasást.
+ *
+ * A lefoglalt erőforrások felszabadítása (readahead_destroy) a hívó
+ * feladata.
+ *
+ * @param p_read_ahead Az előreolvasóra mutató pointer helye.
+ * @param file A fájl.
+ * @param offset A tartomány kezdőpozíciója a fájlban.
+ * @param length A tartomány hossza (bájtban).
+ * @param block_size Egy blokk legnagyobb mérete (bájtban); az utolsó blokk
+ * kivételével minden blokk pontosan ekkora.
+ * @param block_count A pufferek száma (legalább 2).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int readahead_create(ReadAhead** p_read_ahead, FILE* file, uint64_t offset, uint64_t length, size_t block_size, int block_count)
+{
+	ReadAhead* read_ahead = (ReadAhead*)malloc(sizeof(ReadAhead));
+	if (read_ahead == NULL)
+		return MEMORY_ERROR;
+
+	read_ahead->file = file;
+	read_ahead->offset = offset;
+	read_ahead->end = offset + length;
+	read_ahead->block_size = block_size;
+	read_ahead->block_count = 0;
+	read_ahead->lengths = NULL;
+	read_ahead->fill_index = 0;
+	read_ahead->read_index = 0;
+	read_ahead->filled = 0;
+	read_ahead->holding = false;
+	read_ahead->stopping = false;
+	read_ahead->status = NO_ERROR;
+	read_ahead->thread = NULL;
+	read_ahead->mutex = NULL;
+	read_ahead->changed = NULL;
+
+	read_ahead->blocks = (uint8_t**)malloc(block_count * sizeof(uint8_t*));
+	read_ahead->lengths = (size_t*)malloc(block_count * sizeof(size_t));
+	if (read_ahead->blocks == NULL || read_ahead->lengths == NULL)
+	{
+		readahead_destroy(read_ahead);
+		return MEMORY_ERROR;
+	}
+
+	allocator_reserve(block_size);
+
+	for (; read_ahead->block_count < block_count; read_ahead->block_count++)
+	{
+		read_ahead->blocks[read_ahead->block_count] = (uint8_t*)malloc(block_size > 0 ? block_size : 1);
+		if (read_ahead->blocks[read_ahead->block_count] == NULL)
+		{
+			readahead_destroy(read_ahead);
+			return MEMORY_ERROR;
+		}
+	}
+
+	if (platform_mutex_create(&read_ahead->mutex) != NO_ERROR ||
+		platform_condition_create(&read_ahead->changed) != NO_ERROR ||
+		platform_thread_create(&read_ahead->thread, readahead_main, read_ahead) != NO_ERROR)
+	{
+		readahead_destroy(read_ahead);
+		return MEMORY_ERROR;
+	}
+
+	*p_read_ahead = read_ahead;
+
+	return NO_ERROR;
+}
+
+/**
+ * Leállítja és bevárja egy előreolvasó háttérszálát (a folyamatban lévő
+ * blokk beolvasását megvárva), majd felszabadítja az előreolvasót.
+ *
+ * @param read_ahead Az előreolvasó.
+ */
+void readahead_destroy(ReadAhead* read_ahead)
+{
+	if (read_ahead->thread != NULL)
+	{
+		platform_mutex_lock(read_ahead->mutex);
+		read_ahead->stopping = true;
+		platform_condition_broadcast(read_ahead->changed);
+		platform_mutex_unlock(read_ahead->mutex);
+
+		platform_thread_join(read_ahead->thread);
+	}
+
+	if (read_ahead->changed != NULL)
+		platform_condition_destroy(read_ahead->changed);
+	if (read_ahead->mutex != NULL)
+		platform_mutex_destroy(read_ahead->mutex);
+	if (read_ahead->blocks != NULL)
+	{
+		for (int i = 0; i < read_ahead->block_count; i++)
+			free(read_ahead->blocks[i]);
+		free(read_ahead->blocks);
+	}
+	if (read_ahead->lengths != NULL)
+		free(read_ahead->lengths);
+	free(read_ahead);
+}
+
+/**
+ * Visszaadja a háttérszálnak a legutóbb átadott blokkot, majd megvárja és
+ * átadja a hívónak a következő beolvasott blokkot. A blokk a következő
+ * hívásig (vagy az előreolvasó felszabadításáig) érvényes.
+ *
+ * @param[in] read_ahead Az előreolvasó.
+ * @param[out] p_block A blokk kezdőcímének helye.
+ * @param[out] p_length A blokk hosszának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a tartomány végén túli
+ * olvasás vagy a beolvasás közben felmerülő I/O probléma esetén
+ * IO_ERROR-ral tér vissza.
+ */
+int readahead_next(ReadAhead* read_ahead, const uint8_t** p_block, size_t* p_length)
+{
+	int status = NO_ERROR;
+
+	platform_mutex_lock(read_ahead->mutex);
+
+	if (read_ahead->holding)
+	{
+		read_ahead->holding = false;
+		read_ahead->read_index = (read_ahead->read_index + 1) % read_ahead->block_count;
+		platform_condition_broadcast(read_ahead->changed);
+	}
+
+	while (read_ahead->filled == 0 && read_ahead->status == NO_ERROR && read_ahead->offset < read_ahead->end)
+		platform_condition_wait(read_ahead->changed, read_ahead->mutex);
+
+	if (read_ahead->filled > 0)
+	{
+		*p_block = read_ahead->blocks[read_ahead->read_index];
+		*p_length = read_ahead->lengths[read_ahead->read_index];
+		read_ahead->filled--;
+		read_ahead->holding = true;
+	}
+	else
+		status = (read_ahead->status != NO_ERROR) ? read_ahead->status : IO_ERROR;
+
+	platform_mutex_unlock(read_ahead->mutex);
+
+	return status;
+}
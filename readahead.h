@@ -0,0 +1,23 @@
+﻿/*****************************************************************//**
+ * @file   readahead.h
+ * @brief  Egy fájl összefüggő tartományát egy háttérszálon, előre
+ * blokkonként beolvasó modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef READAHEAD_H_INCLUDED
+#define READAHEAD_H_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* egy előreolvasó (opaque típus) */
+typedef struct read_ahead_struct ReadAhead;
+
+int readahead_create(ReadAhead** p_read_ahead, FILE* file, uint64_t offset, uint64_t length, size_t block_size, int block_count);
+void readahead_destroy(ReadAhead* read_ahead);
+int readahead_next(ReadAhead* read_ahead, const uint8_t** p_block, size_t* p_length);
+
+#endif /* READAHEAD_H_INCLUDED */
@@ -0,0 +1,626 @@
+﻿/*****************************************************************//**
+ * @file   server.c
+ * @brief  A kéréseket egy helyi (Unix domain) socketen fogadó, állandóan
+ * futó szerver modul forrásfájlja.
+ *
+ * A szerver egyszer indul el, így a folyamat indítása, az allokátor és a
+ * pixelmátrixok gyorsítótárának bemelegedése nem terheli az egyes
+ * kéréseket. A kapcsolatokat a főszál figyeli, a beérkezett kéréseket
+ * pedig előre elindított munkásszálak szolgálják ki (kérésenként, így a
+ * tétlen kapcsolatok nem foglalnak munkást); a kérésenként szükséges
+ * puffereket a munkások előre lefoglalják, a pixelmátrixok pedig a kérések
+ * között a közös gyorsítótárban maradnak.
+ *
+ * A debugmalloc nem szálbiztos, ezért debug buildben egyetlen munkás
+ * szolgálja ki a kéréseket, a beállított számú szál pedig az egyes
+ * képeken végzett műveleteket gyorsítja; a főszál nem foglal memóriát.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "server.h"
+#include "status.h"
+#include "image.h"
+#include "batch.h"
+#include "plan.h"
+#include "threadpool.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* egy kapcsolat állapota */
+struct server_connection_struct
+{
+	PlatformSocket* socket; /* a kapcsolat socketje, szabad hely esetén NULL */
+	ServerBuffer buffer; /* a fogadott bájtok */
+	char* request; /* a kiszolgálásra váró kérés (a pufferben), vagy NULL */
+	double last_active; /* az utolsó fogadott bájt vagy kiszolgált kérés ideje (másodpercben) */
+	bool busy; /* a kapcsolat kérése a sorban vár, vagy egy munkás szolgálja ki */
+	bool failed; /* a kapcsolatot le kell zárni (megszakadt, vagy hibás a kérése) */
+};
+
+/* a szerver közös állapota */
+struct server_struct
+{
+	const char* path; /* a figyelő socket fájlja */
+	const Options* options; /* a kérések alapértelmezett beállításai */
+	ThreadPool* pool; /* a képeken végzett műveletek munkáskészlete, vagy NULL */
+	PlatformMutex* mutex; /* a sort, a kapcsolatok foglaltságát, a leállítást és a statisztikákat védő zár */
+	PlatformCondition* changed; /* a sor vagy a leállítás változását jelző feltételváltozó */
+	PlatformSocket* wakeup_sender; /* a főszál ébresztésére szolgáló kapcsolat küldő oldala */
+	PlatformSocket* wakeup_receiver; /* a főszál ébresztésére szolgáló kapcsolat fogadó oldala */
+	bool wakeup_pending; /* a főszál ébresztése már folyamatban van */
+	struct server_connection_struct* connections; /* a kapcsolatok helyei (SERVER_MAX_CONNECTIONS darab) */
+	struct server_connection_struct* queue[SERVER_MAX_CONNECTIONS]; /* a kiszolgálásra váró kérések kapcsolatai */
+	int queue_head; /* a sor első elemének indexe */
+	int queue_count; /* a sor elemeinek száma */
+	bool stopping; /* a szerver leállítását kérték */
+	ServerStatistics statistics; /* a kiszolgált kérések statisztikái */
+};
+
+/* egy munkásszál állapota és előre lefoglalt pufferei */
+struct server_worker_struct
+{
+	struct server_struct* server; /* a szerver közös állapota */
+	PlatformThread* thread; /* a munkás szála */
+	char* fields[SERVER_MAX_SWITCHES + 2]; /* a kérés mezői */
+	Operation operations[SERVER_MAX_SWITCHES]; /* a kérés műveletei */
+};
+
+/**
+ * Kiüríti egy kapcsolat pufferét (egy új kapcsolat kiszolgálása előtt).
+ *
+ * @param buffer A puffer.
+ */
+void server_reset_buffer(ServerBuffer* buffer)
+{
+	buffer->filled = 0;
+	buffer->consumed = 0;
+}
+
+/**
+ * Kiveszi a következő, újsor karakterrel lezárt sort egy kapcsolat már
+ * fogadott bájtjai közül. A sor a pufferben marad (a lezáró újsor, illetve
+ * kocsi vissza karakter helyén nullával lezárva), és a következő hívásig
+ * érvényes.
+ *
+ * @param buffer A kapcsolat pufferje.
+ * @param p_line A sor helye; ha a puffer nem tartalmaz teljes sort,
+ * NULL-pointer.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a puffernél hosszabb sor
+ * esetén IO_ERROR-ral tér vissza.
+ */
+static int server_take_line(ServerBuffer* buffer, char** p_line)
+{
+	if (buffer->consumed > 0)
+	{
+		buffer->filled -= buffer->consumed;
+		memmove(buffer->data, buffer->data + buffer->consumed, buffer->filled);
+		buffer->consumed = 0;
+	}
+
+	char* end = (char*)memchr(buffer->data, '\n', buffer->filled);
+	if (end == NULL)
+	{
+		*p_line = NULL;
+		return (buffer->filled == sizeof(buffer->data)) ? IO_ERROR : NO_ERROR;
+	}
+
+	*end = '\0';
+	if (end > buffer->data && end[-1] == '\r')
+		end[-1] = '\0';
+	buffer->consumed = end - buffer->data + 1;
+	*p_line = buffer->data;
+
+	return NO_ERROR;
+}
+
+/**
+ * Beolvassa a következő, újsor karakterrel lezárt sort egy kapcsolatról.
+ * A sor a pufferben marad (a lezáró újsor, illetve kocsi vissza karakter
+ * helyén nullával lezárva), és a következő hívásig érvényes.
+ *
+ * @param endpoint A kapcsolat socketje.
+ * @param buffer A kapcsolat pufferje.
+ * @param p_line A sor helye; a kapcsolat (sorhatáron történő) lezárása
+ * esetén NULL-pointer.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként (a puffernél
+ * hosszabb sor, vagy a sor közepén megszakadt kapcsolat esetén is)
+ * IO_ERROR-ral tér vissza.
+ */
+int server_read_line(PlatformSocket* endpoint, ServerBuffer* buffer, char** p_line)
+{
+	int status;
+
+	for (;;)
+	{
+		if ((status = server_take_line(buffer, p_line)) != NO_ERROR || *p_line != NULL)
+			return status;
+
+		size_t received;
+		if ((status = platform_socket_receive(endpoint, buffer->data + buffer->filled, sizeof(buffer->data) - buffer->filled, &received)) != NO_ERROR)
+			return status;
+		if (received == 0)
+			return (buffer->filled == 0) ? NO_ERROR : IO_ERROR;
+		buffer->filled += received;
+	}
+}
+
+/**
+ * Megvizsgálja, hogy egy kapcsoló a teljes folyamatra vonatkozik-e (a
+ * foglalási mód és a végrehajtási terv kiírása), melyet egy kérés nem
+ * változtathat meg.
+ *
+ * @param sw A kapcsoló.
+ * @return Logikai igazzal tér vissza, ha a kapcsoló a folyamatra vonatkozik.
+ */
+static bool server_is_process_switch(const char* sw)
+{
+	return strncmp(sw, "-alloc=", strlen("-alloc=")) == 0 || strcmp(sw, "-explain") == 0;
+}
+
+/**
+ * Végrehajt egy kérést: a mezőit a munkás előre lefoglalt tömbjeibe bontja,
+ * értelmezi és egyszerűsíti a kapcsolókat, majd feldolgozza a bemeneti
+ * fájlt.
+ *
+ * @param worker A munkás.
+ * @param request A kérés (a mezők elválasztásakor módosul).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, kevés mező esetén
+ * CMD_TOO_FEW_ARGUMENTS-szel, túl sok vagy a folyamatra vonatkozó kapcsoló
+ * (lásd server_is_process_switch) esetén CMD_UNKNOWN_CMD_SWITCH-csel,
+ * egyébként a kapcsolók vagy a feldolgozás hibakódjával tér vissza.
+ */
+static int server_execute(struct server_worker_struct* worker, char* request)
+{
+	int status;
+
+	int field_count = 0;
+	for (char* field = request; field != NULL; field_count++)
+	{
+		if (field_count == SERVER_MAX_SWITCHES + 2)
+			return CMD_UNKNOWN_CMD_SWITCH;
+		worker->fields[field_count] = field;
+
+		field = strchr(field, SERVER_SEPARATOR);
+		if (field != NULL)
+			*field++ = '\0';
+	}
+	if (field_count < 2)
+		return CMD_TOO_FEW_ARGUMENTS;
+	for (int i = 2; i < field_count; i++)
+		if (server_is_process_switch(worker->fields[i]))
+			return CMD_UNKNOWN_CMD_SWITCH;
+
+	/* a kérés kapcsolói a szerver beállításait írják felül */
+	Options options = *worker->server->options;
+
+	int count;
+	if ((status = cmd_parse_switches(&options, worker->operations, &count, worker->fields + 2, field_count - 2)) != NO_ERROR)
+		return status;
+	if ((status = plan_optimize(worker->operations, &count)) != NO_ERROR)
+		goto release_operations;
+
+	FILE* input_file = fopen(worker->fields[0], "rb");
+	if (input_file == NULL)
+	{
+		status = IO_ERROR;
+		goto release_operations;
+	}
+
+	FILE* output_file = fopen(worker->fields[1], "wb");
+	if (output_file == NULL)
+	{
+		status = IO_ERROR;
+		goto close_input;
+	}
+
+	status = batch_process_file(input_file, output_file, worker->operations, count, &options, worker->server->pool);
+
+	if (fclose(output_file) != 0 && status == NO_ERROR)
+		status = IO_ERROR;
+close_input:
+	fclose(input_file);
+release_operations:
+	for (int i = 0; i < count; i++)
+		cmd_release_operation(&worker->operations[i]);
+
+	return status;
+}
+
+
+/**
+ * Felébreszti a kapcsolatokra várakozó főszálat, hogy az a kapcsolatok
+ * megváltozott állapotát (egy munkástól visszakapott kapcsolatot, vagy a
+ * leállítást) figyelembe vegye. A hívónak a zárat tartania kell; az
+ * ébresztő bájt elküldése a zár elengedése után, a visszatérési érték
+ * szerint a hívó feladata.
+ *
+ * @param server A szerver közös állapota.
+ * @return Visszatér azzal, hogy a hívónak kell-e ébresztő bájtot küldenie.
+ */
+static bool server_request_wakeup(struct server_struct* server)
+{
+	if (server->wakeup_pending)
+		return false;
+	server->wakeup_pending = true;
+	return true;
+}
+
+/**
+ * Leállítja a szervert: a sorban várakozó kérések kiszolgálása még
+ * megtörténik, újabb kapcsolatok és kérések azonban nem kerülnek
+ * elfogadásra, a nyitott kapcsolatok pedig lezárulnak.
+ *
+ * @param server A szerver közös állapota.
+ */
+static void server_stop(struct server_struct* server)
+{
+	platform_mutex_lock(server->mutex);
+	server->stopping = true;
+	platform_condition_broadcast(server->changed);
+	bool wakeup = server_request_wakeup(server);
+	platform_mutex_unlock(server->mutex);
+
+	if (wakeup)
+		platform_socket_send(server->wakeup_sender, "", 1);
+}
+
+/**
+ * Kiszolgálja egy kapcsolat soron következő kérését, és válaszol a
+ * hibakódjával. Ha a kapcsolat pufferében már a következő kérés is
+ * megérkezett, a kapcsolat a sor végére kerül (így a többi kapcsolat
+ * kérései is sorra kerülnek), egyébként visszakerül a főszálhoz, mely a
+ * további kéréseire vár.
+ *
+ * @param worker A munkás.
+ * @param connection A kapcsolat.
+ */
+static void server_serve(struct server_worker_struct* worker, struct server_connection_struct* connection)
+{
+	struct server_struct* server = worker->server;
+
+	int status = NO_ERROR;
+	if (strcmp(connection->request, SERVER_STOP_REQUEST) == 0)
+		server_stop(server);
+	else
+		status = server_execute(worker, connection->request);
+
+	char response[16];
+	int length = snprintf(response, sizeof(response), "%d\n", status);
+	bool failed = platform_socket_send(connection->socket, response, (size_t)length) != NO_ERROR ||
+		server_take_line(&connection->buffer, &connection->request) != NO_ERROR;
+
+	platform_mutex_lock(server->mutex);
+	server->statistics.request_count++;
+	if (status != NO_ERROR)
+		server->statistics.failed_count++;
+
+	bool wakeup = false;
+	if (!failed && connection->request != NULL && !server->stopping)
+	{
+		server->queue[(server->queue_head + server->queue_count) % SERVER_MAX_CONNECTIONS] = connection;
+		server->queue_count++;
+		platform_condition_broadcast(server->changed);
+	}
+	else
+	{
+		connection->request = NULL;
+		connection->failed = failed;
+		connection->busy = false;
+		connection->last_active = platform_get_time();
+		wakeup = server_request_wakeup(server);
+	}
+	platform_mutex_unlock(server->mutex);
+
+	if (wakeup)
+		platform_socket_send(server->wakeup_sender, "", 1);
+}
+
+/**
+ * Egy munkásszál belépési pontja: a sorból sorban kiveszi és kiszolgálja
+ * a kéréseket, amíg a szerver le nem áll és a sor ki nem ürül.
+ *
+ * @param argument A munkás.
+ */
+static void server_worker_main(void* argument)
+{
+	struct server_worker_struct* worker = (struct server_worker_struct*)argument;
+	struct server_struct* server = worker->server;
+
+	for (;;)
+	{
+		platform_mutex_lock(server->mutex);
+		while (server->queue_count == 0 && !server->stopping)
+			platform_condition_wait(server->changed, server->mutex);
+		if (server->queue_count == 0)
+		{
+			platform_mutex_unlock(server->mutex);
+			return;
+		}
+
+		struct server_connection_struct* connection = server->queue[server->queue_head];
+		server->queue_head = (server->queue_head + 1) % SERVER_MAX_CONNECTIONS;
+		server->queue_count--;
+		platform_mutex_unlock(server->mutex);
+
+		server_serve(worker, connection);
+	}
+}
+
+/**
+ * Fogadja egy olvasható kapcsolat beérkezett bájtjait, és ha azok egy
+ * teljes kérést tartalmaznak, átadja a kapcsolatot a munkásoknak.
+ *
+ * @param server A szerver közös állapota.
+ * @param connection A kapcsolat (melyet a főszál figyel).
+ */
+static void server_receive(struct server_struct* server, struct server_connection_struct* connection)
+{
+	ServerBuffer* buffer = &connection->buffer;
+
+	size_t received;
+	if (platform_socket_receive(connection->socket, buffer->data + buffer->filled, sizeof(buffer->data) - buffer->filled, &received) != NO_ERROR ||
+		received == 0)
+	{
+		connection->failed = true;
+		return;
+	}
+	buffer->filled += received;
+	connection->last_active = platform_get_time();
+
+	if (server_take_line(buffer, &connection->request) != NO_ERROR)
+	{
+		connection->failed = true;
+		return;
+	}
+	if (connection->request == NULL)
+		return;
+
+	platform_mutex_lock(server->mutex);
+	connection->busy = true;
+	server->queue[(server->queue_head + server->queue_count) % SERVER_MAX_CONNECTIONS] = connection;
+	server->queue_count++;
+	platform_condition_broadcast(server->changed);
+	platform_mutex_unlock(server->mutex);
+}
+
+/**
+ * Figyeli a figyelő socketet és a munkások által épp ki nem szolgált
+ * kapcsolatokat: fogadja az új kapcsolatokat, a beérkezett kéréseket a
+ * munkások sorába teszi, a megszakadt, hibás és SERVER_IDLE_TIMEOUT
+ * másodpercnél régebben tétlen kapcsolatokat pedig lezárja. Így a tétlen
+ * kliensek nem foglalnak munkást. A leállítás kéréséig (és a kiszolgálás
+ * alatt álló kapcsolatok visszaérkezéséig), vagy az első hibáig fut; hiba
+ * esetén a munkásoknál maradt kapcsolatok lezárása a hívó feladata.
+ *
+ * @param server A szerver közös állapota.
+ * @param listener A figyelő socket.
+ * @return Leállítás esetén NO_ERROR-ral, egyébként a kapcsolatok
+ * figyelésének vagy fogadásának hibakódjával tér vissza.
+ */
+static int server_dispatch(struct server_struct* server, PlatformSocket* listener)
+{
+	int status = NO_ERROR;
+
+	PlatformSocket* sockets[SERVER_MAX_CONNECTIONS + 2];
+	bool ready[SERVER_MAX_CONNECTIONS + 2];
+	struct server_connection_struct* watched[SERVER_MAX_CONNECTIONS];
+
+	for (;;)
+	{
+		/* a munkásoktól visszakapott kapcsolatok átvétele; az ébresztés innentől újra kérhető */
+		double now = platform_get_time();
+		int open_count = 0;
+		int watched_count = 0;
+
+		platform_mutex_lock(server->mutex);
+		server->wakeup_pending = false;
+		bool stopping = server->stopping;
+		for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+		{
+			struct server_connection_struct* connection = &server->connections[i];
+			if (connection->socket == NULL)
+				continue;
+
+			if (!connection->busy && (connection->failed || stopping || now - connection->last_active > SERVER_IDLE_TIMEOUT))
+			{
+				platform_socket_close(connection->socket);
+				connection->socket = NULL;
+				continue;
+			}
+
+			open_count++;
+			if (!connection->busy)
+				watched[watched_count++] = connection;
+		}
+		platform_mutex_unlock(server->mutex);
+
+		if (stopping && open_count == 0)
+			return status;
+
+		int count = 0;
+		sockets[count++] = server->wakeup_receiver;
+		bool accepting = !stopping && open_count < SERVER_MAX_CONNECTIONS;
+		if (accepting)
+			sockets[count++] = listener;
+		for (int i = 0; i < watched_count; i++)
+			sockets[count++] = watched[i]->socket;
+
+		/* tétlen kapcsolatok esetén másodpercenként ellenőrizni kell a lejáratukat */
+		int wait_status = platform_socket_wait(sockets, ready, count, (watched_count > 0) ? 1000 : -1);
+		if (wait_status != NO_ERROR)
+		{
+			server_stop(server);
+			return wait_status;
+		}
+
+		if (ready[0])
+		{
+			char wakeup[64];
+			size_t received;
+			platform_socket_receive(server->wakeup_receiver, wakeup, sizeof(wakeup), &received);
+		}
+
+		int first_watched = 1;
+		if (accepting)
+		{
+			first_watched = 2;
+			if (ready[1])
+			{
+				PlatformSocket* socket;
+				int accept_status = platform_socket_accept(listener, &socket);
+				if (accept_status != NO_ERROR)
+				{
+					status = accept_status;
+					server_stop(server);
+					continue;
+				}
+
+				struct server_connection_struct* connection = server->connections;
+				while (connection->socket != NULL)
+					connection++;
+				connection->socket = socket;
+				server_reset_buffer(&connection->buffer);
+				connection->request = NULL;
+				connection->last_active = now;
+				connection->busy = false;
+				connection->failed = false;
+			}
+		}
+
+		for (int i = 0; i < watched_count; i++)
+			if (ready[first_watched + i])
+				server_receive(server, watched[i]);
+	}
+}
+
+/**
+ * Elindítja a szervert a megadott socketfájlon, és a leállító kérésig
+ * (SERVER_STOP_REQUEST) kiszolgálja a kéréseket. A kapcsolatokat a főszál
+ * figyeli, a beérkezett kéréseket pedig release buildben a beállított
+ * számú munkásszál párhuzamosan, debug buildben egyetlen munkás szolgálja
+ * ki. A leállítás bevárja a már fogadott kérések kiszolgálását.
+ *
+ * @param path A socket fájljának elérési útja.
+ * @param options A kérések alapértelmezett beállításai.
+ * @param p_statistics Az összesített eredmény helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, a socket kezelésének hibája
+ * esetén IO_ERROR-ral, egyébként MEMORY_ERROR-ral tér vissza.
+ */
+int server_run(const char* path, const Options* options, ServerStatistics* p_statistics)
+{
+	int status;
+
+#ifdef NDEBUG
+	int worker_count = (options->thread_count > 1) ? options->thread_count : 1;
+#else
+	int worker_count = 1;
+#endif
+
+	struct server_struct server = {
+		.path = path,
+		.options = options,
+		.pool = NULL,
+		.mutex = NULL,
+		.changed = NULL,
+		.wakeup_sender = NULL,
+		.wakeup_receiver = NULL,
+		.wakeup_pending = false,
+		.connections = NULL,
+		.queue_head = 0,
+		.queue_count = 0,
+		.stopping = false,
+		.statistics = { 0, 0 }
+	};
+
+	struct server_worker_struct* workers = (struct server_worker_struct*)malloc(worker_count * sizeof(struct server_worker_struct));
+	if (workers == NULL)
+		return MEMORY_ERROR;
+
+	/* a kapcsolatok helyei előre lefoglalódnak: a főszál a munkásokkal párhuzamosan nem foglalhat */
+	server.connections = (struct server_connection_struct*)malloc(SERVER_MAX_CONNECTIONS * sizeof(struct server_connection_struct));
+	if (server.connections == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto free_workers;
+	}
+	for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+		server.connections[i].socket = NULL;
+
+	PlatformSocket* listener;
+	if ((status = platform_socket_listen(&listener, path)) != NO_ERROR)
+		goto free_connections;
+
+	/* a főszál ébresztése egy saját magához kapcsolódó socketpáron keresztül történik */
+	if ((status = platform_socket_connect(&server.wakeup_sender, path)) != NO_ERROR ||
+		(status = platform_socket_accept(listener, &server.wakeup_receiver)) != NO_ERROR)
+		goto destroy_context;
+
+	if ((status = platform_mutex_create(&server.mutex)) != NO_ERROR ||
+		(status = platform_condition_create(&server.changed)) != NO_ERROR)
+		goto destroy_context;
+
+	/* egy munkás: a szálak a képeken végzett műveleteket gyorsítják */
+	if (worker_count == 1 && options->thread_count > 1 && (status = threadpool_create(&server.pool, options->thread_count)) != NO_ERROR)
+		goto destroy_context;
+	if (worker_count > 1 && (status = image_pool_set_shared(true)) != NO_ERROR)
+		goto destroy_context;
+
+	image_set_thread_pool(server.pool);
+
+	int started = 0;
+	for (; started < worker_count; started++)
+	{
+		workers[started].server = &server;
+		if ((status = platform_thread_create(&workers[started].thread, server_worker_main, &workers[started])) != NO_ERROR)
+			break;
+	}
+
+	if (status == NO_ERROR)
+	{
+		printf("Szerver: %s, %d munkas\n", path, worker_count);
+		fflush(stdout);
+		status = server_dispatch(&server, listener);
+	}
+	else
+		server_stop(&server);
+
+	for (int i = 0; i < started; i++)
+		platform_thread_join(workers[i].thread);
+
+	/* hiba miatti leállás esetén nyitva maradt kapcsolatok */
+	for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+		if (server.connections[i].socket != NULL)
+			platform_socket_close(server.connections[i].socket);
+
+	image_set_thread_pool(NULL);
+
+	*p_statistics = server.statistics;
+
+destroy_context:
+	image_pool_set_shared(false);
+	if (server.pool != NULL)
+		threadpool_destroy(server.pool);
+	if (server.changed != NULL)
+		platform_condition_destroy(server.changed);
+	if (server.mutex != NULL)
+		platform_mutex_destroy(server.mutex);
+	if (server.wakeup_receiver != NULL)
+		platform_socket_close(server.wakeup_receiver);
+	if (server.wakeup_sender != NULL)
+		platform_socket_close(server.wakeup_sender);
+	platform_socket_close(listener);
+free_connections:
+	free(server.connections);
+free_workers:
+	free(workers);
+
+	return status;
+}
@@ -0,0 +1,60 @@
+﻿/*****************************************************************//**
+ * @file   server.h
+ * @brief  A kéréseket egy helyi (Unix domain) socketen fogadó, állandóan
+ * futó szerver modul fejlécfájlja.
+ *
+ * A protokoll soralapú: egy kérés egyetlen, újsor karakterrel lezárt sor,
+ * melynek tabulátorral elválasztott mezői a bemeneti fájl, a kimeneti fájl
+ * és a kapcsolók; a válasz a kérés hibakódja decimálisan, szintén újsor
+ * karakterrel lezárva. Egy kapcsolaton tetszőleges számú kérés küldhető
+ * egymás után.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cmd.h"
+#include "platform.h"
+
+/* egy kérés (egy sor) legnagyobb hossza bájtban, a lezáró újsor karakterrel */
+#define SERVER_MAX_REQUEST		8192
+/* egy kérés kapcsolóinak legnagyobb száma */
+#define SERVER_MAX_SWITCHES		256
+/* az egyszerre nyitva tartott kapcsolatok legnagyobb száma */
+#define SERVER_MAX_CONNECTIONS	64
+/* a tétlen kapcsolatok lezárásáig eltelő idő másodpercben */
+#define SERVER_IDLE_TIMEOUT		60
+
+/* a kérések mezőit elválasztó karakter */
+#define SERVER_SEPARATOR		'\t'
+/* a szervert leállító kérés */
+#define SERVER_STOP_REQUEST		"-stop"
+
+/**
+ * @brief Egy kapcsolat fogadott, de még fel nem dolgozott bájtjai.
+ */
+typedef struct server_buffer_struct
+{
+	char data[SERVER_MAX_REQUEST]; /* a fogadott bájtok */
+	size_t filled; /* a pufferben lévő bájtok száma */
+	size_t consumed; /* a már feldolgozott sorok hossza a puffer elején */
+} ServerBuffer;
+
+/**
+ * @brief A szerver futásának összesített eredménye.
+ */
+typedef struct server_statistics_struct
+{
+	uint64_t request_count; /* a kiszolgált kérések száma */
+	uint64_t failed_count; /* a hibás kérések száma */
+} ServerStatistics;
+
+void server_reset_buffer(ServerBuffer* buffer);
+int server_read_line(PlatformSocket* endpoint, ServerBuffer* buffer, char** p_line);
+int server_run(const char* path, const Options* options, ServerStatistics* p_statistics);
+
+#endif /* SERVER_H_INCLUDED */
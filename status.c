@@ -12,7 +12,9 @@
 
 #include <stdio.h>
 
+#ifndef NDEBUG
 #include "debugmalloc.h"
+#endif
 
 /* az általánosan definiált hibakódok szöveges reprezentációja */
 const char* status_error_code_strings[] = {
@@ -0,0 +1,644 @@
+﻿/*****************************************************************//**
+ * @file   stream.c
+ * @brief  A képeket soronként, a teljes kép memóriába töltése nélkül
+ * feldolgozó modul forrásfájlja.
+ *
+ * A bemeneti kép sorai blokkokban haladnak végig a műveletek láncán, majd
+ * kerülnek kiírásra, így a memóriahasználat a kép magasságától független:
+ * műveletenként egy blokknyi (legfeljebb STREAM_BLOCK_SIZE bájtnyi) sor.
+ * Egy blokk sorai egymástól függetlenül számolhatók, így a képműveletek
+ * munkáskészlete (lásd image_set_thread_pool) sávokra bontva dolgozza fel
+ * őket. Csak a soronként, illetve szűk sorablakon elvégezhető műveletek
+ * támogatottak.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "stream.h"
+#include "image.h"
+#include "bmp.h"
+#include "status.h"
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* egy blokk (a fokozatok között egyszerre továbbadott sorok) legnagyobb mérete bájtban */
+#define STREAM_BLOCK_SIZE		(1 << 19)
+
+/* a sorfolyam egy fokozatát (egy elemi lépést) leíró struktúra */
+struct stream_stage_struct
+{
+	const Operation* operation; /* a fokozathoz tartozó (pontműveleteknél az első) művelet */
+	bool lookup; /* a fokozat csak keresőtáblát alkalmaz (pontműveletek, illetve ráolvasztott kimenet) */
+	ImageLut lut; /* az egymást követő pontműveletek összevont keresőtáblája */
+	uint32_t in_width; /* a bemeneti sorok szélessége */
+	uint32_t in_height; /* a bemeneti sorok száma */
+	uint32_t out_width; /* a kimeneti sorok szélessége */
+	uint32_t out_height; /* a kimeneti sorok száma */
+	uint32_t rows_in; /* az eddig beérkezett sorok száma */
+	uint32_t rows_out; /* az eddig előállított sorok száma */
+	Pixel* window[2]; /* az előző blokkok utolsó két bemeneti sora (elhomályosításnál) */
+	Pixel* block; /* a kimeneti blokk kiszámolt sorainak helye */
+	const Pixel** rows; /* a kimeneti blokk sorai (változatlanul továbbadott sor esetén a bemeneti sor) */
+	const Pixel** sources; /* a kimeneti blokk soronként három forrássora (a fölötte lévő, a megfelelő és az alatta lévő); változatlan sornál a középső NULL */
+	uint32_t pending; /* a kimeneti blokkban összegyűjtött sorok száma */
+};
+
+/* egy teljes sorfolyamot leíró struktúra */
+struct stream_struct
+{
+	struct stream_stage_struct* stages; /* a fokozatok tömbje */
+	size_t stage_count; /* a fokozatok száma */
+	uint32_t block_rows; /* egy blokk sorainak száma */
+	BmpWriter* writer; /* a kimeneti képet soronként kiíró struktúra */
+	uint32_t rows_written; /* az eddig kiírt sorok száma */
+};
+
+/**
+ * Megvizsgálja, hogy egy művelet elvégezhető-e soronként (vagy szűk
+ * sorablakon), vagyis a sorfolyamban.
+ *
+ * @param operation A művelet.
+ * @return Amennyiben a művelet elvégezhető a sorfolyamban, logikai igazzal,
+ * egyébként logikai hamissal tér vissza.
+ */
+static bool stream_is_operation_supported(const Operation* operation)
+{
+	switch (operation->type)
+	{
+	case OPERATION_SCALE:
+	case OPERATION_MIRROR_Y:
+	case OPERATION_BLUR:
+	case OPERATION_EXPOSURE:
+	case OPERATION_CONTRAST:
+	case OPERATION_GAMMA:
+	case OPERATION_LEVELS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Megvizsgálja, hogy egy műveletsor végrehajtható-e a sorfolyamban.
+ *
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @return Amennyiben minden művelet elvégezhető a sorfolyamban, logikai
+ * igazzal, egyébként logikai hamissal tér vissza.
+ */
+bool stream_is_supported(const Operation* operations, int count)
+{
+	for (int i = 0; i < count; i++)
+		if (!stream_is_operation_supported(&operations[i]))
+			return false;
+	return true;
+}
+
+/**
+ * Lefoglal count darab, egymást követő, width szélességű pixelsort.
+ *
+ * @param width A sorok szélessége.
+ * @param count A sorok száma.
+ * @return Sikeres lefutás esetén a lefoglalt sorokra mutató pointerrel,
+ * egyébként NULL-pointerrel tér vissza.
+ */
+static Pixel* stream_create_rows(uint32_t width, uint32_t count)
+{
+	/* nulla szélességű kép esetén is érvényes pointer kell */
+	uint64_t pixels = (uint64_t)(width > 0 ? width : 1) * count;
+	if (pixels > SIZE_MAX / sizeof(Pixel))
+		return NULL;
+	size_t size = (size_t)pixels * sizeof(Pixel);
+
+	allocator_reserve(size);
+
+	return (Pixel*)malloc(size);
+}
+
+/**
+ * Kiszámolja, hány sor alkot egy blokkot: egy blokk legfeljebb
+ * STREAM_BLOCK_SIZE bájtnyi, de legalább egy sorból áll, és nem hosszabb
+ * a képnél.
+ *
+ * @param width A sorfolyam legszélesebb sorának szélessége.
+ * @param height A sorfolyam legmagasabb képének magassága.
+ * @return Visszatér a sorok számával (legalább 1-gyel).
+ */
+static uint32_t stream_calculate_block_rows(uint32_t width, uint32_t height)
+{
+	size_t rows = STREAM_BLOCK_SIZE / ((size_t)(width > 0 ? width : 1) * sizeof(Pixel));
+	if (rows > height)
+		rows = height;
+	return (rows > 0) ? (uint32_t)rows : 1;
+}
+
+/**
+ * Megszámolja, hány fokozatra bomlik egy műveletsor: az n intenzitású
+ * elhomályosítás n darab fokozatra bomlik, az egymást követő
+ * pontműveletek viszont egyetlen, keresőtáblás fokozatba olvadnak. A
+ * műveletekre ráolvasztott keresőtábla a művelet utáni külön fokozat.
+ *
+ * @param[in] operations A műveletek tömbje.
+ * @param[in] count A műveletek száma.
+ * @param[out] p_stage_count A fokozatok számának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, nulla intenzitású
+ * elhomályosítás esetén IMAGE_BAD_PARAMETER-rel tér vissza.
+ */
+static int stream_count_stages(const Operation* operations, int count, size_t* p_stage_count)
+{
+	size_t stage_count = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (operations[i].type == OPERATION_BLUR)
+		{
+			if (operations[i].param.value == 0)
+				return IMAGE_BAD_PARAMETER;
+			stage_count += abs(operations[i].param.value);
+		}
+		else if (!cmd_is_point_operation(&operations[i]) || i == 0 || !cmd_is_point_operation(&operations[i - 1]))
+		{
+			stage_count += 1;
+		}
+		if (operations[i].output != NULL)
+			stage_count += 1;
+	}
+
+	*p_stage_count = stage_count;
+
+	return NO_ERROR;
+}
+
+/**
+ * Megbecsüli egy műveletsor sorfolyamban történő végrehajtásának
+ * memóriaigényét: a bemeneti blokk, fokozatonként egy kimeneti blokk és
+ * két ablaksor mérete a legszélesebb sorral számolva. A becslés a kép
+ * magasságától csak a legfeljebb egy blokknyi kis képeknél függ.
+ *
+ * @param operations A műveletek tömbje (a sorfolyamban végrehajtható).
+ * @param count A műveletek száma.
+ * @param width A bemeneti kép szélessége.
+ * @param height A bemeneti kép magassága.
+ * @return Visszatér a becsült memóriaigénnyel (bájtban).
+ */
+uint64_t stream_estimate_memory(const Operation* operations, int count, uint32_t width, uint32_t height)
+{
+	size_t stage_count;
+	if (stream_count_stages(operations, count, &stage_count) != NO_ERROR)
+		return 0;
+
+	uint32_t max_width = width, max_height = height;
+	for (int i = 0; i < count; i++)
+	{
+		if (operations[i].type != OPERATION_SCALE)
+			continue;
+		if (image_scaled_size(width, height, &operations[i].param.scale, &width, &height) != NO_ERROR)
+			break;
+		if (width > max_width)
+			max_width = width;
+		if (height > max_height)
+			max_height = height;
+	}
+
+	uint64_t row_size = (uint64_t)(max_width > 0 ? max_width : 1) * sizeof(Pixel);
+	uint64_t block_rows = stream_calculate_block_rows(max_width, max_height);
+
+	return (stage_count + 1) * block_rows * row_size + stage_count * 2 * row_size;
+}
+
+/**
+ * Felszabadítja egy sorfolyam fokozatait és a kiíró struktúrát.
+ *
+ * @param stream A sorfolyam.
+ */
+static void stream_destroy(struct stream_struct* stream)
+{
+	for (size_t i = 0; i < stream->stage_count; i++)
+	{
+		struct stream_stage_struct* stage = &stream->stages[i];
+		for (int j = 0; j < 2; j++)
+			if (stage->window[j] != NULL)
+				free(stage->window[j]);
+		if (stage->block != NULL)
+			free(stage->block);
+		if (stage->rows != NULL)
+			free((void*)stage->rows);
+		if (stage->sources != NULL)
+			free((void*)stage->sources);
+	}
+
+	if (stream->stages != NULL)
+		free(stream->stages);
+	if (stream->writer != NULL)
+		bmp_writer_close(stream->writer);
+}
+
+/**
+ * Felépíti a sorfolyam fokozatait a műveletek alapján: kiszámolja minden
+ * fokozat be- és kimeneti méreteit, ezekből a blokkok méretét, majd
+ * lefoglalja a fokozatok blokkjait (lásd stream_count_stages).
+ *
+ * @param[out] stream A felépítendő sorfolyam.
+ * @param[in] operations A műveletek tömbje.
+ * @param[in] count A műveletek száma.
+ * @param[in] width A bemeneti kép szélessége.
+ * @param[in] height A bemeneti kép magassága.
+ * @param[out] p_width A kimeneti kép szélességének helye.
+ * @param[out] p_height A kimeneti kép magasságának helye.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, hibás paraméterezés esetén
+ * IMAGE_BAD_PARAMETER-rel, memóriafoglalási hiba esetén pedig
+ * MEMORY_ERROR-ral tér vissza.
+ */
+static int stream_create_stages(struct stream_struct* stream, const Operation* operations, int count, uint32_t width, uint32_t height, uint32_t* p_width, uint32_t* p_height)
+{
+	int status;
+
+	size_t stage_count;
+	if ((status = stream_count_stages(operations, count, &stage_count)) != NO_ERROR)
+		return status;
+
+	if (stage_count > 0)
+	{
+		stream->stages = (struct stream_stage_struct*)calloc(stage_count, sizeof(struct stream_stage_struct));
+		if (stream->stages == NULL)
+			return MEMORY_ERROR;
+		stream->stage_count = stage_count;
+	}
+
+	uint32_t max_width = width, max_height = height;
+
+	struct stream_stage_struct* stage = stream->stages;
+	for (int i = 0; i < count; i++)
+	{
+		const Operation* operation = &operations[i];
+		size_t repeat = (operation->type == OPERATION_BLUR) ? abs(operation->param.value) : 1;
+		bool point = cmd_is_point_operation(operation);
+
+		if (point)
+		{
+			int composed;
+			if ((status = cmd_compose_point_operations(&stage->lut, operation, count - i, &composed)) != NO_ERROR)
+				return status;
+			i += composed - 1;
+		}
+
+		size_t total = repeat + ((operation->output != NULL) ? 1 : 0);
+		for (size_t j = 0; j < total; j++, stage++)
+		{
+			stage->operation = operation;
+			stage->lookup = point || j == repeat;
+			stage->in_width = width;
+			stage->in_height = height;
+
+			if (j == repeat)
+				stage->lut = *operation->output;
+
+			if (!stage->lookup && operation->type == OPERATION_SCALE &&
+				(status = image_scaled_size(width, height, &operation->param.scale, &width, &height)) != NO_ERROR)
+				return status;
+
+			stage->out_width = width;
+			stage->out_height = height;
+
+			if (width > max_width)
+				max_width = width;
+			if (height > max_height)
+				max_height = height;
+		}
+	}
+
+	stream->block_rows = stream_calculate_block_rows(max_width, max_height);
+
+	for (size_t i = 0; i < stream->stage_count; i++)
+	{
+		stage = &stream->stages[i];
+
+		stage->block = stream_create_rows(stage->out_width, stream->block_rows);
+		stage->rows = (const Pixel**)malloc(stream->block_rows * sizeof(const Pixel*));
+		stage->sources = (const Pixel**)malloc(3 * (size_t)stream->block_rows * sizeof(const Pixel*));
+		if (stage->block == NULL || stage->rows == NULL || stage->sources == NULL)
+			return MEMORY_ERROR;
+
+		if (!stage->lookup && stage->operation->type == OPERATION_BLUR)
+			for (int k = 0; k < 2; k++)
+				if ((stage->window[k] = stream_create_rows(stage->in_width, 1)) == NULL)
+					return MEMORY_ERROR;
+	}
+
+	*p_width = width;
+	*p_height = height;
+
+	return NO_ERROR;
+}
+
+/**
+ * Kiszámolja egy fokozat kimeneti blokkjának egy sávnyi sorát (a blokk
+ * sávokra bontott feldolgozásának egy részfeladata). A változatlanul
+ * továbbadott sorok kimaradnak.
+ *
+ * @param context A fokozat.
+ * @param first A sáv első sorának indexe a blokkban.
+ * @param last A sáv utolsó utáni sorának indexe a blokkban.
+ * @param worker A munkás indexe (nem használt).
+ */
+static void stream_compute_band(void* context, size_t first, size_t last, int worker)
+{
+	(void)worker;
+
+	const struct stream_stage_struct* stage = (const struct stream_stage_struct*)context;
+	const Operation* operation = stage->operation;
+
+	for (size_t i = first; i < last; i++)
+	{
+		const Pixel* const* sources = &stage->sources[3 * i];
+		if (sources[1] == NULL)
+			continue;
+
+		Pixel* dst = stage->block + i * (stage->out_width > 0 ? stage->out_width : 1);
+		if (stage->lookup)
+		{
+			image_lut_row(dst, sources[1], stage->in_width, &stage->lut);
+			continue;
+		}
+
+		switch (operation->type)
+		{
+		case OPERATION_SCALE:
+			image_scale_row(dst, sources[1], stage->out_width, &operation->param.scale);
+			break;
+		case OPERATION_MIRROR_Y:
+			for (uint32_t x = 0; x < stage->in_width; x++)
+				dst[x] = sources[1][stage->in_width - 1 - x];
+			break;
+		case OPERATION_BLUR:
+			image_blur_row(dst, sources[0], sources[1], sources[2], stage->in_width, operation->param.value < 0);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static int stream_push_rows(struct stream_struct* stream, size_t index, const Pixel* const* rows, uint32_t count);
+
+/**
+ * Kiszámolja egy fokozat kimeneti blokkjában összegyűjtött sorokat (a
+ * képműveletek munkáskészletén sávokra bontva), és továbbadja őket a
+ * következő fokozatnak.
+ *
+ * @param stream A sorfolyam.
+ * @param index A fokozat indexe.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a további
+ * fokozatok vagy a kiírás hibakódjával tér vissza.
+ */
+static int stream_flush_stage(struct stream_struct* stream, size_t index)
+{
+	struct stream_stage_struct* stage = &stream->stages[index];
+
+	uint32_t count = stage->pending;
+	if (count == 0)
+		return NO_ERROR;
+	stage->pending = 0;
+
+	image_run_bands(stream_compute_band, stage, count, (size_t)stage->out_width * sizeof(Pixel));
+
+	return stream_push_rows(stream, index + 1, stage->rows, count);
+}
+
+/**
+ * Hozzáad egy sort egy fokozat kimeneti blokkjához; ha a blokk megtelt,
+ * előbb kiszámolja és továbbadja a korábbi sorait.
+ *
+ * @param stream A sorfolyam.
+ * @param index A fokozat indexe.
+ * @param above A forrássor fölötti sor (elhomályosításnál), egyébként NULL.
+ * @param row A forrássor; változatlan továbbadás esetén maga a kimeneti sor.
+ * @param below A forrássor alatti sor (elhomályosításnál), egyébként NULL.
+ * @param unchanged A sor változatlanul kerül-e továbbadásra.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a további
+ * fokozatok vagy a kiírás hibakódjával tér vissza.
+ */
+static int stream_emit_row(struct stream_struct* stream, size_t index, const Pixel* above, const Pixel* row, const Pixel* below, bool unchanged)
+{
+	int status;
+
+	struct stream_stage_struct* stage = &stream->stages[index];
+	if (stage->pending == stream->block_rows && (status = stream_flush_stage(stream, index)) != NO_ERROR)
+		return status;
+
+	size_t i = stage->pending++;
+	const Pixel** sources = &stage->sources[3 * i];
+	sources[0] = above;
+	sources[1] = unchanged ? NULL : row;
+	sources[2] = below;
+	stage->rows[i] = unchanged ? row : stage->block + i * (stage->out_width > 0 ? stage->out_width : 1);
+	stage->rows_out++;
+
+	return NO_ERROR;
+}
+
+/**
+ * Megadja egy elhomályosító fokozat egy bemeneti sorát: az aktuális blokk
+ * sorait a blokkból, az azt megelőző két sort az ablakból.
+ *
+ * @param stage A fokozat.
+ * @param rows Az aktuális blokk sorai.
+ * @param first Az aktuális blokk első sorának indexe.
+ * @param y A sor indexe (legfeljebb kettővel first előtt).
+ * @return Visszatér a sorra mutató pointerrel.
+ */
+static const Pixel* stream_window_row(const struct stream_stage_struct* stage, const Pixel* const* rows, uint32_t first, uint32_t y)
+{
+	return (y >= first) ? rows[y - first] : stage->window[y + 2 - first];
+}
+
+/**
+ * Továbbad egy blokknyi sort a sorfolyam megadott fokozatának, mely a
+ * belőlük keletkező sorokat a kimeneti blokkjába gyűjti, és továbbadja a
+ * következő fokozatnak. Az utolsó fokozat utáni sorok kiírásra kerülnek.
+ * A sorok a hívó pufferében vannak, ezért a fokozat a visszatérés előtt
+ * minden belőlük keletkező sort továbbad.
+ *
+ * @param stream A sorfolyam.
+ * @param index A sorokat fogadó fokozat indexe.
+ * @param rows A sorok.
+ * @param count A sorok száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként egy I/O művelet
+ * által okozott hibakóddal tér vissza.
+ */
+static int stream_push_rows(struct stream_struct* stream, size_t index, const Pixel* const* rows, uint32_t count)
+{
+	int status = NO_ERROR;
+
+	if (index == stream->stage_count)
+	{
+		for (uint32_t i = 0; i < count && status == NO_ERROR; i++)
+		{
+			stream->rows_written++;
+			status = bmp_writer_write_row(stream->writer, rows[i]);
+		}
+		return status;
+	}
+
+	struct stream_stage_struct* stage = &stream->stages[index];
+	const Operation* operation = stage->operation;
+	uint32_t first = stage->rows_in;
+	stage->rows_in += count;
+
+	if (stage->lookup || operation->type == OPERATION_MIRROR_Y)
+	{
+		for (uint32_t i = 0; i < count && status == NO_ERROR; i++)
+			status = stream_emit_row(stream, index, NULL, rows[i], NULL, false);
+	}
+	else if (operation->type == OPERATION_SCALE)
+	{
+		/* a sorok ismétlése vagy kihagyása az image_scale leképezését követi */
+		const ImageScale* scale = &operation->param.scale;
+		uint32_t previous = UINT32_MAX;
+		while (status == NO_ERROR && stage->rows_out < stage->out_height)
+		{
+			uint32_t y = image_scale_coordinate(stage->rows_out, scale->vertical, scale->count);
+			if (y < first || y - first >= count)
+				break;
+
+			/* az ismételt sor nem számolódik újra: az előző kimeneti sorra hivatkozik */
+			if (y != previous)
+				status = stream_emit_row(stream, index, NULL, rows[y - first], NULL, false);
+			else if (stage->pending < stream->block_rows)
+				status = stream_emit_row(stream, index, NULL, stage->rows[stage->pending - 1], NULL, true);
+			else
+			{
+				/* megtelt blokk után az előző sor másolata kezdi a következőt (az első hely nem számolódik) */
+				const Pixel* last = stage->rows[stage->pending - 1];
+				if ((status = stream_flush_stage(stream, index)) == NO_ERROR)
+				{
+					memmove(stage->block, last, (size_t)stage->out_width * sizeof(Pixel));
+					status = stream_emit_row(stream, index, NULL, stage->block, NULL, true);
+				}
+			}
+			previous = y;
+		}
+	}
+	else if (operation->type == OPERATION_BLUR)
+	{
+		/* az első és az utolsó sor változatlan, a többihez a szomszédok is kellenek */
+		for (uint32_t i = 0; i < count && status == NO_ERROR; i++)
+		{
+			uint32_t y = first + i;
+			if (y == 0)
+				status = stream_emit_row(stream, index, NULL, rows[i], NULL, true);
+			if (status == NO_ERROR && y >= 2)
+				status = stream_emit_row(stream, index, stream_window_row(stage, rows, first, y - 2), stream_window_row(stage, rows, first, y - 1), rows[i], false);
+			if (status == NO_ERROR && y > 0 && y == stage->in_height - 1)
+				status = stream_emit_row(stream, index, NULL, rows[i], NULL, true);
+		}
+	}
+	else
+		status = IMAGE_BAD_PARAMETER;
+
+	if (status == NO_ERROR)
+		status = stream_flush_stage(stream, index);
+
+	/* a következő blokkhoz az utolsó két sor kell */
+	if (status == NO_ERROR && stage->window[0] != NULL && count > 0)
+	{
+		size_t size = (size_t)stage->in_width * sizeof(Pixel);
+		if (count >= 2)
+			memcpy(stage->window[0], rows[count - 2], size);
+		else
+		{
+			Pixel* previous_row = stage->window[0];
+			stage->window[0] = stage->window[1];
+			stage->window[1] = previous_row;
+		}
+		memcpy(stage->window[1], rows[count - 1], size);
+	}
+
+	return status;
+}
+
+/**
+ * Blokkonként feldolgoz egy BMP formátumú képet: beolvassa a bemeneti
+ * fájlból, elvégzi rajta a megadott műveleteket, majd kiírja a kimeneti
+ * fájlba. A memóriahasználat korlátos, a kép méretétől csak a szélességén
+ * keresztül függ (lásd stream_estimate_memory). Az egyes fokozatok
+ * blokkjait a képműveletek munkáskészlete dolgozza fel.
+ *
+ * A műveletsornak a sorfolyamban végrehajthatónak kell lennie
+ * (lásd stream_is_supported).
+ *
+ * @param input_file A bemeneti fájl.
+ * @param output_file A kimeneti fájl.
+ * @param operations A műveletek tömbje.
+ * @param count A műveletek száma.
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként a validálások,
+ * a műveletek, az allokációk vagy egy I/O művelet által okozott hibakóddal
+ * tér vissza.
+ */
+int stream_process(FILE* input_file, FILE* output_file, const Operation* operations, int count)
+{
+	int status;
+
+	BmpReader* reader;
+	uint32_t width, height;
+
+	if ((status = bmp_reader_open(&reader, input_file, &width, &height)) != NO_ERROR)
+		return status;
+
+	struct stream_struct stream = { .stages = NULL, .stage_count = 0, .block_rows = 0, .writer = NULL, .rows_written = 0 };
+	Pixel* input = NULL;
+	const Pixel** input_rows = NULL;
+
+	uint32_t out_width, out_height;
+	if ((status = stream_create_stages(&stream, operations, count, width, height, &out_width, &out_height)) != NO_ERROR)
+		goto cleanup;
+
+	input = stream_create_rows(width, stream.block_rows);
+	input_rows = (const Pixel**)malloc(stream.block_rows * sizeof(const Pixel*));
+	if (input == NULL || input_rows == NULL)
+	{
+		status = MEMORY_ERROR;
+		goto cleanup;
+	}
+	for (uint32_t i = 0; i < stream.block_rows; i++)
+		input_rows[i] = input + (size_t)i * (width > 0 ? width : 1);
+
+	if ((status = bmp_writer_open(&stream.writer, output_file, out_width, out_height)) != NO_ERROR)
+		goto cleanup;
+
+	for (uint32_t y = 0; y < height; )
+	{
+		uint32_t rows = (height - y < stream.block_rows) ? height - y : stream.block_rows;
+		for (uint32_t i = 0; i < rows; i++)
+			if ((status = bmp_reader_read_row(reader, (Pixel*)input_rows[i])) != NO_ERROR)
+				goto cleanup;
+		if ((status = stream_push_rows(&stream, 0, input_rows, rows)) != NO_ERROR)
+			goto cleanup;
+		y += rows;
+	}
+
+	/* a skálázás leképezése miatt elvben kimaradhatnának sorok */
+	if (stream.rows_written != out_height)
+	{
+		status = IMAGE_BAD_PARAMETER;
+		goto cleanup;
+	}
+
+	/* a pufferben maradt sorok kiírása is hibát okozhat */
+	status = bmp_writer_close(stream.writer);
+	stream.writer = NULL;
+
+cleanup:
+	if (input_rows != NULL)
+		free((void*)input_rows);
+	if (input != NULL)
+		free(input);
+	stream_destroy(&stream);
+	bmp_reader_close(reader);
+	return status;
+}
@@ -0,0 +1,21 @@
+﻿/*****************************************************************//**
+ * @file   stream.h
+ * @brief  A képeket soronként, a teljes kép memóriába töltése nélkül
+ * feldolgozó modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef STREAM_H_INCLUDED
+#define STREAM_H_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "cmd.h"
+
+bool stream_is_supported(const Operation* operations, int count);
+uint64_t stream_estimate_memory(const Operation* operations, int count, uint32_t width, uint32_t height);
+int stream_process(FILE* input_file, FILE* output_file, const Operation* operations, int count);
+
+#endif /* STREAM_H_INCLUDED */
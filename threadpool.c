@@ -0,0 +1,344 @@
+﻿/*****************************************************************//**
+ * @file   threadpool.c
+ * @brief  Független részfeladatokat több szálon végrehajtó munkáskészlet
+ * modul forrásfájlja.
+ *
+ * A készlet szálai a készlet teljes élettartama alatt futnak, és egy
+ * feltételváltozón várakoznak a következő feladatra. Egy feladat
+ * (threadpool_run) részfeladatai induláskor egyenlő, összefüggő
+ * tartományokban kerülnek a munkások – köztük a hívó szál – saját
+ * soraiba (deque), melyeket a munkások az elejükről, sorban dolgoznak fel,
+ * így a szomszédos részfeladatok (például egy kép szomszédos sávjai)
+ * ugyanazon a szálon, a gyorsítótárban maradva futnak. A saját sorát
+ * kiürítő munkás egy másik munkás sorának végéről ellopja a hátralévő
+ * részfeladatok felét, így az egyenetlen költségű részfeladatok, illetve a
+ * más folyamatok által lassított szálak sem hagynak tétlenül magokat. A
+ * sorokat külön-külön zárak védik, így a munkások csak lopáskor
+ * versengenek egymással.
+ *
+ * A részfeladatok nem foglalhatnak memóriát a debugmalloc-on keresztül,
+ * mivel az nem szálbiztos; a szükséges puffereket a hívónak kell előre,
+ * munkásonként lefoglalnia.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#include "threadpool.h"
+#include "platform.h"
+#include "status.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifndef NDEBUG
+#include "debugmalloc.h"
+#endif
+
+/* a munkáskészlet egy szálának argumentuma */
+struct thread_pool_worker_struct
+{
+	ThreadPool* pool; /* a munkáskészlet */
+	int index; /* a munkás indexe (a hívó szálé 0) */
+	PlatformThread* thread; /* a munkás szála */
+};
+
+/*
+ * Egy munkás részfeladatainak sora: a [head, tail) indextartomány. A munkás
+ * az elejéről veszi ki a következő részfeladatot, a többiek a végéről
+ * lopnak.
+ */
+struct thread_pool_deque_struct
+{
+	PlatformMutex* mutex; /* a tartományt védő zár */
+	size_t head; /* a munkás következő részfeladata */
+	size_t tail; /* az utolsó utáni részfeladat */
+};
+
+/* munkáskészlet */
+struct thread_pool_struct
+{
+	int thread_count; /* a szálak száma a hívó szállal együtt */
+	struct thread_pool_worker_struct* workers; /* a háttérszálak (thread_count - 1 darab) */
+	struct thread_pool_deque_struct* deques; /* munkásonként a részfeladatok sora */
+	int deque_count; /* a létrehozott sorok száma */
+	PlatformMutex* mutex; /* az alábbi mezőket védő zár */
+	PlatformCondition* work_ready; /* új feladat érkezését vagy leállítást jelző feltételváltozó */
+	PlatformCondition* work_done; /* a háttérszálak végzését jelző feltételváltozó */
+	unsigned generation; /* az eddig kiadott feladatok száma */
+	bool stopping; /* le kell-e állniuk a szálaknak */
+	ftask function; /* az aktuális feladat függvénye */
+	void* context; /* az aktuális feladat közös állapota */
+	int busy_workers; /* az aktuális feladaton még dolgozó háttérszálak száma */
+};
+
+/**
+ * Kivesz egy részfeladatot egy munkás saját sorának elejéről.
+ *
+ * @param pool A munkáskészlet.
+ * @param worker A munkás indexe.
+ * @param p_task A részfeladat indexének helye.
+ * @return Logikai igazzal tér vissza, ha a sor nem volt üres.
+ */
+static bool threadpool_pop(ThreadPool* pool, int worker, size_t* p_task)
+{
+	struct thread_pool_deque_struct* deque = &pool->deques[worker];
+
+	platform_mutex_lock(deque->mutex);
+	bool found = (deque->head < deque->tail);
+	if (found)
+		*p_task = deque->head++;
+	platform_mutex_unlock(deque->mutex);
+
+	return found;
+}
+
+/**
+ * Ellopja egy másik munkás sorának végéről a hátralévő részfeladatok felét
+ * (felfelé kerekítve): az elsőt visszaadja, a többit a saját (üres) sorába
+ * teszi. A munkásokat a következőtől kezdve, körben vizsgálja.
+ *
+ * @param pool A munkáskészlet.
+ * @param worker A lopó munkás indexe.
+ * @param p_task A részfeladat indexének helye.
+ * @return Logikai igazzal tér vissza, ha talált részfeladatot; hamissal,
+ * ha minden sor üres.
+ */
+static bool threadpool_steal(ThreadPool* pool, int worker, size_t* p_task)
+{
+	for (int i = 1; i < pool->thread_count; i++)
+	{
+		struct thread_pool_deque_struct* victim = &pool->deques[(worker + i) % pool->thread_count];
+
+		platform_mutex_lock(victim->mutex);
+		size_t count = (victim->tail - victim->head + 1) / 2;
+		size_t first = victim->tail - count;
+		victim->tail = first;
+		platform_mutex_unlock(victim->mutex);
+
+		if (count == 0)
+			continue;
+
+		struct thread_pool_deque_struct* deque = &pool->deques[worker];
+		platform_mutex_lock(deque->mutex);
+		deque->head = first + 1;
+		deque->tail = first + count;
+		platform_mutex_unlock(deque->mutex);
+
+		*p_task = first;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Végrehajtja az aktuális feladat részfeladatait: előbb a saját sorából,
+ * majd a többiektől lopva, amíg minden sor ki nem ürül.
+ *
+ * @param pool A munkáskészlet.
+ * @param worker A munkás indexe.
+ */
+static void threadpool_work(ThreadPool* pool, int worker)
+{
+	size_t task;
+	while (threadpool_pop(pool, worker, &task) || threadpool_steal(pool, worker, &task))
+		pool->function(pool->context, task, worker);
+}
+
+/**
+ * A háttérszálak főciklusa: megvárja a következő feladatot, részt vesz a
+ * végrehajtásában, majd jelzi a végzést, egészen a készlet leállításáig.
+ *
+ * @param argument A munkás leírója.
+ */
+static void threadpool_worker_main(void* argument)
+{
+	struct thread_pool_worker_struct* worker = (struct thread_pool_worker_struct*)argument;
+	ThreadPool* pool = worker->pool;
+
+	unsigned seen = 0;
+
+	for (;;)
+	{
+		platform_mutex_lock(pool->mutex);
+		while (!pool->stopping && pool->generation == seen)
+			platform_condition_wait(pool->work_ready, pool->mutex);
+		if (pool->stopping)
+		{
+			platform_mutex_unlock(pool->mutex);
+			break;
+		}
+		seen = pool->generation;
+		platform_mutex_unlock(pool->mutex);
+
+		threadpool_work(pool, worker->index);
+
+		platform_mutex_lock(pool->mutex);
+		if (--pool->busy_workers == 0)
+			platform_condition_broadcast(pool->work_done);
+		platform_mutex_unlock(pool->mutex);
+	}
+}
+
+/**
+ * Létrehoz egy munkáskészletet, és elindítja a háttérszálait. A hívó szál
+ * is munkásnak számít, így thread_count - 1 háttérszál indul; egy szál
+ * esetén a részfeladatok a hívó szálon, sorban futnak le.
+ *
+ * A lefoglalt erőforrások felszabadítása (threadpool_destroy) a hívó
+ * feladata.
+ *
+ * @param p_pool A munkáskészletre mutató pointer helye.
+ * @param thread_count A szálak száma (legalább 1).
+ * @return Sikeres lefutás esetén NO_ERROR-ral, egyébként MEMORY_ERROR-ral
+ * tér vissza.
+ */
+int threadpool_create(ThreadPool** p_pool, int thread_count)
+{
+	ThreadPool* pool = (ThreadPool*)malloc(sizeof(ThreadPool));
+	if (pool == NULL)
+		return MEMORY_ERROR;
+
+	pool->thread_count = 1;
+	pool->workers = NULL;
+	pool->deques = NULL;
+	pool->deque_count = 0;
+	pool->mutex = NULL;
+	pool->work_ready = NULL;
+	pool->work_done = NULL;
+	pool->generation = 0;
+	pool->stopping = false;
+	pool->busy_workers = 0;
+
+	if (thread_count > 1)
+	{
+		pool->workers = (struct thread_pool_worker_struct*)malloc((thread_count - 1) * sizeof(struct thread_pool_worker_struct));
+		pool->deques = (struct thread_pool_deque_struct*)malloc(thread_count * sizeof(struct thread_pool_deque_struct));
+		if (pool->workers == NULL || pool->deques == NULL ||
+			platform_mutex_create(&pool->mutex) != NO_ERROR ||
+			platform_condition_create(&pool->work_ready) != NO_ERROR ||
+			platform_condition_create(&pool->work_done) != NO_ERROR)
+		{
+			threadpool_destroy(pool);
+			return MEMORY_ERROR;
+		}
+
+		for (int i = 0; i < thread_count; i++)
+		{
+			pool->deques[i].head = pool->deques[i].tail = 0;
+			if (platform_mutex_create(&pool->deques[i].mutex) != NO_ERROR)
+			{
+				threadpool_destroy(pool);
+				return MEMORY_ERROR;
+			}
+			pool->deque_count++;
+		}
+
+		for (int i = 1; i < thread_count; i++)
+		{
+			struct thread_pool_worker_struct* worker = &pool->workers[i - 1];
+			worker->pool = pool;
+			worker->index = i;
+			if (platform_thread_create(&worker->thread, threadpool_worker_main, worker) != NO_ERROR)
+			{
+				threadpool_destroy(pool);
+				return MEMORY_ERROR;
+			}
+			pool->thread_count++;
+		}
+	}
+
+	*p_pool = pool;
+
+	return NO_ERROR;
+}
+
+/**
+ * Leállítja és bevárja egy munkáskészlet háttérszálait, majd felszabadítja
+ * a készletet.
+ *
+ * @param pool A munkáskészlet.
+ */
+void threadpool_destroy(ThreadPool* pool)
+{
+	if (pool->thread_count > 1)
+	{
+		platform_mutex_lock(pool->mutex);
+		pool->stopping = true;
+		platform_condition_broadcast(pool->work_ready);
+		platform_mutex_unlock(pool->mutex);
+
+		for (int i = 1; i < pool->thread_count; i++)
+			platform_thread_join(pool->workers[i - 1].thread);
+	}
+
+	if (pool->work_done != NULL)
+		platform_condition_destroy(pool->work_done);
+	if (pool->work_ready != NULL)
+		platform_condition_destroy(pool->work_ready);
+	if (pool->mutex != NULL)
+		platform_mutex_destroy(pool->mutex);
+	for (int i = 0; i < pool->deque_count; i++)
+		platform_mutex_destroy(pool->deques[i].mutex);
+	if (pool->deques != NULL)
+		free(pool->deques);
+	if (pool->workers != NULL)
+		free(pool->workers);
+	free(pool);
+}
+
+/**
+ * Megadja egy munkáskészlet szálainak számát (a hívó szállal együtt), ami
+ * egyben a részfeladatoknak átadott munkásindexek felső korlátja.
+ *
+ * @param pool A munkáskészlet.
+ * @return Visszatér a szálak számával.
+ */
+int threadpool_get_thread_count(const ThreadPool* pool)
+{
+	return pool->thread_count;
+}
+
+/**
+ * Végrehajtja egy feladat task_count darab részfeladatát a munkáskészlet
+ * szálain, és csak az összes részfeladat végeztével tér vissza. A
+ * részfeladatok indexeik szerint, összefüggő tartományokban oszlanak el a
+ * munkások között, a végrehajtás sorrendje és szálakhoz rendelése azonban
+ * a lopások miatt nem meghatározott.
+ *
+ * @param pool A munkáskészlet.
+ * @param function A részfeladatokat végrehajtó függvény.
+ * @param context A részfeladatok közös állapota.
+ * @param task_count A részfeladatok száma.
+ */
+void threadpool_run(ThreadPool* pool, ftask function, void* context, size_t task_count)
+{
+	if (pool->thread_count == 1)
+	{
+		for (size_t task = 0; task < task_count; task++)
+			function(context, task, 0);
+		return;
+	}
+
+	/* a háttérszálak várakoznak, így a sorok zárak nélkül tölthetők fel */
+	for (int i = 0; i < pool->thread_count; i++)
+	{
+		pool->deques[i].head = task_count * i / pool->thread_count;
+		pool->deques[i].tail = task_count * (i + 1) / pool->thread_count;
+	}
+
+	platform_mutex_lock(pool->mutex);
+	pool->function = function;
+	pool->context = context;
+	pool->busy_workers = pool->thread_count - 1;
+	pool->generation++;
+	platform_condition_broadcast(pool->work_ready);
+	platform_mutex_unlock(pool->mutex);
+
+	threadpool_work(pool, 0);
+
+	platform_mutex_lock(pool->mutex);
+	while (pool->busy_workers > 0)
+		platform_condition_wait(pool->work_done, pool->mutex);
+	platform_mutex_unlock(pool->mutex);
+}
@@ -0,0 +1,29 @@
+﻿/*****************************************************************//**
+ * @file   threadpool.h
+ * @brief  Független részfeladatokat több szálon végrehajtó munkáskészlet
+ * modul fejlécfájlja.
+ *
+ * @author Zoltán Szatmáry
+ * @date   November 2022
+ *********************************************************************/
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+
+#include <stddef.h>
+
+/* egy munkáskészlet (opaque típus) */
+typedef struct thread_pool_struct ThreadPool;
+
+/*
+ * Egy részfeladatot végrehajtó függvényre mutató függvénypointer típus:
+ * a context a közös állapot, a task a részfeladat indexe, a worker pedig a
+ * végrehajtó munkás (a [0, szálak száma) tartományból vett) indexe.
+ */
+typedef void(*ftask)(void* context, size_t task, int worker);
+
+int threadpool_create(ThreadPool** p_pool, int thread_count);
+void threadpool_destroy(ThreadPool* pool);
+int threadpool_get_thread_count(const ThreadPool* pool);
+void threadpool_run(ThreadPool* pool, ftask function, void* context, size_t task_count);
+
+#endif /* THREADPOOL_H_INCLUDED */